@@ -11,7 +11,7 @@
 
 #include "stdbool.h"
 
-#define MAX_CELLS_PER_MODULE   192
+#define MAX_CELLS_PER_MODULE   192      // Highest cell count accepted from a module - cell data is kept in mcu_cells.c sized by the count reported
 #define MAX_MODULES_PER_PACK   32
 
 
@@ -78,6 +78,10 @@ typedef struct {
 
 typedef struct {
   uint16_t     firstModule;
+  uint16_t     mcuRxOverflow;     // module bus RX FIFO overflows
+  uint16_t     mcuRxRingDrop;     // module bus frames dropped, RX ring full
+  uint16_t     mcuTxDrop;         // module bus frames dropped, TX queue class full
+  uint16_t     vcuTxDrop;         // VCU bus frames dropped, TX queue class full
 }errorCounts;
 
 typedef struct {
@@ -102,6 +106,23 @@ typedef struct {
   powerUpStage  powerStage;
 }powerStatus;
 
+typedef struct {                // one complete Status1/2/3 set
+  uint16_t    mmv;
+  uint16_t    mmc;
+  uint16_t    cellHiTemp;
+  uint16_t    cellLoTemp;
+  uint16_t    cellAvgTemp;
+  uint16_t    cellHiVolt;
+  uint16_t    cellLoVolt;
+  uint16_t    cellAvgVolt;
+  uint16_t    cellTotalVolt;
+  uint8_t     status;
+  moduleState currentState;
+  uint8_t     soc;
+  uint8_t     soh;
+  uint8_t     cellCount;
+}moduleStatus;
+
 typedef struct {
   uint8_t     mfgId;
   uint8_t     partId;  // module part ID
@@ -122,24 +143,33 @@ typedef struct {
   uint16_t    cellAvgVolt;    // average voltage
   uint16_t    cellTotalVolt;  // sum of the cell voltages
   uint8_t     status;
-  moduleState currentState;
-  moduleState nextState;
   command     command;
   uint8_t     soc;
   uint8_t     soh;
   uint8_t     cellCount;
-  batteryCell cell[MAX_CELLS_PER_MODULE];
-  lastContact_t lastContact;
   lastContact_t lastTransmit;
   bool        hardwarePending;
-  bool        statusPending;
-  bool        waiting;           // General flag - waiting for any response
-  faultCode   faultCode;
   uint8_t     consecutiveTimeouts;
   uint8_t     statusMessagesReceived;  // Bitmask: bit0=Status1, bit1=Status2, bit2=Status3
-  bool        isRegistered;            // Module currently registered (vs just known)
+  bool        canFd;                   // Module reported MODULE_HW_CAP_CANFD
+  moduleStatus staging;                // Status1/2/3 being assembled - published when all 3 have arrived
+  volatile uint16_t statusSeq;         // Published status sequence - odd while MCU_PublishModuleStatus() is writing
 }batteryModule;
 
+// Fields the control loops read for every module on every pass, one array per field so a scan of one
+// field over the pack touches a single cache line. Indexed like module[]; the cells are kept apart in
+// the cell arena (mcu_cells.h).
+typedef struct {
+  bool          isRegistered[MAX_MODULES_PER_PACK];   // Module currently registered (vs just known)
+  bool          statusPending[MAX_MODULES_PER_PACK];
+  bool          waiting[MAX_MODULES_PER_PACK];        // General flag - waiting for any response
+  faultCode     faultCode[MAX_MODULES_PER_PACK];
+  uint8_t       currentState[MAX_MODULES_PER_PACK];   // moduleState - published with the module status
+  uint8_t       nextState[MAX_MODULES_PER_PACK];      // moduleState
+  lastContact_t lastContact[MAX_MODULES_PER_PACK];    // last frame from the module
+  lastContact_t lastTimeout[MAX_MODULES_PER_PACK];    // last status timeout - the next one is MCU_ET_TIMEOUT after the later of the two
+}moduleControl;
+
 
 typedef struct {
   uint8_t     id;
@@ -178,12 +208,14 @@ typedef struct {
   packState   vcuRequestedState;
   uint8_t     soc;
   uint8_t     soh;
+  uint16_t    socEstimate;    // coulomb counted SOC - 1/640 % (mcu_soc.h)
   lastContact_t vcuLastContact;
   errorCounts errorCounts;
   bool        rtcValid;
   uint16_t    vcuHvBusVoltage;
   controlMode controlMode;
   uint8_t     dmcModuleId;
+  bool        moduleBusFd;    // module requests sent as CAN FD - every registered module is FD capable
 }batteryPack;
 
 
@@ -0,0 +1,77 @@
+ /**************************************************************************************************************
+ * @file           : can_channels.h                                                P A C K   C O N T R O L L E R
+ * @brief          : MCP2517FD channel map - transmit queue and FIFOs per bus, receive filters per FIFO
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef CAN_CHANNELS_H_
+#define CAN_CHANNELS_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "canfdspi_api.h"
+#include "can_tx_queue.h"
+
+
+/***************************************************************************************************************
+* CAN Channel Map                                                                  P A C K   C O N T R O L L E R
+
+  Summary:
+    Which controller channels a bus uses, how deep each is, and which frames each receive FIFO takes.
+
+  Description:
+    fifo[] lists the channels to configure - the TXQ (CAN_TXQUEUE_CH0) and FIFO 1 upwards. The controller
+    gives its 2 KB of RAM to the TXQ and then to FIFO 1, 2, ... in channel order, so the channels a map uses
+    start at FIFO 1 and leave no gaps. Every object holds a 64 byte payload: 72 bytes a message, transmit or
+    receive. CanChannels_Configure() refuses a map that does not fit.
+
+    Transmit channels are loaded by CAN_TX_CLASS_ (can_tx_queue.h) through txClass[]. The controller sends
+    from the highest txPriority channel with a message waiting; the TXQ sends its lowest ID first.
+
+    route[] becomes the acceptance filters, in order - filter 0 first. The controller takes the lowest
+    numbered filter a frame matches and drops a frame no filter matches before it reaches RAM, so traffic
+    the firmware does not decode never costs an SPI read. A route matches the standard ID bits set in mask,
+    of the frame kind the bus carries - extended on the module bus, standard on the VCU bus. sidOffset, when
+    set, is added to every route's sid: the VCU bus IDs move with pack.vcuCanOffset, which must leave the
+    masked low bits clear. CanChannels_Filter() writes the filters again after the offset changes.
+
+    rxEvent picks when a receive FIFO asserts the RX interrupt - CAN_RX_FIFO_NOT_EMPTY_EVENT to drain each
+    frame as it lands, CAN_RX_FIFO_HALF_FULL_EVENT to leave a bulk FIFO to the main loop until it fills.
+***************************************************************************************************************/
+
+typedef struct {
+  CAN_FIFO_CHANNEL  channel;
+  uint8_t           depth;                  // messages, 1-32
+  uint8_t           txPriority;             // 1-32 for a transmit channel, higher sent first - 0 receives
+  CAN_RX_FIFO_EVENT rxEvent;                // receive FIFOs - interrupt enable
+} canFifo_t;
+
+typedef struct {
+  uint16_t          sid;                    // standard ID
+  uint16_t          mask;                   // standard ID bits that must match
+  CAN_FIFO_CHANNEL  fifo;
+} canRoute_t;
+
+typedef struct {
+  const canFifo_t*  fifo;
+  uint8_t           fifos;
+  const canRoute_t* route;
+  uint8_t           routes;                 // up to 32 filters
+  bool              extended;               // frames the bus carries - the other kind is filtered out
+  const uint16_t*   sidOffset;              // added to the route IDs - NULL for none
+  CAN_FIFO_CHANNEL  txClass[CAN_TX_CLASSES];
+} canChannelMap_t;
+
+#define CAN_CHANNEL_OBJECT_BYTES  (8 + 64)  // header and a 64 byte payload, no time stamp
+
+extern const canChannelMap_t mcuChannelMap;
+extern const canChannelMap_t vcuChannelMap;
+
+int8_t CanChannels_Configure(CANFDSPI_MODULE_ID index, const canChannelMap_t* map);
+int8_t CanChannels_Filter(CANFDSPI_MODULE_ID index, const canChannelMap_t* map);
+uint16_t CanChannels_RamBytes(const canChannelMap_t* map);
+bool CanChannels_Txq(const canChannelMap_t* map);
+
+#endif /* CAN_CHANNELS_H_ */
@@ -55,10 +55,19 @@ typedef struct {                  // 0x504 MODULE STATUS #3 - 8 bytes
   uint32_t cellLoTemp   : 16;     // module highest cell temperature
   uint32_t cellHiTemp   : 16;     // module lowest cell temperature
   uint32_t cellAvgTemp  : 16;     // module average cell temperature
-  uint32_t UNUSED_32_63 : 16;
+  uint32_t hwCaps       : 4;      // module capabilities - MODULE_HW_CAP_CANFD, 0 from modules that predate it
+  uint32_t UNUSED_52_63 : 12;
 }CANFRM_MODULE_STATUS_3;
 
 
+typedef struct {                  // 0x50B MODULE STATUS FD - 64 bytes, CAN FD only
+  CANFRM_MODULE_STATUS_1 status1; // bytes 0-7   - as 0x502
+  CANFRM_MODULE_STATUS_2 status2; // bytes 8-15  - as 0x503
+  CANFRM_MODULE_STATUS_3 status3; // bytes 16-23 - as 0x504
+  uint8_t  UNUSED_24_63[40];      // reserved - a module may send DLC 24 and leave these off
+}CANFRM_MODULE_STATUS_FD;
+
+
 typedef struct {                  // 0x505 MODULE DETAIL - 8 bytes
   uint32_t cellId       : 8;      // cell ID
   uint32_t cellCount    : 8;      // module total number of cells (0-255)
@@ -68,6 +77,14 @@ typedef struct {                  // 0x505 MODULE DETAIL - 8 bytes
   uint32_t cellSoh      : 8;      // cell SOH
 }CANFRM_MODULE_DETAIL;
 
+typedef struct {                  // 0x50C MODULE CELL FD - 64 bytes, CAN FD only
+  uint8_t  firstCell;             // cell number of value[0]
+  uint8_t  cellCount;             // values in this frame (1-CELL_FD_MAX_CELLS)
+  uint8_t  kind;                  // CELL_FD_VOLTAGE (mV) or CELL_FD_TEMPERATURE (0.01 C + 55.35 C)
+  uint8_t  totalCells;            // module total number of cells
+  uint16_t value[30];             // raw cell values - DLC covers 4 + 2 * cellCount bytes
+}CANFRM_MODULE_CELL_FD;
+
 typedef struct {                   // 0x515 MODULE DETAIL REQUEST - 3 bytes
   uint32_t moduleId      : 8;      // module ID
   uint32_t cellId        : 8;      // module cell number
@@ -75,6 +92,28 @@ typedef struct {                   // 0x515 MODULE DETAIL REQUEST - 3 bytes
   uint32_t UNUSED_32_63  : 32;     // UNUSED bits 32-63
 }CANFRM_MODULE_DETAIL_REQUEST;
 
+typedef struct {                   // 0x519 MODULE DETAIL STREAM REQUEST - 4 bytes
+  uint32_t firstCell     : 8;      // first cell to send
+  uint32_t windowSize    : 8;      // cells sent back to back before waiting for a window ACK (1-16)
+  uint32_t transferId    : 8;      // echoed in every window ACK
+  uint32_t UNUSED_24_31  : 8;
+}CANFRM_MODULE_DETAIL_STREAM_REQUEST;
+
+typedef struct {                   // 0x51A MODULE DETAIL WINDOW ACK - 5 bytes
+  uint32_t transferId    : 8;      // transfer being acknowledged
+  uint32_t windowBase    : 8;      // first cell ID of the window
+  uint32_t bitmap        : 16;     // bit n set = cell windowBase + n received
+  uint32_t status        : 8;      // DETAIL_ACK_OK, DETAIL_ACK_RETRY or DETAIL_ACK_ABORT
+  uint32_t UNUSED_40_63  : 24;
+}CANFRM_MODULE_DETAIL_WINDOW_ACK;
+
+typedef struct {                   // 0x51B MODULE CELL BALANCE - 8 bytes
+  uint32_t firstCell     : 8;      // cell number of mask bit 0
+  uint32_t duration      : 8;      // seconds to bleed before stopping unless a new frame arrives
+  uint32_t cellMaskLo    : 16;     // bit n set = bleed cell firstCell + n (cells 0-15)
+  uint32_t cellMaskHi;             // cells 16-47
+}CANFRM_MODULE_CELL_BALANCE;
+
 
 typedef struct {                  // 0x510 MODULE REGISTRATION - 8 bytes
   uint32_t moduleId       : 8;    // modules Id number used for future data exchange rather than unique ID
@@ -89,6 +128,11 @@ typedef struct {                  // 0x512 MODULE STATUS REQUEST - 1 byte
   uint8_t moduleId      : 8;      // module ID
 }CANFRM_MODULE_STATUS_REQUEST;
 
+typedef struct {                  // 0x512 MODULE STATUS REQUEST (broadcast, module ID 0x00) - 2 bytes
+  uint8_t slotWidth     : 8;      // response slot width in MODULE_STATUS_SLOT_UNIT_US units
+  uint8_t sequence      : 8;      // request sequence number - for logging
+}CANFRM_MODULE_STATUS_BROADCAST;
+
 
 typedef struct {                  // 0x514 MODULE STATE CHANGE - 4 bytes
   uint32_t moduleId      : 8;     // module ID
@@ -64,6 +64,15 @@ typedef struct {                                // 0x406 VCU_REQUEST_MODULE_LIST
   uint32_t UNUSED_32_63                   : 32; // 32-63
 }CANFRM_0x406_VCU_REQUEST_MODULE_LIST;
 
+typedef struct {                                // 0x40B VCU_REQUEST_TELEMETRY - 8 bytes
+  uint32_t module_id                      : 8;  // 00-07
+  uint32_t tier                           : 2;  // 08-09                                                              TELEM_TIER_RAW, TELEM_TIER_1S, TELEM_TIER_10S or TELEM_TIER_60S
+  uint32_t UNUSED_10_15                   : 6;  // 10-15
+  uint32_t first_entry                    : 8;  // 16-23                                                              0 = newest entry
+  uint32_t entry_count                    : 8;  // 24-31                                                              0 = every entry from first_entry
+  uint32_t UNUSED_32_63                   : 32; // 32-63
+}CANFRM_0x40B_VCU_REQUEST_TELEMETRY;
+
 
 typedef struct {                                // 0x410 BMS_STATE - 8 bytes
                                                 // Bits   Factor     Offset   Min     Max           Unit
@@ -142,6 +151,17 @@ typedef struct {                                // 0x410 BMS_STATE - 8 bytes
   uint32_t UNUSED_56_63                      : 8;  // 56-63
  }CANFRM_0x416_MODULE_LIMITS;
 
+ typedef struct {                                  // 0x418 MODULE_TELEMETRY - 8 bytes, TELEM_PAGES frames per entry
+                                                   // Bits   Factor     Offset   Min        Max         Unit
+  uint32_t module_id                         : 8;  // 00-07
+  uint32_t tier                              : 2;  // 08-09                                                        As requested
+  uint32_t page                              : 2;  // 10-11                                                        TELEM_PAGE_VOLTAGE, TELEM_PAGE_CURRENT, TELEM_PAGE_CELL_VOLT or TELEM_PAGE_CELL_TEMP
+  uint32_t entry                             : 4;  // 12-15                                                        0 = newest entry
+  uint32_t value_0                           : 16; // 16-31                                                        Page values - see MODULE TELEMETRY in CAN_ID_ALL.h
+  uint32_t value_1                           : 16; // 32-47
+  uint32_t value_2                           : 16; // 48-63
+ }CANFRM_0x418_MODULE_TELEMETRY;
+
  typedef struct {                                // 0x430 (was 0xCF10CF3) BMS_DATA_10 - 8 bytes
                                                  // Bits   Factor     Offset   Min     Max           Unit
    uint32_t module_hv_bus_actv_iso         : 16; // 00-15  0.01       0        0       6553.5        Ohm/V             High-Voltage Bus Active Isolation Test Results
@@ -0,0 +1,139 @@
+ /**************************************************************************************************************
+ * @file           : can_rx_ring.h                                                 P A C K   C O N T R O L L E R
+ * @brief          : Lock-free single producer / single consumer ring of received CAN frames
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef CAN_RX_RING_H_
+#define CAN_RX_RING_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "canfdspi_defines.h"
+
+
+/***************************************************************************************************************
+* CAN Receive Ring                                                                 P A C K   C O N T R O L L E R
+
+  Summary:
+    Frames read out of an MCP2517FD RX FIFO from interrupt context, handed to the main loop without a lock.
+
+  Description:
+    One producer - the RX drain, run from the SPI DMA interrupt - and one consumer - the main loop. The
+    producer copies each message object the driver read into the slot CanRxRing_Reserve() gives it and
+    publishes it with CanRxRing_Commit(). The consumer reads the oldest frame in place with CanRxRing_Peek()
+    and gives the slot back with CanRxRing_Release().
+
+    head and tail are free running counters, each written by one side only. The count is head - tail, and
+    the slot is the counter masked by CAN_RX_RING_SIZE - 1. Publishing a counter is a release store and
+    reading the other side's counter an acquire load, so the frame contents are visible before the counter
+    that hands them over - a DMB on the Cortex-M4, real ordering when the host bench runs the two sides on
+    separate threads.
+
+    The controller FIFO must be emptied whether or not the ring has room, otherwise it overflows and its
+    interrupt line stays asserted. When the ring is full CanRxRing_Reserve() returns the spare slot instead
+    - the frame is read and thrown away - and counts the drop. Drops and controller FIFO overflows are
+    counted by the producer only; the consumer reads them to report what changed.
+
+    CanRxRing_Init() is for when no producer can run. Once the drain is live the consumer empties the ring
+    with CanRxRing_Flush(), which only moves tail up to head - the producer may be mid-batch.
+***************************************************************************************************************/
+
+#define CAN_RX_RING_SIZE    128     // power of two - a 32 module broadcast status burst (96 frames) with room
+
+typedef struct {
+  CAN_RX_MSGOBJ obj;                        // ID, control and time stamp as the driver read them
+  uint8_t       data[MAX_DATA_BYTES];
+} canRxFrame_t;
+
+typedef struct {
+  uint32_t      head;                       // frames committed - producer only
+  uint32_t      tail;                       // frames released - consumer only
+  uint32_t      drops;                      // frames read while the ring was full - producer only
+  uint32_t      overflows;                  // controller FIFO overflows seen - producer only
+  uint32_t      peak;                       // most frames held at once - producer only
+  canRxFrame_t  spare;                      // where a frame that finds the ring full is read to
+  canRxFrame_t  frame[CAN_RX_RING_SIZE];
+} canRxRing_t;
+
+/***************************************************************************************************************
+*     C a n R x R i n g _ I n i t                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void CanRxRing_Init(canRxRing_t* ring)
+{
+  memset(ring, 0, sizeof(*ring));
+}
+
+/***************************************************************************************************************
+*     C a n R x R i n g _ F l u s h                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint32_t CanRxRing_Flush(canRxRing_t* ring)
+{
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint32_t released = head - ring->tail;
+
+  // every frame committed so far is released - a frame committed after the load stays for the consumer
+  __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+  return released;
+}
+
+/***************************************************************************************************************
+*     C a n R x R i n g _ C o u n t                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint32_t CanRxRing_Count(const canRxRing_t* ring)
+{
+  return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/***************************************************************************************************************
+*     C a n R x R i n g _ R e s e r v e                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline canRxFrame_t* CanRxRing_Reserve(canRxRing_t* ring)
+{
+  uint32_t head = ring->head;
+
+  // the slot is free once the consumer's release of it is visible
+  if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= CAN_RX_RING_SIZE){
+    ring->drops++;
+    return &ring->spare;
+  }
+  return &ring->frame[head & (CAN_RX_RING_SIZE - 1)];
+}
+
+/***************************************************************************************************************
+*     C a n R x R i n g _ C o m m i t                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void CanRxRing_Commit(canRxRing_t* ring, const canRxFrame_t* frame)
+{
+  uint32_t head = ring->head;
+  uint32_t held;
+
+  if(frame == &ring->spare) return;
+  held = head + 1 - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  if(held > ring->peak) ring->peak = held;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/***************************************************************************************************************
+*     C a n R x R i n g _ P e e k                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline const canRxFrame_t* CanRxRing_Peek(const canRxRing_t* ring)
+{
+  uint32_t tail = ring->tail;
+
+  if(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) return NULL;
+  return &ring->frame[tail & (CAN_RX_RING_SIZE - 1)];
+}
+
+/***************************************************************************************************************
+*     C a n R x R i n g _ R e l e a s e                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void CanRxRing_Release(canRxRing_t* ring)
+{
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* CAN_RX_RING_H_ */
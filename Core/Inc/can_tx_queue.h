@@ -0,0 +1,90 @@
+ /**************************************************************************************************************
+ * @file           : can_tx_queue.h                                                P A C K   C O N T R O L L E R
+ * @brief          : Priority queue of CAN frames waiting for a controller transmit FIFO
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef CAN_TX_QUEUE_H_
+#define CAN_TX_QUEUE_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "canfdspi_api.h"
+
+
+/***************************************************************************************************************
+* CAN Transmit Queue                                                               P A C K   C O N T R O L L E R
+
+  Summary:
+    Frames the main loop sends, held in RAM by traffic class until the MCP2517FD transmit FIFO has room.
+
+  Description:
+    CanTxQueue_Send() copies the frame into the ring of its class and returns - it never waits for the
+    controller. A full ring drops the new frame and counts it against the class. The poll class ring is
+    deeper than the rest - an announcement request answered by a whole pack queues a registration and a
+    status request for every module in the same pass.
+
+    Each class is loaded into a controller channel - the TXQ or a transmit FIFO, several classes may share
+    one (can_channels.h). The refill moves frames into them, highest class first and oldest first within a
+    class, with DRV_CANFDSPI_TransmitLoad() - a chain of SPI DMA transfers, each load started from the
+    completion of the one before. A frame found no room for stays at the head of its ring and its class is
+    passed over until the next CanTxQueue_Refill(), so a full bulk FIFO does not hold up the others. The
+    chain stops when every class is empty or passed over. CanTxQueue_Send() starts it, CanTxQueue_Refill()
+    starts it with every class tried again - from the TX-FIFO-not-full interrupt when a transmitted frame
+    frees a slot, and from the main loop each pass, as the interrupt line is shared by the channels and
+    stays asserted while any of them has room.
+
+    Each class ring has one producer - the main loop - and one consumer - the refill chain - and hands frames
+    over the way can_rx_ring.h does, with release and acquire on the free running head and tail counters.
+    Drops are counted by the producer; frames sent and their latency, CanTxQueue_Send() to the frame loaded
+    into the controller in TIM1 ticks (ms), by the consumer.
+***************************************************************************************************************/
+
+// Traffic classes - a lower number goes first
+#define CAN_TX_CLASS_SAFETY       0         // module state changes, isolate and deregister
+#define CAN_TX_CLASS_VCU          1         // pack state and data reported to the VCU
+#define CAN_TX_CLASS_POLL         2         // status, hardware and announcement requests, replies to modules and VCU
+#define CAN_TX_CLASS_BULK         3         // cell detail, cell balancing, module lists and telemetry
+#define CAN_TX_CLASSES            4
+
+#define CAN_TX_QUEUE_DEPTH        16        // frames per class - power of two, twice the transmit FIFO
+#define CAN_TX_POLL_DEPTH         64        // poll class - power of two, a registration and a status request for each of 32 modules at once
+#define CAN_TX_QUEUE_FRAMES       ((CAN_TX_CLASSES - 1) * CAN_TX_QUEUE_DEPTH + CAN_TX_POLL_DEPTH)
+
+typedef struct {
+  CAN_TX_MSGOBJ obj;
+  uint8_t       data[MAX_DATA_BYTES];
+  uint8_t       length;                     // data bytes
+  uint32_t      queued;                     // TIM1 ticks when CanTxQueue_Send() took it
+} canTxFrame_t;
+
+typedef struct {
+  uint32_t      head;                       // frames queued - producer only
+  uint32_t      tail;                       // frames loaded into the controller - consumer only
+  uint32_t      drops;                      // frames that found the ring full - producer only
+  uint32_t      sent;                       // consumer only, as are the latencies
+  uint32_t      latencyMax;                 // ticks
+  uint32_t      latencySum;                 // ticks - the mean is latencySum / sent
+  uint32_t      depth;                      // frames in the ring - power of two
+  canTxFrame_t* frame;                      // the ring, in the queue's frame store
+} canTxClass_t;
+
+typedef struct {
+  CANFDSPI_TX_LOAD  load[CAN_TX_CLASSES];   // each class's channel load, chained from the completions
+  canTxClass_t      txClass[CAN_TX_CLASSES];
+  uint8_t           full;                   // classes whose channel had no room - consumer only
+  volatile uint8_t  running;                // a refill chain is running
+  volatile uint8_t  pending;                // refill asked for while it was
+  volatile uint8_t  retry;                  // CanTxQueue_Refill() since - the full channels are read again
+  uint32_t          loadErrors;             // frames dropped on a failed load - consumer only
+  canTxFrame_t      store[CAN_TX_QUEUE_FRAMES];  // every class's ring, split up by CanTxQueue_Init()
+} canTxQueue_t;
+
+void CanTxQueue_Init(canTxQueue_t* queue, CANFDSPI_MODULE_ID index, const CAN_FIFO_CHANNEL channel[CAN_TX_CLASSES]);
+bool CanTxQueue_Send(canTxQueue_t* queue, uint8_t txClass, CAN_TX_MSGOBJ* obj, const uint8_t* data, uint8_t length);
+void CanTxQueue_Refill(canTxQueue_t* queue);
+uint32_t CanTxQueue_Count(const canTxQueue_t* queue, uint8_t txClass);
+
+#endif /* CAN_TX_QUEUE_H_ */
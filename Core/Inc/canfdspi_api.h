@@ -83,6 +83,53 @@ typedef uint8_t CANFDSPI_MODULE_ID;
 int8_t DRV_CANFDSPI_Reset(CANFDSPI_MODULE_ID index);
 
 
+// *****************************************************************************
+// *****************************************************************************
+// Section: Asynchronous SPI Transport
+
+typedef struct _CANFDSPI_XFER CANFDSPI_XFER;
+
+//! Called from the DMA interrupt once a transfer is done and CS is released
+
+typedef void (*CANFDSPI_XFER_DONE)(CANFDSPI_XFER* xfer);
+
+//! One SPI transaction - CS assert, DMA transfer, CS release, callback
+
+struct _CANFDSPI_XFER {
+    CANFDSPI_MODULE_ID index;
+    uint16_t size;                      // bytes on the wire, command included
+    int8_t status;                      // HAL status once done
+    CANFDSPI_XFER_DONE done;
+    void* context;                      // for the callback
+    CANFDSPI_XFER* next;                // queue link - owned by the driver while queued
+    uint8_t* tx;                        // buffers of length bytes, owned by the caller
+    uint8_t* rx;
+    uint16_t length;
+};
+
+// *****************************************************************************
+//! Queue a transfer - it runs once the bus is free, done() is called from interrupt context
+
+int8_t DRV_CANFDSPI_XferSubmit(CANFDSPI_XFER* xfer);
+
+// *****************************************************************************
+//! Compose a read of nBytes at address - the data lands at xfer->rx + 2
+
+int8_t DRV_CANFDSPI_XferRead(CANFDSPI_XFER* xfer, CANFDSPI_MODULE_ID index,
+        uint16_t address, uint16_t nBytes);
+
+// *****************************************************************************
+//! Compose a write of nBytes at address
+
+int8_t DRV_CANFDSPI_XferWrite(CANFDSPI_XFER* xfer, CANFDSPI_MODULE_ID index,
+        uint16_t address, const uint8_t *txd, uint16_t nBytes);
+
+// *****************************************************************************
+//! True when no transfer is queued or running
+
+bool DRV_CANFDSPI_XferIdle(void);
+
+
 // *****************************************************************************
 // *****************************************************************************
 // Section: SPI Access Functions
@@ -274,6 +321,55 @@ static inline int8_t DRV_CANFDSPI_TransmitQueueLoad(CANFDSPI_MODULE_ID index,
     return DRV_CANFDSPI_TransmitChannelLoad(index, CAN_TXQUEUE_CH0, txObj, txd, txdNumBytes, flush);
 }
 
+//! Command and a message object of the largest payload
+
+#define CANFDSPI_TX_LOAD_LENGTH (MAX_MSG_SIZE + 2)
+
+typedef struct _CANFDSPI_TX_LOAD CANFDSPI_TX_LOAD;
+
+typedef void (*CANFDSPI_TX_LOAD_DONE)(CANFDSPI_TX_LOAD* load);
+
+//! Asynchronous TX Channel Load - DRV_CANFDSPI_TransmitLoadConfigure() once, set done, then submit
+
+struct _CANFDSPI_TX_LOAD {
+    CANFDSPI_MODULE_ID index;
+    CAN_FIFO_CHANNEL channel;
+    CANFDSPI_TX_LOAD_DONE done;
+    void* context;                      // for the callback
+
+    int8_t status;                      // 0, or the return code the synchronous call would give
+    CAN_TX_FIFO_EVENT flags;            // FIFO events before the message was loaded
+    bool loaded;                        // false when the FIFO was full
+
+    uint8_t pending;                    // transfers still to complete
+    uint8_t uinc[3];                    // UINC and TXREQ write
+    uint8_t sink[3];
+    uint8_t regTx[14];                  // CiFIFOCON, CiFIFOSTA and CiFIFOUA
+    uint8_t regRx[14];
+    CANFDSPI_XFER xfer[2];              // status, then the message object
+    CANFDSPI_XFER uincXfer;
+    uint8_t tx[CANFDSPI_TX_LOAD_LENGTH];
+    uint8_t rx[CANFDSPI_TX_LOAD_LENGTH];
+};
+
+// *****************************************************************************
+//! Set up an asynchronous load of a transmit FIFO
+
+void DRV_CANFDSPI_TransmitLoadConfigure(CANFDSPI_TX_LOAD* load,
+        CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel);
+
+// *****************************************************************************
+//! TX Channel Load without waiting
+/*!
+ * Copies the message object, reads the FIFO status and, if the FIFO is not
+ * full, writes the object where CiFIFOUA points and sets UINC and TXREQ. All
+ * DMA transfers, chained from the transfer interrupt; done() is called from
+ * interrupt context with loaded false when the FIFO had no room.
+ */
+
+int8_t DRV_CANFDSPI_TransmitLoad(CANFDSPI_TX_LOAD* load, CAN_TX_MSGOBJ* txObj,
+        uint8_t *txd, uint32_t txdNumBytes);
+
 // *****************************************************************************
 //! TX Channel Flush
 /*!
@@ -458,6 +554,76 @@ int8_t DRV_CANFDSPI_ReceiveMessageGet(CANFDSPI_MODULE_ID index,
         CAN_FIFO_CHANNEL channel, CAN_RX_MSGOBJ* rxObj,
         uint8_t *rxd, uint8_t nBytes);
 
+//! Most messages one batch reads
+
+#define CANFDSPI_RX_BATCH_MAX 8
+
+//! Status read, or message objects with a command ahead of each of the two RAM reads
+
+#define CANFDSPI_RX_BATCH_LENGTH (CANFDSPI_RX_BATCH_MAX * MAX_MSG_SIZE + 4)
+
+typedef struct _CANFDSPI_RX_BATCH CANFDSPI_RX_BATCH;
+
+typedef void (*CANFDSPI_RX_BATCH_DONE)(CANFDSPI_RX_BATCH* batch);
+
+//! Batched Get Received Messages - DRV_CANFDSPI_ReceiveBatchConfigure() once, set done, then submit
+
+struct _CANFDSPI_RX_BATCH {
+    CANFDSPI_MODULE_ID index;
+    CAN_FIFO_CHANNEL channel;
+    CANFDSPI_RX_BATCH_DONE done;
+    void* context;                      // for the callback
+
+    int8_t status;                      // 0, or the return code the synchronous call would give
+    CAN_RX_FIFO_EVENT flags;            // FIFO events before the messages were read
+    uint8_t count;                      // messages read - DRV_CANFDSPI_ReceiveBatchMessage() decodes them
+
+    uint16_t ramStart;                  // FIFO layout in controller RAM
+    uint8_t objSize;
+    uint8_t depth;
+    bool timeStamp;
+
+    uint8_t first;                      // messages in the first RAM read - the rest wrapped to ramStart
+    uint8_t pending;                    // transfers still to complete
+    uint8_t uinc[3];                    // UINC write, the same for every message
+    uint8_t sink[3];
+    uint8_t ovf[3];                     // RXOVIF clear
+    uint8_t ovfRx[3];
+    CANFDSPI_XFER xfer[2];              // status, then the two RAM reads
+    CANFDSPI_XFER ovfXfer;
+    CANFDSPI_XFER uincXfer[CANFDSPI_RX_BATCH_MAX];
+    uint8_t tx[CANFDSPI_RX_BATCH_LENGTH];
+    uint8_t rx[CANFDSPI_RX_BATCH_LENGTH];
+};
+
+// *****************************************************************************
+//! Read the receive FIFO's place in controller RAM for batched reads
+/*!
+ * Synchronous - call once the FIFOs are configured. RAM is allocated to the
+ * TEF, the TXQ and FIFO 1 upwards in that order.
+ */
+
+int8_t DRV_CANFDSPI_ReceiveBatchConfigure(CANFDSPI_RX_BATCH* batch,
+        CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel);
+
+// *****************************************************************************
+//! Get up to CANFDSPI_RX_BATCH_MAX Received Messages without waiting
+/*!
+ * Reads the FIFO status once, clears an overflow, reads the waiting message
+ * objects in one RAM burst - two when they wrap past the end of the FIFO -
+ * and releases them with back to back UINC writes, the controller moving its
+ * tail one message per write. All DMA transfers, chained from the transfer
+ * interrupt; done() is called from interrupt context with flags and count.
+ */
+
+int8_t DRV_CANFDSPI_ReceiveBatchGet(CANFDSPI_RX_BATCH* batch);
+
+// *****************************************************************************
+//! Decode message i of a completed batch
+
+void DRV_CANFDSPI_ReceiveBatchMessage(CANFDSPI_RX_BATCH* batch, uint8_t i,
+        CAN_RX_MSGOBJ* rxObj, uint8_t *rxd, uint8_t nBytes);
+
 // *****************************************************************************
 //! Receive FIFO Reset
 
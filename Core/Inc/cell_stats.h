@@ -0,0 +1,362 @@
+ /**************************************************************************************************************
+ * @file           : cell_stats.h                                                  P A C K   C O N T R O L L E R
+ * @brief          : One pass cell voltage and temperature statistics kernels
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef CELL_STATS_H_
+#define CELL_STATS_H_
+
+// Include files
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "bms.h"
+
+#if defined(__ARM_FEATURE_DSP)
+#include "cmsis_compiler.h"
+#elif defined(__SSE2__)
+// the host simulator builds against the CMSIS headers, whose __I macro is a parameter name in these
+#pragma push_macro("__I")
+#undef __I
+#include <emmintrin.h>
+#pragma pop_macro("__I")
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/***************************************************************************************************************
+* Cell Statistics Kernels                                                          P A C K   C O N T R O L L E R
+
+  Summary:
+    Minimum, maximum, sum, sum of squares and voltage histogram of a run of cells in one pass.
+
+  Description:
+    CellStats_Accumulate() adds a block of cells to an accumulator, so one accumulator can cover a
+    module or the whole pack. Everything it keeps is exact integer arithmetic in raw cell units, so the
+    mean, standard deviation and spread derived from it by CellStats_Finish() do not depend on the
+    order the cells were added in or on which kernel added them.
+
+    A batteryCell starts with its voltage and temperature, so one 32-bit load holds both as two 16-bit
+    lanes - voltage low, temperature high - and the kernels track both minima and both maxima with
+    dual 16-bit operations:
+
+      Cortex-M4   USUB16 sets the per-lane GE flags, SEL keeps the smaller/larger lane
+      SSE2        four cells per register, unsigned compare by biasing into the signed range
+      NEON        VLD3 splits four cells into voltage, temperature and soc/soh vectors
+
+    CellStats_Scalar() is the plain C definition every kernel must match exactly; the host bench
+    (emulator/bench/cell_stats_bench.c) checks them against it.
+
+    Bin n of the histogram counts cell voltages from CELL_STATS_HIST_BASE + n * 128 mV, with the first
+    and last bin taking everything below and above the range.
+***************************************************************************************************************/
+
+#define CELL_STATS_HIST_BINS      16        // voltage histogram bins
+#define CELL_STATS_HIST_BASE      2400      // mV - lower edge of bin 0
+#define CELL_STATS_HIST_SHIFT     7         // 128 mV bins - 2400 to 4448 mV
+
+typedef struct {
+  uint16_t cells;
+  uint16_t minVolt;
+  uint16_t maxVolt;
+  uint16_t minTemp;
+  uint16_t maxTemp;
+  uint32_t sumVolt;
+  uint32_t sumTemp;
+  uint64_t sumSqVolt;
+  uint64_t sumSqTemp;
+  uint16_t hist[CELL_STATS_HIST_BINS];
+} cellStatsAcc_t;
+
+typedef struct {
+  uint16_t min;
+  uint16_t max;
+  uint16_t mean;                            // truncated
+  uint16_t stddev;                          // population, truncated
+  uint16_t spread;                          // max - min
+} cellStat_t;
+
+// a cell is three halfwords and starts with voltage, temperature - the kernels load it that way
+typedef char cellStatsLayoutCheck[(sizeof(batteryCell) == 6 && offsetof(batteryCell, temp) == 2) ? 1 : -1];
+
+/***************************************************************************************************************
+*     C e l l S t a t s _ I n i t                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void CellStats_Init(cellStatsAcc_t* acc)
+{
+  memset(acc, 0, sizeof(*acc));
+  acc->minVolt = 0xFFFF;
+  acc->minTemp = 0xFFFF;
+}
+
+/***************************************************************************************************************
+*     C e l l S t a t s _ B i n                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint8_t CellStats_Bin(uint16_t voltage)
+{
+  if(voltage < CELL_STATS_HIST_BASE) return 0;
+  voltage = (voltage - CELL_STATS_HIST_BASE) >> CELL_STATS_HIST_SHIFT;
+  return voltage < CELL_STATS_HIST_BINS ? (uint8_t)voltage : CELL_STATS_HIST_BINS - 1;
+}
+
+/***************************************************************************************************************
+*     C e l l S t a t s _ S c a l a r                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void CellStats_Scalar(const batteryCell* cell, uint16_t count, cellStatsAcc_t* acc)
+{
+  uint16_t index;
+
+  for(index = 0; index < count; index++){
+    uint16_t v = cell[index].voltage;
+    uint16_t t = cell[index].temp;
+    if(v < acc->minVolt) acc->minVolt = v;
+    if(v > acc->maxVolt) acc->maxVolt = v;
+    if(t < acc->minTemp) acc->minTemp = t;
+    if(t > acc->maxTemp) acc->maxTemp = t;
+    acc->sumVolt   += v;
+    acc->sumTemp   += t;
+    acc->sumSqVolt += (uint32_t)v * v;
+    acc->sumSqTemp += (uint32_t)t * t;
+    acc->hist[CellStats_Bin(v)]++;
+  }
+  acc->cells += count;
+}
+
+/***************************************************************************************************************
+*     C e l l S t a t s _ A c c u m u l a t e                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+#if defined(__ARM_FEATURE_DSP)
+
+#define CELL_STATS_KERNEL         "Cortex-M4 DSP"
+
+static inline void CellStats_Accumulate(const batteryCell* cell, uint16_t count, cellStatsAcc_t* acc)
+{
+  uint32_t lo = ((uint32_t)acc->minTemp << 16) | acc->minVolt;
+  uint32_t hi = ((uint32_t)acc->maxTemp << 16) | acc->maxVolt;
+  uint32_t sumVolt = 0;
+  uint32_t sumTemp = 0;
+  uint32_t w;
+  uint32_t v;
+  uint32_t t;
+  uint16_t index;
+
+  for(index = 0; index < count; index++){
+    memcpy(&w, &cell[index], sizeof(w));    // voltage in [15:0], temperature in [31:16]
+    __USUB16(w, lo);                        // GE per lane where w >= lo
+    lo = __SEL(lo, w);
+    __USUB16(w, hi);                        // GE per lane where w >= hi
+    hi = __SEL(w, hi);
+    v = w & 0xFFFF;
+    t = w >> 16;
+    sumVolt += v;
+    sumTemp += t;
+    acc->sumSqVolt += v * v;
+    acc->sumSqTemp += t * t;
+    acc->hist[__USAT(((int32_t)v - CELL_STATS_HIST_BASE) >> CELL_STATS_HIST_SHIFT, 4)]++;
+  }
+  acc->minVolt  = lo & 0xFFFF;
+  acc->minTemp  = lo >> 16;
+  acc->maxVolt  = hi & 0xFFFF;
+  acc->maxTemp  = hi >> 16;
+  acc->sumVolt += sumVolt;
+  acc->sumTemp += sumTemp;
+  acc->cells   += count;
+}
+
+#elif defined(__SSE2__)
+
+#define CELL_STATS_KERNEL         "SSE2"
+
+static inline void CellStats_Accumulate(const batteryCell* cell, uint16_t count, cellStatsAcc_t* acc)
+{
+  const __m128i bias = _mm_set1_epi16((short)0x8000);
+  const __m128i low  = _mm_set1_epi32(0xFFFF);
+  const __m128i base = _mm_set1_epi16(CELL_STATS_HIST_BASE);
+  const __m128i top  = _mm_set1_epi16(CELL_STATS_HIST_BINS - 1);
+  __m128i lo    = _mm_xor_si128(_mm_set1_epi32((int)(((uint32_t)acc->minTemp << 16) | acc->minVolt)), bias);
+  __m128i hi    = _mm_xor_si128(_mm_set1_epi32((int)(((uint32_t)acc->maxTemp << 16) | acc->maxVolt)), bias);
+  __m128i sumV  = _mm_setzero_si128();
+  __m128i sumT  = _mm_setzero_si128();
+  __m128i sqV   = _mm_setzero_si128();
+  __m128i sqT   = _mm_setzero_si128();
+  __m128i a, b, x, v, t, bin;
+  uint32_t lane32[4];
+  uint64_t lane64[2];
+  uint16_t lane16[8];
+  uint16_t index = 0;
+  uint8_t  n;
+
+  for(; index + 4 <= count; index += 4){
+    // four cells are 24 bytes - halfwords v0 t0 x0 v1 t1 x1 v2 t2 | x2 v3 t3 x3
+    a = _mm_loadu_si128((const __m128i*)&cell[index]);
+    b = _mm_loadl_epi64((const __m128i*)&cell[index + 2].soc);
+    x = _mm_unpacklo_epi64(_mm_unpacklo_epi32(a, _mm_srli_si128(a, 6)),
+                           _mm_unpacklo_epi32(_mm_shuffle_epi32(a, 3), _mm_srli_si128(b, 2)));
+    // 32-bit lanes now hold voltage low, temperature high - one per cell
+    bin = _mm_min_epi16(_mm_srli_epi16(_mm_subs_epu16(x, base), CELL_STATS_HIST_SHIFT), top);
+    acc->hist[_mm_extract_epi16(bin, 0)]++;
+    acc->hist[_mm_extract_epi16(bin, 2)]++;
+    acc->hist[_mm_extract_epi16(bin, 4)]++;
+    acc->hist[_mm_extract_epi16(bin, 6)]++;
+    lo = _mm_min_epi16(lo, _mm_xor_si128(x, bias));   // signed compare on biased values is unsigned
+    hi = _mm_max_epi16(hi, _mm_xor_si128(x, bias));
+    v = _mm_and_si128(x, low);
+    t = _mm_srli_epi32(x, 16);
+    sumV = _mm_add_epi32(sumV, v);
+    sumT = _mm_add_epi32(sumT, t);
+    sqV  = _mm_add_epi64(sqV, _mm_mul_epu32(v, v));
+    sqV  = _mm_add_epi64(sqV, _mm_mul_epu32(_mm_srli_epi64(v, 32), _mm_srli_epi64(v, 32)));
+    sqT  = _mm_add_epi64(sqT, _mm_mul_epu32(t, t));
+    sqT  = _mm_add_epi64(sqT, _mm_mul_epu32(_mm_srli_epi64(t, 32), _mm_srli_epi64(t, 32)));
+  }
+
+  _mm_storeu_si128((__m128i*)lane16, _mm_xor_si128(lo, bias));
+  for(n = 0; n < 8; n += 2){
+    if(lane16[n]     < acc->minVolt) acc->minVolt = lane16[n];
+    if(lane16[n + 1] < acc->minTemp) acc->minTemp = lane16[n + 1];
+  }
+  _mm_storeu_si128((__m128i*)lane16, _mm_xor_si128(hi, bias));
+  for(n = 0; n < 8; n += 2){
+    if(lane16[n]     > acc->maxVolt) acc->maxVolt = lane16[n];
+    if(lane16[n + 1] > acc->maxTemp) acc->maxTemp = lane16[n + 1];
+  }
+  _mm_storeu_si128((__m128i*)lane32, sumV);
+  acc->sumVolt += lane32[0] + lane32[1] + lane32[2] + lane32[3];
+  _mm_storeu_si128((__m128i*)lane32, sumT);
+  acc->sumTemp += lane32[0] + lane32[1] + lane32[2] + lane32[3];
+  _mm_storeu_si128((__m128i*)lane64, sqV);
+  acc->sumSqVolt += lane64[0] + lane64[1];
+  _mm_storeu_si128((__m128i*)lane64, sqT);
+  acc->sumSqTemp += lane64[0] + lane64[1];
+  acc->cells += index;
+
+  // the last 0-3 cells
+  CellStats_Scalar(&cell[index], count - index, acc);
+}
+
+#elif defined(__ARM_NEON)
+
+#define CELL_STATS_KERNEL         "NEON"
+
+static inline void CellStats_Accumulate(const batteryCell* cell, uint16_t count, cellStatsAcc_t* acc)
+{
+  uint16x4_t  loV  = vdup_n_u16(acc->minVolt);
+  uint16x4_t  hiV  = vdup_n_u16(acc->maxVolt);
+  uint16x4_t  loT  = vdup_n_u16(acc->minTemp);
+  uint16x4_t  hiT  = vdup_n_u16(acc->maxTemp);
+  uint32x4_t  sumV = vdupq_n_u32(0);
+  uint32x4_t  sumT = vdupq_n_u32(0);
+  uint64x2_t  sqV  = vdupq_n_u64(0);
+  uint64x2_t  sqT  = vdupq_n_u64(0);
+  uint16x4x3_t x;
+  uint16_t lane16[4];
+  uint16_t index = 0;
+  uint8_t  n;
+
+  for(; index + 4 <= count; index += 4){
+    x = vld3_u16((const uint16_t*)&cell[index]);     // voltage, temperature, soc/soh
+    vst1_u16(lane16, x.val[0]);
+    for(n = 0; n < 4; n++) acc->hist[CellStats_Bin(lane16[n])]++;
+    loV  = vmin_u16(loV, x.val[0]);
+    hiV  = vmax_u16(hiV, x.val[0]);
+    loT  = vmin_u16(loT, x.val[1]);
+    hiT  = vmax_u16(hiT, x.val[1]);
+    sumV = vaddw_u16(sumV, x.val[0]);
+    sumT = vaddw_u16(sumT, x.val[1]);
+    sqV  = vpadalq_u32(sqV, vmull_u16(x.val[0], x.val[0]));
+    sqT  = vpadalq_u32(sqT, vmull_u16(x.val[1], x.val[1]));
+  }
+
+  loV = vpmin_u16(loV, loV); loV = vpmin_u16(loV, loV);
+  hiV = vpmax_u16(hiV, hiV); hiV = vpmax_u16(hiV, hiV);
+  loT = vpmin_u16(loT, loT); loT = vpmin_u16(loT, loT);
+  hiT = vpmax_u16(hiT, hiT); hiT = vpmax_u16(hiT, hiT);
+  acc->minVolt = vget_lane_u16(loV, 0);
+  acc->maxVolt = vget_lane_u16(hiV, 0);
+  acc->minTemp = vget_lane_u16(loT, 0);
+  acc->maxTemp = vget_lane_u16(hiT, 0);
+  acc->sumVolt   += vgetq_lane_u32(sumV, 0) + vgetq_lane_u32(sumV, 1) + vgetq_lane_u32(sumV, 2) + vgetq_lane_u32(sumV, 3);
+  acc->sumTemp   += vgetq_lane_u32(sumT, 0) + vgetq_lane_u32(sumT, 1) + vgetq_lane_u32(sumT, 2) + vgetq_lane_u32(sumT, 3);
+  acc->sumSqVolt += vgetq_lane_u64(sqV, 0) + vgetq_lane_u64(sqV, 1);
+  acc->sumSqTemp += vgetq_lane_u64(sqT, 0) + vgetq_lane_u64(sqT, 1);
+  acc->cells += index;
+
+  // the last 0-3 cells
+  CellStats_Scalar(&cell[index], count - index, acc);
+}
+
+#else
+
+#define CELL_STATS_KERNEL         "scalar"
+
+static inline void CellStats_Accumulate(const batteryCell* cell, uint16_t count, cellStatsAcc_t* acc)
+{
+  CellStats_Scalar(cell, count, acc);
+}
+
+#endif
+
+/***************************************************************************************************************
+*     C e l l S t a t s _ M e r g e                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void CellStats_Merge(cellStatsAcc_t* acc, const cellStatsAcc_t* part)
+{
+  uint8_t bin;
+
+  if(part->minVolt < acc->minVolt) acc->minVolt = part->minVolt;
+  if(part->maxVolt > acc->maxVolt) acc->maxVolt = part->maxVolt;
+  if(part->minTemp < acc->minTemp) acc->minTemp = part->minTemp;
+  if(part->maxTemp > acc->maxTemp) acc->maxTemp = part->maxTemp;
+  acc->cells     += part->cells;
+  acc->sumVolt   += part->sumVolt;
+  acc->sumTemp   += part->sumTemp;
+  acc->sumSqVolt += part->sumSqVolt;
+  acc->sumSqTemp += part->sumSqTemp;
+  for(bin = 0; bin < CELL_STATS_HIST_BINS; bin++) acc->hist[bin] += part->hist[bin];
+}
+
+/***************************************************************************************************************
+*     C e l l S t a t s _ S q r t                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint16_t CellStats_Sqrt(uint32_t value)
+{
+  uint32_t root = 0;
+  uint32_t bit  = 1UL << 30;
+
+  // digit by digit - floor of the square root, no division
+  while(bit > value) bit >>= 2;
+  while(bit != 0){
+    if(value >= root + bit){
+      value -= root + bit;
+      root   = (root >> 1) + bit;
+    }else{
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint16_t)root;
+}
+
+/***************************************************************************************************************
+*     C e l l S t a t s _ F i n i s h                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void CellStats_Finish(uint16_t cells, uint16_t min, uint16_t max, uint32_t sum, uint64_t sumSq, cellStat_t* stat)
+{
+  uint64_t n = cells;
+
+  if(cells == 0){
+    memset(stat, 0, sizeof(*stat));
+    return;
+  }
+  stat->min    = min;
+  stat->max    = max;
+  stat->spread = max - min;
+  stat->mean   = (uint16_t)(sum / cells);
+  // n * sum of squares - sum^2 is n^2 times the variance, and fits 64 bits for any cell count here
+  stat->stddev = CellStats_Sqrt((uint32_t)((n * sumSq - (uint64_t)sum * sum) / (n * n)));
+}
+
+#endif /* CELL_STATS_H_ */
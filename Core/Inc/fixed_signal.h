@@ -0,0 +1,120 @@
+ /**************************************************************************************************************
+ * @file           : fixed_signal.h                                                P A C K   C O N T R O L L E R
+ * @brief          : Integer conversions between the module, pack and VCU signal encodings
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef FIXED_SIGNAL_H_
+#define FIXED_SIGNAL_H_
+
+// Include files
+#include <stdint.h>
+
+
+/***************************************************************************************************************
+* Fixed Point Signals                                                              P A C K   C O N T R O L L E R
+
+  Summary:
+    Scale and offset of every 16-bit signal as integer constants.
+
+  Description:
+    The _FACTOR/_BASE constants in mcu.h and vcu.h are double literals, so every conversion written with
+    them is software double precision on the Cortex-M4 (its FPU is single precision only). Here each
+    signal is described by the size of one LSB and the value of a raw 0, both as a whole number of quanta
+    of the quantity it measures. Every signal of a quantity shares the quantum, chosen so all of them
+    are exact:
+
+      current      0.01 A       module 0.02 A / -655.36 A, pack and VCU 0.05 A / -1600 A
+      voltage      1 mV         module 0.015 V, VCU 0.05 V, cell 0.001 V
+      temperature  1/3200 C     module 0.01 C / -55.35 C, VCU 0.03125 C / -273 C
+      percentage   1/640 %      module 0.5 %, VCU SOC 0.0015625 %, VCU SOH 0.4 %
+
+    FXS_CONVERT() moves a raw value from one encoding to another as
+        dst = (raw * LSB_src + OFS_src - OFS_dst) / LSB_dst
+    with every constant known at compile time, so it is one multiply, one add and a division by a
+    constant the compiler turns into a multiply and shift. The division truncates toward zero as the
+    float-to-integer cast it replaces did; the result is the exact encoding of the value, where the
+    float path could land one LSB low on values that are whole in the destination (0.001 * x / 0.001).
+
+    Converting between signals of different quantities fails to compile.
+***************************************************************************************************************/
+
+// quantities - signals of different quantities can not be converted into each other
+#define FXS_QTY_CURRENT                 1
+#define FXS_QTY_VOLTAGE                 2
+#define FXS_QTY_TEMPERATURE             3
+#define FXS_QTY_PERCENTAGE              4
+
+// quanta per whole unit of each quantity
+#define FXS_CURRENT_PER_UNIT            100       // 0.01 A
+#define FXS_VOLTAGE_PER_UNIT            1000      // 1 mV
+#define FXS_TEMPERATURE_PER_UNIT        3200      // 1/3200 C
+#define FXS_PERCENTAGE_PER_UNIT         640       // 1/640 %
+
+// signals - LSB and raw 0 in quanta of their quantity, and the float constants they stand for
+#define FXS_MODULE_CURRENT_QTY          FXS_QTY_CURRENT
+#define FXS_MODULE_CURRENT_LSB          2
+#define FXS_MODULE_CURRENT_OFS          (-65536)                        // MODULE_CURRENT_FACTOR/BASE
+#define FXS_PACK_CURRENT_QTY            FXS_QTY_CURRENT
+#define FXS_PACK_CURRENT_LSB            5
+#define FXS_PACK_CURRENT_OFS            (-160000)                       // PACK_CURRENT_FACTOR/BASE
+#define FXS_VCU_CURRENT_QTY             FXS_QTY_CURRENT
+#define FXS_VCU_CURRENT_LSB             5
+#define FXS_VCU_CURRENT_OFS             (-160000)                       // VCU_CURRENT_FACTOR/BASE
+
+#define FXS_MODULE_VOLTAGE_QTY          FXS_QTY_VOLTAGE
+#define FXS_MODULE_VOLTAGE_LSB          15
+#define FXS_MODULE_VOLTAGE_OFS          0                               // MODULE_VOLTAGE_FACTOR/BASE
+#define FXS_VCU_VOLTAGE_QTY             FXS_QTY_VOLTAGE
+#define FXS_VCU_VOLTAGE_LSB             50
+#define FXS_VCU_VOLTAGE_OFS             0                               // VCU_VOLTAGE_FACTOR/BASE
+#define FXS_CELL_VOLTAGE_QTY            FXS_QTY_VOLTAGE
+#define FXS_CELL_VOLTAGE_LSB            1
+#define FXS_CELL_VOLTAGE_OFS            0                               // CELL_VOLTAGE_FACTOR/BASE
+#define FXS_VCU_CELL_VOLTAGE_QTY        FXS_QTY_VOLTAGE
+#define FXS_VCU_CELL_VOLTAGE_LSB        1
+#define FXS_VCU_CELL_VOLTAGE_OFS        0                               // VCU_CELL_VOLTAGE_FACTOR/BASE
+
+#define FXS_TEMPERATURE_QTY             FXS_QTY_TEMPERATURE
+#define FXS_TEMPERATURE_LSB             32
+#define FXS_TEMPERATURE_OFS             (-177120)                       // TEMPERATURE_FACTOR/BASE
+#define FXS_VCU_TEMPERATURE_QTY         FXS_QTY_TEMPERATURE
+#define FXS_VCU_TEMPERATURE_LSB         100
+#define FXS_VCU_TEMPERATURE_OFS         (-873600)                       // VCU_TEMPERATURE_FACTOR/BASE
+
+#define FXS_PERCENTAGE_QTY              FXS_QTY_PERCENTAGE
+#define FXS_PERCENTAGE_LSB              320
+#define FXS_PERCENTAGE_OFS              0                               // PERCENTAGE_FACTOR/BASE
+#define FXS_VCU_SOC_PERCENTAGE_QTY      FXS_QTY_PERCENTAGE
+#define FXS_VCU_SOC_PERCENTAGE_LSB      1
+#define FXS_VCU_SOC_PERCENTAGE_OFS      0                               // VCU_SOC_PERCENTAGE_FACTOR/BASE
+#define FXS_VCU_SOH_PERCENTAGE_QTY      FXS_QTY_PERCENTAGE
+#define FXS_VCU_SOH_PERCENTAGE_LSB      256
+#define FXS_VCU_SOH_PERCENTAGE_OFS      0                               // VCU_SOH_PERCENTAGE_FACTOR/BASE
+
+#define FXS_MODULE_CURRENT_TOLERANCE    30                              // MODULE_CURRENT_TOLERANCE in 0.01 A
+
+// compile time check that two signals measure the same quantity - evaluates to 0
+#define FXS_SAME_QTY(SRC, DST)          (0 * sizeof(char[(FXS_##SRC##_QTY == FXS_##DST##_QTY) ? 1 : -1]))
+
+// raw value in quanta of its quantity
+#define FXS_QUANTA(raw, SIG)            ((int32_t)(raw) * FXS_##SIG##_LSB + FXS_##SIG##_OFS)
+
+// sum of count raw values in quanta - count offsets, one per value summed
+#define FXS_SUM_QUANTA(sum, count, SIG) ((int32_t)(sum) * FXS_##SIG##_LSB + (int32_t)(count) * FXS_##SIG##_OFS)
+
+// quanta to raw value of a signal, truncated toward zero
+#define FXS_FROM_QUANTA(quanta, SIG)    (((int32_t)(quanta) - FXS_##SIG##_OFS) / FXS_##SIG##_LSB)
+
+// raw value of one signal to the raw value of another
+#define FXS_CONVERT(raw, SRC, DST)      ((int32_t)FXS_SAME_QTY(SRC, DST) + \
+                                         ((int32_t)(raw) * FXS_##SRC##_LSB + (FXS_##SRC##_OFS - FXS_##DST##_OFS)) / FXS_##DST##_LSB)
+
+// saturate to the 16-bit raw range
+static inline uint16_t FXS_SaturateU16(int32_t value)
+{
+  return value < 0 ? 0 : (value > 65535 ? 65535 : (uint16_t)value);
+}
+
+#endif /* FIXED_SIGNAL_H_ */
@@ -10,6 +10,7 @@
 
 // Include files
 #include "canfdspi_api.h"
+#include "can_channels.h"
 //#include "main.h"
 #include "bms.h"
 
@@ -24,7 +25,26 @@
 
 //! Use RX and TX Interrupt pins to check FIFO status
 #define MCU_USE_RX_INT
-#define MAX_TXQUEUE_ATTEMPTS 50
+#define MCU_USE_TX_INT
+
+//! Poll with one broadcast status request, modules reply in their ID slot (requires ModuleCPU support)
+//#define MCU_USE_BROADCAST_STATUS
+
+//! Fetch cell detail as a windowed stream instead of one request per cell (requires ModuleCPU support)
+//#define MCU_USE_DETAIL_STREAM
+
+//! Switch the module bus to CAN FD once every registered module reports MODULE_HW_CAP_CANFD (requires ModuleCPU support)
+//#define MCU_USE_CANFD
+
+//! Only send VCU data frames whose pack values changed, all of them every MCU_STATS_VCU_REFRESH cycles (requires VCU support)
+//#define MCU_USE_VCU_DIRTY
+
+//! Memory barrier for data shared with interrupts - the host simulator (PCU_HOST_SIM) has no DMB instruction
+#ifdef PCU_HOST_SIM
+#define MCU_DMB()  __sync_synchronize()
+#else
+#define MCU_DMB()  __DMB()
+#endif
 
 // Switches
 #define MCU_SWITCH_RELEASED true  //Switch has an internal pullup when not pressed - input = 1
@@ -38,11 +58,16 @@
 #define MCU_TX_INT()	(HAL_GPIO_ReadPin(CAN2_INT0_GPIO_Port, CAN2_INT0_Pin))
 #define MCU_RX_INT()	(HAL_GPIO_ReadPin(CAN2_INT1_GPIO_Port, CAN2_INT1_Pin))
 
-// Transmit Channels
-#define MCU_TX_FIFO CAN_FIFO_CH2
+// Transmit Channels - sizes, priorities and routes in mcuChannelMap (can_channels.c)
+#define MCU_TXQ           CAN_TXQUEUE_CH0   // VCU and polling classes
+#define MCU_TX_FIFO       CAN_FIFO_CH2      // safety class
+#define MCU_TX_BULK_FIFO  CAN_FIFO_CH3      // bulk class
 
-// Receive Channels
-#define MCU_RX_FIFO CAN_FIFO_CH1
+// Receive Channels - drained in this order
+#define MCU_RX_FIFO       CAN_FIFO_CH1      // module status
+#define MCU_RX_OTHER_FIFO CAN_FIFO_CH5      // announcements, hardware, time requests and cell comm status
+#define MCU_RX_BULK_FIFO  CAN_FIFO_CH4      // cell data - detail, packed and FD
+#define MCU_RX_FIFOS      3
 
 #define MCU_STATUS_INTERVAL       2000      // Module status request interval - 2 seconds
 #define MCU_STATE_TX_INTERVAL     1000      // Module state retry interval - 1 seconds
@@ -52,6 +77,30 @@
 #define MCU_ANNOUNCE_REQUEST_INTERVAL 10000 // Module announcement request interval - 10 seconds
 #define MCU_MAX_CONSECUTIVE_TIMEOUTS  3     // Maximum consecutive timeouts before deregistering
 
+#define MCU_POLL_REFRESH_TARGET   250       // Target status refresh period per module - 250 ms
+#define MCU_POLL_WINDOW_MIN       1         // Minimum status requests in flight
+#define MCU_POLL_WINDOW_MAX       6         // Maximum status requests in flight - keep below TX FIFO depth (7)
+#define MCU_POLL_LATENCY_INIT     20        // Initial status response latency estimate - 20 ms
+#define MCU_POLL_SLOT_TIMEOUT     100       // Unanswered request gives its window slot back - 100 ms
+
+#define MCU_POLL_INTERVAL_FAST    50        // Status poll interval for a module under stress - 50 ms
+#define MCU_POLL_INTERVAL_NORMAL  MCU_POLL_REFRESH_TARGET  // Status poll interval for an active module
+#define MCU_POLL_INTERVAL_IDLE    MCU_STATUS_INTERVAL      // Status poll interval for an idle module out of service
+#define MCU_POLL_BUSLOAD_BUDGET   30        // Module bus time allowed for status polling - percent
+#define MCU_POLL_COST_US          1140      // Worst case bus time of one poll (request + Status1/2/3) at 500 kbit/s - us
+#define MCU_POLL_COST_FD_US       590       // Worst case bus time of one CAN FD poll (request + 64 byte STATUS_FD) at 500k/2M - us
+#define MCU_POLL_CURRENT_FAST     500       // |module current| that needs fast polling - 10 A in 0.02 A units
+#define MCU_POLL_CURRENT_IDLE     25        // |module current| treated as idle - 0.5 A in 0.02 A units
+#define MCU_POLL_DVDT_FAST        200       // Module voltage change that needs fast polling - mV/s
+#define MCU_POLL_DVDT_IDLE        20        // Module voltage change treated as idle - mV/s
+#define MCU_POLL_CELL_HI_MV       4150      // Cell voltage near the upper limit - mV
+#define MCU_POLL_CELL_LO_MV       3000      // Cell voltage near the lower limit - mV
+#define MCU_POLL_CELL_HI_TEMP     10535     // Cell temperature near the upper limit - 50 C in TEMPERATURE_FACTOR units
+
+#define MCU_DETAIL_WINDOW_SIZE    8         // Cells per streamed window - leaves RX FIFO room for status traffic
+#define MCU_DETAIL_WINDOW_TIMEOUT 20        // No cell detail for this long - ACK what we have - 20 ms
+#define MCU_DETAIL_MAX_RETRIES    3         // Retries of one window before the stream is aborted
+
 #define PACK_CURRENT_BASE         -1600     // amps
 #define PACK_CURRENT_FACTOR       0.05      // amps
 #define MODULE_VOLTAGE_BASE       0         // Volts
@@ -122,7 +171,65 @@ typedef struct {
 extern MCU_DATA appData;
 //extern batteryPack pack;
 
+/***************************************************************************************************************
+* Cell Detail Stream                                                               P A C K   C O N T R O L L E R
+
+  Summary:
+    Tracks the one streaming cell detail transfer in progress.
+
+  Description:
+    The module sends windowSize MODULE_DETAIL frames back to back. Each received cell sets its bit in
+    bitmap and is stored straight into the module's cell block (mcu_cells.h). A complete window is acknowledged at once with
+    DETAIL_ACK_OK, which releases the next window. A window that stalls for MCU_DETAIL_WINDOW_TIMEOUT is
+    acknowledged with DETAIL_ACK_RETRY so only the missing cells are resent.
+***************************************************************************************************************/
+
+typedef struct {
+  bool          active;
+  uint8_t       moduleIndex;
+  uint8_t       transferId;
+  uint8_t       windowBase;     // first cell of the current window
+  uint8_t       windowSize;
+  uint16_t      bitmap;         // cells of the current window received
+  uint8_t       cellCount;      // from the first MODULE_DETAIL frame, 0 until known
+  uint8_t       retries;
+  lastContact_t started;
+  lastContact_t lastRx;
+  uint32_t      lastDuration;   // ms taken by the last completed transfer
+}mcuDetailStream_t;
+
+extern mcuDetailStream_t mcuDetailStream;
+
+/***************************************************************************************************************
+* Module Lookup                                                                    P A C K   C O N T R O L L E R
+
+  Summary:
+    Constant time moduleId and uniqueId to module index lookup.
+
+  Description:
+    Every received module frame is matched to its slot by the moduleId in its extended ID, and every
+    announcement by its uniqueId. indexById maps a moduleId straight to the slot of the registered module
+    holding it, MAX_MODULES_PER_PACK when none does. It is rebuilt by MCU_UpdateModuleCounts(), which runs
+    on every registration and deregistration.
+
+    uidSlot is an open addressed hash of the uniqueId of every occupied slot, registered or not, holding
+    slot index + 1 (0 = empty) and probing linearly. A slot keeps its uniqueId when its module leaves
+    service so it gets the same moduleId back on re-registration - entries are only ever added, and all
+    are dropped by PCU_Initialize(), so the table needs no deletion. It is twice the slot count, so a
+    probe run stays short and always ends at an empty entry.
+***************************************************************************************************************/
+
+#define MCU_UID_HASH_SLOTS        64        // power of 2, at least twice MAX_MODULES_PER_PACK
+
+typedef struct {
+  uint8_t indexById[MAX_MODULES_PER_PACK + 1];   // moduleId -> slot, moduleId is slot + 1
+  uint8_t uidSlot[MCU_UID_HASH_SLOTS];           // uniqueId hash -> slot + 1, 0 when empty
+}mcuLookup_t;
+
+extern mcuLookup_t mcuLookup;
+
 extern batteryModule module[MAX_MODULES_PER_PACK];
+extern moduleControl moduleCtl;
 
 /***************************************************************************************************************
 *
@@ -137,11 +244,18 @@ void PCU_Initialize(void);
 void PCU_Tasks(void);
 
 
-//! Initialize CANFDSPI
-void DRV_CANFDSPI_Init(CANFDSPI_MODULE_ID index);
+//! Initialize CANFDSPI with the channels and routes of one bus (can_channels.h)
+void DRV_CANFDSPI_Init(CANFDSPI_MODULE_ID index, const canChannelMap_t* map);
+
+//! Queue txObj/txd for the module bus in a CAN_TX_CLASS_ class (can_tx_queue.h) - never waits for the controller,
+//! false if the class ring was full and the frame was dropped
+bool MCU_TransmitMessageQueue(uint8_t txClass);
+
+//! Move queued frames into the module bus TX FIFO - called from the CAN2 TX interrupt
+void MCU_TxRefill(void);
 
-//! Add message to transmit FIFO
-void MCU_TransmitMessageQueue(CANFDSPI_MODULE_ID index);
+//! Read the module bus RX FIFO into mcuRxRing - called from the CAN2 RX interrupt
+void MCU_RxDrain(void);
 
 //! Decode received messages
 void MCU_ReceiveMessages(void);
@@ -151,14 +265,23 @@ void MCU_DeRegisterModule(uint8_t moduleId);
 void MCU_DeRegisterAllModules(void);
 void MCU_IsolateAllModules(void);
 void MCU_RequestModuleAnnouncement(void);
-void MCU_RequestModuleStatus(uint8_t moduleId);
+bool MCU_RequestModuleStatus(uint8_t moduleId);
+bool MCU_RequestAllModuleStatus(void);
 void MCU_ProcessModuleStatus1(void);
 void MCU_ProcessModuleStatus2(void);
 void MCU_ProcessModuleStatus3(void);
+void MCU_ProcessModuleStatusFd(void);
+void MCU_PublishModuleStatus(uint8_t moduleIndex);
+void MCU_ModuleStatusSnapshot(uint8_t moduleIndex, moduleStatus* snapshot);
 
 void MCU_RequestCellDetail(uint8_t moduleId);
+void MCU_RequestCellDetailStream(uint8_t moduleId);
 void MCU_ProcessCellDetail(void);
+void MCU_ProcessCellPacked(void);
+void MCU_ProcessCellFd(void);
+void MCU_CheckCellDetailStream(void);
 void MCU_TransmitMaxState(moduleState state);
+void MCU_TransmitCellBalance(uint8_t moduleId, uint8_t firstCell, uint64_t cellMask);
 
 extern void MCU_TransmitState(uint8_t moduleId, moduleState state);
 
@@ -167,6 +290,7 @@ void MCU_TransmitSwitchState(void);
 
 extern uint8_t MCU_FindMaxVoltageModule(void);
 extern uint8_t MCU_ModuleIndexFromId(uint8_t moduleId);
+extern uint8_t MCU_ModuleIndexFromUid(uint32_t uniqueId);
 extern void MCU_UpdateModuleCounts(void);
 extern void MCU_UpdateModuleContact(uint8_t moduleIndex);
 extern void MCU_ResetAllModuleTimeouts(void);
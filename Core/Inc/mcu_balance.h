@@ -0,0 +1,103 @@
+ /**************************************************************************************************************
+ * @file           : mcu_balance.h                                                 P A C K   C O N T R O L L E R
+ * @brief          : Header for the cell balancing planner
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MCU_BALANCE_H_
+#define MCU_BALANCE_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "bms.h"
+#include "../../protocols/CAN_ID_ALL.h"
+
+
+/***************************************************************************************************************
+*
+*                      Section: Type Definitions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+#define MCU_BALANCE_START_MV        10      // Start bleeding a cell this far above the pack minimum (mV)
+#define MCU_BALANCE_STOP_MV         4       // Stop bleeding it once it is this close (mV)
+#define MCU_BALANCE_DONE_MV         12      // Pack reports balanced when the cell spread is within this (mV)
+#define MCU_BALANCE_FLOOR_MV        3000    // No bleeding while the lowest cell is below this (mV)
+#define MCU_BALANCE_INTERVAL        1000    // Planning cycle start interval - 1 s
+#define MCU_BALANCE_REFRESH         5000    // Unchanged masks are sent again after this - 5 s
+#define MCU_BALANCE_DURATION        15      // Seconds a module bleeds without hearing from the pack
+#define MCU_BALANCE_CELLS_PER_PASS  48      // Cells planned per PCU_Tasks() pass
+#define MCU_BALANCE_FRAMES_PER_PASS 2       // CELL_BALANCE frames loaded per PCU_Tasks() pass
+#define MCU_BALANCE_FRAMES          ((MAX_CELLS_PER_MODULE + CELL_BALANCE_FRAME_CELLS - 1) / CELL_BALANCE_FRAME_CELLS)
+
+// VCU cell balance control (vcu_cell_balance_ctrl, module_cell_balance_ctrl)
+#define MCU_BALANCE_CTRL_OFF        0
+#define MCU_BALANCE_CTRL_ON         1
+
+/***************************************************************************************************************
+* Cell Balancing Planner                                                           P A C K   C O N T R O L L E R
+
+  Summary:
+    Chooses the cells to bleed from the pack wide cell voltages and sends the bleed masks to the modules.
+
+  Description:
+    Balancing is switched on for the whole pack by vcu_cell_balance_ctrl in the VCU command (0x400) or
+    for one module by module_cell_balance_ctrl in direct module control (0x404).
+
+    A planning cycle starts every MCU_BALANCE_INTERVAL. It takes the pack minimum cell voltage from
+    mcuCellStats as the target, then walks the cells of every registered module: a cell more than
+    MCU_BALANCE_START_MV above the target starts bleeding, a bleeding cell stops once it is within
+    MCU_BALANCE_STOP_MV. The gap between the two keeps a cell from toggling on measurement noise.
+    The walk is resumable - PCU_Tasks() plans at most MCU_BALANCE_CELLS_PER_PASS cells per pass, so a
+    full pack of 32 x 192 cells costs the same per pass as a single module.
+
+    The masks are kept per CELL_BALANCE frame (48 cells). A frame whose mask changed is queued for its
+    module, and every frame with a bleeding cell is queued again once per MCU_BALANCE_REFRESH so the
+    module's own MCU_BALANCE_DURATION timeout never runs out while balancing. At most
+    MCU_BALANCE_FRAMES_PER_PASS queued frames are loaded per pass, so a cycle that changes the whole
+    pack goes out in bursts the TX FIFO absorbs instead of one long stall.
+
+    A module without a complete cell set, a module no longer enabled, and every module while the lowest
+    cell is below MCU_BALANCE_FLOOR_MV are planned with all cells off. The end of each cycle sets
+    pack.cellBalanceActive (any cell bleeding) and pack.cellBalanceStatus (pack spread within
+    MCU_BALANCE_DONE_MV), and the per module flags reported in MODULE_STATE.
+***************************************************************************************************************/
+
+typedef struct {
+  uint64_t bleed[MAX_MODULES_PER_PACK][MCU_BALANCE_FRAMES]; // bit n set = bleed cell frame * 48 + n
+  uint8_t  pending[MAX_MODULES_PER_PACK];     // bit f set = frame f must be sent to the module
+  uint32_t pendingMask;                       // bit n set when pending[n] is not 0
+  bool     packEnable;                        // balance every registered module
+  uint32_t moduleEnable;                      // bit n set = balance module[n] (direct module control)
+  bool     running;                           // a planning cycle is in progress
+  bool     refresh;                           // this cycle queues every frame with a bleeding cell
+  uint32_t cycleMask;                         // modules still to plan this cycle
+  uint8_t  cursorCell;                        // next cell of the lowest module in cycleMask
+  uint8_t  changed;                           // frames of that module changed so far this cycle
+  uint16_t target;                            // pack minimum cell voltage at the cycle start (mV)
+  uint16_t bleedCells;                        // cells bleeding in the cycle being planned
+  uint32_t cycleStart;                        // MCU_Now() of the last cycle start
+  uint32_t lastRefresh;                       // MCU_Now() of the last refresh cycle
+  uint32_t activeMask;                        // bit n set = module[n] has a cell bleeding
+  uint32_t balancedMask;                      // bit n set = every cell of module[n] within MCU_BALANCE_DONE_MV
+  uint16_t bleeding;                          // cells bleeding after the last complete cycle
+  uint16_t cycles;                            // complete planning cycles
+} mcuBalance_t;
+
+extern mcuBalance_t mcuBalance;
+
+
+/***************************************************************************************************************
+*
+*                      Section: Function Prototypes                                P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+extern void     MCU_BalanceInit(void);
+extern void     MCU_BalancePackControl(uint8_t control);
+extern void     MCU_BalanceModuleControl(uint8_t moduleIndex, uint8_t control);
+extern void     MCU_BalanceModulesChanged(uint32_t moduleMask);
+extern void     MCU_BalanceTasks(uint32_t now);
+
+#endif /* MCU_BALANCE_H_ */
@@ -0,0 +1,75 @@
+ /**************************************************************************************************************
+ * @file           : mcu_cells.h                                                   P A C K   C O N T R O L L E R
+ * @brief          : Header for the module cell data arena
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MCU_CELLS_H_
+#define MCU_CELLS_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "bms.h"
+
+
+/***************************************************************************************************************
+*
+*                      Section: Type Definitions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+#define MCU_CELL_MODULE_CELLS     94        // Most cells a supported module reports
+#define MCU_CELL_POOL_CELLS       (MAX_MODULES_PER_PACK * MCU_CELL_MODULE_CELLS)  // Cells shared by all modules - a full pack of the largest modules, 18 KB
+
+/***************************************************************************************************************
+* Cell Arena                                                                       P A C K   C O N T R O L L E R
+
+  Summary:
+    Cell data for every module from one shared pool, sized by the cell count the module reports.
+
+  Description:
+    Modules report 14 to 94 cells, so a fixed MAX_CELLS_PER_MODULE block for each of the 32 slots
+    (36 KB) is mostly unused. A module gets a block of exactly its reported cell count the first time
+    cell data arrives for it, and gives it back when it leaves service (MCU_UpdateModuleCounts()).
+
+    Blocks are handed out from the top of the used area. When the space above it is too small but the
+    pool as a whole has room, MCU_CellsCompact() slides every block down over the holes left by freed
+    ones, keeping cell data, and the allocation is retried. Only the main loop touches the pool and no
+    caller keeps a block pointer across passes, so moving blocks is safe.
+
+    The pool holds a full pack of MCU_CELL_MODULE_CELLS modules, so only a module reporting more than
+    that can fail to fit. It keeps no cell data - allocFailures counts it, the error is reported and its
+    cells are dropped until a block frees up.
+***************************************************************************************************************/
+
+typedef struct {
+  batteryCell pool[MCU_CELL_POOL_CELLS];
+  uint16_t    offset[MAX_MODULES_PER_PACK];   // first cell of each module's block
+  uint8_t     count[MAX_MODULES_PER_PACK];    // cells in each module's block, 0 when it has none
+  uint16_t    top;                            // end of the used area - blocks are handed out from here
+  uint16_t    used;                           // cells in blocks, top - used are in holes
+  uint16_t    allocFailures;                  // blocks that did not fit even after compaction
+} mcuCells_t;
+
+extern mcuCells_t mcuCells;
+
+
+/***************************************************************************************************************
+*
+*                      Section: Function Prototypes                                P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+extern void         MCU_CellsInit(void);
+extern batteryCell* MCU_CellsAlloc(uint8_t moduleIndex, uint8_t cellCount);
+extern void         MCU_CellsRelease(uint8_t moduleIndex);
+extern void         MCU_CellsCompact(void);
+
+// module's cell block, NULL when it has none - valid until the next MCU_CellsAlloc()
+static inline batteryCell* MCU_Cells(uint8_t moduleIndex)
+{
+  return mcuCells.count[moduleIndex] ? &mcuCells.pool[mcuCells.offset[moduleIndex]] : 0;
+}
+
+#endif /* MCU_CELLS_H_ */
@@ -0,0 +1,73 @@
+ /**************************************************************************************************************
+ * @file           : mcu_cellstats.h                                               P A C K   C O N T R O L L E R
+ * @brief          : Header for the pack cell level statistics
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MCU_CELLSTATS_H_
+#define MCU_CELLSTATS_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "bms.h"
+#include "cell_stats.h"
+
+
+/***************************************************************************************************************
+*
+*                      Section: Type Definitions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+* Pack Cell Statistics                                                             P A C K   C O N T R O L L E R
+
+  Summary:
+    Pack statistics worked out from the cell data the pack controller collected.
+
+  Description:
+    The pack hi/lo/avg in mcu_stats.c come from the summaries the modules report in Status2/3. These
+    are derived from the cells themselves: minimum, maximum, mean, standard deviation and spread of the
+    cell voltages and temperatures, the module holding each extreme, and a voltage histogram.
+
+    Each module keeps an accumulator (cell_stats.h) over its last complete cell set. The set is marked
+    stale by MCU_CellStatsModuleChanged() when the last cell of a cell detail request has arrived, and
+    when the module registers or leaves service. MCU_UpdateCellStats() runs the kernel over the cell
+    blocks of the stale modules only, then merges the 32 accumulators into the pack figures. A module
+    without a complete cell set takes no part.
+
+    Voltages are in mV and temperatures in the raw module encoding (TEMPERATURE_FACTOR/BASE).
+***************************************************************************************************************/
+
+typedef struct {
+  cellStatsAcc_t module[MAX_MODULES_PER_PACK];  // last complete cell set of each module
+  uint32_t   staleMask;                       // bit n set when module[n] must be run again
+  uint32_t   cellMask;                        // bit n set when module[n] is in the pack figures
+  uint16_t   cells;                           // cells in the pack figures
+  uint8_t    modules;                         // modules in the pack figures
+  cellStat_t volt;
+  cellStat_t temp;
+  uint8_t    modMinVolt;                      // module index holding each extreme, lowest on a tie
+  uint8_t    modMaxVolt;
+  uint8_t    modMinTemp;
+  uint8_t    modMaxTemp;
+  uint16_t   hist[CELL_STATS_HIST_BINS];      // pack cell voltage histogram
+  uint16_t   updates;                         // counts every change of the pack figures
+} mcuCellStats_t;
+
+extern mcuCellStats_t mcuCellStats;
+
+
+/***************************************************************************************************************
+*
+*                      Section: Function Prototypes                                P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+extern void     MCU_CellStatsInit(void);
+extern void     MCU_CellStatsModuleChanged(uint8_t moduleIndex);
+extern void     MCU_CellStatsModulesChanged(uint32_t moduleMask);
+extern void     MCU_UpdateCellStats(void);
+
+#endif /* MCU_CELLSTATS_H_ */
@@ -0,0 +1,122 @@
+ /**************************************************************************************************************
+ * @file           : mcu_sched.h                                                   P A C K   C O N T R O L L E R
+ * @brief          : Header for the deadline driven module scheduler
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MCU_SCHED_H_
+#define MCU_SCHED_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "bms.h"
+
+
+/***************************************************************************************************************
+*
+*                      Section: Type Definitions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+#define MCU_SCHED_IDLE_RECHECK    100       // Re-check interval for a module with nothing due - 100 ms
+#define MCU_SCHED_NONE            MAX_MODULES_PER_PACK  // Returned when no module is due
+
+/***************************************************************************************************************
+* Module Scheduler                                                                 P A C K   C O N T R O L L E R
+
+  Summary:
+    Min-heap of registered modules ordered by their next deadline.
+
+  Description:
+    Each registered module has a single deadline, the earliest of:
+      - status poll due       (last contact + MCU_STATUS_INTERVAL)
+      - status reply timeout  (last contact + MCU_ET_TIMEOUT, while statusPending)
+      - state retransmit      (last state tx + MCU_STATE_TX_INTERVAL, while commandIssued)
+    PCU_Tasks() only services modules at the top of the heap whose deadline has expired, so idle slots
+    cost nothing per pass. registeredMask mirrors moduleCtl.isRegistered[] so the remaining per-module loops
+    can walk occupied slots only.
+
+    Deadlines are in milliseconds from MCU_Now() and compared with signed differences so the 32 bit
+    counter may wrap.
+***************************************************************************************************************/
+
+typedef struct {
+  uint8_t  heap[MAX_MODULES_PER_PACK];        // module indexes, heap[0] has the earliest deadline
+  uint8_t  pos[MAX_MODULES_PER_PACK];         // heap position of each module index, MCU_SCHED_NONE if absent
+  uint32_t due[MAX_MODULES_PER_PACK];         // deadline of each module index (ms)
+  uint8_t  count;                             // number of entries in the heap
+  uint32_t registeredMask;                    // bit n set when module[n] is registered
+} mcuSchedule_t;
+
+extern mcuSchedule_t mcuSched;
+
+/***************************************************************************************************************
+* Status Poller                                                                    P A C K   C O N T R O L L E R
+
+  Summary:
+    Pipelined status polling with several requests in flight.
+
+  Description:
+    Up to 'window' modules may have a status request outstanding at once. A request leaves the window
+    when Status1/2/3 have all arrived (statusMessagesReceived == 0x07) or MCU_POLL_SLOT_TIMEOUT after it was
+    sent - the module stays statusPending until MCU_ET_TIMEOUT, but a lost reply does not hold the window.
+    Modules in comms error are skipped here and asked by the scheduler every MCU_STATUS_INTERVAL.
+    The completion latency is tracked as an 8x scaled moving average (latencyAvg, ms * 8), and on every
+    completion MCU_PollComplete() sizes the window by Little's law from the poll rate the budget allows,
+    demand / pollCost polls per second, with demand capped at busLoadBudget:
+        window = ceil(latencyAvg * min(demand, busLoadBudget) / (8000 * pollCost))
+    clamped to MCU_POLL_WINDOW_MIN..MCU_POLL_WINDOW_MAX.
+
+    Each module has its own poll interval, re-chosen from its latest status by MCU_PollRate():
+      - MCU_POLL_INTERVAL_FAST    high current, fast voltage change, cells near a limit or over current
+      - MCU_POLL_INTERVAL_IDLE    not on, no current and no voltage change
+      - MCU_POLL_INTERVAL_NORMAL  everything else
+    Every poll costs pollCost of bus time (MCU_POLL_COST_US, or MCU_POLL_COST_FD_US once the module bus
+    runs CAN FD), so the summed demand (bus us per second) is held
+    within busLoadBudget by stretching all intervals by the same Q8 factor when it is exceeded.
+***************************************************************************************************************/
+
+typedef struct {
+  uint32_t requestTime[MAX_MODULES_PER_PACK]; // MCU_Now() when the last status request was sent
+  uint32_t inFlightMask;                      // bit n set while module[n] has a request in the window
+  uint32_t latencyAvg;                        // response latency moving average (ms * 8)
+  uint8_t  window;                            // current number of requests allowed in flight
+  uint8_t  nextIndex;                         // round-robin start point for the next request
+  uint16_t interval[MAX_MODULES_PER_PACK];    // poll interval chosen for each module (ms)
+  uint16_t lastMmv[MAX_MODULES_PER_PACK];     // module voltage at the previous status (dV/dt)
+  uint32_t lastSample[MAX_MODULES_PER_PACK];  // MCU_Now() of the previous status, 0 = none yet
+  uint32_t demand;                            // bus time needed by all polls at their intervals (us/s)
+  uint32_t busLoadBudget;                     // bus time allowed for polling (us/s)
+  uint16_t stretch;                           // interval multiplier when over budget (Q8, 256 = 1.0)
+  uint16_t pollCost;                          // bus time of one poll (us) - MCU_POLL_COST_US or MCU_POLL_COST_FD_US
+} mcuPoller_t;
+
+extern mcuPoller_t mcuPoll;
+
+
+/***************************************************************************************************************
+*
+*                      Section: Function Prototypes                                P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+extern uint32_t MCU_Now(void);
+extern uint32_t MCU_TicksToMs(lastContact_t* pTime);
+extern void     MCU_SchedInit(void);
+extern void     MCU_SchedUpdate(uint8_t moduleIndex);
+extern void     MCU_SchedDefer(uint8_t moduleIndex, uint32_t delay);
+extern void     MCU_SchedRemove(uint8_t moduleIndex);
+extern uint8_t  MCU_SchedNextDue(uint32_t now);
+extern bool     MCU_SchedStateTxDue(uint8_t moduleIndex, uint32_t now);
+
+extern void     MCU_PollInit(void);
+extern void     MCU_PollIssued(uint8_t moduleIndex);
+extern void     MCU_PollComplete(uint8_t moduleIndex);
+extern void     MCU_PollRelease(uint8_t moduleIndex);
+extern uint8_t  MCU_PollNextCandidate(uint32_t now);
+extern void     MCU_PollRate(uint8_t moduleIndex);
+extern void     MCU_PollBudget(void);
+extern void     MCU_PollSetBudget(uint8_t percent);
+
+#endif /* MCU_SCHED_H_ */
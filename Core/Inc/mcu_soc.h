@@ -0,0 +1,68 @@
+ /**************************************************************************************************************
+ * @file           : mcu_soc.h                                                     P A C K   C O N T R O L L E R
+ * @brief          : Header for the pack state of charge estimate
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MCU_SOC_H_
+#define MCU_SOC_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "bms.h"
+#include "soc_estimator.h"
+
+
+/***************************************************************************************************************
+*
+*                      Section: Type Definitions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+#define MCU_SOC_MODULE_AH         100       // Nominal module capacity (Ah) - the module SOC reports correct the rest
+#define MCU_SOC_INTERVAL          100       // Estimate update interval - 100 ms
+#define MCU_SOC_HOLD              5000      // A module current older than this is no longer counted - 5 s
+
+/***************************************************************************************************************
+* Pack State of Charge Estimate                                                    P A C K   C O N T R O L L E R
+
+  Summary:
+    Smooth pack SOC between module status reports, for BMS_DATA_2.
+
+  Description:
+    pack.soc is the lowest module SOC - 0.5 % steps that move only when a status set comes in. Each
+    registered module also gets a soc_estimator.h estimate: MCU_SocModuleStatus() runs for every status
+    set MCU_PublishModuleStatus() publishes, counts the old current up to that moment and then takes the
+    new SOC and current. MCU_SocTasks() counts every module's current forward each MCU_SOC_INTERVAL and
+    sets pack.socEstimate to the lowest estimate of the modules in the pack aggregates, so it is the
+    same weakest module figure as pack.soc at 1/640 % resolution.
+
+    A module starts from its first status set after it registers. A module that stops reporting keeps
+    its last estimate, but its current is not counted past MCU_SOC_HOLD. With no module estimate,
+    pack.socEstimate follows pack.soc.
+***************************************************************************************************************/
+
+typedef struct {
+  socEst_t est[MAX_MODULES_PER_PACK];
+  uint32_t lastCount[MAX_MODULES_PER_PACK];   // MCU_Now() the module's current was counted up to
+  uint32_t lastReport[MAX_MODULES_PER_PACK];  // MCU_Now() of the module's last status set
+  uint32_t validMask;                         // bit n set = est[n] started from a status set
+  uint32_t lastUpdate;                        // MCU_Now() of the last MCU_SocTasks() update
+} mcuSoc_t;
+
+extern mcuSoc_t mcuSoc;
+
+
+/***************************************************************************************************************
+*
+*                      Section: Function Prototypes                                P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+extern void     MCU_SocInit(void);
+extern void     MCU_SocModuleStatus(uint8_t moduleIndex, const moduleStatus* status, uint32_t now);
+extern void     MCU_SocModulesChanged(uint32_t moduleMask);
+extern void     MCU_SocTasks(uint32_t now);
+
+#endif /* MCU_SOC_H_ */
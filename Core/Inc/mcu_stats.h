@@ -0,0 +1,86 @@
+ /**************************************************************************************************************
+ * @file           : mcu_stats.h                                                   P A C K   C O N T R O L L E R
+ * @brief          : Header for the incremental pack statistics
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MCU_STATS_H_
+#define MCU_STATS_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "bms.h"
+#include "module_stats.h"
+
+
+/***************************************************************************************************************
+*
+*                      Section: Type Definitions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+// VCU data frames whose pack values changed - returned by MCU_StatsTakeDirty(). BMS_STATE carries the
+// pack state as well and is sent every cycle.
+#define MCU_STATS_DIRTY_DATA1     0x01      // 0x421 BMS_DATA_1  - pack voltage and current
+#define MCU_STATS_DIRTY_DATA2     0x02      // 0x422 BMS_DATA_2  - cell voltages, SOC
+#define MCU_STATS_DIRTY_DATA3     0x04      // 0x423 BMS_DATA_3  - cell temperatures
+#define MCU_STATS_DIRTY_DATA5     0x08      // 0x425 BMS_DATA_5  - current limits, end voltage
+#define MCU_STATS_DIRTY_DATA8     0x10      // 0x428 BMS_DATA_8  - modules with the hi/lo cell voltage
+#define MCU_STATS_DIRTY_DATA9     0x20      // 0x429 BMS_DATA_9  - modules with the hi/lo cell temperature
+#define MCU_STATS_DIRTY_ALL       0x3F
+
+#define MCU_STATS_VCU_REFRESH     4         // Send unchanged VCU data frames every 4th BMS cycle - 2 seconds
+
+/***************************************************************************************************************
+* Pack Statistics                                                                  P A C K   C O N T R O L L E R
+
+  Summary:
+    Pack aggregates kept up to date one module at a time.
+
+  Description:
+    A module's contribution is recomputed only when it is marked stale by MCU_StatsModuleChanged():
+    a new status was published, its hardware limits arrived, a fault was raised or cleared, or it
+    registered or deregistered. MCU_UpdateStats() rebuilds the module's moduleStatsEntry_t and, while
+    it stays active, moves the running totals from its old summary row to the new one with
+    ModuleStats_Update() (module_stats.h) - a fixed number of operations unless the module held a minimum
+    it now moves away from, which searches that one key again. A pass with nothing stale costs one mask
+    test.
+
+    A module joining or leaving the aggregates compacts the summary again from the entries and rebuilds
+    the totals with one branchless ModuleStats_Pass() kernel pass, once per pass however many changed.
+    Equal keys go to the lower slot, the same module the old full scan picked.
+
+    The sums are kept in the raw module units. Currents and limits are converted to the pack encoding
+    once, in integers (fixed_signal.h), when the pack values are derived.
+***************************************************************************************************************/
+
+typedef struct {
+  moduleStatsEntry_t   entry[MAX_MODULES_PER_PACK];   // contribution of each module while it is active
+  moduleStatsSummary_t summary;               // active modules compacted in slot order
+  moduleStatsResult_t  totals;                // minima, sums and on count over the summary
+  uint8_t  row[MAX_MODULES_PER_PACK];         // summary row of each active module
+  uint32_t activeMask;                        // bit n set when module[n] is in the pack aggregates
+  uint32_t onMask;                            // ... and its status reports moduleOn
+  uint32_t staleMask;                         // bit n set when module[n] must be recomputed
+  bool     rebuild;                           // activeMask changed - the summary must be compacted again
+  bool     refresh;                           // pack values must be derived again
+  uint8_t  dirty;                             // MCU_STATS_DIRTY_x of VCU frames changed since last taken
+} mcuStats_t;
+
+extern mcuStats_t mcuStats;
+
+
+/***************************************************************************************************************
+*
+*                      Section: Function Prototypes                                P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+extern void     MCU_StatsInit(void);
+extern void     MCU_StatsModuleChanged(uint8_t moduleIndex);
+extern void     MCU_StatsModulesChanged(uint32_t moduleMask);
+extern void     MCU_UpdateStats(void);
+extern uint8_t  MCU_StatsTakeDirty(void);
+
+#endif /* MCU_STATS_H_ */
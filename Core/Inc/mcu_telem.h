@@ -0,0 +1,118 @@
+ /**************************************************************************************************************
+ * @file           : mcu_telem.h                                                   P A C K   C O N T R O L L E R
+ * @brief          : Header for the per module status history
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MCU_TELEM_H_
+#define MCU_TELEM_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "bms.h"
+#include "../../protocols/CAN_ID_ALL.h"
+#include "../../protocols/can_frm_vcu.h"
+
+
+/***************************************************************************************************************
+*
+*                      Section: Type Definitions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+#define MCU_TELEM_RAW_DEPTH       8         // Latest status sets at full rate
+#define MCU_TELEM_1S_DEPTH        6         // 1 s periods  - the last 6 s
+#define MCU_TELEM_10S_DEPTH       6         // 10 s periods - the last minute
+#define MCU_TELEM_60S_DEPTH       10        // 60 s periods - the last 10 minutes
+#define MCU_TELEM_TIERS           3         // decimated tiers - TELEM_TIER_1S..TELEM_TIER_60S
+#define MCU_TELEM_TIER_ENTRIES    (MCU_TELEM_1S_DEPTH + MCU_TELEM_10S_DEPTH + MCU_TELEM_60S_DEPTH)
+#define MCU_TELEM_FRAMES_PER_PASS 2         // MODULE_TELEMETRY frames loaded per PCU_Tasks() pass
+
+/***************************************************************************************************************
+* Module Status History                                                            P A C K   C O N T R O L L E R
+
+  Summary:
+    Bounded history of every module's published status, at full rate and decimated into 1 s, 10 s and
+    60 s min/max/avg periods.
+
+  Description:
+    MCU_TelemRecord() runs for each status set MCU_PublishModuleStatus() publishes. The set goes into the
+    module's RAW ring, and into one open period per tier. A period is closed into its tier's ring by the
+    first set that falls in a later period, so each tier is built straight from the status sets - not from
+    the tier below - and its averages are exact. A period with no status set leaves no entry; the entry
+    times show the gap. Periods start on multiples of their length on the MCU_Now() clock.
+
+    All rings are fixed size, about 1 KB per module slot (32 KB for the pack). A slot's history is cleared
+    when a module registers into it.
+
+    VCU_REQUEST_TELEMETRY starts a query through MCU_TelemQueryStart(). VCU_TransmitTelemetry() then
+    loads MCU_TELEM_FRAMES_PER_PASS frames per pass from MCU_TelemQueryNext(), so a long reply never
+    holds up the control loop. A query counts entries from the newest at the time of the request; status
+    sets recorded while it is sent are skipped over, and it ends early if the entries it still has to
+    send are overwritten. A new request replaces a query in progress. Recording and the query both run
+    from PCU_Tasks().
+***************************************************************************************************************/
+
+typedef struct {                    // one status set, or the min/max/avg of the sets in one period
+  uint32_t time;                    // MCU_Now() of the set or the period start (ms)
+  uint16_t voltMin;                 // module voltage - MODULE_VOLTAGE_FACTOR
+  uint16_t voltMax;
+  uint16_t voltAvg;
+  uint16_t currMin;                 // module current - MODULE_CURRENT_FACTOR/BASE
+  uint16_t currMax;
+  uint16_t currAvg;
+  uint16_t cellLoVolt;              // lowest cell in the period (mV)
+  uint16_t cellHiVolt;              // highest cell in the period (mV)
+  uint16_t cellLoTemp;              // lowest cell temperature - TEMPERATURE_FACTOR/BASE
+  uint16_t cellHiTemp;              // highest cell temperature
+  uint8_t  soc;                     // average
+  uint8_t  samples;                 // status sets in the period, 255 = 255 or more
+} mcuTelemEntry_t;
+
+typedef struct {                    // period being collected
+  mcuTelemEntry_t entry;            // time, min and max so far
+  uint32_t voltSum;
+  uint32_t currSum;
+  uint32_t socSum;
+  uint16_t count;                   // status sets so far, 0 = no open period
+} mcuTelemOpen_t;
+
+typedef struct {
+  mcuTelemEntry_t raw[MCU_TELEM_RAW_DEPTH];
+  mcuTelemEntry_t tier[MCU_TELEM_TIER_ENTRIES];     // 1 s, 10 s and 60 s rings back to back
+  mcuTelemOpen_t  open[MCU_TELEM_TIERS];
+  uint8_t         head[MCU_TELEM_TIERS + 1];        // next write position of RAW and each tier ring
+  uint8_t         count[MCU_TELEM_TIERS + 1];       // entries held
+  uint16_t        written[MCU_TELEM_TIERS + 1];     // entries ever written - wraps
+} mcuTelemModule_t;
+
+typedef struct {
+  bool     active;
+  uint8_t  moduleIndex;
+  uint8_t  moduleId;
+  uint8_t  tier;                    // TELEM_TIER_RAW..TELEM_TIER_60S
+  uint8_t  entry;                   // next entry, counted from the newest at the request
+  uint8_t  end;                     // one past the last entry to send
+  uint8_t  page;                    // next page of that entry
+  uint16_t written;                 // written[tier] at the request
+} mcuTelemQuery_t;
+
+extern mcuTelemModule_t mcuTelem[MAX_MODULES_PER_PACK];
+extern mcuTelemQuery_t  mcuTelemQuery;
+
+
+/***************************************************************************************************************
+*
+*                      Section: Function Prototypes                                P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+extern void     MCU_TelemInit(void);
+extern void     MCU_TelemRecord(uint8_t moduleIndex, const moduleStatus* status, uint32_t now);
+extern void     MCU_TelemModulesJoined(uint32_t moduleMask);
+extern bool     MCU_TelemEntry(uint8_t moduleIndex, uint8_t tier, uint8_t entry, mcuTelemEntry_t* out);
+extern void     MCU_TelemQueryStart(uint8_t moduleId, uint8_t tier, uint8_t firstEntry, uint8_t entryCount);
+extern bool     MCU_TelemQueryNext(CANFRM_0x418_MODULE_TELEMETRY* frame, uint32_t now);
+
+#endif /* MCU_TELEM_H_ */
@@ -0,0 +1,249 @@
+ /**************************************************************************************************************
+ * @file           : module_stats.h                                                P A C K   C O N T R O L L E R
+ * @brief          : Branchless pack aggregation kernel over the active module summary
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef MODULE_STATS_H_
+#define MODULE_STATS_H_
+
+// Include files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "bms.h"
+
+
+/***************************************************************************************************************
+* Module Statistics Kernel                                                         P A C K   C O N T R O L L E R
+
+  Summary:
+    Minimum, lowest slot holding it and sum of every module value the pack aggregates, kept up to date
+    over a compacted summary of the active modules.
+
+  Description:
+    Each module's contribution is a moduleStatsEntry_t: the keys the pack takes the minimum of (maxima
+    stored inverted, 0xFFFF - value) and the values it sums, the first MODULE_STATS_ON_SUMS of them only
+    while the module is on. ModuleStats_Compact() copies the entries of the active modules into rows of
+    a struct-of-arrays summary, in slot order, when the active set changes.
+
+    ModuleStats_Pass() is the kernel, run after a compaction. It walks each summary array once, with no
+    branch on the data and a fixed trip count - ModuleStats_Compact() fills the rows past the active
+    modules with values that lose every minimum and add nothing:
+
+      minima      a key is stored as key << 8 | slot, so one unsigned minimum finds both the lowest
+                  key and, as rows are in slot order, the lowest slot holding it
+      sums        on-only values are masked with 0xFFFF/0 per row instead of tested
+
+    Each inner loop is the same operation over one contiguous array of MAX_MODULES_PER_PACK values,
+    which the compiler unrolls into select instructions on the Cortex-M4 and into vector code on the
+    host.
+
+    A module whose values change while it stays active goes through ModuleStats_Update() instead, which
+    rewrites its row and moves the totals from the old row to the new one: the sums and on count by the
+    difference, each minimum by one comparison. Only a key whose minimum this module held and that it
+    now moves away from is searched for again - ModuleStats_Min() over that one array.
+
+    ModuleStats_Scalar() is the plain definition over the uncompacted entries - a slot walk that tests
+    the active and on masks - that the kernel and the updates must match exactly, and that matches the
+    tournament trees they replaced: an empty key set reports MODULE_STATS_EMPTY from slot 0. The host
+    bench (emulator/bench/module_stats_bench.c) checks them against each other and the pack values
+    derived from them against the float MCU_UpdateStats() of the original firmware.
+***************************************************************************************************************/
+
+// keys - the pack takes the minimum of each, maxima are stored inverted (0xFFFF - value)
+#define MODULE_STATS_CELL_LO_VOLT     0
+#define MODULE_STATS_CELL_HI_VOLT     1
+#define MODULE_STATS_CELL_LO_TEMP     2
+#define MODULE_STATS_CELL_HI_TEMP     3
+#define MODULE_STATS_SOC              4
+#define MODULE_STATS_SOH              5
+#define MODULE_STATS_KEYS             6
+
+// sums - the first MODULE_STATS_ON_SUMS count only modules that are on
+#define MODULE_STATS_MMV              0
+#define MODULE_STATS_MMC              1
+#define MODULE_STATS_MAX_CHARGE_A     2
+#define MODULE_STATS_MAX_DISCHARGE_A  3
+#define MODULE_STATS_ON_SUMS          4
+#define MODULE_STATS_MAX_CHARGE_END_V 4
+#define MODULE_STATS_CELL_AVG_VOLT    5
+#define MODULE_STATS_CELL_AVG_TEMP    6
+#define MODULE_STATS_SUMS             7
+
+#define MODULE_STATS_EMPTY            0xFFFF    // minimum of a key no active module holds
+
+typedef struct {                            // one module's contribution
+  uint16_t key[MODULE_STATS_KEYS];
+  uint16_t sum[MODULE_STATS_SUMS];
+  bool     on;                              // module reports moduleOn
+} moduleStatsEntry_t;
+
+typedef struct {                            // active modules, one row each in slot order
+  uint8_t  rows;
+  uint8_t  slot[MAX_MODULES_PER_PACK];                      // module index of each row
+  uint32_t rank[MODULE_STATS_KEYS][MAX_MODULES_PER_PACK];   // key << 8 | slot
+  uint16_t sum[MODULE_STATS_SUMS][MAX_MODULES_PER_PACK];
+  uint16_t on[MAX_MODULES_PER_PACK];                        // 0xFFFF when on, 0 when off
+} moduleStatsSummary_t;
+
+typedef struct {
+  uint16_t min[MODULE_STATS_KEYS];          // MODULE_STATS_EMPTY when no active module is below it
+  uint8_t  slot[MODULE_STATS_KEYS];         // lowest slot holding the minimum, 0 when it is MODULE_STATS_EMPTY
+  uint32_t sum[MODULE_STATS_SUMS];
+  uint8_t  on;                              // modules on
+} moduleStatsResult_t;
+
+#define MODULE_STATS_RANK(key, slot)  (((uint32_t)(key) << 8) | (slot))
+#define MODULE_STATS_RANK_NONE        0xFFFFFFFF  // rank of a row past the active modules
+
+/***************************************************************************************************************
+*     M o d u l e S t a t s _ S e t R o w                                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void ModuleStats_SetRow(moduleStatsSummary_t* summary, uint8_t row, uint8_t slot, const moduleStatsEntry_t* entry)
+{
+  uint8_t index;
+
+  summary->slot[row] = slot;
+  for(index = 0; index < MODULE_STATS_KEYS; index++) summary->rank[index][row] = MODULE_STATS_RANK(entry->key[index], slot);
+  for(index = 0; index < MODULE_STATS_SUMS; index++) summary->sum[index][row]  = entry->sum[index];
+  summary->on[row] = entry->on ? 0xFFFF : 0;
+}
+
+/***************************************************************************************************************
+*     M o d u l e S t a t s _ C o m p a c t                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void ModuleStats_Compact(moduleStatsSummary_t* summary, uint8_t* rowOf, const moduleStatsEntry_t* entry, uint32_t activeMask)
+{
+  uint8_t slot;
+  uint8_t row;
+  uint8_t index;
+
+  summary->rows = 0;
+  for(; activeMask != 0; activeMask &= activeMask - 1){
+    slot = __builtin_ctz(activeMask);
+    rowOf[slot] = summary->rows;
+    ModuleStats_SetRow(summary, summary->rows++, slot, &entry[slot]);
+  }
+
+  // rows past the active modules lose every minimum and add nothing
+  for(row = summary->rows; row < MAX_MODULES_PER_PACK; row++){
+    summary->slot[row] = 0;
+    for(index = 0; index < MODULE_STATS_KEYS; index++) summary->rank[index][row] = MODULE_STATS_RANK_NONE;
+    for(index = 0; index < MODULE_STATS_SUMS; index++) summary->sum[index][row]  = 0;
+    summary->on[row] = 0;
+  }
+}
+
+/***************************************************************************************************************
+*     M o d u l e S t a t s _ S c a l a r                                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void ModuleStats_Scalar(const moduleStatsEntry_t* entry, uint32_t activeMask, moduleStatsResult_t* result)
+{
+  uint8_t slot;
+  uint8_t index;
+
+  memset(result, 0, sizeof(*result));
+  for(index = 0; index < MODULE_STATS_KEYS; index++) result->min[index] = MODULE_STATS_EMPTY;
+
+  for(slot = 0; slot < MAX_MODULES_PER_PACK; slot++){
+    if(!(activeMask & (1UL << slot))) continue;
+    for(index = 0; index < MODULE_STATS_KEYS; index++){
+      if(entry[slot].key[index] < result->min[index]){
+        result->min[index]  = entry[slot].key[index];
+        result->slot[index] = slot;
+      }
+    }
+    for(index = 0; index < MODULE_STATS_SUMS; index++){
+      if(index >= MODULE_STATS_ON_SUMS || entry[slot].on) result->sum[index] += entry[slot].sum[index];
+    }
+    if(entry[slot].on) result->on++;
+  }
+}
+
+/***************************************************************************************************************
+*     M o d u l e S t a t s _ M i n                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint32_t ModuleStats_Min(const uint32_t* rank)
+{
+  uint32_t best = MODULE_STATS_RANK(MODULE_STATS_EMPTY, 0);  // nothing below the empty key - slot 0, as the trees
+  uint8_t  row;
+
+  // every row, padding included - a fixed trip count the compiler can unroll and vectorise
+  for(row = 0; row < MAX_MODULES_PER_PACK; row++) best = rank[row] < best ? rank[row] : best;
+  return best;
+}
+
+/***************************************************************************************************************
+*     M o d u l e S t a t s _ P a s s                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void ModuleStats_Pass(const moduleStatsSummary_t* summary, moduleStatsResult_t* result)
+{
+  uint32_t best;
+  uint32_t total;
+  uint8_t  index;
+  uint8_t  row;
+
+  for(index = 0; index < MODULE_STATS_KEYS; index++){
+    best = ModuleStats_Min(summary->rank[index]);
+    result->min[index]  = (uint16_t)(best >> 8);
+    result->slot[index] = (uint8_t)best;
+  }
+
+  for(index = 0; index < MODULE_STATS_ON_SUMS; index++){
+    const uint16_t* sum = summary->sum[index];
+    total = 0;
+    for(row = 0; row < MAX_MODULES_PER_PACK; row++) total += sum[row] & summary->on[row];
+    result->sum[index] = total;
+  }
+  for(; index < MODULE_STATS_SUMS; index++){
+    const uint16_t* sum = summary->sum[index];
+    total = 0;
+    for(row = 0; row < MAX_MODULES_PER_PACK; row++) total += sum[row];
+    result->sum[index] = total;
+  }
+
+  total = 0;
+  for(row = 0; row < MAX_MODULES_PER_PACK; row++) total += summary->on[row] & 1;
+  result->on = (uint8_t)total;
+}
+
+/***************************************************************************************************************
+*     M o d u l e S t a t s _ U p d a t e                                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void ModuleStats_Update(moduleStatsSummary_t* summary, moduleStatsResult_t* result, uint8_t row, const moduleStatsEntry_t* entry)
+{
+  uint16_t on = entry->on ? 0xFFFF : 0;
+  uint32_t best;
+  uint32_t oldRank;
+  uint32_t newRank;
+  uint8_t  slot = summary->slot[row];
+  uint8_t  index;
+
+  // sums - the old row out and the new one in, exact in unsigned arithmetic
+  for(index = 0; index < MODULE_STATS_ON_SUMS; index++)
+    result->sum[index] += (uint32_t)(entry->sum[index] & on) - (summary->sum[index][row] & summary->on[row]);
+  for(; index < MODULE_STATS_SUMS; index++)
+    result->sum[index] += (uint32_t)entry->sum[index] - summary->sum[index][row];
+  result->on += (on & 1) - (summary->on[row] & 1);
+
+  for(index = 0; index < MODULE_STATS_SUMS; index++) summary->sum[index][row] = entry->sum[index];
+  summary->on[row] = on;
+
+  // minima - a lower rank takes over, the module holding one that moves up means searching again
+  for(index = 0; index < MODULE_STATS_KEYS; index++){
+    oldRank = summary->rank[index][row];
+    newRank = MODULE_STATS_RANK(entry->key[index], slot);
+    if(newRank == oldRank) continue;
+    summary->rank[index][row] = newRank;
+    best = MODULE_STATS_RANK(result->min[index], result->slot[index]);
+    if(newRank < best) best = newRank;
+    else if(oldRank == best) best = ModuleStats_Min(summary->rank[index]);
+    else continue;
+    result->min[index]  = (uint16_t)(best >> 8);
+    result->slot[index] = (uint8_t)best;
+  }
+}
+
+#endif /* MODULE_STATS_H_ */
@@ -18,7 +18,7 @@
 #define SD_SECTORS_PER_FRAME    2       // Number of SD sectors per frame
 
 // Maximum values
-#define MAX_CELLS_PER_MODULE    94      // Maximum cells supported
+#define SD_FRAME_MAX_CELLS      94      // Cells per string reading in a ModuleCPU frame - the pack limit is MAX_CELLS_PER_MODULE in bms.h
 #define MAX_FRAME_NUMBER        0xFFFFFF // 24-bit frame number (16.7M frames)
 
 // Frame status flags
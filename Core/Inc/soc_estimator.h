@@ -0,0 +1,119 @@
+ /**************************************************************************************************************
+ * @file           : soc_estimator.h                                               P A C K   C O N T R O L L E R
+ * @brief          : Integer coulomb counting state of charge estimator
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+#ifndef SOC_ESTIMATOR_H_
+#define SOC_ESTIMATOR_H_
+
+// Include files
+#include <stdint.h>
+
+
+/***************************************************************************************************************
+* State of Charge Estimator                                                        P A C K   C O N T R O L L E R
+
+  Summary:
+    One module's state of charge, counted from its current between status reports and held to the
+    SOC the module reports.
+
+  Description:
+    A module reports its SOC in 0.5 % steps, and only as often as its status is polled, so the SOC
+    built from the reports alone moves in visible steps. The estimator keeps the SOC in the 1/640 %
+    quanta of fixed_signal.h (the VCU SOC LSB) and moves it by the charge the module's current carries:
+
+      SocEst_Integrate()  adds current * dt to a charge accumulator in 0.01 A ms and moves every whole
+                          quantum of it into the SOC. The current is the last one the module reported,
+                          held until the next report.
+      SocEst_Report()     takes a new report. A report of n stands for n * 0.5 % +/- 0.25 %; an
+                          estimate outside that band is moved 1/2^SOC_EST_CORRECT_SHIFT of the way back
+                          towards it, at most SOC_EST_CORRECT_MAX per report, so a counting error never
+                          shows as a step. An estimate more than SOC_EST_RESYNC away - a module that
+                          restarted or was recalibrated - starts again from the report.
+
+    All of it is integer: a multiply per integration, and a division by the charge per quantum only
+    once a whole quantum has built up. chargePerQuantum is the capacity in Ah * SOC_EST_QUANTUM_PER_AH.
+    A capacity that is off only makes the estimate lean on the band correction more.
+
+    The host harness (emulator/bench/soc_estimator_bench.c) runs it against current profiles.
+***************************************************************************************************************/
+
+#define SOC_EST_FULL              64000     // 100 % in 1/640 % quanta
+#define SOC_EST_STEP              320       // one module SOC LSB - 0.5 %
+#define SOC_EST_QUANTUM_PER_AH    5625      // 0.01 A ms of charge per 1/640 % of 1 Ah - 3.6e8 / 64000
+#define SOC_EST_CORRECT_SHIFT     2         // an estimate outside the report band moves 1/4 of the way back
+#define SOC_EST_CORRECT_MAX       64        // ... by at most 0.1 % per report
+#define SOC_EST_RESYNC            3200      // 5 % off - start again from the report
+#define SOC_EST_MAX_DT            1000      // ms integrated per call at most - keeps current * dt in 32 bits
+
+typedef struct {
+  int32_t soc;                              // estimate, 1/640 %
+  int32_t charge;                           // charge not yet in soc, 0.01 A ms
+  int32_t current;                          // last reported current, 0.01 A - positive charges
+} socEst_t;
+
+/***************************************************************************************************************
+*     S o c E s t _ C l a m p                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline int32_t SocEst_Clamp(int32_t soc)
+{
+  return soc < 0 ? 0 : (soc > SOC_EST_FULL ? SOC_EST_FULL : soc);
+}
+
+/***************************************************************************************************************
+*     S o c E s t _ R e s e t                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void SocEst_Reset(socEst_t* est, uint8_t reportedSoc, int32_t current)
+{
+  est->soc     = SocEst_Clamp((int32_t)reportedSoc * SOC_EST_STEP);
+  est->charge  = 0;
+  est->current = current;
+}
+
+/***************************************************************************************************************
+*     S o c E s t _ I n t e g r a t e                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void SocEst_Integrate(socEst_t* est, uint32_t dt, int32_t chargePerQuantum)
+{
+  int32_t quanta;
+
+  if(dt > SOC_EST_MAX_DT) dt = SOC_EST_MAX_DT;
+  est->charge += est->current * (int32_t)dt;
+
+  // truncates toward zero - the remainder keeps its sign for the next call
+  if(est->charge >= chargePerQuantum || est->charge <= -chargePerQuantum){
+    quanta       = est->charge / chargePerQuantum;
+    est->charge -= quanta * chargePerQuantum;
+    est->soc     = SocEst_Clamp(est->soc + quanta);
+  }
+}
+
+/***************************************************************************************************************
+*     S o c E s t _ R e p o r t                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void SocEst_Report(socEst_t* est, uint8_t reportedSoc, int32_t current)
+{
+  int32_t reported = (int32_t)reportedSoc * SOC_EST_STEP;
+  int32_t error;
+
+  if(est->soc < reported - SOC_EST_STEP / 2)      error = reported - SOC_EST_STEP / 2 - est->soc;
+  else if(est->soc > reported + SOC_EST_STEP / 2) error = reported + SOC_EST_STEP / 2 - est->soc;
+  else                                            error = 0;
+
+  if(error > SOC_EST_RESYNC || error < -SOC_EST_RESYNC){
+    SocEst_Reset(est, reportedSoc, current);
+    return;
+  }
+  // rounded away from zero so the last quantum closes too
+  if(error > 0)      error =  (error + (1 << SOC_EST_CORRECT_SHIFT) - 1) >> SOC_EST_CORRECT_SHIFT;
+  else if(error < 0) error = -((-error + (1 << SOC_EST_CORRECT_SHIFT) - 1) >> SOC_EST_CORRECT_SHIFT);
+  if(error > SOC_EST_CORRECT_MAX)  error = SOC_EST_CORRECT_MAX;
+  if(error < -SOC_EST_CORRECT_MAX) error = -SOC_EST_CORRECT_MAX;
+
+  est->soc     = SocEst_Clamp(est->soc + error);
+  est->current = current;
+}
+
+#endif /* SOC_ESTIMATOR_H_ */
@@ -10,6 +10,7 @@
 
 // Include files
 #include "canfdspi_api.h"
+#include "can_tx_queue.h"
 #include "bms.h"
 
 
@@ -24,12 +25,17 @@
 //! Use RX and TX Interrupt pins to check FIFO status
 #define VCU_USE_RX_INT
 
-// Transmit Channels
-#define VCU_TX_FIFO CAN_FIFO_CH2
+// Transmit Channels - sizes, priorities and routes in vcuChannelMap (can_channels.c)
+#define VCU_TXQ           CAN_TXQUEUE_CH0   // VCU and polling classes
+#define VCU_TX_FIFO       CAN_FIFO_CH2      // safety class
+#define VCU_TX_BULK_FIFO  CAN_FIFO_CH3      // bulk class
 
 // Receive Channels
 #define VCU_RX_FIFO CAN_FIFO_CH1
 
+// Pack VCU IDs - pack 1 is 0x100 above the CAN_ID_ALL.h IDs, any other pack at them
+#define VCU_CAN_OFFSET(packId)      ((packId) == 1 ? 0x100 : 0x000)
+
 
 #define VCU_CURRENT_BASE            -1600       // amps
 #define VCU_CURRENT_FACTOR          0.05        // amps
@@ -48,8 +54,12 @@
 
 
 extern packState vcuStateRequested;
+extern canTxQueue_t vcuTxQueue;
 extern uint32_t VCU_TicksSinceLastMessage(void);
 extern void VCU_ReceiveMessages(void);
+extern void VCU_TransmitMessageQueue(uint8_t txClass);
+extern void VCU_TxRefill(void);
+extern void VCU_SetCanOffset(uint16_t offset);
 extern void VCU_TransmitBmsState(void);
 extern void VCU_TransmitBmsData1(void);
 extern void VCU_TransmitBmsData2(void);
@@ -67,6 +77,7 @@ extern void VCU_TransmitModuleCellTemp(void);
 extern void VCU_TransmitModuleCellId(void);
 extern void VCU_TransmitModuleLimits(void);
 extern void VCU_TransmitModuleList(void);
+extern void VCU_TransmitTelemetry(void);
 
 
 
@@ -0,0 +1,197 @@
+/***************************************************************************************************************
+ * @file           : can_channels.c                                                P A C K   C O N T R O L L E R
+ * @brief          : MCP2517FD channel maps - the TXQ and FIFOs of the module and VCU buses and their routes.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "vcu.h"
+#include "../../protocols/CAN_ID_ALL.h"
+#include "can_channels.h"
+
+#define CAN_ROUTE_SID             0x7FF     // mask - every standard ID bit
+
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+extern batteryPack pack;
+
+// Module bus - 28 objects, 2016 of 2048 bytes
+static const canFifo_t mcuFifo[] = {
+  { MCU_TXQ,            4, 2, CAN_RX_FIFO_NO_EVENT        },  // polling - lowest ID first
+  { MCU_RX_FIFO,        8, 0, CAN_RX_FIFO_NOT_EMPTY_EVENT },  // module status
+  { MCU_TX_FIFO,        6, 3, CAN_RX_FIFO_NO_EVENT        },  // safety - in the order queued, ahead of the rest
+  { MCU_TX_BULK_FIFO,   2, 1, CAN_RX_FIFO_NO_EVENT        },  // cell detail requests and balancing
+  { MCU_RX_BULK_FIFO,   4, 0, CAN_RX_FIFO_HALF_FULL_EVENT },  // cell data - the main loop drains it each pass
+  { MCU_RX_OTHER_FIFO,  4, 0, CAN_RX_FIFO_NOT_EMPTY_EVENT },  // announcements, hardware, time requests
+};
+
+// The frames MCU_ReceiveMessages() decodes - add a route with each new handler
+static const canRoute_t mcuRoute[] = {
+  // state and status - never behind a cell data burst
+  { ID_MODULE_STATUS_1,         0x7FE,          MCU_RX_FIFO       },  // STATUS_1 and STATUS_2
+  { ID_MODULE_STATUS_3,         CAN_ROUTE_SID,  MCU_RX_FIFO       },
+  { ID_MODULE_STATUS_FD,        CAN_ROUTE_SID,  MCU_RX_FIFO       },
+  // bulk - cell data
+  { ID_MODULE_DETAIL,           CAN_ROUTE_SID,  MCU_RX_BULK_FIFO  },
+  { ID_MODULE_CELL_PACKED,      CAN_ROUTE_SID,  MCU_RX_BULK_FIFO  },
+  { ID_MODULE_CELL_FD,          CAN_ROUTE_SID,  MCU_RX_BULK_FIFO  },
+  // announcements and the rest
+  { ID_MODULE_ANNOUNCEMENT,     0x7FE,          MCU_RX_OTHER_FIFO },  // ANNOUNCEMENT and HARDWARE
+  { ID_MODULE_TIME_REQUEST,     0x7FE,          MCU_RX_OTHER_FIFO },  // TIME_REQUEST and CELL_COMM_STATUS1
+};
+
+const canChannelMap_t mcuChannelMap = {
+  mcuFifo,  sizeof(mcuFifo)  / sizeof(mcuFifo[0]),
+  mcuRoute, sizeof(mcuRoute) / sizeof(mcuRoute[0]),
+  true,     NULL,
+  { MCU_TX_FIFO, MCU_TXQ, MCU_TXQ, MCU_TX_BULK_FIFO },  // by CAN_TX_CLASS_
+};
+
+// VCU bus - 28 objects, 2016 of 2048 bytes
+static const canFifo_t vcuFifo[] = {
+  { VCU_TXQ,            4, 2, CAN_RX_FIFO_NO_EVENT        },  // pack data and replies - lowest ID first
+  { VCU_RX_FIFO,       16, 0, CAN_RX_FIFO_NOT_EMPTY_EVENT },
+  { VCU_TX_FIFO,        4, 3, CAN_RX_FIFO_NO_EVENT        },  // BMS state
+  { VCU_TX_BULK_FIFO,   4, 1, CAN_RX_FIFO_NO_EVENT        },  // module lists and telemetry
+};
+
+// The frames VCU_ReceiveMessages() decodes, at this pack's offset - other packs and vehicle traffic stay out
+static const canRoute_t vcuRoute[] = {
+  { ID_VCU_COMMAND,             0x7FC,          VCU_RX_FIFO       },  // COMMAND, TIME, READ_EEPROM and WRITE_EEPROM
+  { ID_VCU_MODULE_COMMAND,      0x7FE,          VCU_RX_FIFO       },  // MODULE_COMMAND and KEEP_ALIVE
+  { ID_VCU_REQUEST_MODULE_LIST, CAN_ROUTE_SID,  VCU_RX_FIFO       },
+  { ID_VCU_REQUEST_TELEMETRY,   CAN_ROUTE_SID,  VCU_RX_FIFO       },
+};
+
+const canChannelMap_t vcuChannelMap = {
+  vcuFifo,  sizeof(vcuFifo)  / sizeof(vcuFifo[0]),
+  vcuRoute, sizeof(vcuRoute) / sizeof(vcuRoute[0]),
+  false,    &pack.vcuCanOffset,
+  { VCU_TX_FIFO, VCU_TXQ, VCU_TXQ, VCU_TX_BULK_FIFO },  // by CAN_TX_CLASS_
+};
+
+
+/***************************************************************************************************************
+*
+*                   Section: Channel Map Functions                                 P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     C a n C h a n n e l s _ R a m B y t e s                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint16_t CanChannels_RamBytes(const canChannelMap_t* map)
+{
+  uint16_t bytes = 0;
+  uint8_t index;
+
+  for(index = 0; index < map->fifos; index++)
+    bytes += map->fifo[index].depth * CAN_CHANNEL_OBJECT_BYTES;
+  return bytes;
+}
+
+/***************************************************************************************************************
+*     C a n C h a n n e l s _ T x q                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+bool CanChannels_Txq(const canChannelMap_t* map)
+{
+  uint8_t index;
+
+  // CiCON.TXQEN - the TXQ takes RAM ahead of FIFO 1 only when enabled
+  for(index = 0; index < map->fifos; index++)
+    if(map->fifo[index].channel == CAN_TXQUEUE_CH0) return true;
+  return false;
+}
+
+/***************************************************************************************************************
+*     C a n C h a n n e l s _ C o n f i g u r e                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+int8_t CanChannels_Configure(CANFDSPI_MODULE_ID index, const canChannelMap_t* map)
+{
+  CAN_TX_QUEUE_CONFIG txqConfig;
+  CAN_TX_FIFO_CONFIG txConfig;
+  CAN_RX_FIFO_CONFIG rxConfig;
+  const canFifo_t* fifo;
+  uint8_t n;
+
+  // Configuration mode only - called between DRV_CANFDSPI_Configure() and the operation mode select
+  if(CanChannels_RamBytes(map) > cRAM_SIZE || map->routes > CAN_FILTER_TOTAL) return -1;
+
+  // Setup TXQ and FIFOs
+  for(n = 0; n < map->fifos; n++){
+    fifo = &map->fifo[n];
+    if(fifo->channel == CAN_TXQUEUE_CH0){
+      DRV_CANFDSPI_TransmitQueueConfigureObjectReset(&txqConfig);
+      txqConfig.FifoSize = fifo->depth - 1;
+      txqConfig.PayLoadSize = CAN_PLSIZE_64;
+      txqConfig.TxPriority = fifo->txPriority - 1;
+      DRV_CANFDSPI_TransmitQueueConfigure(index, &txqConfig);
+    }else if(fifo->txPriority){
+      DRV_CANFDSPI_TransmitChannelConfigureObjectReset(&txConfig);
+      txConfig.FifoSize = fifo->depth - 1;
+      txConfig.PayLoadSize = CAN_PLSIZE_64;
+      txConfig.TxPriority = fifo->txPriority - 1;
+      DRV_CANFDSPI_TransmitChannelConfigure(index, fifo->channel, &txConfig);
+    }else{
+      DRV_CANFDSPI_ReceiveChannelConfigureObjectReset(&rxConfig);
+      rxConfig.FifoSize = fifo->depth - 1;
+      rxConfig.PayLoadSize = CAN_PLSIZE_64;
+      DRV_CANFDSPI_ReceiveChannelConfigure(index, fifo->channel, &rxConfig);
+    }
+
+    // Transmit and Receive Interrupts - the pins are set up by the caller
+#ifdef MCU_USE_TX_INT
+    if(fifo->txPriority)
+      DRV_CANFDSPI_TransmitChannelEventEnable(index, fifo->channel, CAN_TX_FIFO_NOT_FULL_EVENT);
+#endif
+    if(!fifo->txPriority && fifo->rxEvent != CAN_RX_FIFO_NO_EVENT)
+      DRV_CANFDSPI_ReceiveChannelEventEnable(index, fifo->channel, fifo->rxEvent);
+  }
+
+  // Setup RX Filters
+  return CanChannels_Filter(index, map);
+}
+
+/***************************************************************************************************************
+*     C a n C h a n n e l s _ F i l t e r                                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+int8_t CanChannels_Filter(CANFDSPI_MODULE_ID index, const canChannelMap_t* map)
+{
+  REG_CiFLTOBJ fObj;
+  REG_CiMASK mObj;
+  const canRoute_t* route;
+  uint16_t offset = map->sidOffset != NULL ? *map->sidOffset : 0;
+  uint8_t n;
+
+  if(map->routes > CAN_FILTER_TOTAL) return -1;
+
+  // Any operation mode - a filter is written while disabled, first match wins, filters past the routes stay off
+  for(n = 0; n < CAN_FILTER_TOTAL; n++){
+    if(DRV_CANFDSPI_FilterDisable(index, (CAN_FILTER)n) != 0) return -2;
+    if(n >= map->routes) continue;
+    route = &map->route[n];
+
+    fObj.word = 0;
+    fObj.bF.SID = (route->sid + offset) & CAN_ROUTE_SID;
+    fObj.bF.EXIDE = map->extended;
+    fObj.bF.EID = 0x00;
+    DRV_CANFDSPI_FilterObjectConfigure(index, (CAN_FILTER)n, &fObj.bF);
+
+    mObj.word = 0;
+    mObj.bF.MSID = route->mask;
+    mObj.bF.MIDE = 1; // Only the frame kind the bus carries
+    mObj.bF.MEID = 0x0;
+    DRV_CANFDSPI_FilterMaskConfigure(index, (CAN_FILTER)n, &mObj.bF);
+
+    DRV_CANFDSPI_FilterToFifoLink(index, (CAN_FILTER)n, route->fifo, true);
+  }
+  return 0;
+}
@@ -0,0 +1,199 @@
+/***************************************************************************************************************
+ * @file           : can_tx_queue.c                                                P A C K   C O N T R O L L E R
+ * @brief          : Priority transmit queue - refills an MCP2517FD transmit FIFO from RAM over SPI DMA.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "string.h"
+#include "mcu_sched.h"
+#include "can_tx_queue.h"
+
+static bool CanTxQueue_Stop(canTxQueue_t* queue);
+static void CanTxQueue_Kick(canTxQueue_t* queue);
+static void CanTxQueue_LoadNext(canTxQueue_t* queue);
+static void CanTxQueue_Loaded(CANFDSPI_TX_LOAD* load);
+
+
+/***************************************************************************************************************
+*
+*                   Section: Application Local Functions                           P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ S t o p                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static bool CanTxQueue_Stop(canTxQueue_t* queue)
+{
+  // ends the chain - unless a send or a TX interrupt came in while it ran, then it carries on
+  queue->running = 0;
+  if(!queue->pending || __atomic_exchange_n(&queue->running, 1, __ATOMIC_ACQ_REL)) return true;
+  queue->pending = 0;
+  return false;
+}
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ K i c k                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void CanTxQueue_Kick(canTxQueue_t* queue)
+{
+  // one chain at a time - asked for before the check, so a chain just ending sees it and runs on
+  queue->pending = 1;
+  if(__atomic_exchange_n(&queue->running, 1, __ATOMIC_ACQ_REL)) return;
+
+  // does nothing until CanTxQueue_Init() has bound the queue to a controller
+  queue->pending = 0;
+  if(queue->load[0].done == NULL){
+    queue->running = 0;
+    return;
+  }
+  CanTxQueue_LoadNext(queue);
+}
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ L o a d N e x t                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void CanTxQueue_LoadNext(canTxQueue_t* queue)
+{
+  canTxClass_t* txClass;
+  canTxFrame_t* frame;
+  uint8_t index;
+
+  for(;;){
+    // a refill since the last look - read the full channels again
+    if(queue->retry){
+      queue->retry = 0;
+      queue->full = 0;
+    }
+
+    // the oldest frame of the highest class waiting with room to go - its head is visible once its contents are
+    for(index = 0; index < CAN_TX_CLASSES; index++){
+      txClass = &queue->txClass[index];
+      if(!(queue->full & (1u << index)) && __atomic_load_n(&txClass->head, __ATOMIC_ACQUIRE) != txClass->tail) break;
+    }
+
+    if(index < CAN_TX_CLASSES){
+      frame = &txClass->frame[txClass->tail & (txClass->depth - 1)];
+      if(DRV_CANFDSPI_TransmitLoad(&queue->load[index], &frame->obj, frame->data, frame->length) == 0)
+        return;
+
+      // a frame the driver refuses would be refused again - drop it and carry on
+      queue->loadErrors++;
+      __atomic_store_n(&txClass->tail, txClass->tail + 1, __ATOMIC_RELEASE);
+      continue;
+    }
+
+    // nothing left that can go
+    if(CanTxQueue_Stop(queue)) return;
+  }
+}
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ L o a d e d                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void CanTxQueue_Loaded(CANFDSPI_TX_LOAD* load)
+{
+  canTxQueue_t* queue = (canTxQueue_t*)load->context;
+  uint8_t index = (uint8_t)(load - queue->load);
+  canTxClass_t* txClass = &queue->txClass[index];
+  const canTxFrame_t* frame;
+  uint32_t latency;
+
+  if(load->status == 0 && !load->loaded){
+    // channel full - the frame stays at the head of its ring, the class waits for the next refill
+    queue->full |= (uint8_t)(1u << index);
+    CanTxQueue_LoadNext(queue);
+    return;
+  }
+
+  if(load->status != 0){
+    queue->loadErrors++;
+  }else{
+    frame = &txClass->frame[txClass->tail & (txClass->depth - 1)];
+    latency = MCU_Now() - frame->queued;
+    if((int32_t)latency < 0) latency = 0;    // TIM1 overflow not yet counted in this interrupt
+    if(latency > txClass->latencyMax) txClass->latencyMax = latency;
+    txClass->latencySum += latency;
+    txClass->sent++;
+  }
+
+  // give the slot back to the main loop and load the next frame
+  __atomic_store_n(&txClass->tail, txClass->tail + 1, __ATOMIC_RELEASE);
+  CanTxQueue_LoadNext(queue);
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: Transmit Queue Functions                              P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ I n i t                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void CanTxQueue_Init(canTxQueue_t* queue, CANFDSPI_MODULE_ID index, const CAN_FIFO_CHANNEL channel[CAN_TX_CLASSES])
+{
+  canTxFrame_t* store;
+  uint8_t n;
+
+  memset(queue, 0, sizeof(*queue));
+  store = queue->store;
+  for(n = 0; n < CAN_TX_CLASSES; n++){
+    queue->txClass[n].depth = (n == CAN_TX_CLASS_POLL) ? CAN_TX_POLL_DEPTH : CAN_TX_QUEUE_DEPTH;
+    queue->txClass[n].frame = store;
+    store += queue->txClass[n].depth;
+    DRV_CANFDSPI_TransmitLoadConfigure(&queue->load[n], index, channel[n]);
+    queue->load[n].done = CanTxQueue_Loaded;
+    queue->load[n].context = queue;
+  }
+}
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ S e n d                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+bool CanTxQueue_Send(canTxQueue_t* queue, uint8_t txClass, CAN_TX_MSGOBJ* obj, const uint8_t* data, uint8_t length)
+{
+  canTxClass_t* ring = &queue->txClass[txClass];
+  canTxFrame_t* frame;
+  uint32_t head = ring->head;
+
+  // the slot is free once the refill's release of it is visible
+  if(length > MAX_DATA_BYTES || head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ring->depth){
+    ring->drops++;
+    return false;
+  }
+
+  frame = &ring->frame[head & (ring->depth - 1)];
+  memcpy(&frame->obj, obj, sizeof(frame->obj));
+  memcpy(frame->data, data, length);
+  frame->length = length;
+  frame->queued = MCU_Now();
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  CanTxQueue_Kick(queue);
+  return true;
+}
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ R e f i l l                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void CanTxQueue_Refill(canTxQueue_t* queue)
+{
+  // a channel has room - every class is tried again, the chain started if it is not running
+  queue->retry = 1;
+  CanTxQueue_Kick(queue);
+}
+
+/***************************************************************************************************************
+*     C a n T x Q u e u e _ C o u n t                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint32_t CanTxQueue_Count(const canTxQueue_t* queue, uint8_t txClass)
+{
+  const canTxClass_t* ring = &queue->txClass[txClass];
+
+  return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
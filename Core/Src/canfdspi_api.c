@@ -11,6 +11,7 @@
 // *****************************************************************************
 // *****************************************************************************
 // Section: Included Files
+#include <string.h>
 #include "main.h"
 #include "canfdspi_api.h"
 #include "canfdspi_register.h"
@@ -102,6 +103,173 @@ const uint16_t crc16_table[256] = {
 
 extern SPI_HandleTypeDef hspi1;
 
+//! Nonzero while a synchronous driver call holds the SPI bus and the buffers above
+static volatile uint8_t drvCanfdspiBusy = 0;
+
+//! Asynchronous transfers - the head is running or next to run
+static CANFDSPI_XFER* xferHead = NULL;
+static CANFDSPI_XFER* xferTail = NULL;
+static volatile uint8_t xferRunning = 0;
+
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: SPI Bus Ownership
+
+// The three MCP25xxFD share hspi1. Asynchronous transfers queue and run from
+// the DMA interrupt; a synchronous call waits for the one on the wire, holds
+// the bus while it spins in HAL_SPI_TransmitReceive() and starts the queue
+// again when it lets go. Synchronous calls are for thread context only - one
+// made from an interrupt could wait on a DMA completion that cannot run.
+
+static void DRV_CANFDSPI_XferStart(void);
+
+static inline void DRV_CANFDSPI_BusTake(void)
+{
+    drvCanfdspiBusy++;
+    while (xferRunning) {
+    }
+}
+
+static inline void DRV_CANFDSPI_BusGive(void)
+{
+    uint32_t primask;
+
+    if (--drvCanfdspiBusy == 0 && xferHead != NULL) {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        DRV_CANFDSPI_XferStart();
+        __set_PRIMASK(primask);
+    }
+}
+
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Asynchronous SPI Transport
+
+static void DRV_CANFDSPI_ChipSelect(CANFDSPI_MODULE_ID index, GPIO_PinState state)
+{
+    if (index == CAN3) {
+        HAL_GPIO_WritePin(CAN3_CS_GPIO_Port, CAN3_CS_Pin, state);
+    } else if (index == CAN2) {
+        HAL_GPIO_WritePin(CAN2_CS_GPIO_Port, CAN2_CS_Pin, state);
+    } else {
+        HAL_GPIO_WritePin(CAN1_CS_GPIO_Port, CAN1_CS_Pin, state);
+    }
+}
+
+static void DRV_CANFDSPI_XferFinish(int8_t status)
+{
+    CANFDSPI_XFER* xfer = xferHead;
+
+    DRV_CANFDSPI_ChipSelect(xfer->index, GPIO_PIN_SET);
+    xferHead = xfer->next;
+    if (xferHead == NULL) {
+        xferTail = NULL;
+    }
+    xferRunning = 0;
+
+    // the callback may queue the next step - it starts from here or from XferStart()
+    xfer->status = status;
+    if (xfer->done != NULL) {
+        xfer->done(xfer);
+    }
+}
+
+// Start the head of the queue unless the bus is in use - interrupts masked or
+// called from the DMA interrupt
+static void DRV_CANFDSPI_XferStart(void)
+{
+    CANFDSPI_XFER* xfer;
+
+    while (!xferRunning && drvCanfdspiBusy == 0 && (xfer = xferHead) != NULL) {
+        xferRunning = 1;
+        DRV_CANFDSPI_ChipSelect(xfer->index, GPIO_PIN_RESET);
+        if (HAL_SPI_TransmitReceive_DMA(&hspi1, xfer->tx, xfer->rx, xfer->size) == HAL_OK) {
+            return;
+        }
+        DRV_CANFDSPI_XferFinish(HAL_ERROR);
+    }
+}
+
+int8_t DRV_CANFDSPI_XferSubmit(CANFDSPI_XFER* xfer)
+{
+    uint32_t primask;
+
+    if (xfer->size == 0 || xfer->size > xfer->length) {
+        return -1;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    xfer->next = NULL;
+    xfer->status = HAL_BUSY;
+    if (xferTail != NULL) {
+        xferTail->next = xfer;
+    } else {
+        xferHead = xfer;
+    }
+    xferTail = xfer;
+    DRV_CANFDSPI_XferStart();
+    __set_PRIMASK(primask);
+
+    return 0;
+}
+
+int8_t DRV_CANFDSPI_XferRead(CANFDSPI_XFER* xfer, CANFDSPI_MODULE_ID index,
+        uint16_t address, uint16_t nBytes)
+{
+    if (nBytes + 2 > xfer->length) {
+        return -1;
+    }
+
+    xfer->index = index;
+    xfer->size = nBytes + 2;
+    xfer->tx[0] = (uint8_t) ((cINSTRUCTION_READ << 4) + ((address >> 8) & 0xF));
+    xfer->tx[1] = (uint8_t) (address & 0xFF);
+    memset(&xfer->tx[2], 0, nBytes);
+
+    return 0;
+}
+
+int8_t DRV_CANFDSPI_XferWrite(CANFDSPI_XFER* xfer, CANFDSPI_MODULE_ID index,
+        uint16_t address, const uint8_t *txd, uint16_t nBytes)
+{
+    if (nBytes + 2 > xfer->length) {
+        return -1;
+    }
+
+    xfer->index = index;
+    xfer->size = nBytes + 2;
+    xfer->tx[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((address >> 8) & 0xF));
+    xfer->tx[1] = (uint8_t) (address & 0xFF);
+    memcpy(&xfer->tx[2], txd, nBytes);
+
+    return 0;
+}
+
+bool DRV_CANFDSPI_XferIdle(void)
+{
+    return xferHead == NULL;
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == &hspi1 && xferRunning) {
+        DRV_CANFDSPI_XferFinish(HAL_OK);
+        DRV_CANFDSPI_XferStart();
+    }
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == &hspi1 && xferRunning) {
+        DRV_CANFDSPI_XferFinish(HAL_ERROR);
+        DRV_CANFDSPI_XferStart();
+    }
+}
+
 // *****************************************************************************
 // *****************************************************************************
 // Section: Reset
@@ -111,6 +279,8 @@ int8_t DRV_CANFDSPI_Reset(CANFDSPI_MODULE_ID index)
     uint16_t spiTransferSize = 2;
     HAL_StatusTypeDef spiTransferError;
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) (cINSTRUCTION_RESET << 4);
     spiTransmitBuffer[1] = 0;
@@ -129,6 +299,7 @@ int8_t DRV_CANFDSPI_Reset(CANFDSPI_MODULE_ID index)
     spiTransferError = HAL_SPI_TransmitReceive(&hspi1, spiTransmitBuffer, spiReceiveBuffer, spiTransferSize, SPI_TIMEOUT);
     HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
 	}
+  DRV_CANFDSPI_BusGive();
   return spiTransferError;
 }
 
@@ -142,6 +313,8 @@ int8_t DRV_CANFDSPI_ReadByte(CANFDSPI_MODULE_ID index, uint16_t address, uint8_t
   uint16_t spiTransferSize = 3;
   HAL_StatusTypeDef spiTransferError;
 
+  DRV_CANFDSPI_BusTake();
+
   // Compose command
   spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_READ << 4) + ((address >> 8) & 0xF));
   spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -163,6 +336,7 @@ int8_t DRV_CANFDSPI_ReadByte(CANFDSPI_MODULE_ID index, uint16_t address, uint8_t
   // Update data
   *rxd = spiReceiveBuffer[2];
 
+  DRV_CANFDSPI_BusGive();
   return spiTransferError;
 }
 
@@ -171,6 +345,8 @@ int8_t DRV_CANFDSPI_WriteByte(CANFDSPI_MODULE_ID index, uint16_t address, uint8_
   uint16_t spiTransferSize = 3;
   HAL_StatusTypeDef spiTransferError;
 
+  DRV_CANFDSPI_BusTake();
+
   // Compose command
   spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((address >> 8) & 0xF));
   spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -189,6 +365,7 @@ int8_t DRV_CANFDSPI_WriteByte(CANFDSPI_MODULE_ID index, uint16_t address, uint8_
     spiTransferError = HAL_SPI_TransmitReceive(&hspi1, spiTransmitBuffer, spiReceiveBuffer, spiTransferSize, SPI_TIMEOUT);
     HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
   }
+  DRV_CANFDSPI_BusGive();
   return spiTransferError;
 }
 
@@ -199,6 +376,8 @@ int8_t DRV_CANFDSPI_ReadWord(CANFDSPI_MODULE_ID index, uint16_t address, uint32_
   uint16_t spiTransferSize = 6;
   HAL_StatusTypeDef spiTransferError;
 
+  DRV_CANFDSPI_BusTake();
+
   // Compose command
   spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_READ << 4) + ((address >> 8) & 0xF));
   spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -217,6 +396,7 @@ int8_t DRV_CANFDSPI_ReadWord(CANFDSPI_MODULE_ID index, uint16_t address, uint32_
     HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
   }
   if (spiTransferError != HAL_OK) {
+      DRV_CANFDSPI_BusGive();
       return spiTransferError;
   }
 
@@ -227,6 +407,7 @@ int8_t DRV_CANFDSPI_ReadWord(CANFDSPI_MODULE_ID index, uint16_t address, uint32_
       *rxd += x << ((i - 2)*8);
   }
 
+  DRV_CANFDSPI_BusGive();
   return spiTransferError;
 }
 
@@ -237,6 +418,8 @@ int8_t DRV_CANFDSPI_WriteWord(CANFDSPI_MODULE_ID index, uint16_t address,
     uint16_t spiTransferSize = 6;
     HAL_StatusTypeDef spiTransferError;
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -259,6 +442,7 @@ int8_t DRV_CANFDSPI_WriteWord(CANFDSPI_MODULE_ID index, uint16_t address,
       spiTransferError = HAL_SPI_TransmitReceive(&hspi1, spiTransmitBuffer, spiReceiveBuffer, spiTransferSize, SPI_TIMEOUT);
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -269,6 +453,8 @@ int8_t DRV_CANFDSPI_ReadHalfWord(CANFDSPI_MODULE_ID index, uint16_t address, uin
     uint16_t spiTransferSize = 4;
     HAL_StatusTypeDef spiTransferError;
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_READ << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -288,6 +474,7 @@ int8_t DRV_CANFDSPI_ReadHalfWord(CANFDSPI_MODULE_ID index, uint16_t address, uin
     }
 
     if (spiTransferError != HAL_OK) {
+        DRV_CANFDSPI_BusGive();
         return spiTransferError;
     }
 
@@ -298,6 +485,7 @@ int8_t DRV_CANFDSPI_ReadHalfWord(CANFDSPI_MODULE_ID index, uint16_t address, uin
         *rxd += x << ((i - 2)*8);
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -308,6 +496,8 @@ int8_t DRV_CANFDSPI_WriteHalfWord(CANFDSPI_MODULE_ID index, uint16_t address,
     uint16_t spiTransferSize = 4;
     HAL_StatusTypeDef spiTransferError;
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -331,6 +521,7 @@ int8_t DRV_CANFDSPI_WriteHalfWord(CANFDSPI_MODULE_ID index, uint16_t address,
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -341,6 +532,8 @@ int8_t DRV_CANFDSPI_WriteByteSafe(CANFDSPI_MODULE_ID index, uint16_t address,
     uint16_t spiTransferSize = 5;
     HAL_StatusTypeDef spiTransferError;
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_WRITE_SAFE << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -365,6 +558,7 @@ int8_t DRV_CANFDSPI_WriteByteSafe(CANFDSPI_MODULE_ID index, uint16_t address,
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -376,6 +570,8 @@ int8_t DRV_CANFDSPI_WriteWordSafe(CANFDSPI_MODULE_ID index, uint16_t address,
     uint16_t spiTransferSize = 8;
     HAL_StatusTypeDef spiTransferError;
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_WRITE_SAFE << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -404,6 +600,7 @@ int8_t DRV_CANFDSPI_WriteWordSafe(CANFDSPI_MODULE_ID index, uint16_t address,
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -419,6 +616,8 @@ int8_t DRV_CANFDSPI_ReadByteArray(CANFDSPI_MODULE_ID index, uint16_t address,
         return -1;
     }
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_READ << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -447,6 +646,7 @@ int8_t DRV_CANFDSPI_ReadByteArray(CANFDSPI_MODULE_ID index, uint16_t address,
         rxd[i] = spiReceiveBuffer[i + 2];
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -464,6 +664,8 @@ int8_t DRV_CANFDSPI_ReadByteArrayWithCRC(CANFDSPI_MODULE_ID index, uint16_t addr
         return -1;
     }
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_READ_CRC << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -492,6 +694,7 @@ int8_t DRV_CANFDSPI_ReadByteArrayWithCRC(CANFDSPI_MODULE_ID index, uint16_t addr
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
     if (spiTransferError != HAL_OK) {
+        DRV_CANFDSPI_BusGive();
         return spiTransferError;
     }
 
@@ -517,6 +720,7 @@ int8_t DRV_CANFDSPI_ReadByteArrayWithCRC(CANFDSPI_MODULE_ID index, uint16_t addr
         rxd[i] = spiReceiveBuffer[i + 3];
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -532,6 +736,8 @@ int8_t DRV_CANFDSPI_WriteByteArray(CANFDSPI_MODULE_ID index, uint16_t address,
         return -1;
     }
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -554,6 +760,7 @@ int8_t DRV_CANFDSPI_WriteByteArray(CANFDSPI_MODULE_ID index, uint16_t address,
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -569,6 +776,8 @@ int8_t DRV_CANFDSPI_WriteByteArrayWithCRC(CANFDSPI_MODULE_ID index, uint16_t add
     if (spiTransferSize > sizeof(spiTransmitBuffer)) {
         return -1;
     }
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (uint8_t) ((cINSTRUCTION_WRITE_CRC << 4) + ((address >> 8) & 0xF));
     spiTransmitBuffer[1] = (uint8_t) (address & 0xFF);
@@ -602,6 +811,7 @@ int8_t DRV_CANFDSPI_WriteByteArrayWithCRC(CANFDSPI_MODULE_ID index, uint16_t add
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -618,6 +828,8 @@ int8_t DRV_CANFDSPI_ReadWordArray(CANFDSPI_MODULE_ID index, uint16_t address,
         return -1;
     }
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (cINSTRUCTION_READ << 4) + ((address >> 8) & 0xF);
     spiTransmitBuffer[1] = address & 0xFF;
@@ -640,6 +852,7 @@ int8_t DRV_CANFDSPI_ReadWordArray(CANFDSPI_MODULE_ID index, uint16_t address,
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
     if (spiTransferError) {
+        DRV_CANFDSPI_BusGive();
         return spiTransferError;
     }
 
@@ -653,6 +866,7 @@ int8_t DRV_CANFDSPI_ReadWordArray(CANFDSPI_MODULE_ID index, uint16_t address,
         rxd[i] = w.word;
     }
 
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -669,6 +883,8 @@ int8_t DRV_CANFDSPI_WriteWordArray(CANFDSPI_MODULE_ID index, uint16_t address,
         return -1;
     }
 
+    DRV_CANFDSPI_BusTake();
+
     // Compose command
     spiTransmitBuffer[0] = (cINSTRUCTION_WRITE << 4) + ((address >> 8) & 0xF);
     spiTransmitBuffer[1] = address & 0xFF;
@@ -695,6 +911,7 @@ int8_t DRV_CANFDSPI_WriteWordArray(CANFDSPI_MODULE_ID index, uint16_t address,
       spiTransferError = HAL_SPI_TransmitReceive(&hspi1, spiTransmitBuffer, spiReceiveBuffer, spiTransferSize, SPI_TIMEOUT);
       HAL_GPIO_WritePin(CAN1_CS_GPIO_Port,  CAN1_CS_Pin , GPIO_PIN_SET);
     }
+    DRV_CANFDSPI_BusGive();
     return spiTransferError;
 }
 
@@ -1053,6 +1270,154 @@ int8_t DRV_CANFDSPI_TransmitChannelLoad(CANFDSPI_MODULE_ID index,
     return spiTransferError;
 }
 
+void DRV_CANFDSPI_TransmitLoadConfigure(CANFDSPI_TX_LOAD* load,
+        CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+    REG_CiFIFOCON ciFifoCon;
+    uint16_t a;
+
+    memset(load, 0, sizeof(*load));
+    load->index = index;
+    load->channel = channel;
+
+    // UINC and TXREQ write - the same byte for every message
+    ciFifoCon.word = 0;
+    ciFifoCon.txBF.UINC = 1;
+    ciFifoCon.txBF.TxRequest = 1;
+    a = cREGADDR_CiFIFOCON + (channel * CiFIFO_OFFSET) + 1;
+    load->uinc[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((a >> 8) & 0xF));
+    load->uinc[1] = (uint8_t) (a & 0xFF);
+    load->uinc[2] = ciFifoCon.byte[1];
+}
+
+// The last transfer to finish ends the load
+static void DRV_CANFDSPI_TransmitLoadRelease(CANFDSPI_TX_LOAD* load)
+{
+    if (--load->pending == 0) {
+        if (load->status != 0) {
+            load->loaded = false;
+        }
+        if (load->done != NULL) {
+            load->done(load);
+        }
+    }
+}
+
+static void DRV_CANFDSPI_TransmitLoadStep(CANFDSPI_XFER* xfer)
+{
+    CANFDSPI_TX_LOAD* load = (CANFDSPI_TX_LOAD*) xfer->context;
+
+    if (xfer->status != HAL_OK && load->status == 0) {
+        load->status = (xfer == &load->uincXfer) ? -5 : -4;
+    }
+    DRV_CANFDSPI_TransmitLoadRelease(load);
+}
+
+static void DRV_CANFDSPI_TransmitLoadQueue(CANFDSPI_TX_LOAD* load, CANFDSPI_XFER* xfer)
+{
+    xfer->done = DRV_CANFDSPI_TransmitLoadStep;
+    xfer->context = load;
+    load->pending++;
+    if (DRV_CANFDSPI_XferSubmit(xfer) != 0) {
+        xfer->status = HAL_ERROR;
+        DRV_CANFDSPI_TransmitLoadStep(xfer);
+    }
+}
+
+static void DRV_CANFDSPI_TransmitLoadStatus(CANFDSPI_XFER* xfer)
+{
+    CANFDSPI_TX_LOAD* load = (CANFDSPI_TX_LOAD*) xfer->context;
+    const uint8_t* ba = &xfer->rx[2];
+    REG_CiFIFOCON ciFifoCon;
+    REG_CiFIFOSTA ciFifoSta;
+    REG_CiFIFOUA ciFifoUa;
+    uint16_t a;
+
+    if (xfer->status != HAL_OK) {
+        load->status = -1;
+    } else {
+        memcpy(ciFifoCon.byte, &ba[0], 4);
+        memcpy(ciFifoSta.byte, &ba[4], 4);
+        memcpy(ciFifoUa.byte, &ba[8], 4);
+
+        // Check that it is a transmit buffer
+        if (!ciFifoCon.txBF.TxEnable) {
+            load->status = -2;
+        } else {
+            load->flags = (CAN_TX_FIFO_EVENT) (ciFifoSta.byte[0] & CAN_TX_FIFO_ALL_EVENTS);
+        }
+    }
+    if (load->status != 0 || !(load->flags & CAN_TX_FIFO_NOT_FULL_EVENT)) {
+        if (load->done != NULL) {
+            load->done(load);
+        }
+        return;
+    }
+
+#ifdef USERADDRESS_TIMES_FOUR
+    a = 4 * ciFifoUa.bF.UserAddress;
+#else
+    a = ciFifoUa.bF.UserAddress;
+#endif
+    a += cRAMADDR_START;
+
+    // the object was copied in at submit - only its address was missing
+    load->tx[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((a >> 8) & 0xF));
+    load->tx[1] = (uint8_t) (a & 0xFF);
+    load->loaded = true;
+
+    // One more than the transfers - released once they are both queued
+    load->pending = 1;
+    DRV_CANFDSPI_TransmitLoadQueue(load, &load->xfer[1]);
+    DRV_CANFDSPI_TransmitLoadQueue(load, &load->uincXfer);
+    DRV_CANFDSPI_TransmitLoadRelease(load);
+}
+
+int8_t DRV_CANFDSPI_TransmitLoad(CANFDSPI_TX_LOAD* load, CAN_TX_MSGOBJ* txObj,
+        uint8_t *txd, uint32_t txdNumBytes)
+{
+    uint32_t dataBytesInObject;
+    uint16_t n;
+
+    // Check that DLC is big enough for data
+    dataBytesInObject = DRV_CANFDSPI_DlcToDataBytes((CAN_DLC) txObj->bF.ctrl.DLC);
+    if (dataBytesInObject < txdNumBytes || txdNumBytes > MAX_DATA_BYTES) {
+        return -3;
+    }
+
+    load->status = 0;
+    load->flags = CAN_TX_FIFO_NO_EVENT;
+    load->loaded = false;
+
+    // Message object behind the command bytes, padded to a multiple of 4 bytes
+    memcpy(&load->tx[2], txObj->byte, 8);
+    memcpy(&load->tx[10], txd, txdNumBytes);
+    n = (uint16_t) ((txdNumBytes + 3) & ~3u);
+    memset(&load->tx[10 + txdNumBytes], 0, n - txdNumBytes);
+
+    load->xfer[1].index = load->index;
+    load->xfer[1].tx = load->tx;
+    load->xfer[1].rx = load->rx;
+    load->xfer[1].length = sizeof(load->tx);
+    load->xfer[1].size = 2 + 8 + n;
+
+    load->uincXfer.index = load->index;
+    load->uincXfer.tx = load->uinc;
+    load->uincXfer.rx = load->sink;
+    load->uincXfer.length = sizeof(load->uinc);
+    load->uincXfer.size = sizeof(load->uinc);
+
+    // CiFIFOCON, CiFIFOSTA and CiFIFOUA
+    load->xfer[0].length = sizeof(load->regTx);
+    load->xfer[0].tx = load->regTx;
+    load->xfer[0].rx = load->regRx;
+    DRV_CANFDSPI_XferRead(&load->xfer[0], load->index, cREGADDR_CiFIFOCON + (load->channel * CiFIFO_OFFSET), 12);
+    load->xfer[0].done = DRV_CANFDSPI_TransmitLoadStatus;
+    load->xfer[0].context = load;
+
+    return DRV_CANFDSPI_XferSubmit(&load->xfer[0]);
+}
+
 int8_t DRV_CANFDSPI_TransmitChannelFlush(CANFDSPI_MODULE_ID index,
         CAN_FIFO_CHANNEL channel)
 {
@@ -1534,6 +1899,288 @@ int8_t DRV_CANFDSPI_ReceiveMessageGet(CANFDSPI_MODULE_ID index,
     return spiTransferError;
 }
 
+int8_t DRV_CANFDSPI_ReceiveBatchConfigure(CANFDSPI_RX_BATCH* batch,
+        CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+    static const uint8_t payload[] = {8, 12, 16, 20, 24, 32, 48, 64};
+    REG_CiCON ciCon;
+    REG_CiTEFCON ciTefCon;
+    REG_CiFIFOCON ciFifoCon;
+    uint16_t a = cRAMADDR_START;
+    uint8_t n;
+    uint8_t ch;
+    int8_t spiTransferError = 0;
+
+    memset(batch, 0, sizeof(*batch));
+    batch->index = index;
+    batch->channel = channel;
+
+    spiTransferError = DRV_CANFDSPI_ReadWord(index, cREGADDR_CiCON, &ciCon.word);
+    if (spiTransferError) {
+        return -1;
+    }
+
+    // TEF - header and time stamp only
+    if (ciCon.bF.StoreInTEF) {
+        spiTransferError = DRV_CANFDSPI_ReadWord(index, cREGADDR_CiTEFCON, &ciTefCon.word);
+        if (spiTransferError) {
+            return -1;
+        }
+        n = ciTefCon.bF.TimeStampEnable ? 12 : 8;
+        a += (ciTefCon.bF.FifoSize + 1) * n;
+    }
+
+    // TXQ, then each FIFO below this one - transmit objects carry no time stamp
+    for (ch = ciCon.bF.TXQEnable ? 0 : 1; ch <= channel; ch++) {
+        spiTransferError = DRV_CANFDSPI_ReadWord(index, cREGADDR_CiFIFOCON + (ch * CiFIFO_OFFSET), &ciFifoCon.word);
+        if (spiTransferError) {
+            return -1;
+        }
+        n = 8 + payload[ciFifoCon.rxBF.PayLoadSize];
+        if (!ciFifoCon.txBF.TxEnable && ciFifoCon.rxBF.RxTimeStampEnable) {
+            n += 4;
+        }
+        if (ch == channel) {
+            if (ciFifoCon.txBF.TxEnable) {
+                return -2;
+            }
+            batch->ramStart = a;
+            batch->objSize = n;
+            batch->depth = ciFifoCon.rxBF.FifoSize + 1;
+            batch->timeStamp = ciFifoCon.rxBF.RxTimeStampEnable;
+        } else {
+            a += (ciFifoCon.rxBF.FifoSize + 1) * n;
+        }
+    }
+
+    if (channel == CAN_TXQUEUE_CH0 || batch->objSize > MAX_MSG_SIZE || a + batch->depth * batch->objSize > cRAMADDR_END) {
+        batch->depth = 0;
+        return -3;
+    }
+
+    // UINC write - the same byte for every message
+    ciFifoCon.word = 0;
+    ciFifoCon.rxBF.UINC = 1;
+    a = cREGADDR_CiFIFOCON + (channel * CiFIFO_OFFSET) + 1;
+    batch->uinc[0] = (uint8_t) ((cINSTRUCTION_WRITE << 4) + ((a >> 8) & 0xF));
+    batch->uinc[1] = (uint8_t) (a & 0xFF);
+    batch->uinc[2] = ciFifoCon.byte[1];
+
+    return spiTransferError;
+}
+
+static void DRV_CANFDSPI_ReceiveBatchStep(CANFDSPI_XFER* xfer);
+
+static void DRV_CANFDSPI_ReceiveBatchQueue(CANFDSPI_RX_BATCH* batch, CANFDSPI_XFER* xfer,
+        uint8_t *tx, uint8_t *rx, uint16_t length)
+{
+    xfer->index = batch->index;
+    xfer->tx = tx;
+    xfer->rx = rx;
+    xfer->length = length;
+    xfer->done = DRV_CANFDSPI_ReceiveBatchStep;
+    xfer->context = batch;
+    batch->pending++;
+    if (DRV_CANFDSPI_XferSubmit(xfer) != 0) {
+        xfer->status = HAL_ERROR;
+        DRV_CANFDSPI_ReceiveBatchStep(xfer);
+    }
+}
+
+// The last transfer to finish ends the batch
+static void DRV_CANFDSPI_ReceiveBatchRelease(CANFDSPI_RX_BATCH* batch)
+{
+    if (--batch->pending == 0) {
+        if (batch->status != 0) {
+            batch->count = 0;
+        }
+        if (batch->done != NULL) {
+            batch->done(batch);
+        }
+    }
+}
+
+// Every transfer after the status read
+static void DRV_CANFDSPI_ReceiveBatchStep(CANFDSPI_XFER* xfer)
+{
+    CANFDSPI_RX_BATCH* batch = (CANFDSPI_RX_BATCH*) xfer->context;
+
+    if (xfer->status != HAL_OK && batch->status == 0) {
+        batch->status = (xfer >= &batch->uincXfer[0]) ? -4 : (xfer == &batch->ovfXfer) ? -1 : -3;
+    }
+    DRV_CANFDSPI_ReceiveBatchRelease(batch);
+}
+
+static void DRV_CANFDSPI_ReceiveBatchStatus(CANFDSPI_XFER* xfer)
+{
+    CANFDSPI_RX_BATCH* batch = (CANFDSPI_RX_BATCH*) xfer->context;
+    const uint8_t* ba = &xfer->rx[2];
+    REG_CiFIFOCON ciFifoCon;
+    REG_CiFIFOSTA ciFifoSta;
+    REG_CiFIFOUA ciFifoUa;
+    uint16_t ua;
+    uint8_t tail;
+    uint8_t count;
+    uint8_t i;
+
+    if (xfer->status != HAL_OK) {
+        batch->status = -1;
+        if (batch->done != NULL) {
+            batch->done(batch);
+        }
+        return;
+    }
+
+    memcpy(ciFifoCon.byte, &ba[0], 4);
+    memcpy(ciFifoSta.byte, &ba[4], 4);
+    memcpy(ciFifoUa.byte, &ba[8], 4);
+
+    // Check that it is a receive buffer
+    if (ciFifoCon.txBF.TxEnable) {
+        batch->status = -2;
+        if (batch->done != NULL) {
+            batch->done(batch);
+        }
+        return;
+    }
+    batch->flags = (CAN_RX_FIFO_EVENT) (ciFifoSta.byte[0] & CAN_RX_FIFO_ALL_EVENTS);
+
+#ifdef USERADDRESS_TIMES_FOUR
+    ua = 4 * ciFifoUa.bF.UserAddress + cRAMADDR_START;
+#else
+    ua = ciFifoUa.bF.UserAddress + cRAMADDR_START;
+#endif
+
+    // Messages waiting - FIFOCI is where the next one will be stored, UA the oldest
+    count = 0;
+    if (batch->flags & CAN_RX_FIFO_NOT_EMPTY_EVENT) {
+        tail = (ua - batch->ramStart) / batch->objSize;
+        if (ua < batch->ramStart || tail >= batch->depth || (ua - batch->ramStart) % batch->objSize) {
+            // not where the layout says - read the one message UA points at
+            tail = 0;
+            count = 1;
+        } else {
+            count = (ciFifoSta.rxBF.FifoIndex + batch->depth - tail) % batch->depth;
+            if (count == 0) {
+                count = batch->depth;
+            }
+        }
+        if (count > CANFDSPI_RX_BATCH_MAX) {
+            count = CANFDSPI_RX_BATCH_MAX;
+        }
+        batch->first = (count < batch->depth - tail) ? count : batch->depth - tail;
+    }
+    batch->count = count;
+
+    // One more than the transfers - released once they are all queued
+    batch->pending = 1;
+
+    if (batch->flags & CAN_RX_FIFO_OVERFLOW_EVENT) {
+        // RXOVIF clears on a 0 written to it, the other flags are read only
+        i = (uint8_t) (batch->flags & ~CAN_RX_FIFO_OVERFLOW_EVENT);
+        batch->ovfXfer.length = sizeof(batch->ovf);
+        batch->ovfXfer.tx = batch->ovf;
+        DRV_CANFDSPI_XferWrite(&batch->ovfXfer, batch->index, cREGADDR_CiFIFOSTA + (batch->channel * CiFIFO_OFFSET), &i, 1);
+        DRV_CANFDSPI_ReceiveBatchQueue(batch, &batch->ovfXfer, batch->ovf, batch->ovfRx, sizeof(batch->ovf));
+    }
+
+    if (count > 0) {
+        // the oldest messages up to the end of the FIFO, then the rest from its start
+        batch->xfer[0].length = 2 + batch->first * batch->objSize;
+        batch->xfer[0].tx = batch->tx;
+        DRV_CANFDSPI_XferRead(&batch->xfer[0], batch->index, ua, batch->first * batch->objSize);
+        DRV_CANFDSPI_ReceiveBatchQueue(batch, &batch->xfer[0], batch->tx, batch->rx, batch->xfer[0].length);
+        if (count > batch->first) {
+            i = count - batch->first;
+            batch->xfer[1].length = 2 + i * batch->objSize;
+            batch->xfer[1].tx = &batch->tx[batch->xfer[0].length];
+            DRV_CANFDSPI_XferRead(&batch->xfer[1], batch->index, batch->ramStart, i * batch->objSize);
+            DRV_CANFDSPI_ReceiveBatchQueue(batch, &batch->xfer[1], &batch->tx[batch->xfer[0].length],
+                    &batch->rx[batch->xfer[0].length], batch->xfer[1].length);
+        }
+
+        // the controller moves its tail one message per UINC - queued behind the reads
+        for (i = 0; i < count; i++) {
+            batch->uincXfer[i].size = sizeof(batch->uinc);
+            DRV_CANFDSPI_ReceiveBatchQueue(batch, &batch->uincXfer[i], batch->uinc, batch->sink, sizeof(batch->uinc));
+        }
+    }
+
+    // release the hold - ends the batch here when nothing was queued
+    DRV_CANFDSPI_ReceiveBatchRelease(batch);
+}
+
+int8_t DRV_CANFDSPI_ReceiveBatchGet(CANFDSPI_RX_BATCH* batch)
+{
+    if (batch->depth == 0) {
+        return -1;
+    }
+
+    batch->status = 0;
+    batch->flags = CAN_RX_FIFO_NO_EVENT;
+    batch->count = 0;
+    batch->first = 0;
+
+    // CiFIFOCON, CiFIFOSTA and CiFIFOUA
+    batch->xfer[0].length = sizeof(batch->tx);
+    batch->xfer[0].tx = batch->tx;
+    batch->xfer[0].rx = batch->rx;
+    DRV_CANFDSPI_XferRead(&batch->xfer[0], batch->index, cREGADDR_CiFIFOCON + (batch->channel * CiFIFO_OFFSET), 12);
+    batch->xfer[0].done = DRV_CANFDSPI_ReceiveBatchStatus;
+    batch->xfer[0].context = batch;
+
+    return DRV_CANFDSPI_XferSubmit(&batch->xfer[0]);
+}
+
+void DRV_CANFDSPI_ReceiveBatchMessage(CANFDSPI_RX_BATCH* batch, uint8_t i,
+        CAN_RX_MSGOBJ* rxObj, uint8_t *rxd, uint8_t nBytes)
+{
+    const uint8_t* ba;
+    REG_t myReg;
+    uint8_t n;
+
+    // each RAM read has its command bytes ahead of it
+    if (i < batch->first) {
+        ba = &batch->rx[2 + i * batch->objSize];
+    } else {
+        ba = &batch->rx[4 + i * batch->objSize];
+    }
+
+    // Assign message header
+    myReg.byte[0] = ba[0];
+    myReg.byte[1] = ba[1];
+    myReg.byte[2] = ba[2];
+    myReg.byte[3] = ba[3];
+    rxObj->word[0] = myReg.word;
+
+    myReg.byte[0] = ba[4];
+    myReg.byte[1] = ba[5];
+    myReg.byte[2] = ba[6];
+    myReg.byte[3] = ba[7];
+    rxObj->word[1] = myReg.word;
+
+    if (batch->timeStamp) {
+        myReg.byte[0] = ba[8];
+        myReg.byte[1] = ba[9];
+        myReg.byte[2] = ba[10];
+        myReg.byte[3] = ba[11];
+        rxObj->word[2] = myReg.word;
+        ba += 12;
+        n = batch->objSize - 12;
+    } else {
+        rxObj->word[2] = 0;
+        ba += 8;
+        n = batch->objSize - 8;
+    }
+
+    // Assign message data - bytes past the object's payload read as 0
+    if (nBytes < n) {
+        n = nBytes;
+    }
+    memcpy(rxd, ba, n);
+    memset(&rxd[n], 0, nBytes - n);
+}
+
 int8_t DRV_CANFDSPI_ReceiveChannelReset(CANFDSPI_MODULE_ID index,
         CAN_FIFO_CHANNEL channel)
 {
@@ -53,6 +53,8 @@ RTC_HandleTypeDef hrtc;
 
 SPI_HandleTypeDef hspi1;
 SPI_HandleTypeDef hspi2;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
 
 TIM_HandleTypeDef htim1;
 
@@ -157,6 +159,7 @@ GPIO_TypeDef  * BAT_CHRG_EN_GPIO_Port;
 void SystemClock_Config(void);
 void PeriphCommonClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_SPI1_Init(void);
 static void MX_SPI2_Init(void);
 static void MX_USART1_UART_Init(void);
@@ -390,6 +393,8 @@ EE_Status StoreEEPROM(uint16_t virtAddress, uint32_t data)
 
   eeStatus = EE_WriteVariable32bits(virtAddress, data);
   eeStatus|= EE_ReadVariable32bits(virtAddress, &data);
+  // keep the RAM copy in step so a re-initialize sees the value just written
+  if((eeStatus & EE_STATUSMASK_ERROR) != EE_STATUSMASK_ERROR) eeVarDataTab[virtAddress] = data;
 
   // Start cleanup IT mode, if cleanup is needed
   if ((eeStatus & EE_STATUSMASK_CLEANUP) == EE_STATUSMASK_CLEANUP) {eeErasingOnGoing = 1;eeStatus|= EE_CleanUp_IT();}
@@ -535,7 +540,9 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
     // CAN1 (VCU) Interrupt
   }else if (GPIO_Pin == CAN1_INT0_Pin){
     // CAN1 (VCU) TX Interrupt
-    can1TxInterrupt = 1;
+    can1TxInterrupt = !HAL_GPIO_ReadPin(CAN1_INT0_GPIO_Port, CAN1_INT0_Pin); // Active Low - inverted with !
+    // the TX FIFO has room - load the frames waiting in the queue over SPI DMA
+    if (can1TxInterrupt) VCU_TxRefill();
   }else if (GPIO_Pin == CAN1_INT1_Pin){
      // CAN1 (VCU) RX Interrupt
      can1RxInterrupt = !HAL_GPIO_ReadPin(CAN1_INT1_GPIO_Port, CAN1_INT1_Pin); // Active Low - inverted with !
@@ -545,11 +552,17 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
     // CAN2 (MCU) Interrupt
   }else if (GPIO_Pin == CAN2_INT0_Pin){
     // CAN2 (MCU) TX Interrupt
-    can2TxInterrupt = 1;
+    can2TxInterrupt = !HAL_GPIO_ReadPin(CAN2_INT0_GPIO_Port, CAN2_INT0_Pin); // Active Low - inverted with !
+    // the TX FIFO has room - load the frames waiting in the queue over SPI DMA
+    if (can2TxInterrupt) MCU_TxRefill();
   }else if (GPIO_Pin == CAN2_INT1_Pin){
     // CAN2 (MCU) RX Interrupt
     can2RxInterrupt = !HAL_GPIO_ReadPin(CAN2_INT1_GPIO_Port, CAN2_INT1_Pin); // Active Low - inverted with !
-    if (can2RxInterrupt) switchLedOn(MCU_RX_LED);
+    if (can2RxInterrupt){
+      switchLedOn(MCU_RX_LED);
+      // start emptying the controller FIFO over SPI DMA - PCU_Tasks() decodes the frames from mcuRxRing
+      MCU_RxDrain();
+    }
     else switchLedOff(MCU_RX_LED);
   }else if(GPIO_Pin == BUTTON1_Pin){
 
@@ -656,6 +669,7 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_SPI1_Init();
   MX_SPI2_Init();
   MX_USART1_UART_Init();
@@ -1232,6 +1246,26 @@ static void MX_USB_PCD_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel1_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+  /* DMA1_Channel2_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -14,10 +14,21 @@
 #include "string.h"
 #include "stdio.h"
 #include "../../protocols/can_frm_mod.h"
+#include "../../protocols/can_cell_pack.h"
 #include "vcu.h"
 #include "time.h"
 #include "eeprom_data.h"
 #include "debug.h"
+#include "mcu_sched.h"
+#include "mcu_stats.h"
+#include "fixed_signal.h"
+#include "mcu_cells.h"
+#include "mcu_cellstats.h"
+#include "mcu_balance.h"
+#include "mcu_telem.h"
+#include "mcu_soc.h"
+#include "can_rx_ring.h"
+#include "can_tx_queue.h"
 
 /***************************************************************************************************************
 *
@@ -33,19 +44,26 @@ CAN_CONFIG config;
 CAN_OPERATION_MODE opMode;
 
 // Transmit objects
-CAN_TX_FIFO_CONFIG txConfig;
-CAN_TX_FIFO_EVENT txFlags;
 CAN_TX_MSGOBJ txObj;
 uint8_t txd[MAX_DATA_BYTES];
 
 // Receive objects
-CAN_RX_FIFO_CONFIG rxConfig;
-REG_CiFLTOBJ fObj;
-REG_CiMASK mObj;
 CAN_RX_FIFO_EVENT rxFlags;
 CAN_RX_MSGOBJ rxObj;
 uint8_t rxd[MAX_DATA_BYTES];
 
+// Frames the CAN2 RX interrupt has read out of the controller, waiting for MCU_ReceiveMessages()
+canRxRing_t mcuRxRing;
+static CANFDSPI_RX_BATCH mcuRxBatch[MCU_RX_FIFOS];   // the drain's FIFO reads, chained from their completions
+static const CAN_FIFO_CHANNEL mcuRxFifo[MCU_RX_FIFOS] = { MCU_RX_FIFO, MCU_RX_OTHER_FIFO, MCU_RX_BULK_FIFO };
+static volatile uint8_t mcuRxDraining;        // a drain chain is running
+static volatile uint8_t mcuRxPending;         // RX interrupt while it was
+static uint32_t mcuRxOverflowsSeen;           // ring counters already reported
+static uint32_t mcuRxDropsSeen;
+
+// Frames waiting for the CAN2 TX FIFO, by traffic class
+canTxQueue_t mcuTxQueue;
+
 
 REG_t reg;
 
@@ -57,6 +75,9 @@ uint8_t rec;
 CAN_ERROR_STATE errorFlags;
 
 batteryModule module[MAX_MODULES_PER_PACK];
+moduleControl moduleCtl;
+mcuDetailStream_t mcuDetailStream;
+mcuLookup_t mcuLookup;
 batteryPack pack;
 
 uint32_t MCU_TicksSinceLastMessage(uint8_t moduleId);
@@ -65,12 +86,17 @@ uint32_t MCU_ElapsedTicks(lastContact_t* pLastContact);
 void MCU_UpdateModuleCounts(void);
 void MCU_TransmitState(uint8_t moduleId, moduleState state);
 uint8_t MCU_FindMaxVoltageModule(void);
-void MCU_UpdateStats(void);
 void MCU_RequestHardware(uint8_t moduleId);
 void MCU_ProcessModuleHardware(void);
 void MCU_ProcessModuleTime(void);
 void MCU_ProcessCellCommStatus1(void);
 static bool MCU_ShouldLogMessage(uint16_t messageId, bool isTx);
+static void MCU_SendDetailWindowAck(uint8_t status);
+static void MCU_DetailStreamCell(uint8_t cellId, uint8_t cellCount);
+static void MCU_StatusPartReceived(uint8_t moduleIndex, uint8_t part);
+static void MCU_ModuleUidAdd(uint8_t moduleIndex);
+static void MCU_RxDrainFrom(uint8_t fifo);
+static void MCU_RxDrainNext(CANFDSPI_RX_BATCH* batch);
 
 
 /***************************************************************************************************************
@@ -96,10 +122,12 @@ static bool MCU_ShouldLogMessage(uint16_t messageId, bool isTx)
     case ID_MODULE_STATUS_1:          return (debugMessages & DBG_MSG_STATUS1) != 0;
     case ID_MODULE_STATUS_2:          return (debugMessages & DBG_MSG_STATUS2) != 0;
     case ID_MODULE_STATUS_3:          return (debugMessages & DBG_MSG_STATUS3) != 0;
+    case ID_MODULE_STATUS_FD:         return (debugMessages & DBG_MSG_STATUS1) != 0;
     case ID_MODULE_STATE_CHANGE:      return (debugMessages & DBG_MSG_STATE_CHANGE) != 0;
     case ID_MODULE_HARDWARE_REQUEST:  return (debugMessages & DBG_MSG_HARDWARE_REQ) != 0;
     case ID_MODULE_HARDWARE:          return (debugMessages & DBG_MSG_HARDWARE) != 0;
     case ID_MODULE_DETAIL:            return (debugMessages & DBG_MSG_CELL_DETAIL) != 0;
+    case ID_MODULE_CELL_FD:           return (debugMessages & DBG_MSG_CELL_DETAIL) != 0;
     case ID_MODULE_CELL_COMM_STATUS1: return (debugMessages & DBG_MSG_CELL_STATUS1) != 0;
     case ID_MODULE_CELL_COMM_STATUS2: return (debugMessages & DBG_MSG_CELL_STATUS2) != 0;
     case ID_MODULE_TIME_REQUEST:      return (debugMessages & DBG_MSG_TIME_REQ) != 0;
@@ -124,6 +152,7 @@ static bool MCU_ShouldLogMessage(uint16_t messageId, bool isTx)
 ***************************************************************************************************************/
 void PCU_Initialize(void)
 {
+  uint16_t vcuCanOffset;
 
 
   // Retrieve parameters from emulated EEPROM
@@ -136,17 +165,16 @@ void PCU_Initialize(void)
 
   LoadAllEEPROM();
 
+  vcuCanOffset = pack.vcuCanOffset;   // the VCU filters stay programmed for this until VCU_SetCanOffset moves them
   memset(&pack,0,sizeof(pack));
+  pack.vcuCanOffset = vcuCanOffset;
 
   //pack.id = EE_PACK_ID;
   pack.id = eeVarDataTab[EE_PACK_CONTROLLER_ID];
   pack.mfgId=0;
   pack.partId=0;
   pack.uniqueId=0;
-  if (pack.id == 0)
-    pack.vcuCanOffset = 0;
-  else if (pack.id == 1)
-    pack.vcuCanOffset =0x100;
+  VCU_SetCanOffset(VCU_CAN_OFFSET(pack.id));
   pack.hwVersion=HW_VER;
   pack.fwVersion=FW_VER;
   pack.voltage=0;
@@ -178,6 +206,23 @@ void PCU_Initialize(void)
   for (index=0;index<MAX_MODULES_PER_PACK;index++){
     memset(&module[index],0,sizeof(module[index]));
   }
+  memset(&moduleCtl,0,sizeof(moduleCtl));
+  memset(mcuLookup.indexById, MAX_MODULES_PER_PACK, sizeof(mcuLookup.indexById));
+  memset(mcuLookup.uidSlot, 0, sizeof(mcuLookup.uidSlot));
+  MCU_CellsInit();
+  MCU_CellStatsInit();
+  MCU_BalanceInit();
+  MCU_TelemInit();
+  MCU_SocInit();
+  // also run from a pack ID write, with the RX drain live - frames queued under the old ID are dropped from
+  // the consumer side, the drain keeps its counters and only what it counts from now on is reported
+  CanRxRing_Flush(&mcuRxRing);
+  mcuRxOverflowsSeen = mcuRxRing.overflows;
+  mcuRxDropsSeen = mcuRxRing.drops;
+  MCU_SchedInit();
+  MCU_PollInit();
+  MCU_StatsInit();
+  memset(&mcuDetailStream, 0, sizeof(mcuDetailStream));
 
 
   bool passed;
@@ -252,13 +297,29 @@ void PCU_Tasks(void)
   uint8_t moduleId;
   uint8_t firstModuleIndex;
   uint32_t elapsedTicks;
-  static uint8_t nextModuleToPoll = 0;
-  static lastContact_t lastStatusPoll = {0, 0};
+  uint32_t timeoutTicks;
+  uint32_t now;
+  uint32_t slots;
+  bool timedOut;
+  uint8_t dirty;
+  bool vcuRefresh;
+#ifdef MCU_USE_BROADCAST_STATUS
+  static lastContact_t lastStatusBroadcast = {0, 0};
+#endif
+#ifdef MCU_USE_VCU_DIRTY
+  static uint8_t vcuRefreshCount = 0;
+#endif
 
   if(appData.state == PC_STATE_INIT){  // Application initialization
 
-    DRV_CANFDSPI_Init(CAN1);  // VCU interface
-    DRV_CANFDSPI_Init(CAN2);  // Module Controller interface
+    DRV_CANFDSPI_Init(CAN1, &vcuChannelMap);  // VCU interface
+    DRV_CANFDSPI_Init(CAN2, &mcuChannelMap);  // Module Controller interface
+    for(index = 0; index < MCU_RX_FIFOS; index++){
+      DRV_CANFDSPI_ReceiveBatchConfigure(&mcuRxBatch[index], CAN2, mcuRxFifo[index]);
+      mcuRxBatch[index].done = MCU_RxDrainNext;
+    }
+    CanTxQueue_Init(&mcuTxQueue, CAN2, mcuChannelMap.txClass);
+    CanTxQueue_Init(&vcuTxQueue, VCU_CAN, vcuChannelMap.txClass);
 
     MCU_IsolateAllModules();
     MCU_DeRegisterAllModules();
@@ -287,9 +348,17 @@ void PCU_Tasks(void)
     if(can1RxInterrupt)
       VCU_ReceiveMessages();
 
-    //Check for CAN1 RX Interrupt (VCU)
+    //Module bus frames are drained by the CAN2 RX interrupt - a line still asserted owes a drain
+    //Status and announcements are drained as they land - cell data waits for this pass unless its FIFO fills
     if(can2RxInterrupt)
-      MCU_ReceiveMessages();
+      MCU_RxDrain();
+    else
+      MCU_RxDrainFrom(MCU_RX_FIFOS - 1);
+    MCU_ReceiveMessages();
+
+    //Queued frames are loaded by the TX interrupts as the FIFOs free up - this catches any they have not started
+    MCU_TxRefill();
+    VCU_TxRefill();
 
     //Check for expired last contact from VCU
     elapsedTicks = VCU_TicksSinceLastMessage();
@@ -321,17 +390,36 @@ void PCU_Tasks(void)
       lastAnnounceRequest.overflows = etTimerOverflows;
     }
 
-    //Check for expired last contact from module
+    // Recover a stalled cell detail window
+    if(mcuDetailStream.active)
+      MCU_CheckCellDetailStream();
+
+    //Check for expired last contact from module - only modules whose deadline has expired are visited
     ShowDebugMessage(MSG_POLLING_CYCLE, pack.moduleCount);
-    for (index =0;index < MAX_MODULES_PER_PACK;index++){
-      if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
-      elapsedTicks = MCU_TicksSinceLastMessage(module[index].moduleId);
+    now = MCU_Now();
+    while((index = MCU_SchedNextDue(now)) != MCU_SCHED_NONE){
+      // deadlines are only brought forward eagerly, so re-validate before servicing
+      MCU_SchedUpdate(index);
+      if(MCU_SchedNextDue(now) != index) continue;
+
+      timedOut = false;
+      elapsedTicks = MCU_ElapsedTicks(&moduleCtl.lastContact[index]);
+      // a timeout period runs from the last contact or the last timeout, whichever is later
+      timeoutTicks = MCU_ElapsedTicks(&moduleCtl.lastTimeout[index]);
+      if(timeoutTicks > elapsedTicks) timeoutTicks = elapsedTicks;
       ShowDebugMessage(MSG_MODULE_CHECK, module[index].moduleId, elapsedTicks, 
-                       module[index].statusPending, module[index].faultCode.commsError);
-      if(elapsedTicks > MCU_ET_TIMEOUT && (module[index].statusPending == true)){
+                       moduleCtl.statusPending[index], moduleCtl.faultCode[index].commsError);
+      if(timeoutTicks > MCU_ET_TIMEOUT && (moduleCtl.statusPending[index] == true)){
+        timedOut = true;
+        MCU_PollRelease(index);  // request is lost - free its slot in the polling window
+        moduleCtl.statusPending[index] = false;  // and ask again
+        moduleCtl.waiting[index] = false;
         // Increment consecutive timeout counter
         module[index].consecutiveTimeouts++;
         module[index].statusMessagesReceived = 0;  // Clear any partial status
+        // start the next timeout period - lastContact stays the last frame the module sent
+        moduleCtl.lastTimeout[index].ticks = htim1.Instance->CNT;
+        moduleCtl.lastTimeout[index].overflows = etTimerOverflows;
         
         if(module[index].consecutiveTimeouts >= MCU_MAX_CONSECUTIVE_TIMEOUTS){
           // Max timeouts reached - deregister the module
@@ -348,116 +436,106 @@ void PCU_Tasks(void)
           ShowDebugMessage(MSG_DEREGISTER, module[index].moduleId, module[index].uniqueId, index);
           
           // Mark module as deregistered (don't remove from array)
-          module[index].isRegistered = false;
+          moduleCtl.isRegistered[index] = false;
           
           // Update module counts
           MCU_UpdateModuleCounts();
           
           // Continue without adjusting index (no array shift)
         }
-        else if( module[index].faultCode.commsError == false){
+        else if( moduleCtl.faultCode[index].commsError == false){
           // First timeout or still under limit - isolate module
           if((debugLevel & ( DBG_MCU + DBG_ERRORS)) == ( DBG_MCU + DBG_ERRORS) ){ 
             sprintf(tempBuffer,"MCU ERROR - Module timeout ID=%02x (timeout %d of %d)",
                     module[index].moduleId, module[index].consecutiveTimeouts, MCU_MAX_CONSECUTIVE_TIMEOUTS); 
             serialOut(tempBuffer);
           }
-          if (pack.vcuRequestedState == packPrecharge && module[index].currentState == moduleOn){
+          if (pack.vcuRequestedState == packPrecharge && moduleCtl.currentState[index] == moduleOn){
             // This was the first module on and its faulted - select another!
             pack.powerStatus.powerStage = stageSelectModule;
           }
           // turn off the faulted module and flag the fault
-          module[index].nextState = moduleOff;
-          module[index].faultCode.commsError = true;
+          moduleCtl.nextState[index] = moduleOff;
+          moduleCtl.faultCode[index].commsError = true;
+          MCU_StatsModuleChanged(index);
+        }
+      }else if(elapsedTicks > MCU_STATUS_INTERVAL && (moduleCtl.statusPending[index] == false) && 
+               (moduleCtl.waiting[index] == false)){  // Don't send if waiting for another response
+        // the status poller skips a module in comms error - ask it here, at MCU_STATUS_INTERVAL, until a reply
+        // clears the fault. Healthy modules are polled by the poller alone, within its window and bus budget
+        if(moduleCtl.faultCode[index].commsError == true){
+          ShowDebugMessage(MSG_STATUS_REQUEST, module[index].moduleId, index);
+          MCU_RequestModuleStatus(module[index].moduleId);
         }
-      }else if(elapsedTicks > MCU_STATUS_INTERVAL && (module[index].statusPending == false) && 
-               (module[index].waiting == false)){  // Don't send if waiting for another response
-        // Send State
-        ShowDebugMessage(MSG_STATUS_REQUEST, module[index].moduleId, index);
-        MCU_RequestModuleStatus(module[index].moduleId);
         // Have we received the hardware info? This should have been sent at registration
-        if(module[index].hardwarePending && (module[index].waiting == false))
+        if(module[index].hardwarePending && (moduleCtl.waiting[index] == false))
           // Not received, so lets request it
           MCU_RequestHardware(module[index].moduleId);
       }else{
-        // timers have not been exceeded
-        if(module[index].faultCode.commsError == true){
-          // if the module was in fault, bring it back online
-          module[index].faultCode.commsError  = false;
-        }
+        // timers have not been exceeded - a comms fault stays until a status reply clears it
         ShowDebugMessage(MSG_MODULE_CHECK, module[index].moduleId, elapsedTicks, 
-                         module[index].statusPending, module[index].faultCode.commsError);
+                         moduleCtl.statusPending[index], moduleCtl.faultCode[index].commsError);
       }
+
+      // re-arm the module - if its deadline did not move, look again on a later pass
+      MCU_SchedUpdate(index);
+      if(MCU_SchedNextDue(now) == index)
+        MCU_SchedDefer(index, timedOut ? 1 : MCU_SCHED_IDLE_RECHECK);
     }
     
-    // Round-robin polling of modules
-    if(pack.moduleCount > 0){
-      uint32_t timeSinceLastPoll = MCU_ElapsedTicks(&lastStatusPoll);
-      
-      // Poll one module every 100ms to distribute the load
-      if(timeSinceLastPoll > 100){
-        // Find the next valid module to poll
-        uint8_t modulesToCheck = pack.moduleCount;
-        while(modulesToCheck > 0){
-          if(nextModuleToPoll >= pack.moduleCount){
-            nextModuleToPoll = 0;
-          }
-          
-          // Only poll modules that are not in timeout/error state or waiting for response
-          if(module[nextModuleToPoll].statusPending == false && 
-             module[nextModuleToPoll].faultCode.commsError == false &&
-             module[nextModuleToPoll].waiting == false){
-            ShowDebugMessage(MSG_STATUS_REQUEST, module[nextModuleToPoll].moduleId, nextModuleToPoll);
-            MCU_RequestModuleStatus(module[nextModuleToPoll].moduleId);
-            
-            // Have we received the hardware info?
-            if(module[nextModuleToPoll].hardwarePending && 
-               module[nextModuleToPoll].waiting == false){
-              MCU_RequestHardware(module[nextModuleToPoll].moduleId);
-            }
-            
-            // Move to next module for next poll
-            nextModuleToPoll++;
-            
-            // Update last poll time
-            lastStatusPoll.ticks = htim1.Instance->CNT;
-            lastStatusPoll.overflows = etTimerOverflows;
-            break;
-          }
-          
-          nextModuleToPoll++;
-          modulesToCheck--;
-        }
+#ifdef MCU_USE_BROADCAST_STATUS
+    // Broadcast status polling - one request per refresh period, modules reply in their ID slot
+    // a request the poll ring could not take is tried again on the next pass
+    if(pack.moduleCount > 0 && MCU_ElapsedTicks(&lastStatusBroadcast) > MCU_POLL_REFRESH_TARGET &&
+       MCU_RequestAllModuleStatus()){
+      lastStatusBroadcast.ticks = htim1.Instance->CNT;
+      lastStatusBroadcast.overflows = etTimerOverflows;
+    }
+#else
+    // Pipelined status polling - keep up to mcuPoll.window requests in flight
+    while((index = MCU_PollNextCandidate(now)) != MCU_SCHED_NONE){
+      ShowDebugMessage(MSG_STATUS_REQUEST, module[index].moduleId, index);
+      // the poll ring is full - stop here, the module stays a candidate for the next pass
+      if(!MCU_RequestModuleStatus(module[index].moduleId)) break;
+
+      // Have we received the hardware info?
+      if(module[index].hardwarePending && 
+         moduleCtl.waiting[index] == false){
+        MCU_RequestHardware(module[index].moduleId);
       }
     }
+#endif
   }
 
   if (pack.controlMode == dmcMode){
    // DIRECT MODULE CONTROL MODE
    // Command the modules
-    for (index =0;index < MAX_MODULES_PER_PACK;index++){
-      if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
+    now = MCU_Now();
+    for (slots = mcuSched.registeredMask; slots != 0; slots &= slots - 1){
+      index = __builtin_ctz(slots);
+      if(module[index].uniqueId == 0) continue;
       // Handle the  over current condition
-      if(module[index].faultCode.overCurrent == true){
-        if (module[index].currentState != moduleOff){
+      if(moduleCtl.faultCode[index].overCurrent == true){
+        if (moduleCtl.currentState[index] != moduleOff){
           // Turn off the module
-          module[index].nextState = moduleOff;
+          moduleCtl.nextState[index] = moduleOff;
           // clear the over current flag
-          module[index].faultCode.overCurrent = false;
+          moduleCtl.faultCode[index].overCurrent = false;
+          MCU_StatsModuleChanged(index);
         }
-      } else if (module[index].faultCode.commsError == false && module[index].faultCode.hwIncompatible == false ){
+      } else if (moduleCtl.faultCode[index].commsError == false && moduleCtl.faultCode[index].hwIncompatible == false ){
         // No faults - have we already commanded the module?
-        if((module[index].command.commandStatus == commandIssued) && (module[index].command.commandedState == module[index].nextState)){
+        if((module[index].command.commandStatus == commandIssued) && (module[index].command.commandedState == moduleCtl.nextState[index])){
           // module has been commanded, allow some delay before re-issuing the command
-          if(MCU_TicksSinceLastStateTx(module[index].moduleId) > MCU_STATE_TX_INTERVAL){
+          if(MCU_SchedStateTxDue(index, now)){
             // Command the module
-            MCU_TransmitState(module[index].moduleId,module[index].nextState);
+            MCU_TransmitState(module[index].moduleId,moduleCtl.nextState[index]);
           }
         }else {
           ShowDebugMessage(MSG_STATE_TRANSITION, module[index].moduleId, 
-                           module[index].currentState, module[index].nextState,
+                           moduleCtl.currentState[index], moduleCtl.nextState[index],
                            module[index].command.commandedState, module[index].command.commandStatus);
-          MCU_TransmitState(module[index].moduleId,module[index].nextState);
+          MCU_TransmitState(module[index].moduleId,moduleCtl.nextState[index]);
         }
       }
     }
@@ -512,29 +590,29 @@ void PCU_Tasks(void)
         firstModuleIndex = MCU_ModuleIndexFromId(pack.powerStatus.firstModuleId);
         if (firstModuleIndex < MAX_MODULES_PER_PACK){
           // check that our first module hasnt gone into fault
-          if(module[firstModuleIndex].faultCode.commsError == true || module[firstModuleIndex].faultCode.hwIncompatible == true){
+          if(moduleCtl.faultCode[firstModuleIndex].commsError == true || moduleCtl.faultCode[firstModuleIndex].hwIncompatible == true){
              // module has gone into fault or hw incompatible -  go back a stage and select another
              pack.powerStatus.powerStage = stageSelectModule;
              if((debugLevel & (DBG_MCU + DBG_ERRORS)) == (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Selected module %02x in fault - selecting another",pack.powerStatus.firstModuleId); serialOut(tempBuffer);}
           } else if (pack.vcuRequestedState == packOn){
-            if (module[firstModuleIndex].currentState == moduleOn){
+            if (moduleCtl.currentState[firstModuleIndex] == moduleOn){
               // mark the pack as requested by the vcu
               pack.state = packOn;
               // set powerStage idle
               pack.powerStatus.powerStage = stageIdle;
             } else {
               // Command the module to turn on
-                module[firstModuleIndex].nextState = moduleOn;
+                moduleCtl.nextState[firstModuleIndex] = moduleOn;
             }
           } else if (pack.vcuRequestedState == packPrecharge){
-            if (module[firstModuleIndex].currentState == modulePrecharge){
+            if (moduleCtl.currentState[firstModuleIndex] == modulePrecharge){
               // mark the pack as requested by the vcu
               pack.state = packPrecharge;
               // set powerStage idle
               pack.powerStatus.powerStage = stageIdle;
             } else{
               // Command the module to pre-charge state
-                module[firstModuleIndex].nextState = modulePrecharge;
+                moduleCtl.nextState[firstModuleIndex] = modulePrecharge;
             }
           }
         } else {
@@ -544,46 +622,49 @@ void PCU_Tasks(void)
       }
     }
     // Command the rest of the modules
-    for (index =0;index < MAX_MODULES_PER_PACK;index++){
-      if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
+    now = MCU_Now();
+    for (slots = mcuSched.registeredMask; slots != 0; slots &= slots - 1){
+      index = __builtin_ctz(slots);
+      if(module[index].uniqueId == 0) continue;
       // Handle the  over current condition
-      if(module[index].faultCode.overCurrent == true){
+      if(moduleCtl.faultCode[index].overCurrent == true){
         if (pack.vcuRequestedState != packOff){
           // Command the module to standby
-          module[index].nextState = moduleStandby;
+          moduleCtl.nextState[index] = moduleStandby;
         } else {
           // Turn off the module
-          module[index].nextState = moduleOff;
+          moduleCtl.nextState[index] = moduleOff;
           // clear the over current flag
-          module[index].faultCode.overCurrent = false;
+          moduleCtl.faultCode[index].overCurrent = false;
+          MCU_StatsModuleChanged(index);
         }
-      } else if (module[index].faultCode.commsError == false && module[index].faultCode.hwIncompatible == false ){
+      } else if (moduleCtl.faultCode[index].commsError == false && moduleCtl.faultCode[index].hwIncompatible == false ){
         // Handle the pack states
         switch (pack.vcuRequestedState){
           // ON
           case packOn :
             if(pack.state == packOn){
-              module[index].nextState = moduleOn;
+              moduleCtl.nextState[index] = moduleOn;
             }
             // work out pack status - pack soc is stored as per the module soc and needs to be converted for calculation
-            if      (pack.soc < (PACK_EMPTY_SOC_THRESHOLD / PERCENTAGE_FACTOR )) { pack.status = packStatusEmpty; } // < 5% = Empty
-            else if (pack.soc > (PACK_FULL_SOC_THRESHOLD  / PERCENTAGE_FACTOR )) { pack.status = packStatusFull;  } // > 95% = Full
+            if      (pack.soc < FXS_FROM_QUANTA(PACK_EMPTY_SOC_THRESHOLD * FXS_PERCENTAGE_PER_UNIT, PERCENTAGE)) { pack.status = packStatusEmpty; } // < 5% = Empty
+            else if (pack.soc > FXS_FROM_QUANTA(PACK_FULL_SOC_THRESHOLD  * FXS_PERCENTAGE_PER_UNIT, PERCENTAGE)) { pack.status = packStatusFull;  } // > 95% = Full
             else                                                                 { pack.status = packStatusNormal;} // 5% to 95% = Normal
             break;
           // PRECHARGE
           case packPrecharge :
             if (pack.state == packPrecharge && index != firstModuleIndex){
-              module[index].nextState = moduleStandby;
+              moduleCtl.nextState[index] = moduleStandby;
             }
             pack.status = packStatusOff;
             break;
           case packStandby:
-            module[index].nextState = moduleStandby;
+            moduleCtl.nextState[index] = moduleStandby;
             pack.state  = packStandby;
             pack.status = packStatusOff;
             break;
           case packOff:
-            module[index].nextState = moduleOff;
+            moduleCtl.nextState[index] = moduleOff;
             pack.state  = packOff;
             pack.status = packStatusOff;
             break;
@@ -592,38 +673,51 @@ void PCU_Tasks(void)
         }
       }
       // Have we already commanded the module?
-      if((module[index].command.commandStatus == commandIssued) && (module[index].command.commandedState == module[index].nextState)){
+      if((module[index].command.commandStatus == commandIssued) && (module[index].command.commandedState == moduleCtl.nextState[index])){
         // module has been commanded, allow some delay before re-issuing the command
-        if(MCU_TicksSinceLastStateTx(module[index].moduleId) > MCU_STATE_TX_INTERVAL){
+        if(MCU_SchedStateTxDue(index, now)){
           // Command the module
-          MCU_TransmitState(module[index].moduleId,module[index].nextState);
+          MCU_TransmitState(module[index].moduleId,moduleCtl.nextState[index]);
         }
       }else {
-        MCU_TransmitState(module[index].moduleId,module[index].nextState);
+        MCU_TransmitState(module[index].moduleId,moduleCtl.nextState[index]);
       }
     }
 
     //Update our pack statistics
     MCU_UpdateStats();
+    MCU_SocTasks(now);
+    MCU_UpdateCellStats();
+    MCU_BalanceTasks(now);
+    VCU_TransmitTelemetry();
 
     // This should fire every 200ms
     if(sendMaxState >0){
       // Broadcast Maximum State to modules
       MCU_TransmitMaxState(pack.vcuRequestedState);
+      sendMaxState=0;
     }
 
     // This should fire every 500ms
     if(sendState > 0){
       // Send BMS Data to VCU
       if (pack.rtcValid == false) VCU_RequestTime();
+      dirty = MCU_StatsTakeDirty();
+#ifdef MCU_USE_VCU_DIRTY
+      // unchanged frames go out every MCU_STATS_VCU_REFRESH cycles so the VCU timeouts never fire
+      vcuRefresh = (++vcuRefreshCount >= MCU_STATS_VCU_REFRESH);
+      if(vcuRefresh) vcuRefreshCount = 0;
+#else
+      vcuRefresh = true;
+#endif
       VCU_TransmitBmsState();
-      VCU_TransmitBmsData1();
-      VCU_TransmitBmsData2();
-      VCU_TransmitBmsData3();
-      VCU_TransmitBmsData5();
-      VCU_TransmitBmsData8();
-      VCU_TransmitBmsData9();
-      VCU_TransmitBmsData10();
+      if(vcuRefresh || (dirty & MCU_STATS_DIRTY_DATA1)) VCU_TransmitBmsData1();
+      if(vcuRefresh || (dirty & MCU_STATS_DIRTY_DATA2)) VCU_TransmitBmsData2();
+      if(vcuRefresh || (dirty & MCU_STATS_DIRTY_DATA3)) VCU_TransmitBmsData3();
+      if(vcuRefresh || (dirty & MCU_STATS_DIRTY_DATA5)) VCU_TransmitBmsData5();
+      if(vcuRefresh || (dirty & MCU_STATS_DIRTY_DATA8)) VCU_TransmitBmsData8();
+      if(vcuRefresh || (dirty & MCU_STATS_DIRTY_DATA9)) VCU_TransmitBmsData9();
+      if(vcuRefresh) VCU_TransmitBmsData10();
       sendState=0;
     }
   }
@@ -641,7 +735,7 @@ void PCU_Tasks(void)
 /***************************************************************************************************************
 *     D R V _ C A N F D S P I _ I n i t                                            P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
-void DRV_CANFDSPI_Init(CANFDSPI_MODULE_ID index)
+void DRV_CANFDSPI_Init(CANFDSPI_MODULE_ID index, const canChannelMap_t* map)
 {
   // Reset device
   DRV_CANFDSPI_Reset(index);
@@ -655,51 +749,20 @@ void DRV_CANFDSPI_Init(CANFDSPI_MODULE_ID index)
   DRV_CANFDSPI_ConfigureObjectReset(&config);
   config.IsoCrcEnable = 1;
   config.StoreInTEF = 0;
+  config.TXQEnable = CanChannels_Txq(map);
 
   DRV_CANFDSPI_Configure(index, &config);
 
-  // Setup TX FIFO
-  DRV_CANFDSPI_TransmitChannelConfigureObjectReset(&txConfig);
-  txConfig.FifoSize = 7;
-  txConfig.PayLoadSize = CAN_PLSIZE_64;
-  txConfig.TxPriority = 1;
-
-  DRV_CANFDSPI_TransmitChannelConfigure(index, MCU_TX_FIFO, &txConfig);
-
-  // Setup RX FIFO
-  DRV_CANFDSPI_ReceiveChannelConfigureObjectReset(&rxConfig);
-  rxConfig.FifoSize = 15;
-  rxConfig.PayLoadSize = CAN_PLSIZE_64;
-
-  DRV_CANFDSPI_ReceiveChannelConfigure(index, MCU_RX_FIFO, &rxConfig);
-
-  // Setup RX Filter
-  fObj.word = 0;
-  fObj.bF.SID = 0x00;
-  fObj.bF.EXIDE = 0;
-  fObj.bF.EID = 0x00;
-
-  DRV_CANFDSPI_FilterObjectConfigure(index, CAN_FILTER0, &fObj.bF);
-
-  // Setup RX Mask
-  mObj.word = 0;
-  mObj.bF.MSID = 0x0;
-  mObj.bF.MIDE = 0; // Both standard and extended frames accepted
-  mObj.bF.MEID = 0x0;
-  DRV_CANFDSPI_FilterMaskConfigure(index, CAN_FILTER0, &mObj.bF);
-
-  // Link FIFO and Filter
-  DRV_CANFDSPI_FilterToFifoLink(index, CAN_FILTER0, MCU_RX_FIFO, true);
+  // Setup TXQ, FIFOs and RX Filters, with their interrupts
+  if(CanChannels_Configure(index, map) != 0){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS)) == (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - CAN%d channel map does not fit (%d bytes)", index + 1, CanChannels_RamBytes(map)); serialOut(tempBuffer);}
+  }
 
   // Setup Bit Time
   DRV_CANFDSPI_BitTimeConfigure(index, CAN_500K_2M, CAN_SSP_MODE_AUTO, CAN_SYSCLK_40M);
 
   // Setup Transmit and Receive Interrupts
   DRV_CANFDSPI_GpioModeConfigure(index, GPIO_MODE_INT, GPIO_MODE_INT);
-#ifdef MCU_USE_TX_INT
-  DRV_CANFDSPI_TransmitChannelEventEnable(index, MCU_TX_FIFO, CAN_TX_FIFO_NOT_FULL_EVENT);
-#endif
-  DRV_CANFDSPI_ReceiveChannelEventEnable(index, MCU_RX_FIFO, CAN_RX_FIFO_NOT_EMPTY_EVENT);
   DRV_CANFDSPI_ModuleEventEnable(index, CAN_TX_EVENT | CAN_RX_EVENT);
 
   // Select Normal Mode
@@ -709,210 +772,92 @@ void DRV_CANFDSPI_Init(CANFDSPI_MODULE_ID index)
 
 
 /***************************************************************************************************************
-*     M C U _ U p d a t e S t a t s                                               P A C K   C O N T R O L L E R
+*     M C U _ R x D r a i n                                                        P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
-void MCU_UpdateStats(void)
+void MCU_RxDrain(void)
 {
+  MCU_RxDrainFrom(0);
+}
 
-  uint8_t index;
-  uint8_t modulesOn            = 0;
-  uint32_t voltage             = 0;
-  float moduleCurrent          = 0;
-  float totalCurrent           = 0;
-  float moduleMaxChargeA       = 0;
-  float moduleMaxDischargeA    = 0;
-  uint16_t lowestSoc           = 255;
-  uint16_t lowestSoh           = 255;
-  uint32_t totalAvgCellVolt    = 0;
-  uint16_t highestCellVolt     = 0;
-  uint16_t lowestCellVolt      = 65535;
-  uint32_t totalAvgCellTemp    = 0;
-  uint16_t highestCellTemp     = 0;
-  uint16_t lowestCellTemp      = 65535;
-  float    maxChargeA          = 0;
-  float    maxDischargeA       = 0;
-  float    packCurrent         = 0;
-  uint32_t totalMaxChargeEndV  = 0;
-  uint8_t  activeModules       = 0;
-  uint8_t  modLowestCellVolt   = 0;
-  uint8_t  modHighestCellVolt  = 0;
-  uint8_t  modLowestCellTemp   = 0;
-  uint8_t  modHighestCellTemp  = 0;
-
+/***************************************************************************************************************
+*     M C U _ R x D r a i n F r o m                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_RxDrainFrom(uint8_t fifo)
+{
+  // one chain at a time - an interrupt while it runs has it read the FIFOs again before it stops
+  if(__atomic_exchange_n(&mcuRxDraining, 1, __ATOMIC_ACQ_REL)){
+    mcuRxPending = 1;
+    return;
+  }
 
-  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
-    // only generate stats for modules that are not in fault or in over current
-    if(module[index].faultCode.commsError == false && module[index].faultCode.overCurrent ==  false && module[index].faultCode.hwIncompatible == false){
-      // sum the currents of all modules that are ON and average the voltages
-      if(module[index].currentState == moduleOn) {
-        // calculate module max currents in Amps
-        moduleMaxChargeA    = MODULE_CURRENT_BASE + (module[index].maxChargeA    * MODULE_CURRENT_FACTOR);
-        moduleMaxDischargeA = MODULE_CURRENT_BASE + (module[index].maxDischargeA * MODULE_CURRENT_FACTOR);
-        //sum the voltage - averaged later
-        voltage = voltage + module[index].mmv;
-        //increment module on count
-        modulesOn++;
-        //calculate module current in amps
-        moduleCurrent       = MODULE_CURRENT_BASE + (module[index].mmc           * MODULE_CURRENT_FACTOR);
-
-       // Check for over current condition. Negative current flows out of battery, positive current flows into battery
-       // ALLOW FOR +/- 0.3A ACCURACY FROM MODULE?? ie. If current limit is zero and the module is reporting 0.25A then allow for this.
-       if(moduleCurrent - MODULE_CURRENT_TOLERANCE > moduleMaxChargeA){
-         module[index].faultCode.overCurrent = true;
-          if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - module charge current (%.2fA) exceeds specification (max %.2fA)",moduleCurrent, moduleMaxChargeA); serialOut(tempBuffer);}
-        } else if(moduleCurrent + MODULE_CURRENT_TOLERANCE < moduleMaxDischargeA) {
-          module[index].faultCode.overCurrent = true;
-          if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - module discharge current (%.2fA) exceeds specification (max %.2fA)",moduleCurrent, moduleMaxDischargeA); serialOut(tempBuffer);}
-        }
-        // have we now put the module into over current?
-       if(module[index].faultCode.overCurrent == true){
-          // are we in pre-charge (just the one module on)?
-          if (pack.vcuRequestedState == packPrecharge){
-            // ah crap - this was the first module on and its over current - go back and select another
-            pack.powerStatus.powerStage = stageSelectModule;
-          }
-        }
+  // fails until PC_STATE_INIT has configured the batch - nothing to drain before then
+  mcuRxPending = 0;
+  if(DRV_CANFDSPI_ReceiveBatchGet(&mcuRxBatch[fifo]) != 0)
+    mcuRxDraining = 0;
+}
 
-        totalCurrent = totalCurrent + moduleCurrent;
-        maxDischargeA      = maxDischargeA        + moduleMaxDischargeA;
-        maxChargeA         = maxChargeA           + moduleMaxChargeA;
-      }
-      // sum the maxCharge, maxDischarge currents, and average the maxChargeEndV, cellAvgVolt, cellAvgTemp
-      totalMaxChargeEndV = totalMaxChargeEndV   + module[index].maxChargeEndV;
-      totalAvgCellVolt   = totalAvgCellVolt     + module[index].cellAvgVolt;
-      totalAvgCellTemp   = totalAvgCellTemp     + module[index].cellAvgTemp;
-      // highest/lowest
-      if( module[index].soc < lowestSoc) lowestSoc = module[index].soc;
-      if( module[index].soh < lowestSoh) lowestSoh = module[index].soh;
-      if( module[index].cellLoVolt < lowestCellVolt){
-        lowestCellVolt  = module[index].cellLoVolt;
-        modLowestCellVolt = module[index].moduleId;
-      }
-      if( module[index].cellHiVolt > highestCellVolt){
-        highestCellVolt = module[index].cellHiVolt;
-        modHighestCellVolt = module[index].moduleId;
-      }
-      if( module[index].cellHiTemp > highestCellTemp){
-        highestCellTemp = module[index].cellHiTemp;
-        modHighestCellTemp = module[index].moduleId;
-      }
-      if( module[index].cellLoTemp < lowestCellTemp){
-        lowestCellTemp  = module[index].cellLoTemp;
-        modLowestCellTemp = module[index].moduleId;
-      }
-      activeModules++; // a module that is flagged overcurrent in the preceeeding code is still active atm until it gets sent the standby
-    }
-  }
-  // Pack active module count
-  pack.activeModules = activeModules;
+/***************************************************************************************************************
+*     M C U _ R x D r a i n N e x t                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_RxDrainNext(CANFDSPI_RX_BATCH* batch)
+{
+  canRxFrame_t* frame;
+  uint8_t index;
+  uint8_t fifo;
 
-  // Pack faulted module count
-  pack.faultedModules = pack.moduleCount - pack.activeModules;
+  // A broadcast status burst delivers three frames per module - count any frames the FIFO had to drop
+  if(batch->flags & CAN_RX_FIFO_OVERFLOW_EVENT)
+    mcuRxRing.overflows++;
 
-  // Pack Voltage and Current
-  if (modulesOn > 0){
-    pack.voltage = voltage / modulesOn;
-    //Check for max/min current out of range - set to min/max and flag error
-    if(totalCurrent > (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))){
-      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total current (%.2fA) exceeds specification (max %.2fA)",totalCurrent, (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))); serialOut(tempBuffer);}
-      totalCurrent = (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR));
-    }
-    else if(totalCurrent < PACK_CURRENT_BASE){
-      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total current (%.2fA) exceeds specification (max %dA)",totalCurrent, PACK_CURRENT_BASE); serialOut(tempBuffer);}
-      totalCurrent = PACK_CURRENT_BASE;
-    }
-    // value is now within limits
-    packCurrent = (totalCurrent/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
-    pack.current = (uint16_t) packCurrent;
+  // the FIFO is emptied even when the ring is full - a frame that finds no room is counted as a drop
+  for(index = 0; index < batch->count; index++){
+    frame = CanRxRing_Reserve(&mcuRxRing);
+    DRV_CANFDSPI_ReceiveBatchMessage(batch, index, &frame->obj, frame->data, MAX_DATA_BYTES);
+    CanRxRing_Commit(&mcuRxRing, frame);
+  }
 
-  }else{
-    pack.voltage = 0;
-    packCurrent = (0 / PACK_CURRENT_FACTOR) - (PACK_CURRENT_BASE / PACK_CURRENT_FACTOR); // 0 Amps converted.
-    pack.current = (uint16_t) packCurrent;
-  }
-
-  // Maximum Pack charge/discharge current and end voltage
-  if(maxChargeA > (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))){
-    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxChargeA (%.2fA) exceeds specification (max %.2fA)",maxChargeA, (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))); serialOut(tempBuffer);}
-    maxChargeA = (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR));
-  }else if(maxChargeA < PACK_CURRENT_BASE){
-    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxChargeA (%.2fA) exceeds specification (max %dA)",maxChargeA, PACK_CURRENT_BASE); serialOut(tempBuffer);}
-    maxChargeA = PACK_CURRENT_BASE;
-  }
-  // value is within limits
-  pack.maxChargeA = (maxChargeA/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
-
-  // Maximum Pack charge/discharge current and end voltage
-  if(maxDischargeA > (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))){
-    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxDischargeA (%.2fA) exceeds specification (max %.2fA)",maxDischargeA, (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))); serialOut(tempBuffer);}
-    maxDischargeA = (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR));
-  }else if(maxDischargeA < PACK_CURRENT_BASE){
-    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxDischargeA (%.2fA) exceeds specification (max %dA)",maxDischargeA, PACK_CURRENT_BASE); serialOut(tempBuffer);}
-    maxDischargeA = PACK_CURRENT_BASE;
-  }
-  // value is now within limits
-  pack.maxChargeA = (maxChargeA/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
-  pack.maxDischargeA = (maxDischargeA/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
-
-  if(pack.activeModules > 0) pack.maxChargeEndV = totalMaxChargeEndV / pack.activeModules;
-  else pack.maxChargeEndV = 0;
-
-  // Pack SOC = SOC of weakest module
-  if(pack.activeModules > 0 && lowestSoc < 255) pack.soc = lowestSoc;
-  else pack.soc = 0;
-
-  // Pack SOH = SOH of weakest module
-  if(pack.activeModules > 0 && lowestSoh < 255) pack.soh = lowestSoh;
-  else pack.soh = 0;
-
-  // Pack Cell Avg Volt
-  if(pack.activeModules > 0) pack.cellAvgVolt = totalAvgCellVolt / pack.activeModules;
-  else pack.cellAvgVolt = 0;
-
-  // Pack Hi/Lo Cell Volt
-  pack.cellHiVolt = highestCellVolt;
-  pack.modCellHiVolt = modHighestCellVolt;
-  if (lowestCellVolt < 65535){
-    pack.cellLoVolt = lowestCellVolt;
-    pack.modCellLoVolt = modLowestCellVolt;
-  }
-  else{
-    pack.cellLoVolt = 0;
-    pack.modCellLoVolt = 0;
-  }
-
-  // Pack Cell Avg Temp
-  if(pack.activeModules > 0) pack.cellAvgTemp = totalAvgCellTemp / pack.activeModules;
-  else pack.cellAvgTemp = 0; //-55 degrees!
-
-  // Pack Hi/Lo Cell Temp
-  pack.cellHiTemp = highestCellTemp;
-  pack.modCellHiTemp = modHighestCellTemp;
-  if (lowestCellTemp < 65535){
-    pack.cellLoTemp = lowestCellTemp;
-    pack.modCellLoTemp = modLowestCellTemp;
-  }
-  else{
-    pack.cellLoTemp = 0; //-55 degrees!
-    pack.modCellLoTemp = 0;
+  // a FIFO that had frames sends the chain back to the status FIFO, an empty one on to the next - it ends
+  // once every FIFO from there down was empty. A failed transfer ends it too, the main loop retries
+  fifo = (uint8_t)(batch - mcuRxBatch) + 1;
+  if(batch->count > 0 || mcuRxPending){
+    mcuRxPending = 0;
+    fifo = 0;
+  }
+  if(batch->status == 0 && fifo < MCU_RX_FIFOS){
+    if(DRV_CANFDSPI_ReceiveBatchGet(&mcuRxBatch[fifo]) == 0)
+      return;
   }
+  mcuRxDraining = 0;
 }
 
-
 /***************************************************************************************************************
 *     M C U _ R e c e i v e M e s s a g e s                                       P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
 void MCU_ReceiveMessages(void)
 {
+  const canRxFrame_t* frame;
+  uint32_t count;
+
+  // counters the drain keeps - report what changed since the last pass
+  count = mcuRxRing.overflows;
+  if(count != mcuRxOverflowsSeen){
+    pack.errorCounts.mcuRxOverflow += (uint16_t)(count - mcuRxOverflowsSeen);
+    mcuRxOverflowsSeen = count;
+    if((debugLevel & (DBG_MCU + DBG_ERRORS)) == (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - RX FIFO overflow (count=%d)", pack.errorCounts.mcuRxOverflow); serialOut(tempBuffer);}
+  }
+  count = mcuRxRing.drops;
+  if(count != mcuRxDropsSeen){
+    pack.errorCounts.mcuRxRingDrop += (uint16_t)(count - mcuRxDropsSeen);
+    mcuRxDropsSeen = count;
+    if((debugLevel & (DBG_MCU + DBG_ERRORS)) == (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - RX ring full (dropped=%d)", pack.errorCounts.mcuRxRingDrop); serialOut(tempBuffer);}
+  }
 
-  // Check if FIFO is not empty
-  DRV_CANFDSPI_ReceiveChannelEventGet(CAN2, MCU_RX_FIFO, &rxFlags);
-
-  while ( rxFlags & CAN_RX_FIFO_NOT_EMPTY_EVENT){
+  while((frame = CanRxRing_Peek(&mcuRxRing)) != NULL){
 
-    // Get message
-    DRV_CANFDSPI_ReceiveMessageGet(CAN2, MCU_RX_FIFO, &rxObj, rxd, MAX_DATA_BYTES);
+    // the handlers decode rxObj/rxd - copy the frame out and give the slot back to the drain
+    memcpy(&rxObj, &frame->obj, sizeof(rxObj));
+    memcpy(rxd, frame->data, sizeof(rxd));
+    CanRxRing_Release(&mcuRxRing);
 
     // Raw CAN message logging disabled - use specific message handlers
 
@@ -933,6 +878,10 @@ void MCU_ReceiveMessages(void)
         // Cell Information from module - process it
         MCU_ProcessCellDetail();
         break;
+      case ID_MODULE_CELL_PACKED:
+        // Several cell voltages or temperatures in one frame
+        MCU_ProcessCellPacked();
+        break;
       case ID_MODULE_HARDWARE:
         MCU_ProcessModuleHardware();
         break;
@@ -948,6 +897,14 @@ void MCU_ReceiveMessages(void)
         // Status packet from module - process it
         MCU_ProcessModuleStatus3();
         break;
+      case ID_MODULE_STATUS_FD:
+        // Status 1/2/3 in one CAN FD frame
+        MCU_ProcessModuleStatusFd();
+        break;
+      case ID_MODULE_CELL_FD:
+        // Cell voltages or temperatures in one CAN FD frame
+        MCU_ProcessCellFd();
+        break;
       case ID_MODULE_TIME_REQUEST:
         // Module is requesting time
         MCU_ProcessModuleTime();
@@ -961,43 +918,35 @@ void MCU_ReceiveMessages(void)
         ShowDebugMessage(MSG_UNKNOWN_CAN_ID, rxObj.bF.id.SID);
         break;
     }
-
-    // check for any more messages
-    DRV_CANFDSPI_ReceiveChannelEventGet(CAN2, MCU_RX_FIFO, &rxFlags);
   }
 }
 
 /***************************************************************************************************************
 *     M C U _ T r a n s m i t M e s s a g e Q u e u e                              P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
-void MCU_TransmitMessageQueue(CANFDSPI_MODULE_ID index)
+bool MCU_TransmitMessageQueue(uint8_t txClass)
 {
-    uint8_t attempts = MAX_TXQUEUE_ATTEMPTS;
-
-    // Check if FIFO is not full
-    do {
-      DRV_CANFDSPI_TransmitChannelEventGet(index, MCU_TX_FIFO, &txFlags);
-      if (attempts == 0) {
-        Nop();
-        Nop();
-        DRV_CANFDSPI_ErrorCountStateGet(index, &tec, &rec, &errorFlags);
-        ShowDebugMessage(MSG_TX_FIFO_ERROR, index, tec, rec, errorFlags);
-
-        //Flush channel
-        DRV_CANFDSPI_TransmitChannelFlush(index, MCU_TX_FIFO);
-
-        return;
-      }
-      attempts--;
-    }
-    while (!(txFlags & CAN_TX_FIFO_NOT_FULL_EVENT));
-
     // Load message and transmit
     uint8_t n = DRV_CANFDSPI_DlcToDataBytes(txObj.bF.ctrl.DLC);
-    
+
     // Raw CAN message logging disabled - use specific message handlers
 
-    DRV_CANFDSPI_TransmitChannelLoad(index, MCU_TX_FIFO, &txObj, txd, n, true);
+    // The frame waits in RAM until the TX FIFO has room - only a full class ring loses it
+    if (!CanTxQueue_Send(&mcuTxQueue, txClass, &txObj, txd, n)) {
+      pack.errorCounts.mcuTxDrop++;
+      DRV_CANFDSPI_ErrorCountStateGet(CAN2, &tec, &rec, &errorFlags);
+      ShowDebugMessage(MSG_TX_FIFO_ERROR, CAN2, tec, rec, errorFlags);
+      return false;
+    }
+    return true;
+}
+
+/***************************************************************************************************************
+*     M C U _ T x R e f i l l                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_TxRefill(void)
+{
+  CanTxQueue_Refill(&mcuTxQueue);
 }
 
 /***************************************************************************************************************
@@ -1015,25 +964,22 @@ void MCU_RegisterModule(void){
   ShowDebugMessage(ID_MODULE_ANNOUNCEMENT, announcement.moduleFw, announcement.moduleMfgId, announcement.modulePartId, announcement.moduleUniqueId);
 
   // Check if module already exists (registered or not)
-  moduleIndex = MAX_MODULES_PER_PACK; // Invalid index
-  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(module[index].uniqueId == announcement.moduleUniqueId){
-      moduleIndex = index;
-      break;
-    }
-  }
+  moduleIndex = MCU_ModuleIndexFromUid(announcement.moduleUniqueId);
 
   if(moduleIndex < MAX_MODULES_PER_PACK){
     // Existing module - just mark as registered
-    module[moduleIndex].isRegistered = true;
-    module[moduleIndex].faultCode.commsError = 0;
-    module[moduleIndex].lastContact.ticks = htim1.Instance->CNT;
-    module[moduleIndex].lastContact.overflows = etTimerOverflows;
+    moduleCtl.isRegistered[moduleIndex] = true;
+    moduleCtl.faultCode[moduleIndex].commsError = 0;
+    moduleCtl.lastContact[moduleIndex].ticks = htim1.Instance->CNT;
+    moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
+    moduleCtl.lastTimeout[moduleIndex] = moduleCtl.lastContact[moduleIndex];
     module[moduleIndex].consecutiveTimeouts = 0;  // Reset timeout counter on re-registration
     module[moduleIndex].statusMessagesReceived = 0;  // Reset status tracking
-    module[moduleIndex].statusPending = false;  // Start with false to allow polling
-    module[moduleIndex].waiting = false;  // Initialize waiting flag
+    moduleCtl.statusPending[moduleIndex] = false;  // Start with false to allow polling
+    moduleCtl.waiting[moduleIndex] = false;  // Initialize waiting flag
     module[moduleIndex].hardwarePending = true;  // Re-request hardware info
+    module[moduleIndex].canFd = false;  // Classic CAN until a status frame says otherwise
+    MCU_StatsModuleChanged(moduleIndex);
     
     // Update module counts
     MCU_UpdateModuleCounts();
@@ -1053,16 +999,19 @@ void MCU_RegisterModule(void){
       // Initialize new module
       module[moduleIndex].moduleId = moduleIndex + 1;  // ID = index + 1
       module[moduleIndex].uniqueId = announcement.moduleUniqueId;
-      module[moduleIndex].isRegistered = true;
+      MCU_ModuleUidAdd(moduleIndex);
+      moduleCtl.isRegistered[moduleIndex] = true;
       module[moduleIndex].fwVersion = announcement.moduleFw;
       module[moduleIndex].partId = announcement.modulePartId;
       module[moduleIndex].mfgId = announcement.moduleMfgId;
-      module[moduleIndex].lastContact.ticks = htim1.Instance->CNT;
-      module[moduleIndex].lastContact.overflows = etTimerOverflows;
-      module[moduleIndex].statusPending = false;  // Start with false to allow immediate polling
-      module[moduleIndex].waiting = false;  // Initialize waiting flag
+      moduleCtl.lastContact[moduleIndex].ticks = htim1.Instance->CNT;
+      moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
+      moduleCtl.lastTimeout[moduleIndex] = moduleCtl.lastContact[moduleIndex];
+      moduleCtl.statusPending[moduleIndex] = false;  // Start with false to allow immediate polling
+      moduleCtl.waiting[moduleIndex] = false;  // Initialize waiting flag
       module[moduleIndex].consecutiveTimeouts = 0;  // Initialize timeout counter for new module
       module[moduleIndex].statusMessagesReceived = 0;  // Initialize status tracking
+      module[moduleIndex].canFd = false;  // Classic CAN until a status frame says otherwise
       
       // Update module counts
       MCU_UpdateModuleCounts();
@@ -1102,7 +1051,7 @@ void MCU_RegisterModule(void){
   txObj.bF.ctrl.IDE = 1;                          // ID Extension selection - send base frame when cleared, extended frame when set
 
   ShowDebugMessage(ID_MODULE_REGISTRATION, registration.moduleId, registration.controllerId, registration.moduleMfgId, registration.modulePartId, registration.moduleUniqueId);
-  MCU_TransmitMessageQueue(CAN2);                     // Send it
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_POLL);        // Send it
   
   // Reset timeouts for all modules during registration (to account for polling delays)
   MCU_ResetAllModuleTimeouts();
@@ -1139,7 +1088,7 @@ void MCU_DeRegisterModule(uint8_t moduleId){
     txObj.bF.ctrl.IDE = 1;                          // ID Extension selection - send base frame when cleared, extended frame when set
 
     ShowDebugMessage(ID_MODULE_DEREGISTER, moduleId);
-    MCU_TransmitMessageQueue(CAN2);                  // Send it
+    MCU_TransmitMessageQueue(CAN_TX_CLASS_SAFETY);   // Send it
 }
 
 /***************************************************************************************************************
@@ -1168,12 +1117,12 @@ void MCU_DeRegisterAllModules(void){
     txObj.bF.ctrl.IDE = 1;                          // ID Extension selection - send base frame when cleared, extended frame when set
 
     ShowDebugMessage(ID_MODULE_ALL_DEREGISTER);
-    MCU_TransmitMessageQueue(CAN2);                     // Send it
+    MCU_TransmitMessageQueue(CAN_TX_CLASS_SAFETY);      // Send it
     
     // Mark all modules as unregistered locally
     for(int i = 0; i < MAX_MODULES_PER_PACK; i++){
         if(module[i].uniqueId != 0){
-            module[i].isRegistered = false;
+            moduleCtl.isRegistered[i] = false;
         }
     }
     
@@ -1208,7 +1157,7 @@ void MCU_IsolateAllModules(void){
   txObj.bF.ctrl.IDE = 1;                          // ID Extension selection - send base frame when cleared, extended frame when set
 
   ShowDebugMessage(ID_MODULE_ALL_ISOLATE);
-  MCU_TransmitMessageQueue(CAN2);                     // Send it
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_SAFETY);      // Send it
 }
 
 /***************************************************************************************************************
@@ -1242,7 +1191,7 @@ void MCU_RequestModuleAnnouncement(void){
   // This allows us to see new debug messages every 5 seconds when announcements are sent
   ResetDebugOnceOnly();
   
-  MCU_TransmitMessageQueue(CAN2);                  // Send it
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_POLL);     // Send it
 }
 
 /***************************************************************************************************************
@@ -1278,7 +1227,7 @@ void MCU_ProcessModuleTime(void){
   txObj.bF.ctrl.IDE = 1;                          // ID Extension selection - send base frame when cleared, extended frame when set
 
   ShowDebugMessage(ID_MODULE_SET_TIME);  // Simplified - just log that time was set
-  MCU_TransmitMessageQueue(CAN2);                     // Send it
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_POLL);        // Send it
 }
 
 
@@ -1289,16 +1238,9 @@ void MCU_RequestHardware(uint8_t moduleId){
 
   CANFRM_MODULE_HW_REQUEST hardwareRequest;
   uint8_t moduleIndex;
-  uint8_t index;
 
   //find the module index
-  moduleIndex = MAX_MODULES_PER_PACK;
-  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
-    //if(status.moduleId == module[index].moduleId)
-    if(moduleId == module[index].moduleId)
-      moduleIndex = index; // found it - save the index
-    }
+  moduleIndex = MCU_ModuleIndexFromId(moduleId);
   if (moduleIndex == MAX_MODULES_PER_PACK){
     // Unregistered module
     if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Unregistered module in MCU_RequestHardware()"); serialOut(tempBuffer);}
@@ -1327,7 +1269,7 @@ void MCU_RequestHardware(uint8_t moduleId){
     txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
 
     ShowDebugMessage(ID_MODULE_HARDWARE_REQUEST, moduleId);
-    MCU_TransmitMessageQueue(CAN2);                    // Send it
+    MCU_TransmitMessageQueue(CAN_TX_CLASS_POLL);       // Send it
   }
 }
 
@@ -1339,7 +1281,6 @@ void MCU_ProcessModuleHardware(void){
 
   CANFRM_MODULE_HARDWARE hardware;
   uint8_t moduleIndex;
-  uint8_t index;
   float moduleMaxChargeA;
   float moduleMaxDischargeA;
   float moduleMaxEndVoltage;
@@ -1350,13 +1291,7 @@ void MCU_ProcessModuleHardware(void){
   memcpy(&hardware, rxd, sizeof(hardware));
 
   //find the module index
-  moduleIndex = MAX_MODULES_PER_PACK;
-  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
-    //if(status.moduleId == module[index].moduleId)
-    if(rxObj.bF.id.EID == module[index].moduleId)
-      moduleIndex = index; // found it - save the index
-  }
+  moduleIndex = MCU_ModuleIndexFromId(rxObj.bF.id.EID);
 
   if (moduleIndex == MAX_MODULES_PER_PACK){
     // Unregistered module
@@ -1370,8 +1305,8 @@ void MCU_ProcessModuleHardware(void){
     module[moduleIndex].hwVersion     = hardware.hwVersion;
 
     // update last contact time
-    module[moduleIndex].lastContact.ticks     = htim1.Instance->CNT;
-    module[moduleIndex].lastContact.overflows = etTimerOverflows;
+    moduleCtl.lastContact[moduleIndex].ticks     = htim1.Instance->CNT;
+    moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
 
     // clear the hardware pending flag
     module[moduleIndex].hardwarePending = false;
@@ -1388,7 +1323,7 @@ void MCU_ProcessModuleHardware(void){
       module[moduleIndex].maxChargeA     = (0/MODULE_CURRENT_FACTOR) - (MODULE_CURRENT_BASE/MODULE_CURRENT_FACTOR);
       module[moduleIndex].maxDischargeA  = (0/MODULE_CURRENT_FACTOR) - (MODULE_CURRENT_BASE/MODULE_CURRENT_FACTOR);
       //Flag the module as incompatible and turn it off
-      module[moduleIndex].faultCode.hwIncompatible = true;
+      moduleCtl.faultCode[moduleIndex].hwIncompatible = true;
       MCU_TransmitState(module[moduleIndex].moduleId,moduleOff);
     }else if (moduleMaxChargeA > MODULE_MAX_CHARGE_A){
       // warning - value exceeds defaults - clip to defaults
@@ -1402,7 +1337,7 @@ void MCU_ProcessModuleHardware(void){
       module[moduleIndex].maxChargeA     = (0/MODULE_CURRENT_FACTOR) - (MODULE_CURRENT_BASE/MODULE_CURRENT_FACTOR);
       module[moduleIndex].maxDischargeA  = (0/MODULE_CURRENT_FACTOR) - (MODULE_CURRENT_BASE/MODULE_CURRENT_FACTOR);
       //Flag the module as incompatible and turn it off
-      module[moduleIndex].faultCode.hwIncompatible = true;
+      moduleCtl.faultCode[moduleIndex].hwIncompatible = true;
       MCU_TransmitState(module[moduleIndex].moduleId,moduleOff);
     } else if (moduleMaxDischargeA < MODULE_MAX_DISCHARGE_A) {
       // warning - value exceeds defaults - clip to defaults
@@ -1417,6 +1352,8 @@ void MCU_ProcessModuleHardware(void){
 
       ShowDebugMessage(ID_MODULE_HARDWARE, rxObj.bF.id.EID);
     }
+    // new limits, or the module is now incompatible
+    MCU_StatsModuleChanged(moduleIndex);
   }
 }
 
@@ -1424,30 +1361,19 @@ void MCU_ProcessModuleHardware(void){
 /***************************************************************************************************************
 *     M C U _ R e q u e s t M o d u l e S t a t u s                               P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
-void MCU_RequestModuleStatus(uint8_t moduleId){
+bool MCU_RequestModuleStatus(uint8_t moduleId){
 
   CANFRM_MODULE_STATUS_REQUEST statusRequest;
   uint8_t moduleIndex;
-  uint8_t index;
 
   //find the module index
-  moduleIndex = MAX_MODULES_PER_PACK;
-  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
-    //if(status.moduleId == module[index].moduleId)
-    if(moduleId == module[index].moduleId)
-      moduleIndex = index; // found it - save the index
-    }
+  moduleIndex = MCU_ModuleIndexFromId(moduleId);
   if (moduleIndex == MAX_MODULES_PER_PACK){
     // Unregistered module
     if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Unregistered module in MCU_RequestModuleStatus()"); serialOut(tempBuffer);}
+    return false;
   }else{
 
-    // set request flags
-    module[moduleIndex].statusPending = true;
-    module[moduleIndex].waiting = true;  // Set general waiting flag
-    module[moduleIndex].statusMessagesReceived = 0;  // Clear previous status bits
-
     // request cell detail packet for cell 0
     // Hardware MOB filtering now handles routing - moduleId in data is redundant
     // statusRequest.moduleId = moduleId;
@@ -1462,9 +1388,9 @@ void MCU_RequestModuleStatus(uint8_t moduleId){
     txObj.bF.id.SID = ID_MODULE_STATUS_REQUEST;    // Standard ID
     txObj.bF.id.EID = moduleId;                    // Extended ID
 
-    txObj.bF.ctrl.BRS = 0;                         // Bit Rate Switch - use DBR when set, NBR when cleared
+    txObj.bF.ctrl.BRS = pack.moduleBusFd;          // Bit Rate Switch - use DBR when set, NBR when cleared
     txObj.bF.ctrl.DLC = CAN_DLC_1;                 // 1 bytes to transmit
-    txObj.bF.ctrl.FDF = 0;                         // Frame Data Format - CAN FD when set, CAN 2.0 when cleared
+    txObj.bF.ctrl.FDF = pack.moduleBusFd;          // Frame Data Format - CAN FD when set, CAN 2.0 when cleared - FD request gets STATUS_FD
     txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
 
     // Use new debug message system for polling message
@@ -1473,15 +1399,70 @@ void MCU_RequestModuleStatus(uint8_t moduleId){
     // Debug: Explicitly show we're sending status request
     if(debugLevel & DBG_MCU){ 
       sprintf(tempBuffer,"MCU TX 0x514 Status Request to Module %02x (waiting=%d)", 
-              moduleId, module[moduleIndex].waiting); 
+              moduleId, moduleCtl.waiting[moduleIndex]); 
       serialOut(tempBuffer);
     }
     
-    MCU_TransmitMessageQueue(CAN2);                    // Send it
+    // a request the poll ring could not take was never sent - leave the module due so it is asked again
+    if(!MCU_TransmitMessageQueue(CAN_TX_CLASS_POLL)) return false;       // Send it
+
+    // set request flags
+    moduleCtl.statusPending[moduleIndex] = true;
+    moduleCtl.waiting[moduleIndex] = true;  // Set general waiting flag
+    module[moduleIndex].statusMessagesReceived = 0;  // Clear previous status bits
+    MCU_PollIssued(moduleIndex);  // occupies a slot in the polling window until Status1/2/3 arrive
     
     // Reset timeout when we request status from a module
     MCU_UpdateModuleContact(moduleIndex);
+    return true;
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ R e q u e s t A l l M o d u l e S t a t u s                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+bool MCU_RequestAllModuleStatus(void){
+
+  CANFRM_MODULE_STATUS_BROADCAST statusBroadcast;
+  static uint8_t sequence = 0;
+  uint32_t slots;
+  uint8_t index;
+
+  // module N replies (N-1) slots after it receives the request
+  statusBroadcast.slotWidth = pack.moduleBusFd ? MODULE_STATUS_SLOT_FD : MODULE_STATUS_SLOT_DEFAULT;
+  statusBroadcast.sequence  = sequence++;
+
+   // clear bit fields
+  txObj.word[0] = 0;                              // Configure transmit message
+  txObj.word[1] = 0;
+  txObj.word[2] = 0;
+
+  memcpy(txd, &statusBroadcast, sizeof(statusBroadcast));
+
+  txObj.bF.id.SID = ID_MODULE_STATUS_REQUEST;    // Standard ID
+  txObj.bF.id.EID = CAN_MODULE_ID_BROADCAST;     // Extended ID - broadcast to registered modules
+
+  txObj.bF.ctrl.BRS = pack.moduleBusFd;          // Bit Rate Switch - use DBR when set, NBR when cleared
+  txObj.bF.ctrl.DLC = CAN_DLC_2;                 // 2 bytes to transmit
+  txObj.bF.ctrl.FDF = pack.moduleBusFd;          // Frame Data Format - CAN FD when set, CAN 2.0 when cleared - FD request gets STATUS_FD
+  txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
+
+  ShowDebugMessage(ID_MODULE_STATUS_REQUEST, CAN_MODULE_ID_BROADCAST);
+  if(!MCU_TransmitMessageQueue(CAN_TX_CLASS_POLL)) return false;       // Send it
+
+  // every registered module answers a broadcast - mark them as waiting for Status1/2/3
+  for (slots = mcuSched.registeredMask; slots != 0; slots &= slots - 1){
+    index = __builtin_ctz(slots);
+    // still owed a reply from an earlier request - leave its timeout running
+    if(moduleCtl.statusPending[index] == true) continue;
+
+    moduleCtl.statusPending[index] = true;
+    moduleCtl.waiting[index] = true;
+    module[index].statusMessagesReceived = 0;
+    MCU_PollIssued(index);
+    MCU_UpdateModuleContact(index);
   }
+  return true;
 }
 
 
@@ -1499,8 +1480,8 @@ uint8_t MCU_FindMaxVoltageModule(void){
 
   //find the module index of the module with the highest mmv that is not in fault
   for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
-    if(module[index].mmv > maxVoltage && module[index].faultCode.commsError == false && module[index].faultCode.overCurrent == false && module[index].faultCode.hwIncompatible == false ){
+    if(!moduleCtl.isRegistered[index] || module[index].uniqueId == 0) continue;
+    if(module[index].mmv > maxVoltage && moduleCtl.faultCode[index].commsError == false && moduleCtl.faultCode[index].overCurrent == false && moduleCtl.faultCode[index].hwIncompatible == false ){
       maxVoltage = module[index].mmv;
       moduleId = module[index].moduleId;
       activeModules++;
@@ -1512,6 +1493,110 @@ uint8_t MCU_FindMaxVoltageModule(void){
 
 
 
+/***************************************************************************************************************
+*     M C U _ S t a t u s P a r t R e c e i v e d                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_StatusPartReceived(uint8_t moduleIndex, uint8_t part)
+{
+  // Track which status message was received - part 0 = Status1, 1 = Status2, 2 = Status3
+  module[moduleIndex].statusMessagesReceived |= (1 << part);
+
+  // Only publish and clear statusPending and waiting when all 3 received
+  if(module[moduleIndex].statusMessagesReceived == 0x07) {  // All 3 bits set
+    MCU_PublishModuleStatus(moduleIndex);
+    moduleCtl.statusPending[moduleIndex] = false;
+    moduleCtl.waiting[moduleIndex] = false;  // Clear general waiting flag
+    module[moduleIndex].statusMessagesReceived = 0;  // Reset for next time
+
+    if(moduleCtl.faultCode[moduleIndex].commsError == true){
+      // the module answered - bring it back online
+      moduleCtl.faultCode[moduleIndex].commsError = false;
+      MCU_StatsModuleChanged(moduleIndex);
+    }
+
+    if(moduleCtl.currentState[moduleIndex] ==  module[moduleIndex].command.commandedState){
+     // update the command status if the current state is equal to the commmanded state
+     module[moduleIndex].command.commandStatus = commandActive;
+    }
+
+    MCU_PollComplete(moduleIndex);  // leave the polling window and sample the latency
+    MCU_SchedUpdate(moduleIndex);  // next status request is now due from this contact
+  }
+
+  // Log timeout counter reset if it was non-zero
+  if(module[moduleIndex].consecutiveTimeouts > 0) {
+    ShowDebugMessage(MSG_TIMEOUT_RESET, module[moduleIndex].moduleId, module[moduleIndex].consecutiveTimeouts);
+  }
+  module[moduleIndex].consecutiveTimeouts = 0;  // Reset timeout counter on successful response
+}
+
+/***************************************************************************************************************
+*     M C U _ P u b l i s h M o d u l e S t a t u s                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PublishModuleStatus(uint8_t moduleIndex)
+{
+  batteryModule* pModule = &module[moduleIndex];
+  uint32_t now;
+
+  // sequence is odd while the copy is in progress - MCU_ModuleStatusSnapshot() retries until it reads a
+  // stable even value, so a reader never mixes two status sets even if this runs from an interrupt
+  pModule->statusSeq++;
+  MCU_DMB();
+  pModule->mmv           = pModule->staging.mmv;
+  pModule->mmc           = pModule->staging.mmc;
+  pModule->soc           = pModule->staging.soc;
+  pModule->soh           = pModule->staging.soh;
+  moduleCtl.currentState[moduleIndex] = pModule->staging.currentState;
+  pModule->status        = pModule->staging.status;
+  pModule->cellCount     = pModule->staging.cellCount;
+  pModule->cellAvgVolt   = pModule->staging.cellAvgVolt;
+  pModule->cellHiVolt    = pModule->staging.cellHiVolt;
+  pModule->cellLoVolt    = pModule->staging.cellLoVolt;
+  pModule->cellTotalVolt = pModule->staging.cellTotalVolt;
+  pModule->cellAvgTemp   = pModule->staging.cellAvgTemp;
+  pModule->cellHiTemp    = pModule->staging.cellHiTemp;
+  pModule->cellLoTemp    = pModule->staging.cellLoTemp;
+  MCU_DMB();
+  pModule->statusSeq++;
+
+  // the pack statistics pick up the new status on the next pass
+  MCU_StatsModuleChanged(moduleIndex);
+  now = MCU_Now();
+  MCU_SocModuleStatus(moduleIndex, &pModule->staging, now);
+  MCU_TelemRecord(moduleIndex, &pModule->staging, now);
+}
+
+/***************************************************************************************************************
+*     M C U _ M o d u l e S t a t u s S n a p s h o t                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_ModuleStatusSnapshot(uint8_t moduleIndex, moduleStatus* snapshot)
+{
+  batteryModule* pModule = &module[moduleIndex];
+  uint16_t seq;
+
+  // lock free read - copy again if a publish started or finished while we were copying
+  do{
+    seq = pModule->statusSeq;
+    MCU_DMB();
+    snapshot->mmv           = pModule->mmv;
+    snapshot->mmc           = pModule->mmc;
+    snapshot->soc           = pModule->soc;
+    snapshot->soh           = pModule->soh;
+    snapshot->currentState  = moduleCtl.currentState[moduleIndex];
+    snapshot->status        = pModule->status;
+    snapshot->cellCount     = pModule->cellCount;
+    snapshot->cellAvgVolt   = pModule->cellAvgVolt;
+    snapshot->cellHiVolt    = pModule->cellHiVolt;
+    snapshot->cellLoVolt    = pModule->cellLoVolt;
+    snapshot->cellTotalVolt = pModule->cellTotalVolt;
+    snapshot->cellAvgTemp   = pModule->cellAvgTemp;
+    snapshot->cellHiTemp    = pModule->cellHiTemp;
+    snapshot->cellLoTemp    = pModule->cellLoTemp;
+    MCU_DMB();
+  }while((seq & 1) || seq != pModule->statusSeq);
+}
+
+
 /***************************************************************************************************************
 *     M C U _ P r o c e s s M o d u l e S t a t u s 1                              P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
@@ -1541,39 +1626,20 @@ void MCU_ProcessModuleStatus1(void){
     // Unregistered module
     ShowDebugMessage(MSG_UNREGISTERED_MOD, rxObj.bF.id.EID);  // Use EID for module ID
   }else{
-    // Track which status message was received
-    module[moduleIndex].statusMessagesReceived |= (1 << 0);  // Status1 received
-    
-    // Only clear statusPending and waiting when all 3 received
-    if(module[moduleIndex].statusMessagesReceived == 0x07) {  // All 3 bits set
-        module[moduleIndex].statusPending = false;
-        module[moduleIndex].waiting = false;  // Clear general waiting flag
-        module[moduleIndex].statusMessagesReceived = 0;  // Reset for next time
-    }
-    
-    // Log timeout counter reset if it was non-zero
-    if(module[moduleIndex].consecutiveTimeouts > 0) {
-      ShowDebugMessage(MSG_TIMEOUT_RESET, module[moduleIndex].moduleId, module[moduleIndex].consecutiveTimeouts);
-    }
-    module[moduleIndex].consecutiveTimeouts = 0;  // Reset timeout counter on successful response
-
-    // save the data
-    module[moduleIndex].mmc           = status1.moduleMmc; //MODULE_CURRENT_BASE + (MODULE_CURRENT_FACTOR * status1.moduleMmc);
-    module[moduleIndex].mmv           = status1.moduleMmv; //MODULE_VOLTAGE_BASE + (MODULE_VOLTAGE_FACTOR * status1.moduleMmv);
-    module[moduleIndex].soc           = status1.moduleSoc; //PERCENTAGE_BASE + (PERCENTAGE_FACTOR * status1.moduleSoc);
-    module[moduleIndex].soh           = status1.moduleSoh; //PERCENTAGE_BASE + (PERCENTAGE_FACTOR * status1.moduleSoh);
-    module[moduleIndex].currentState  = status1.moduleState;
-    module[moduleIndex].status        = status1.moduleStatus;
-    module[moduleIndex].cellCount     = status1.cellCount;
+    // stage the data - readers only see it once Status2 and Status3 have arrived too
+    module[moduleIndex].staging.mmc           = status1.moduleMmc; //MODULE_CURRENT_BASE + (MODULE_CURRENT_FACTOR * status1.moduleMmc);
+    module[moduleIndex].staging.mmv           = status1.moduleMmv; //MODULE_VOLTAGE_BASE + (MODULE_VOLTAGE_FACTOR * status1.moduleMmv);
+    module[moduleIndex].staging.soc           = status1.moduleSoc; //PERCENTAGE_BASE + (PERCENTAGE_FACTOR * status1.moduleSoc);
+    module[moduleIndex].staging.soh           = status1.moduleSoh; //PERCENTAGE_BASE + (PERCENTAGE_FACTOR * status1.moduleSoh);
+    module[moduleIndex].staging.currentState  = status1.moduleState;
+    module[moduleIndex].staging.status        = status1.moduleStatus;
+    module[moduleIndex].staging.cellCount     = status1.cellCount;
 
     // update last contact time
-    module[moduleIndex].lastContact.ticks     = htim1.Instance->CNT;
-    module[moduleIndex].lastContact.overflows = etTimerOverflows;
+    moduleCtl.lastContact[moduleIndex].ticks     = htim1.Instance->CNT;
+    moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
 
-    if(module[moduleIndex].currentState ==  module[moduleIndex].command.commandedState){
-     // update the command status if the current state is equal to the commmanded state
-     module[moduleIndex].command.commandStatus = commandActive;
-    }
+    MCU_StatusPartReceived(moduleIndex, 0);
 
 
     if(debugLevel & DBG_MCU){
@@ -1586,11 +1652,11 @@ void MCU_ProcessModuleStatus1(void){
       char  strStatus[15];
 
       // State
-      switch (module[moduleIndex].currentState){
+      switch (moduleCtl.currentState[moduleIndex]){
         case 0   : sprintf(strState,"Off(0)"); break;  // both relays off
         case 1   : sprintf(strState,"Standby(1)"); break;  // mechanical on, FET off on all modules
         case 3   : sprintf(strState,"On(3)"); break;  // both relays on for all modules."
-        default  : sprintf(strState,"ERROR(%d)",module[moduleIndex].currentState); break;
+        default  : sprintf(strState,"ERROR(%d)",moduleCtl.currentState[moduleIndex]); break;
       }
       // Status
       switch (module[moduleIndex].status){
@@ -1642,31 +1708,17 @@ void MCU_ProcessModuleStatus2(void){
     // Unregistered module
     if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Unregistered module in MCU_ProcessModuleStatus2()"); serialOut(tempBuffer);}
   }else{
-    // Track which status message was received
-    module[moduleIndex].statusMessagesReceived |= (1 << 1);  // Status2 received
-    
-    // Only clear statusPending and waiting when all 3 received
-    if(module[moduleIndex].statusMessagesReceived == 0x07) {  // All 3 bits set
-        module[moduleIndex].statusPending = false;
-        module[moduleIndex].waiting = false;  // Clear general waiting flag
-        module[moduleIndex].statusMessagesReceived = 0;  // Reset for next time
-    }
-    
-    // Log timeout counter reset if it was non-zero
-    if(module[moduleIndex].consecutiveTimeouts > 0) {
-      ShowDebugMessage(MSG_TIMEOUT_RESET, module[moduleIndex].moduleId, module[moduleIndex].consecutiveTimeouts);
-    }
-    module[moduleIndex].consecutiveTimeouts = 0;  // Reset timeout counter on successful response
-
-    // save the data
-    module[moduleIndex].cellAvgVolt           = status2.cellAvgVolt;
-    module[moduleIndex].cellHiVolt            = status2.cellHiVolt;
-    module[moduleIndex].cellLoVolt            = status2.cellLoVolt;
-    module[moduleIndex].cellTotalVolt         = status2.cellTotalV;
+    // stage the data - readers only see it once Status1 and Status3 have arrived too
+    module[moduleIndex].staging.cellAvgVolt   = status2.cellAvgVolt;
+    module[moduleIndex].staging.cellHiVolt    = status2.cellHiVolt;
+    module[moduleIndex].staging.cellLoVolt    = status2.cellLoVolt;
+    module[moduleIndex].staging.cellTotalVolt = status2.cellTotalV;
 
     // update last contact time
-    module[moduleIndex].lastContact.ticks     = htim1.Instance->CNT;
-    module[moduleIndex].lastContact.overflows = etTimerOverflows;
+    moduleCtl.lastContact[moduleIndex].ticks     = htim1.Instance->CNT;
+    moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
+
+    MCU_StatusPartReceived(moduleIndex, 1);
 
     if(debugLevel & DBG_MCU){
 
@@ -1713,30 +1765,22 @@ void MCU_ProcessModuleStatus3(void){
     // Unregistered module
     if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Unregistered module in MCU_ProcessModuleStatus3()"); serialOut(tempBuffer);}
   }else{
-    // Track which status message was received
-    module[moduleIndex].statusMessagesReceived |= (1 << 2);  // Status3 received
-    
-    // Only clear statusPending and waiting when all 3 received
-    if(module[moduleIndex].statusMessagesReceived == 0x07) {  // All 3 bits set
-        module[moduleIndex].statusPending = false;
-        module[moduleIndex].waiting = false;  // Clear general waiting flag
-        module[moduleIndex].statusMessagesReceived = 0;  // Reset for next time
-    }
-    
-    // Log timeout counter reset if it was non-zero
-    if(module[moduleIndex].consecutiveTimeouts > 0) {
-      ShowDebugMessage(MSG_TIMEOUT_RESET, module[moduleIndex].moduleId, module[moduleIndex].consecutiveTimeouts);
+    // stage the data - readers only see it once Status1 and Status2 have arrived too
+    module[moduleIndex].staging.cellAvgTemp   = status3.cellAvgTemp;
+    module[moduleIndex].staging.cellHiTemp    = status3.cellHiTemp;
+    module[moduleIndex].staging.cellLoTemp    = status3.cellLoTemp;
+
+    if(module[moduleIndex].canFd != ((status3.hwCaps & MODULE_HW_CAP_CANFD) != 0)){
+      // FD capability changed - re-check the module bus mode
+      module[moduleIndex].canFd = !module[moduleIndex].canFd;
+      MCU_UpdateModuleCounts();
     }
-    module[moduleIndex].consecutiveTimeouts = 0;  // Reset timeout counter on successful response
-
-    // save the data
-    module[moduleIndex].cellAvgTemp           = status3.cellAvgTemp;
-    module[moduleIndex].cellHiTemp            = status3.cellHiTemp;
-    module[moduleIndex].cellLoTemp            = status3.cellLoTemp;
 
     // update last contact time
-    module[moduleIndex].lastContact.ticks     = htim1.Instance->CNT;
-    module[moduleIndex].lastContact.overflows = etTimerOverflows;
+    moduleCtl.lastContact[moduleIndex].ticks     = htim1.Instance->CNT;
+    moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
+
+    MCU_StatusPartReceived(moduleIndex, 2);
 
     if(debugLevel & DBG_MCU){
 
@@ -1755,6 +1799,30 @@ void MCU_ProcessModuleStatus3(void){
 }
 
 
+/***************************************************************************************************************
+*     M C U _ P r o c e s s M o d u l e S t a t u s F d                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_ProcessModuleStatusFd(void){
+
+  CANFRM_MODULE_STATUS_FD statusFd;
+
+  // a module may leave the reserved tail off - anything under 24 bytes is not a full status
+  if(DRV_CANFDSPI_DlcToDataBytes(rxObj.bF.ctrl.DLC) < (sizeof(statusFd.status1) + sizeof(statusFd.status2) + sizeof(statusFd.status3))){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Short STATUS_FD frame from module %02x (DLC=%d)", rxObj.bF.id.EID, rxObj.bF.ctrl.DLC); serialOut(tempBuffer);}
+    return;
+  }
+  memcpy(&statusFd, rxd, sizeof(statusFd));
+
+  // hand each part to the classic handler as if it had arrived on its own - the third one completes the poll
+  memcpy(rxd, &statusFd.status1, sizeof(statusFd.status1));
+  MCU_ProcessModuleStatus1();
+  memcpy(rxd, &statusFd.status2, sizeof(statusFd.status2));
+  MCU_ProcessModuleStatus2();
+  memcpy(rxd, &statusFd.status3, sizeof(statusFd.status3));
+  MCU_ProcessModuleStatus3();
+}
+
+
 /***************************************************************************************************************
 *     M C U _ P r o c e s s C e l l C o m m S t a t u s 1                          P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
@@ -1772,13 +1840,15 @@ void MCU_ProcessCellCommStatus1(void){
   
   if(moduleIndex < MAX_MODULES_PER_PACK){
     // Cell Status is valid communication - clear pending status and reset timeout
-    module[moduleIndex].statusPending = false;
+    moduleCtl.statusPending[moduleIndex] = false;
     module[moduleIndex].statusMessagesReceived = 0;
     module[moduleIndex].consecutiveTimeouts = 0;
     
     // Update last contact time
-    module[moduleIndex].lastContact.ticks = htim1.Instance->CNT;
-    module[moduleIndex].lastContact.overflows = etTimerOverflows;
+    moduleCtl.lastContact[moduleIndex].ticks = htim1.Instance->CNT;
+    moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
+    MCU_PollRelease(moduleIndex);
+    MCU_SchedUpdate(moduleIndex);
   }
 
   if(debugLevel & DBG_MCU){ 
@@ -1822,20 +1892,21 @@ void MCU_RequestCellDetail(uint8_t moduleId){
 
   CANFRM_MODULE_DETAIL_REQUEST detailRequest;
   uint8_t moduleIndex = MAX_MODULES_PER_PACK;
-  uint8_t index;
   
-  // Find module index
-  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(!module[index].isRegistered) continue;
-    if(moduleId == module[index].moduleId){
-      moduleIndex = index;
-      break;
-    }
+#ifdef MCU_USE_DETAIL_STREAM
+  // a CAN FD module returns every cell for one request - no need to stream
+  if(!pack.moduleBusFd){
+    MCU_RequestCellDetailStream(moduleId);
+    return;
   }
+#endif
+
+  // Find module index
+  moduleIndex = MCU_ModuleIndexFromId(moduleId);
   
   if(moduleIndex < MAX_MODULES_PER_PACK){
     // Set waiting flag
-    module[moduleIndex].waiting = true;
+    moduleCtl.waiting[moduleIndex] = true;
   }
 
   // request cell detail packet for cell 0
@@ -1853,9 +1924,9 @@ void MCU_RequestCellDetail(uint8_t moduleId){
   txObj.bF.id.SID = ID_MODULE_DETAIL_REQUEST;    // Standard ID
   txObj.bF.id.EID = moduleId;                    // Extended ID
 
-  txObj.bF.ctrl.BRS = 0;                         // Bit Rate Switch - use DBR when set, NBR when cleared
+  txObj.bF.ctrl.BRS = pack.moduleBusFd;          // Bit Rate Switch - use DBR when set, NBR when cleared
   txObj.bF.ctrl.DLC = CAN_DLC_3;                 // 3 bytes to transmit
-  txObj.bF.ctrl.FDF = 0;                         // Frame Data Format - CAN FD when set, CAN 2.0 when cleared
+  txObj.bF.ctrl.FDF = pack.moduleBusFd;          // Frame Data Format - CAN FD when set, CAN 2.0 when cleared - FD request gets CELL_FD
   txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
 
   ShowDebugMessage(MSG_CELL_DETAIL_REQ, moduleId);  // Simplified
@@ -1866,7 +1937,7 @@ void MCU_RequestCellDetail(uint8_t moduleId){
     serialOut(tempBuffer);
   }
 
-  MCU_TransmitMessageQueue(CAN2);                    // Send it
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_BULK);       // Send it
 }
 
 
@@ -1901,7 +1972,7 @@ void MCU_TransmitState(uint8_t moduleId, moduleState state){
   txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
 
   ShowDebugMessage(ID_MODULE_STATE_CHANGE, moduleId, state);
-  MCU_TransmitMessageQueue(CAN2);                    // Send it
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_SAFETY);     // Send it
 
   // Update commanded state and command status
   index = MCU_ModuleIndexFromId(moduleId);
@@ -1910,8 +1981,8 @@ void MCU_TransmitState(uint8_t moduleId, moduleState state){
     module[index].command.commandStatus   = commandIssued;
     module[index].lastTransmit.ticks      = htim1.Instance->CNT;
     module[index].lastTransmit.overflows  = etTimerOverflows;
-    // Reset timeout when we transmit TO a module
-    MCU_UpdateModuleContact(index);
+    // re-arm for the command retransmit - a transmit is not contact, so a lost status reply still times out
+    MCU_SchedUpdate(index);
   }
 }
 
@@ -1945,7 +2016,7 @@ void MCU_TransmitMaxState(moduleState state){
   txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
 
 //  if(debugLevel & DBG_MCU){ sprintf(tempBuffer,"MCU TX 0x517 Maximum Permissible State, STATE=%02x",state); serialOut(tempBuffer);}
-  MCU_TransmitMessageQueue(CAN2);                    // Send it
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_SAFETY);     // Send it
 
   /*
   // Update commanded state and command status
@@ -1961,6 +2032,39 @@ void MCU_TransmitMaxState(moduleState state){
   */
 }
 
+/***************************************************************************************************************
+*     M C U _ T r a n s m i t C e l l B a l a n c e                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_TransmitCellBalance(uint8_t moduleId, uint8_t firstCell, uint64_t cellMask){
+
+  // Bit n of cellMask set = bleed cell firstCell + n. The module stops by itself after 'duration'
+  // seconds, so the planner repeats the mask while the cells still need it.
+
+  CANFRM_MODULE_CELL_BALANCE cellBalance;
+
+  cellBalance.firstCell  = firstCell;
+  cellBalance.duration   = MCU_BALANCE_DURATION;
+  cellBalance.cellMaskLo = (uint16_t)cellMask;
+  cellBalance.cellMaskHi = (uint32_t)(cellMask >> 16);
+
+   // clear bit fields
+  txObj.word[0] = 0;                              // Configure transmit message
+  txObj.word[1] = 0;
+  txObj.word[2] = 0;
+
+  memcpy(txd, &cellBalance, sizeof(cellBalance));
+
+  txObj.bF.id.SID = ID_MODULE_CELL_BALANCE;      // Standard ID
+  txObj.bF.id.EID = moduleId;                    // Extended ID
+
+  txObj.bF.ctrl.BRS = 0;                         // Bit Rate Switch - use DBR when set, NBR when cleared
+  txObj.bF.ctrl.DLC = CAN_DLC_8;                 // 8 bytes to transmit
+  txObj.bF.ctrl.FDF = 0;                         // Frame Data Format - CAN FD when set, CAN 2.0 when cleared
+  txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
+
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_BULK);       // Send it
+}
+
 /***************************************************************************************************************
 *     M C U _ P r o c e s s C e l l D e t a i l                                    P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
@@ -1969,7 +2073,7 @@ void MCU_ProcessCellDetail(void){
   CANFRM_MODULE_DETAIL_REQUEST detailRequest;
   CANFRM_MODULE_DETAIL cellDetail;
   uint8_t moduleIndex = 0;
-  uint8_t index;
+  batteryCell* cell;
 
 
   // copy data to announcement structure
@@ -1984,13 +2088,7 @@ void MCU_ProcessCellDetail(void){
   }
 
   //check whether the module is already registered and perhaps lost its registration
-  moduleIndex = MAX_MODULES_PER_PACK; //default the index to the next entry (we are using 0 so next index is the moduleCount)
-  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-    if(!module[index].isRegistered || module[index].uniqueId == 0) continue;
-    //if(cellDetail.moduleId == module[index].moduleId)
-    if(rxObj.bF.id.EID == module[index].moduleId)
-      moduleIndex = index; // module is already registered, save the index
-  }
+  moduleIndex = MCU_ModuleIndexFromId(rxObj.bF.id.EID);
   
   if (moduleIndex == MAX_MODULES_PER_PACK){
     // Unregistered module
@@ -1998,15 +2096,29 @@ void MCU_ProcessCellDetail(void){
     return;
   }
   
-  // store the details
-  module[moduleIndex].cellCount = cellDetail.cellCount;
-  module[moduleIndex].cell[cellDetail.cellId].soc = cellDetail.cellSoc;
-  module[moduleIndex].cell[cellDetail.cellId].soh = cellDetail.cellSoh;
-  module[moduleIndex].cell[cellDetail.cellId].temp = cellDetail.cellTemp;
-  module[moduleIndex].cell[cellDetail.cellId].voltage= cellDetail.cellVoltage;
+  if (cellDetail.cellId >= MAX_CELLS_PER_MODULE){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Cell ID %d out of range in MCU_ProcessCellDetail()", cellDetail.cellId); serialOut(tempBuffer);}
+    return;
+  }
 
-  module[moduleIndex].lastContact.ticks = htim1.Instance->CNT;
-  module[moduleIndex].lastContact.overflows = etTimerOverflows;
+  // store the details - the block is sized by the cell count in the frame, the published
+  // module cellCount stays with the status publish
+  cell = MCU_CellsAlloc(moduleIndex, cellDetail.cellCount);
+  if(cell != NULL && cellDetail.cellId < mcuCells.count[moduleIndex]){
+    cell[cellDetail.cellId].soc = cellDetail.cellSoc;
+    cell[cellDetail.cellId].soh = cellDetail.cellSoh;
+    cell[cellDetail.cellId].temp = cellDetail.cellTemp;
+    cell[cellDetail.cellId].voltage= cellDetail.cellVoltage;
+  }
+
+  moduleCtl.lastContact[moduleIndex].ticks = htim1.Instance->CNT;
+  moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
+
+  // streamed cells arrive unrequested - just track the window
+  if(mcuDetailStream.active && mcuDetailStream.moduleIndex == moduleIndex){
+    MCU_DetailStreamCell(cellDetail.cellId, cellDetail.cellCount);
+    return;
+  }
 
   // request the next cell detail packet
   if (cellDetail.cellId < (cellDetail.cellCount -1)){
@@ -2035,23 +2147,304 @@ void MCU_ProcessCellDetail(void){
               rxObj.bF.id.EID, detailRequest.cellId); 
       serialOut(tempBuffer);
     }
-    MCU_TransmitMessageQueue(CAN2);                     // Send it
+    MCU_TransmitMessageQueue(CAN_TX_CLASS_BULK);        // Send it
   }
   else {
     // We've received all cells, clear the waiting flag
-    module[moduleIndex].waiting = false;
+    moduleCtl.waiting[moduleIndex] = false;
+    MCU_CellStatsModuleChanged(moduleIndex);
   }
 }
 
+/***************************************************************************************************************
+*     M C U _ P r o c e s s C e l l P a c k e d                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_ProcessCellPacked(void){
+
+  uint16_t values[CELL_PACK_MAX_CELLS];
+  uint8_t  moduleIndex;
+  uint8_t  firstCell;
+  uint8_t  cells;
+  uint8_t  index;
+  uint16_t cellId;
+  batteryCell* cell;
+
+  // the extended ID carries the module, the first cell and whether these are voltages or temperatures
+  moduleIndex = MCU_ModuleIndexFromId(CellPack_ModuleId(rxObj.bF.id.EID));
+  if(moduleIndex >= MAX_MODULES_PER_PACK || !moduleCtl.isRegistered[moduleIndex]){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Unregistered module in MCU_ProcessCellPacked()"); serialOut(tempBuffer);}
+    return;
+  }
+
+  cells = CellPack_Decode(rxd, DRV_CANFDSPI_DlcToDataBytes(rxObj.bF.ctrl.DLC), values);
+  if(cells == 0){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Bad packed cell frame length (DLC=%d)", rxObj.bF.ctrl.DLC); serialOut(tempBuffer);}
+    return;
+  }
+
+  // packed frames carry no total - size the block by the cell count in the module status
+  cell = MCU_CellsAlloc(moduleIndex, module[moduleIndex].cellCount);
+  firstCell = CellPack_FirstCell(rxObj.bF.id.EID);
+  for(index = 0; cell != NULL && index < cells; index++){
+    cellId = firstCell + index;
+    if(cellId >= mcuCells.count[moduleIndex]) break;
+    if(CellPack_Kind(rxObj.bF.id.EID) == CELL_PACK_VOLTAGE)
+      cell[cellId].voltage = values[index];
+    else
+      cell[cellId].temp = values[index];
+  }
+
+  // temperatures follow the voltages - the frame carrying the last temperature completes the set
+  if(cell != NULL && CellPack_Kind(rxObj.bF.id.EID) == CELL_PACK_TEMPERATURE && firstCell + cells >= mcuCells.count[moduleIndex]){
+    MCU_CellStatsModuleChanged(moduleIndex);
+  }
+
+  // EID is not a plain module ID for this frame, so MCU_ReceiveMessages() did not count it as contact
+  MCU_UpdateModuleContact(moduleIndex);
+}
+
+/***************************************************************************************************************
+*     M C U _ P r o c e s s C e l l F d                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_ProcessCellFd(void){
+
+  CANFRM_MODULE_CELL_FD cellFd;
+  uint8_t  moduleIndex;
+  uint8_t  cells;
+  uint8_t  index;
+  uint16_t cellId;
+  batteryCell* cell;
+
+  memset(&cellFd, 0, sizeof(cellFd));
+  memcpy(&cellFd, rxd, DRV_CANFDSPI_DlcToDataBytes(rxObj.bF.ctrl.DLC));
+
+  moduleIndex = MCU_ModuleIndexFromId(rxObj.bF.id.EID);
+  if(moduleIndex >= MAX_MODULES_PER_PACK || !moduleCtl.isRegistered[moduleIndex]){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Unregistered module in MCU_ProcessCellFd()"); serialOut(tempBuffer);}
+    return;
+  }
+
+  // never trust the count beyond what the DLC actually carried
+  cells = cellFd.cellCount;
+  if(cells > CELL_FD_MAX_CELLS) cells = CELL_FD_MAX_CELLS;
+  if(DRV_CANFDSPI_DlcToDataBytes(rxObj.bF.ctrl.DLC) < 4 + (2 * cells)){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Short CAN FD cell frame (DLC=%d, cells=%d)", rxObj.bF.ctrl.DLC, cellFd.cellCount); serialOut(tempBuffer);}
+    return;
+  }
+
+  cell = MCU_CellsAlloc(moduleIndex, cellFd.totalCells);
+  for(index = 0; cell != NULL && index < cells; index++){
+    cellId = cellFd.firstCell + index;
+    if(cellId >= mcuCells.count[moduleIndex]) break;
+    if(cellFd.kind == CELL_FD_VOLTAGE)
+      cell[cellId].voltage = cellFd.value[index];
+    else
+      cell[cellId].temp = cellFd.value[index];
+  }
+
+  if(debugLevel & DBG_MCU){
+    sprintf(tempBuffer,"MCU RX 0x50C Cell FD: Module=%02x, %s cells %d-%d of %d", rxObj.bF.id.EID,
+            cellFd.kind == CELL_FD_VOLTAGE ? "Voltage" : "Temperature", cellFd.firstCell, cellFd.firstCell + cells - 1, cellFd.totalCells);
+    serialOut(tempBuffer);
+  }
+
+  // temperatures follow the voltages - the last temperature frame ends the request
+  if(cellFd.kind == CELL_FD_TEMPERATURE && (cellFd.firstCell + cells) >= cellFd.totalCells){
+    moduleCtl.waiting[moduleIndex] = false;
+    MCU_CellStatsModuleChanged(moduleIndex);
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ R e q u e s t C e l l D e t a i l S t r e a m                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_RequestCellDetailStream(uint8_t moduleId){
+
+  CANFRM_MODULE_DETAIL_STREAM_REQUEST streamRequest;
+  uint8_t moduleIndex;
+
+  moduleIndex = MCU_ModuleIndexFromId(moduleId);
+  if(moduleIndex >= MAX_MODULES_PER_PACK || !moduleCtl.isRegistered[moduleIndex]) return;
+
+  // one stream at a time - the windows of two modules would compete for the RX FIFO
+  if(mcuDetailStream.active){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Cell detail stream busy with module %02x", module[mcuDetailStream.moduleIndex].moduleId); serialOut(tempBuffer);}
+    return;
+  }
+
+  mcuDetailStream.active      = true;
+  mcuDetailStream.moduleIndex = moduleIndex;
+  mcuDetailStream.transferId++;
+  mcuDetailStream.windowBase  = 0;
+  mcuDetailStream.windowSize  = MCU_DETAIL_WINDOW_SIZE;
+  mcuDetailStream.bitmap      = 0;
+  mcuDetailStream.cellCount   = 0;
+  mcuDetailStream.retries     = 0;
+  mcuDetailStream.started.ticks     = htim1.Instance->CNT;
+  mcuDetailStream.started.overflows = etTimerOverflows;
+  mcuDetailStream.lastRx      = mcuDetailStream.started;
+
+  moduleCtl.waiting[moduleIndex] = true;
+
+  streamRequest.firstCell    = 0;
+  streamRequest.windowSize   = mcuDetailStream.windowSize;
+  streamRequest.transferId   = mcuDetailStream.transferId;
+  streamRequest.UNUSED_24_31 = 0;
+
+   // clear bit fields
+  txObj.word[0] = 0;                              // Configure transmit message
+  txObj.word[1] = 0;
+  txObj.word[2] = 0;
+
+  memcpy(txd, &streamRequest, sizeof(streamRequest));
+
+  txObj.bF.id.SID = ID_MODULE_DETAIL_STREAM_REQUEST; // Standard ID
+  txObj.bF.id.EID = moduleId;                    // Extended ID
+
+  txObj.bF.ctrl.BRS = 0;                         // Bit Rate Switch - use DBR when set, NBR when cleared
+  txObj.bF.ctrl.DLC = CAN_DLC_4;                 // 4 bytes to transmit
+  txObj.bF.ctrl.FDF = 0;                         // Frame Data Format - CAN FD when set, CAN 2.0 when cleared
+  txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
+
+  ShowDebugMessage(MSG_CELL_DETAIL_REQ, moduleId);
+
+  if(debugLevel & DBG_MCU){
+    sprintf(tempBuffer,"MCU TX 0x519 Cell detail stream: Module=%02x, Window=%d, Transfer=%d",
+            moduleId, mcuDetailStream.windowSize, mcuDetailStream.transferId);
+    serialOut(tempBuffer);
+  }
+
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_BULK);       // Send it
+}
+
+/***************************************************************************************************************
+*     M C U _ S e n d D e t a i l W i n d o w A c k                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_SendDetailWindowAck(uint8_t status){
+
+  CANFRM_MODULE_DETAIL_WINDOW_ACK windowAck;
+
+  windowAck.transferId   = mcuDetailStream.transferId;
+  windowAck.windowBase   = mcuDetailStream.windowBase;
+  windowAck.bitmap       = mcuDetailStream.bitmap;
+  windowAck.status       = status;
+  windowAck.UNUSED_40_63 = 0;
+
+   // clear bit fields
+  txObj.word[0] = 0;                              // Configure transmit message
+  txObj.word[1] = 0;
+  txObj.word[2] = 0;
+
+  memcpy(txd, &windowAck, sizeof(windowAck));
+
+  txObj.bF.id.SID = ID_MODULE_DETAIL_WINDOW_ACK; // Standard ID
+  txObj.bF.id.EID = module[mcuDetailStream.moduleIndex].moduleId; // Extended ID
+
+  txObj.bF.ctrl.BRS = 0;                         // Bit Rate Switch - use DBR when set, NBR when cleared
+  txObj.bF.ctrl.DLC = CAN_DLC_5;                 // 5 bytes to transmit
+  txObj.bF.ctrl.FDF = 0;                         // Frame Data Format - CAN FD when set, CAN 2.0 when cleared
+  txObj.bF.ctrl.IDE = 1;                         // ID Extension selection - send base frame when cleared, extended frame when set
+
+  MCU_TransmitMessageQueue(CAN_TX_CLASS_BULK);       // Send it
+}
+
+/***************************************************************************************************************
+*     M C U _ D e t a i l S t r e a m C e l l                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_DetailStreamCell(uint8_t cellId, uint8_t cellCount){
+
+  uint8_t  windowCells;
+  uint16_t windowMask;
+  uint8_t  moduleIndex = mcuDetailStream.moduleIndex;
+
+  if(mcuDetailStream.cellCount == 0){
+    // first frame of the transfer tells us how many cells to expect
+    if(cellCount == 0 || cellCount > MAX_CELLS_PER_MODULE){
+      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Cell detail stream from module %02x reports %d cells", module[moduleIndex].moduleId, cellCount); serialOut(tempBuffer);}
+      MCU_SendDetailWindowAck(DETAIL_ACK_ABORT);
+      mcuDetailStream.active = false;
+      moduleCtl.waiting[moduleIndex] = false;
+      return;
+    }
+    mcuDetailStream.cellCount = cellCount;
+  }
+
+  mcuDetailStream.lastRx.ticks     = htim1.Instance->CNT;
+  mcuDetailStream.lastRx.overflows = etTimerOverflows;
+
+  // late retransmits from an earlier window were already stored - nothing to track
+  if(cellId < mcuDetailStream.windowBase || cellId >= mcuDetailStream.windowBase + mcuDetailStream.windowSize) return;
+  mcuDetailStream.bitmap |= (1U << (cellId - mcuDetailStream.windowBase));
+
+  windowCells = mcuDetailStream.cellCount - mcuDetailStream.windowBase;
+  if(windowCells > mcuDetailStream.windowSize) windowCells = mcuDetailStream.windowSize;
+  windowMask = (1UL << windowCells) - 1;
+  if((mcuDetailStream.bitmap & windowMask) != windowMask) return;
+
+  // window complete - acknowledge it, which releases the next one
+  MCU_SendDetailWindowAck(DETAIL_ACK_OK);
+  mcuDetailStream.retries = 0;
+
+  if(mcuDetailStream.windowBase + windowCells >= mcuDetailStream.cellCount){
+    // last window - the transfer is done
+    mcuDetailStream.active = false;
+    mcuDetailStream.lastDuration = MCU_ElapsedTicks(&mcuDetailStream.started);
+    moduleCtl.waiting[moduleIndex] = false;
+    MCU_CellStatsModuleChanged(moduleIndex);
+    if(debugLevel & DBG_MCU){
+      sprintf(tempBuffer,"MCU Cell detail stream complete: Module=%02x, Cells=%d, Time=%lums",
+              module[moduleIndex].moduleId, mcuDetailStream.cellCount, (unsigned long)mcuDetailStream.lastDuration);
+      serialOut(tempBuffer);
+    }
+    return;
+  }
+
+  mcuDetailStream.windowBase += mcuDetailStream.windowSize;
+  mcuDetailStream.bitmap = 0;
+}
+
+/***************************************************************************************************************
+*     M C U _ C h e c k C e l l D e t a i l S t r e a m                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_CheckCellDetailStream(void){
+
+  uint8_t moduleIndex = mcuDetailStream.moduleIndex;
+
+  if(!mcuDetailStream.active) return;
+
+  // module went away mid transfer
+  if(!moduleCtl.isRegistered[moduleIndex]){
+    mcuDetailStream.active = false;
+    return;
+  }
+
+  if(MCU_ElapsedTicks(&mcuDetailStream.lastRx) <= MCU_DETAIL_WINDOW_TIMEOUT) return;
+
+  if(mcuDetailStream.retries >= MCU_DETAIL_MAX_RETRIES){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Cell detail stream from module %02x stalled at cell %d - aborting", module[moduleIndex].moduleId, mcuDetailStream.windowBase); serialOut(tempBuffer);}
+    MCU_SendDetailWindowAck(DETAIL_ACK_ABORT);
+    mcuDetailStream.active = false;
+    moduleCtl.waiting[moduleIndex] = false;
+    return;
+  }
+
+  // ask for the cells of this window that have not arrived
+  mcuDetailStream.retries++;
+  MCU_SendDetailWindowAck(DETAIL_ACK_RETRY);
+  mcuDetailStream.lastRx.ticks     = htim1.Instance->CNT;
+  mcuDetailStream.lastRx.overflows = etTimerOverflows;
+}
+
 /***************************************************************************************************************
 *     M C U _ U p d a t e M o d u l e C o n t a c t                              P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
 void MCU_UpdateModuleContact(uint8_t moduleIndex)
 {
-    if(moduleIndex < MAX_MODULES_PER_PACK && module[moduleIndex].isRegistered){
-        module[moduleIndex].lastContact.ticks = htim1.Instance->CNT;
-        module[moduleIndex].lastContact.overflows = etTimerOverflows;
+    if(moduleIndex < MAX_MODULES_PER_PACK && moduleCtl.isRegistered[moduleIndex]){
+        moduleCtl.lastContact[moduleIndex].ticks = htim1.Instance->CNT;
+        moduleCtl.lastContact[moduleIndex].overflows = etTimerOverflows;
         module[moduleIndex].consecutiveTimeouts = 0;  // Reset timeout counter on any contact
+        MCU_SchedUpdate(moduleIndex);
     }
 }
 
@@ -2061,10 +2454,11 @@ void MCU_UpdateModuleContact(uint8_t moduleIndex)
 void MCU_ResetAllModuleTimeouts(void)
 {
     for(int i = 0; i < MAX_MODULES_PER_PACK; i++){
-        if(module[i].isRegistered && module[i].uniqueId != 0){
-            module[i].lastContact.ticks = htim1.Instance->CNT;
-            module[i].lastContact.overflows = etTimerOverflows;
+        if(moduleCtl.isRegistered[i] && module[i].uniqueId != 0){
+            moduleCtl.lastContact[i].ticks = htim1.Instance->CNT;
+            moduleCtl.lastContact[i].overflows = etTimerOverflows;
             // Don't reset consecutiveTimeouts here - only on actual contact
+            MCU_SchedUpdate(i);
         }
     }
 }
@@ -2074,18 +2468,50 @@ void MCU_ResetAllModuleTimeouts(void)
 ***************************************************************************************************************/
 uint8_t MCU_ModuleIndexFromId(uint8_t moduleId)
 {
-   uint8_t moduleIndex;
-   uint8_t index;
-
-   //find the module index
-   moduleIndex = MAX_MODULES_PER_PACK;
-   for(index = 0; index < MAX_MODULES_PER_PACK; index++){
-     if(moduleId == module[index].moduleId && module[index].isRegistered)
-       moduleIndex = index; // found it - save the index
-     }
-   if (moduleIndex != MAX_MODULES_PER_PACK) return moduleIndex;
-   else return MAX_MODULES_PER_PACK; // unregistered module
+   // ids past the table are never handed out - unregistered module
+   if(moduleId > MAX_MODULES_PER_PACK) return MAX_MODULES_PER_PACK;
+   return mcuLookup.indexById[moduleId];
+}
+
+/***************************************************************************************************************
+*     M C U _ M o d u l e U i d H a s h                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint8_t MCU_ModuleUidHash(uint32_t uniqueId)
+{
+  // multiplicative hash - the top bits mix every bit of the id, serial numbers differ in the low ones
+  return (uint8_t)((uniqueId * 2654435761UL) >> 26) & (MCU_UID_HASH_SLOTS - 1);
+}
+
+/***************************************************************************************************************
+*     M C U _ M o d u l e I n d e x F r o m U i d                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint8_t MCU_ModuleIndexFromUid(uint32_t uniqueId)
+{
+  uint8_t hash = MCU_ModuleUidHash(uniqueId);
+  uint8_t entry;
+
+  // 0 marks an empty slot, never a module
+  if(uniqueId == 0) return MAX_MODULES_PER_PACK;
 
+  while((entry = mcuLookup.uidSlot[hash]) != 0){
+    if(module[entry - 1].uniqueId == uniqueId) return entry - 1;
+    hash = (hash + 1) & (MCU_UID_HASH_SLOTS - 1);
+  }
+  return MAX_MODULES_PER_PACK; // never announced
+}
+
+/***************************************************************************************************************
+*     M C U _ M o d u l e U i d A d d                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_ModuleUidAdd(uint8_t moduleIndex)
+{
+  uint8_t hash = MCU_ModuleUidHash(module[moduleIndex].uniqueId);
+
+  if(module[moduleIndex].uniqueId == 0) return;
+
+  // at most MAX_MODULES_PER_PACK of the entries are in use - there is always an empty one
+  while(mcuLookup.uidSlot[hash] != 0) hash = (hash + 1) & (MCU_UID_HASH_SLOTS - 1);
+  mcuLookup.uidSlot[hash] = moduleIndex + 1;
 }
 
 /***************************************************************************************************************
@@ -2093,19 +2519,56 @@ uint8_t MCU_ModuleIndexFromId(uint8_t moduleId)
 ***************************************************************************************************************/
 void MCU_UpdateModuleCounts(void)
 {
+    uint8_t  fdModules = 0;
+    bool     busFd = false;
+    uint32_t oldRegisteredMask = mcuSched.registeredMask;
+
     pack.totalModules = 0;
     pack.activeModules = 0;
     pack.moduleCount = 0;  // Keep for compatibility
+    mcuSched.registeredMask = 0;
+    memset(mcuLookup.indexById, MAX_MODULES_PER_PACK, sizeof(mcuLookup.indexById));
     
     for(int i = 0; i < MAX_MODULES_PER_PACK; i++){
         if(module[i].uniqueId != 0){
             pack.totalModules++;
-            if(module[i].isRegistered){
+            if(moduleCtl.isRegistered[i]){
                 pack.activeModules++;
                 pack.moduleCount++;  // Keep for compatibility
+                mcuSched.registeredMask |= (1UL << i);
+                if(module[i].moduleId <= MAX_MODULES_PER_PACK) mcuLookup.indexById[module[i].moduleId] = i;
+                if(module[i].canFd) fdModules++;
+                continue;
             }
         }
+        // no longer registered - drop it from the scheduler and the polling window, give back its cells
+        MCU_SchedRemove(i);
+        MCU_PollRelease(i);
+        MCU_CellsRelease(i);
+        // a module registering into this slot later starts from the normal poll rate
+        mcuPoll.interval[i] = MCU_POLL_INTERVAL_NORMAL;
+        mcuPoll.lastSample[i] = 0;
+    }
+#ifdef MCU_USE_CANFD
+    // one classic CAN module on the bus would flag every FD frame as an error - all or nothing
+    busFd = (pack.activeModules > 0 && fdModules == pack.activeModules);
+#endif
+    if(busFd != pack.moduleBusFd){
+        pack.moduleBusFd = busFd;
+        if(debugLevel & DBG_MCU){ sprintf(tempBuffer,"MCU - Module bus %s (%d of %d modules FD capable)", busFd ? "CAN FD" : "classic CAN", fdModules, pack.activeModules); serialOut(tempBuffer);}
     }
+    mcuPoll.pollCost = pack.moduleBusFd ? MCU_POLL_COST_FD_US : MCU_POLL_COST_US;
+
+    // the set of modules being polled changed - re-check the bus load budget
+    MCU_PollBudget();
+
+    // modules entering or leaving service move the pack statistics, and activeModules above is only
+    // the registered count until they are derived again
+    MCU_StatsModulesChanged(oldRegisteredMask ^ mcuSched.registeredMask);
+    MCU_CellStatsModulesChanged(oldRegisteredMask ^ mcuSched.registeredMask);
+    MCU_BalanceModulesChanged(oldRegisteredMask ^ mcuSched.registeredMask);
+    MCU_SocModulesChanged(oldRegisteredMask ^ mcuSched.registeredMask);
+    MCU_TelemModulesJoined(mcuSched.registeredMask & ~oldRegisteredMask);
 }
 
 
@@ -2124,11 +2587,11 @@ uint32_t MCU_TicksSinceLastMessage(uint8_t moduleId)
 
   uint8_t moduleIndex = MCU_ModuleIndexFromId(moduleId);
   if(moduleIndex < MAX_MODULES_PER_PACK){
-    if ((overFlows - module[moduleIndex].lastContact.overflows) == 0){
-      elapsedTicks = timerCNT - module[moduleIndex].lastContact.ticks;
+    if ((overFlows - moduleCtl.lastContact[moduleIndex].overflows) == 0){
+      elapsedTicks = timerCNT - moduleCtl.lastContact[moduleIndex].ticks;
     } else {
       //             (           ticks last contact to overflow point               ) + (                           ticks in completed overflows                               ) + ( ticks in current timer period)
-      elapsedTicks = ((htim1.Init.Period +1) - module[moduleIndex].lastContact.ticks) + ( (htim1.Init.Period +1) * (overFlows - (module[moduleIndex].lastContact.overflows +1))) + (timerCNT);
+      elapsedTicks = ((htim1.Init.Period +1) - moduleCtl.lastContact[moduleIndex].ticks) + ( (htim1.Init.Period +1) * (overFlows - (moduleCtl.lastContact[moduleIndex].overflows +1))) + (timerCNT);
     }
     return elapsedTicks;
   } else {
@@ -0,0 +1,269 @@
+/***************************************************************************************************************
+ * @file           : mcu_balance.c                                                 P A C K   C O N T R O L L E R
+ * @brief          : Cell balancing planner - bleed targets from the pack cell voltages.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "bms.h"
+#include "stdio.h"
+#include "string.h"
+#include "debug.h"
+#include "mcu_sched.h"
+#include "mcu_cells.h"
+#include "mcu_cellstats.h"
+#include "mcu_balance.h"
+
+#define MCU_BALANCE_NO_TARGET   0xFFFF      // no cell can be above it - plans every cell off
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+mcuBalance_t mcuBalance;
+
+extern batteryPack pack;
+
+static void     MCU_BalancePackFlags(void);
+static void     MCU_BalanceStartCycle(uint32_t now);
+static void     MCU_BalanceEndCycle(void);
+static uint16_t MCU_BalancePlanModule(uint8_t moduleIndex, uint16_t budget);
+static void     MCU_BalanceSend(void);
+
+
+/***************************************************************************************************************
+*
+*                   Section: Application Local Functions                           P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e P a c k F l a g s                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_BalancePackFlags(void)
+{
+  pack.cellBalanceActive = (mcuBalance.activeMask != 0);
+  pack.cellBalanceStatus = (mcuCellStats.cells > 0 && mcuCellStats.volt.spread <= MCU_BALANCE_DONE_MV);
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e S t a r t C y c l e                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_BalanceStartCycle(uint32_t now)
+{
+  mcuBalance.running    = true;
+  mcuBalance.cycleMask  = mcuSched.registeredMask;
+  mcuBalance.cursorCell = 0;
+  mcuBalance.changed    = 0;
+  mcuBalance.bleedCells = 0;
+
+  // the target holds for the whole cycle, so cells planned late are judged like the early ones
+  if(mcuCellStats.cells > 0 && mcuCellStats.volt.min >= MCU_BALANCE_FLOOR_MV)
+    mcuBalance.target = mcuCellStats.volt.min;
+  else
+    mcuBalance.target = MCU_BALANCE_NO_TARGET;
+
+  mcuBalance.refresh = ((int32_t)(now - mcuBalance.lastRefresh) >= MCU_BALANCE_REFRESH);
+  if(mcuBalance.refresh) mcuBalance.lastRefresh = now;
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e E n d C y c l e                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_BalanceEndCycle(void)
+{
+  mcuBalance.running = false;
+  mcuBalance.cycles++;
+
+  if(mcuBalance.bleedCells != mcuBalance.bleeding){
+    if(debugLevel & DBG_MCU){ sprintf(tempBuffer,"MCU - Cell balancing %d cells bleeding, target %dmV, spread %dmV", mcuBalance.bleedCells, mcuBalance.target, mcuCellStats.volt.spread); serialOut(tempBuffer);}
+  }
+  mcuBalance.bleeding = mcuBalance.bleedCells;
+  MCU_BalancePackFlags();
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e P l a n M o d u l e                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static uint16_t MCU_BalancePlanModule(uint8_t moduleIndex, uint16_t budget)
+{
+  uint64_t* bleed = mcuBalance.bleed[moduleIndex];
+  batteryCell* cell = MCU_Cells(moduleIndex);
+  uint32_t bit = 1UL << moduleIndex;
+  uint16_t count = mcuCells.count[moduleIndex];
+  uint16_t used = 0;
+  uint16_t first;
+  uint32_t limit;
+  uint64_t cellBit;
+  uint64_t keep;
+  uint8_t  frame;
+  bool     active = false;
+
+  // off unless enabled and the module has a complete cell set
+  if(!(mcuBalance.packEnable || (mcuBalance.moduleEnable & bit)) || !(mcuCellStats.cellMask & bit) || cell == NULL)
+    count = 0;
+
+  for(; mcuBalance.cursorCell < count && used < budget; mcuBalance.cursorCell++, used++){
+    frame   = mcuBalance.cursorCell / CELL_BALANCE_FRAME_CELLS;
+    cellBit = 1ULL << (mcuBalance.cursorCell % CELL_BALANCE_FRAME_CELLS);
+    // a bleeding cell carries on down to STOP, an idle one waits until it is START above the target
+    limit   = (uint32_t)mcuBalance.target + ((bleed[frame] & cellBit) ? MCU_BALANCE_STOP_MV : MCU_BALANCE_START_MV);
+    if(cell[mcuBalance.cursorCell].voltage > limit){
+      if(!(bleed[frame] & cellBit)){
+        bleed[frame] |= cellBit;
+        mcuBalance.changed |= 1 << frame;
+      }
+      mcuBalance.bleedCells++;
+    } else if(bleed[frame] & cellBit){
+      bleed[frame] &= ~cellBit;
+      mcuBalance.changed |= 1 << frame;
+    }
+  }
+  if(mcuBalance.cursorCell < count) return used;
+
+  // module done - nothing past its last cell bleeds, then queue the frames that changed
+  for(frame = 0; frame < MCU_BALANCE_FRAMES; frame++){
+    first = frame * CELL_BALANCE_FRAME_CELLS;
+    if(count <= first)                                 keep = 0;
+    else if(count - first >= CELL_BALANCE_FRAME_CELLS) keep = ~0ULL;
+    else                                               keep = (1ULL << (count - first)) - 1;
+    if(bleed[frame] & ~keep){
+      bleed[frame] &= keep;
+      mcuBalance.changed |= 1 << frame;
+    }
+    if((mcuBalance.changed & (1 << frame)) || (mcuBalance.refresh && bleed[frame] != 0))
+      mcuBalance.pending[moduleIndex] |= 1 << frame;
+    if(bleed[frame] != 0) active = true;
+  }
+  if(mcuBalance.pending[moduleIndex] != 0) mcuBalance.pendingMask |= bit;
+
+  if(active) mcuBalance.activeMask |= bit;
+  else       mcuBalance.activeMask &= ~bit;
+  if((mcuCellStats.cellMask & bit) && mcuCellStats.module[moduleIndex].maxVolt <= (uint32_t)mcuCellStats.volt.min + MCU_BALANCE_DONE_MV)
+    mcuBalance.balancedMask |= bit;
+  else
+    mcuBalance.balancedMask &= ~bit;
+
+  mcuBalance.cycleMask &= ~bit;
+  mcuBalance.cursorCell = 0;
+  mcuBalance.changed    = 0;
+  return used + 1;
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e S e n d                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_BalanceSend(void)
+{
+  uint8_t frames = MCU_BALANCE_FRAMES_PER_PASS;
+  uint8_t index;
+  uint8_t frame;
+
+  while(mcuBalance.pendingMask != 0 && frames > 0){
+    index = __builtin_ctz(mcuBalance.pendingMask);
+    frame = __builtin_ctz(mcuBalance.pending[index]);
+    MCU_TransmitCellBalance(module[index].moduleId, frame * CELL_BALANCE_FRAME_CELLS, mcuBalance.bleed[index][frame]);
+    mcuBalance.pending[index] &= ~(1 << frame);
+    if(mcuBalance.pending[index] == 0) mcuBalance.pendingMask &= ~(1UL << index);
+    frames--;
+  }
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: Cell Balancing Functions                              P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e I n i t                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_BalanceInit(void)
+{
+  memset(&mcuBalance, 0, sizeof(mcuBalance));
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e P a c k C o n t r o l                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_BalancePackControl(uint8_t control)
+{
+  bool enable = (control == MCU_BALANCE_CTRL_ON);
+
+  if(enable == mcuBalance.packEnable) return;
+  mcuBalance.packEnable = enable;
+  if(debugLevel & DBG_MCU){ sprintf(tempBuffer,"MCU - Cell balancing %s for the pack", enable ? "on" : "off"); serialOut(tempBuffer);}
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e M o d u l e C o n t r o l                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_BalanceModuleControl(uint8_t moduleIndex, uint8_t control)
+{
+  uint32_t bit;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+  bit = 1UL << moduleIndex;
+  if(control == MCU_BALANCE_CTRL_ON) mcuBalance.moduleEnable |= bit;
+  else                               mcuBalance.moduleEnable &= ~bit;
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e M o d u l e s C h a n g e d                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_BalanceModulesChanged(uint32_t moduleMask)
+{
+  uint32_t modules;
+  uint8_t  index;
+
+  // a module leaving service stops by itself after MCU_BALANCE_DURATION, one joining starts with
+  // nothing bleeding - either way the slot starts again from all cells off
+  if(moduleMask & mcuBalance.cycleMask & (0 - mcuBalance.cycleMask)){
+    mcuBalance.cursorCell = 0;  // the module being planned
+    mcuBalance.changed    = 0;
+  }
+  for(modules = moduleMask; modules != 0; modules &= modules - 1){
+    index = __builtin_ctz(modules);
+    memset(mcuBalance.bleed[index], 0, sizeof(mcuBalance.bleed[index]));
+    mcuBalance.pending[index] = 0;
+  }
+  mcuBalance.pendingMask  &= ~moduleMask;
+  mcuBalance.moduleEnable &= ~moduleMask;
+  mcuBalance.cycleMask    &= ~moduleMask;
+  mcuBalance.activeMask   &= ~moduleMask;
+  mcuBalance.balancedMask &= ~moduleMask;
+}
+
+/***************************************************************************************************************
+*     M C U _ B a l a n c e T a s k s                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_BalanceTasks(uint32_t now)
+{
+  uint16_t budget = MCU_BALANCE_CELLS_PER_PASS;
+  uint16_t used;
+
+  if(!mcuBalance.running && (int32_t)(now - mcuBalance.cycleStart) >= MCU_BALANCE_INTERVAL){
+    mcuBalance.cycleStart = now;
+    // nothing enabled and nothing left bleeding - no cycle to plan
+    if(mcuBalance.packEnable || mcuBalance.moduleEnable != 0 || mcuBalance.activeMask != 0)
+      MCU_BalanceStartCycle(now);
+    else
+      MCU_BalancePackFlags();
+  }
+
+  while(mcuBalance.running && budget > 0){
+    if(mcuBalance.cycleMask == 0){
+      MCU_BalanceEndCycle();
+      break;
+    }
+    used = MCU_BalancePlanModule(__builtin_ctz(mcuBalance.cycleMask), budget);
+    budget = (used < budget) ? budget - used : 0;
+  }
+
+  MCU_BalanceSend();
+}
@@ -0,0 +1,118 @@
+/***************************************************************************************************************
+ * @file           : mcu_cells.c                                                   P A C K   C O N T R O L L E R
+ * @brief          : Shared cell data arena for the battery modules.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "bms.h"
+#include "stdio.h"
+#include "string.h"
+#include "debug.h"
+#include "mcu_cells.h"
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+mcuCells_t mcuCells;
+
+
+/***************************************************************************************************************
+*
+*                   Section: Cell Arena Functions                                  P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ C e l l s I n i t                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_CellsInit(void)
+{
+  memset(&mcuCells, 0, sizeof(mcuCells));
+}
+
+/***************************************************************************************************************
+*     M C U _ C e l l s R e l e a s e                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_CellsRelease(uint8_t moduleIndex)
+{
+  if(moduleIndex >= MAX_MODULES_PER_PACK || mcuCells.count[moduleIndex] == 0) return;
+
+  mcuCells.used -= mcuCells.count[moduleIndex];
+  // the last block handed out - its space goes straight back to the top
+  if(mcuCells.offset[moduleIndex] + mcuCells.count[moduleIndex] == mcuCells.top)
+    mcuCells.top = mcuCells.offset[moduleIndex];
+  mcuCells.count[moduleIndex] = 0;
+
+  // nothing left in use - no holes either
+  if(mcuCells.used == 0) mcuCells.top = 0;
+}
+
+/***************************************************************************************************************
+*     M C U _ C e l l s C o m p a c t                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_CellsCompact(void)
+{
+  uint16_t cursor = 0;
+  uint16_t lowest;
+  uint8_t  next;
+  uint8_t  index;
+
+  // move the blocks down in address order so a block never lands on one not yet moved
+  for(;;){
+    next   = MAX_MODULES_PER_PACK;
+    lowest = MCU_CELL_POOL_CELLS;
+    for(index = 0; index < MAX_MODULES_PER_PACK; index++){
+      if(mcuCells.count[index] == 0 || mcuCells.offset[index] < cursor) continue;
+      if(mcuCells.offset[index] < lowest){
+        lowest = mcuCells.offset[index];
+        next   = index;
+      }
+    }
+    if(next == MAX_MODULES_PER_PACK) break;
+
+    if(lowest != cursor){
+      memmove(&mcuCells.pool[cursor], &mcuCells.pool[lowest], mcuCells.count[next] * sizeof(batteryCell));
+      mcuCells.offset[next] = cursor;
+    }
+    cursor += mcuCells.count[next];
+  }
+  mcuCells.top = cursor;
+}
+
+/***************************************************************************************************************
+*     M C U _ C e l l s A l l o c                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+batteryCell* MCU_CellsAlloc(uint8_t moduleIndex, uint8_t cellCount)
+{
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return 0;
+
+  // no count to size by, or the block already fits it - keep what the module has
+  if(cellCount == 0 || cellCount > MAX_CELLS_PER_MODULE || cellCount == mcuCells.count[moduleIndex])
+    return MCU_Cells(moduleIndex);
+
+  // the module reports a different cell count - its old block is the wrong size
+  MCU_CellsRelease(moduleIndex);
+
+  if(MCU_CELL_POOL_CELLS - mcuCells.top < cellCount){
+    if(MCU_CELL_POOL_CELLS - mcuCells.used < cellCount){
+      mcuCells.allocFailures++;
+      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - No room for %d cells of module %02x (%d of %d cells free)", cellCount, module[moduleIndex].moduleId, MCU_CELL_POOL_CELLS - mcuCells.used, MCU_CELL_POOL_CELLS); serialOut(tempBuffer);}
+      return 0;
+    }
+    MCU_CellsCompact();
+  }
+
+  mcuCells.offset[moduleIndex] = mcuCells.top;
+  mcuCells.count[moduleIndex]  = cellCount;
+  mcuCells.top  += cellCount;
+  mcuCells.used += cellCount;
+  memset(&mcuCells.pool[mcuCells.offset[moduleIndex]], 0, cellCount * sizeof(batteryCell));
+
+  return &mcuCells.pool[mcuCells.offset[moduleIndex]];
+}
@@ -0,0 +1,136 @@
+/***************************************************************************************************************
+ * @file           : mcu_cellstats.c                                               P A C K   C O N T R O L L E R
+ * @brief          : Pack statistics from the collected cell data.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "bms.h"
+#include "stdio.h"
+#include "string.h"
+#include "debug.h"
+#include "mcu_cells.h"
+#include "mcu_cellstats.h"
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+mcuCellStats_t mcuCellStats;
+
+static void MCU_CellStatsDerivePack(void);
+
+
+/***************************************************************************************************************
+*
+*                   Section: Application Local Functions                           P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ C e l l S t a t s D e r i v e P a c k                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_CellStatsDerivePack(void)
+{
+  cellStatsAcc_t total;
+  cellStatsAcc_t* part;
+  uint32_t modules;
+  uint8_t  index;
+
+  CellStats_Init(&total);
+  mcuCellStats.modules    = 0;
+  mcuCellStats.modMinVolt = MAX_MODULES_PER_PACK;
+  mcuCellStats.modMaxVolt = MAX_MODULES_PER_PACK;
+  mcuCellStats.modMinTemp = MAX_MODULES_PER_PACK;
+  mcuCellStats.modMaxTemp = MAX_MODULES_PER_PACK;
+
+  // lowest slot first, so a module only takes an extreme from a lower one when it beats it
+  for(modules = mcuCellStats.cellMask; modules != 0; modules &= modules - 1){
+    index = __builtin_ctz(modules);
+    part  = &mcuCellStats.module[index];
+    if(mcuCellStats.modules == 0 || part->minVolt < total.minVolt) mcuCellStats.modMinVolt = index;
+    if(mcuCellStats.modules == 0 || part->maxVolt > total.maxVolt) mcuCellStats.modMaxVolt = index;
+    if(mcuCellStats.modules == 0 || part->minTemp < total.minTemp) mcuCellStats.modMinTemp = index;
+    if(mcuCellStats.modules == 0 || part->maxTemp > total.maxTemp) mcuCellStats.modMaxTemp = index;
+    CellStats_Merge(&total, part);
+    mcuCellStats.modules++;
+  }
+
+  mcuCellStats.cells = total.cells;
+  CellStats_Finish(total.cells, total.minVolt, total.maxVolt, total.sumVolt, total.sumSqVolt, &mcuCellStats.volt);
+  CellStats_Finish(total.cells, total.minTemp, total.maxTemp, total.sumTemp, total.sumSqTemp, &mcuCellStats.temp);
+  memcpy(mcuCellStats.hist, total.hist, sizeof(mcuCellStats.hist));
+  mcuCellStats.updates++;
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: Cell Statistics Functions                             P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ C e l l S t a t s I n i t                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_CellStatsInit(void)
+{
+  memset(&mcuCellStats, 0, sizeof(mcuCellStats));
+  mcuCellStats.modMinVolt = MAX_MODULES_PER_PACK;
+  mcuCellStats.modMaxVolt = MAX_MODULES_PER_PACK;
+  mcuCellStats.modMinTemp = MAX_MODULES_PER_PACK;
+  mcuCellStats.modMaxTemp = MAX_MODULES_PER_PACK;
+}
+
+/***************************************************************************************************************
+*     M C U _ C e l l S t a t s M o d u l e C h a n g e d                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_CellStatsModuleChanged(uint8_t moduleIndex)
+{
+  if(moduleIndex < MAX_MODULES_PER_PACK) mcuCellStats.staleMask |= 1UL << moduleIndex;
+}
+
+/***************************************************************************************************************
+*     M C U _ C e l l S t a t s M o d u l e s C h a n g e d                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_CellStatsModulesChanged(uint32_t moduleMask)
+{
+  mcuCellStats.staleMask |= moduleMask;
+}
+
+/***************************************************************************************************************
+*     M C U _ U p d a t e C e l l S t a t s                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_UpdateCellStats(void)
+{
+  cellStatsAcc_t* part;
+  batteryCell* cell;
+  uint32_t stale;
+  uint32_t bit;
+  uint8_t  index;
+
+  if(mcuCellStats.staleMask == 0) return;
+
+  stale = mcuCellStats.staleMask;
+  mcuCellStats.staleMask = 0;
+  for(; stale != 0; stale &= stale - 1){
+    index = __builtin_ctz(stale);
+    bit   = 1UL << index;
+    part  = &mcuCellStats.module[index];
+    cell  = MCU_Cells(index);
+
+    CellStats_Init(part);
+    if(!moduleCtl.isRegistered[index] || cell == NULL){
+      mcuCellStats.cellMask &= ~bit;
+      continue;
+    }
+    CellStats_Accumulate(cell, mcuCells.count[index], part);
+    mcuCellStats.cellMask |= bit;
+  }
+
+  MCU_CellStatsDerivePack();
+}
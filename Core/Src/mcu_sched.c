@@ -0,0 +1,458 @@
+/***************************************************************************************************************
+ * @file           : mcu_sched.c                                                   P A C K   C O N T R O L L E R
+ * @brief          : Deadline driven scheduler for battery module servicing.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "bms.h"
+#include "mcu_sched.h"
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+mcuSchedule_t mcuSched;
+mcuPoller_t   mcuPoll;
+
+static void MCU_SchedSiftUp(uint8_t slot);
+static void MCU_SchedSiftDown(uint8_t slot);
+static void MCU_SchedSet(uint8_t moduleIndex, uint32_t due);
+
+
+/***************************************************************************************************************
+*
+*                   Section: Application Local Functions                           P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ S c h e d B e f o r e                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline bool MCU_SchedBefore(uint32_t a, uint32_t b)
+{
+  // true when deadline a expires before deadline b - safe across counter wrap
+  return (int32_t)(a - b) < 0;
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d S w a p                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline void MCU_SchedSwap(uint8_t a, uint8_t b)
+{
+  uint8_t tmp = mcuSched.heap[a];
+
+  mcuSched.heap[a] = mcuSched.heap[b];
+  mcuSched.heap[b] = tmp;
+  mcuSched.pos[mcuSched.heap[a]] = a;
+  mcuSched.pos[mcuSched.heap[b]] = b;
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d S i f t U p                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_SchedSiftUp(uint8_t slot)
+{
+  uint8_t parent;
+
+  while(slot > 0){
+    parent = (slot - 1) >> 1;
+    if(!MCU_SchedBefore(mcuSched.due[mcuSched.heap[slot]], mcuSched.due[mcuSched.heap[parent]])) break;
+    MCU_SchedSwap(slot, parent);
+    slot = parent;
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d S i f t D o w n                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_SchedSiftDown(uint8_t slot)
+{
+  uint8_t child;
+
+  for(;;){
+    child = (slot << 1) + 1;
+    if(child >= mcuSched.count) break;
+    // pick the earlier of the two children
+    if((child + 1) < mcuSched.count &&
+       MCU_SchedBefore(mcuSched.due[mcuSched.heap[child + 1]], mcuSched.due[mcuSched.heap[child]])) child++;
+    if(!MCU_SchedBefore(mcuSched.due[mcuSched.heap[child]], mcuSched.due[mcuSched.heap[slot]])) break;
+    MCU_SchedSwap(slot, child);
+    slot = child;
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d S e t                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_SchedSet(uint8_t moduleIndex, uint32_t due)
+{
+  uint8_t slot = mcuSched.pos[moduleIndex];
+
+  mcuSched.due[moduleIndex] = due;
+  if(slot == MCU_SCHED_NONE){
+    // not scheduled yet - append and sift into place
+    slot = mcuSched.count++;
+    mcuSched.heap[slot] = moduleIndex;
+    mcuSched.pos[moduleIndex] = slot;
+    MCU_SchedSiftUp(slot);
+  }else{
+    // already scheduled - the deadline may have moved either way
+    MCU_SchedSiftUp(slot);
+    MCU_SchedSiftDown(mcuSched.pos[moduleIndex]);
+  }
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: Scheduler Functions                                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ N o w                                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint32_t MCU_Now(void)
+{
+  uint32_t overFlows;
+  uint32_t timerCNT;
+
+  // re-read if the overflow interrupt fired between the two reads
+  do {
+    overFlows = etTimerOverflows;
+    timerCNT  = htim1.Instance->CNT;
+  } while (overFlows != etTimerOverflows);
+
+  return (overFlows * (htim1.Init.Period + 1)) + timerCNT;
+}
+
+/***************************************************************************************************************
+*     M C U _ T i c k s T o M s                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint32_t MCU_TicksToMs(lastContact_t* pTime)
+{
+  // same time base as MCU_Now()
+  return (pTime->overflows * (htim1.Init.Period + 1)) + pTime->ticks;
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d I n i t                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SchedInit(void)
+{
+  uint8_t index;
+
+  mcuSched.count = 0;
+  mcuSched.registeredMask = 0;
+  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
+    mcuSched.pos[index] = MCU_SCHED_NONE;
+    mcuSched.due[index] = 0;
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d U p d a t e                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SchedUpdate(uint8_t moduleIndex)
+{
+  uint32_t due;
+  uint32_t timeout;
+  uint32_t stateTxDue;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+
+  if(!moduleCtl.isRegistered[moduleIndex] || module[moduleIndex].uniqueId == 0){
+    MCU_SchedRemove(moduleIndex);
+    return;
+  }
+
+  if(moduleCtl.statusPending[moduleIndex] == true){
+    // waiting for Status1/2/3 - next event is the reply timeout, from the last contact or timeout
+    due = MCU_TicksToMs(&moduleCtl.lastContact[moduleIndex]);
+    timeout = MCU_TicksToMs(&moduleCtl.lastTimeout[moduleIndex]);
+    if(MCU_SchedBefore(due, timeout)) due = timeout;
+    due += MCU_ET_TIMEOUT + 1;
+  }else{
+    // idle - next event is the periodic status request
+    due = MCU_TicksToMs(&moduleCtl.lastContact[moduleIndex]) + MCU_STATUS_INTERVAL + 1;
+  }
+
+  if(module[moduleIndex].command.commandStatus == commandIssued){
+    // an unacknowledged state command is retransmitted after MCU_STATE_TX_INTERVAL
+    stateTxDue = MCU_TicksToMs(&module[moduleIndex].lastTransmit) + MCU_STATE_TX_INTERVAL + 1;
+    if(MCU_SchedBefore(stateTxDue, due)) due = stateTxDue;
+  }
+
+  MCU_SchedSet(moduleIndex, due);
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d D e f e r                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SchedDefer(uint8_t moduleIndex, uint32_t delay)
+{
+  // push the deadline out - used when a module was serviced but its deadline has not moved
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+  if(mcuSched.pos[moduleIndex] == MCU_SCHED_NONE) return;
+  MCU_SchedSet(moduleIndex, MCU_Now() + delay);
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d R e m o v e                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SchedRemove(uint8_t moduleIndex)
+{
+  uint8_t slot;
+  uint8_t last;
+  uint8_t moved;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+
+  slot = mcuSched.pos[moduleIndex];
+  if(slot == MCU_SCHED_NONE) return;
+
+  // move the last entry into the vacated slot and restore the heap order
+  last = --mcuSched.count;
+  mcuSched.pos[moduleIndex] = MCU_SCHED_NONE;
+  if(slot != last){
+    moved = mcuSched.heap[last];
+    mcuSched.heap[slot] = moved;
+    mcuSched.pos[moved] = slot;
+    MCU_SchedSiftUp(slot);
+    MCU_SchedSiftDown(mcuSched.pos[moved]);
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d N e x t D u e                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint8_t MCU_SchedNextDue(uint32_t now)
+{
+  // returns the module index with the earliest expired deadline, or MCU_SCHED_NONE
+  if(mcuSched.count == 0) return MCU_SCHED_NONE;
+  if(MCU_SchedBefore(now, mcuSched.due[mcuSched.heap[0]])) return MCU_SCHED_NONE;
+  return mcuSched.heap[0];
+}
+
+/***************************************************************************************************************
+*     M C U _ S c h e d S t a t e T x D u e                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+bool MCU_SchedStateTxDue(uint8_t moduleIndex, uint32_t now)
+{
+  // O(1) replacement for MCU_TicksSinceLastStateTx() > MCU_STATE_TX_INTERVAL
+  return (int32_t)(now - MCU_TicksToMs(&module[moduleIndex].lastTransmit)) > MCU_STATE_TX_INTERVAL;
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: Status Poller Functions                               P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ P o l l I n i t                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PollInit(void)
+{
+  uint8_t index;
+
+  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
+    mcuPoll.requestTime[index] = 0;
+  }
+  mcuPoll.inFlightMask = 0;
+  mcuPoll.latencyAvg   = MCU_POLL_LATENCY_INIT << 3;
+  mcuPoll.window       = MCU_POLL_WINDOW_MIN;
+  mcuPoll.nextIndex    = 0;
+  for(index = 0; index < MAX_MODULES_PER_PACK; index++){
+    mcuPoll.interval[index]   = MCU_POLL_INTERVAL_NORMAL;
+    mcuPoll.lastMmv[index]    = 0;
+    mcuPoll.lastSample[index] = 0;
+  }
+  mcuPoll.demand        = 0;
+  mcuPoll.busLoadBudget = MCU_POLL_BUSLOAD_BUDGET * 10000UL;
+  mcuPoll.stretch       = 256;
+  mcuPoll.pollCost      = MCU_POLL_COST_US;
+}
+
+/***************************************************************************************************************
+*     M C U _ P o l l I s s u e d                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PollIssued(uint8_t moduleIndex)
+{
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+  mcuPoll.requestTime[moduleIndex] = MCU_Now();
+  mcuPoll.inFlightMask |= (1UL << moduleIndex);
+}
+
+/***************************************************************************************************************
+*     M C U _ P o l l C o m p l e t e                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PollComplete(uint8_t moduleIndex)
+{
+  uint32_t latency;
+  uint32_t demand;
+  uint32_t window;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+  if((mcuPoll.inFlightMask & (1UL << moduleIndex)) == 0) return;
+  mcuPoll.inFlightMask &= ~(1UL << moduleIndex);
+
+  // moving average over 8 samples, kept scaled by 8 so no fraction is lost
+  latency = MCU_Now() - mcuPoll.requestTime[moduleIndex];
+  if(latency > MCU_ET_TIMEOUT) latency = MCU_ET_TIMEOUT;
+  mcuPoll.latencyAvg = mcuPoll.latencyAvg - (mcuPoll.latencyAvg >> 3) + latency;
+
+  // pick the next poll interval from the status just received
+  MCU_PollRate(moduleIndex);
+
+  // size the window for the poll rate the budget allows - polls/s = demand / pollCost
+  demand = mcuPoll.demand < mcuPoll.busLoadBudget ? mcuPoll.demand : mcuPoll.busLoadBudget;
+  window = (uint32_t)((((uint64_t)mcuPoll.latencyAvg * demand) + ((8000ULL * mcuPoll.pollCost) - 1)) /
+                      (8000ULL * mcuPoll.pollCost));
+  if(window < MCU_POLL_WINDOW_MIN) window = MCU_POLL_WINDOW_MIN;
+  if(window > MCU_POLL_WINDOW_MAX) window = MCU_POLL_WINDOW_MAX;
+  mcuPoll.window = window;
+}
+
+/***************************************************************************************************************
+*     M C U _ P o l l R e l e a s e                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PollRelease(uint8_t moduleIndex)
+{
+  // request abandoned (timeout, deregistration) - free the window slot without a latency sample
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+  mcuPoll.inFlightMask &= ~(1UL << moduleIndex);
+}
+
+/***************************************************************************************************************
+*     M C U _ P o l l N e x t C a n d i d a t e                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint8_t MCU_PollNextCandidate(uint32_t now)
+{
+  uint32_t candidates;
+  uint32_t upper;
+  uint32_t late;
+  uint8_t  index;
+
+  // a reply this late is lost - free its slot so one loss does not stall the window for MCU_ET_TIMEOUT,
+  // the module stays statusPending until then
+  for(late = mcuPoll.inFlightMask; late != 0; late &= late - 1){
+    index = __builtin_ctz(late);
+    if((int32_t)(now - mcuPoll.requestTime[index]) > MCU_POLL_SLOT_TIMEOUT) mcuPoll.inFlightMask &= ~(1UL << index);
+  }
+
+  // window full?
+  if(__builtin_popcount(mcuPoll.inFlightMask) >= mcuPoll.window) return MCU_SCHED_NONE;
+
+  candidates = mcuSched.registeredMask & ~mcuPoll.inFlightMask;
+  while(candidates != 0){
+    // round-robin - prefer slots at or after nextIndex, then wrap
+    upper = candidates & ~((1UL << mcuPoll.nextIndex) - 1);
+    index = __builtin_ctz(upper != 0 ? upper : candidates);
+    candidates &= ~(1UL << index);
+
+    // skip modules in timeout/error state, waiting for a response, or refreshed recently
+    if(moduleCtl.statusPending[index] == true) continue;
+    if(moduleCtl.waiting[index] == true) continue;
+    if(moduleCtl.faultCode[index].commsError == true) continue;
+    if((int32_t)(now - mcuPoll.requestTime[index]) < (int32_t)((mcuPoll.interval[index] * mcuPoll.stretch) >> 8)) continue;
+
+    mcuPoll.nextIndex = (index + 1) % MAX_MODULES_PER_PACK;
+    return index;
+  }
+  return MCU_SCHED_NONE;
+}
+
+/***************************************************************************************************************
+*     M C U _ P o l l R a t e                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PollRate(uint8_t moduleIndex)
+{
+  uint32_t now;
+  uint32_t elapsed;
+  uint32_t current;
+  uint32_t dvdt;
+  bool     dvdtKnown = false;
+  bool     nearLimit;
+  uint16_t interval;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+
+  now = MCU_Now();
+
+  // module current magnitude in 0.02 A units - mmc is offset by 655.36 A (32768 counts)
+  current = module[moduleIndex].mmc >= 32768 ? module[moduleIndex].mmc - 32768 : 32768 - module[moduleIndex].mmc;
+
+  // module voltage rate of change in mV/s - mmv is in 15 mV units
+  dvdt = 0;
+  elapsed = now - mcuPoll.lastSample[moduleIndex];
+  if(mcuPoll.lastSample[moduleIndex] != 0 && elapsed > 0){
+    dvdt = module[moduleIndex].mmv >= mcuPoll.lastMmv[moduleIndex] ?
+           module[moduleIndex].mmv - mcuPoll.lastMmv[moduleIndex] : mcuPoll.lastMmv[moduleIndex] - module[moduleIndex].mmv;
+    dvdt = (dvdt * 15 * 1000) / elapsed;
+    dvdtKnown = true;
+  }
+  mcuPoll.lastMmv[moduleIndex]    = module[moduleIndex].mmv;
+  mcuPoll.lastSample[moduleIndex] = now;
+
+  // cells approaching a voltage or temperature limit - cellLoVolt reads 0 until cell data arrives
+  nearLimit = module[moduleIndex].cellHiVolt >= MCU_POLL_CELL_HI_MV ||
+              (module[moduleIndex].cellLoVolt != 0 && module[moduleIndex].cellLoVolt <= MCU_POLL_CELL_LO_MV) ||
+              module[moduleIndex].cellHiTemp >= MCU_POLL_CELL_HI_TEMP;
+
+  if(moduleCtl.faultCode[moduleIndex].overCurrent == true || current >= MCU_POLL_CURRENT_FAST ||
+     dvdt >= MCU_POLL_DVDT_FAST || nearLimit){
+    interval = MCU_POLL_INTERVAL_FAST;
+  }else if(moduleCtl.currentState[moduleIndex] != moduleOn && current < MCU_POLL_CURRENT_IDLE &&
+           dvdtKnown && dvdt < MCU_POLL_DVDT_IDLE){
+    // standby or off and nothing moving - back off
+    interval = MCU_POLL_INTERVAL_IDLE;
+  }else{
+    interval = MCU_POLL_INTERVAL_NORMAL;
+  }
+
+  if(interval != mcuPoll.interval[moduleIndex]){
+    mcuPoll.interval[moduleIndex] = interval;
+    MCU_PollBudget();
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ P o l l B u d g e t                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PollBudget(void)
+{
+  uint32_t slots;
+  uint32_t demand = 0;
+  uint32_t stretch;
+
+  // bus time per second needed to poll every registered module at its chosen interval
+  for(slots = mcuSched.registeredMask; slots != 0; slots &= slots - 1){
+    demand += (mcuPoll.pollCost * 1000UL) / mcuPoll.interval[__builtin_ctz(slots)];
+  }
+  mcuPoll.demand = demand;
+
+  // over budget - slow every module down by the same factor so fast modules stay relatively fast
+  stretch = 256;
+  if(demand > mcuPoll.busLoadBudget){
+    stretch = ((demand << 8) + mcuPoll.busLoadBudget - 1) / mcuPoll.busLoadBudget;
+  }
+  mcuPoll.stretch = stretch;
+}
+
+/***************************************************************************************************************
+*     M C U _ P o l l S e t B u d g e t                                            P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_PollSetBudget(uint8_t percent)
+{
+  if(percent < 1)   percent = 1;
+  if(percent > 100) percent = 100;
+  mcuPoll.busLoadBudget = percent * 10000UL;
+  MCU_PollBudget();
+}
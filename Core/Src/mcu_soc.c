@@ -0,0 +1,126 @@
+/***************************************************************************************************************
+ * @file           : mcu_soc.c                                                     P A C K   C O N T R O L L E R
+ * @brief          : Pack state of charge estimate - coulomb counted between module status reports.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "bms.h"
+#include "string.h"
+#include "mcu_stats.h"
+#include "fixed_signal.h"
+#include "mcu_soc.h"
+
+#define MCU_SOC_CHARGE_PER_QUANTUM  (MCU_SOC_MODULE_AH * SOC_EST_QUANTUM_PER_AH)
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+mcuSoc_t mcuSoc;
+
+extern batteryPack pack;
+
+static void MCU_SocCount(uint8_t moduleIndex, uint32_t now);
+
+
+/***************************************************************************************************************
+*
+*                   Section: Application Local Functions                           P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ S o c C o u n t                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_SocCount(uint8_t moduleIndex, uint32_t now)
+{
+  uint32_t held = mcuSoc.lastReport[moduleIndex] + MCU_SOC_HOLD;
+  uint32_t until = now;
+
+  // the reported current is counted up to MCU_SOC_HOLD after its report, no further
+  if((int32_t)(until - held) > 0) until = held;
+  if((int32_t)(until - mcuSoc.lastCount[moduleIndex]) > 0)
+    SocEst_Integrate(&mcuSoc.est[moduleIndex], until - mcuSoc.lastCount[moduleIndex], MCU_SOC_CHARGE_PER_QUANTUM);
+  mcuSoc.lastCount[moduleIndex] = now;
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: State of Charge Functions                             P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ S o c I n i t                                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SocInit(void)
+{
+  memset(&mcuSoc, 0, sizeof(mcuSoc));
+  pack.socEstimate = 0;
+}
+
+/***************************************************************************************************************
+*     M C U _ S o c M o d u l e S t a t u s                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SocModuleStatus(uint8_t moduleIndex, const moduleStatus* status, uint32_t now)
+{
+  uint32_t bit = 1UL << moduleIndex;
+  int32_t  current;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+  current = FXS_QUANTA(status->mmc, MODULE_CURRENT);
+
+  if(mcuSoc.validMask & bit){
+    MCU_SocCount(moduleIndex, now);
+    SocEst_Report(&mcuSoc.est[moduleIndex], status->soc, current);
+  } else {
+    SocEst_Reset(&mcuSoc.est[moduleIndex], status->soc, current);
+    mcuSoc.validMask |= bit;
+  }
+  mcuSoc.lastCount[moduleIndex]  = now;
+  mcuSoc.lastReport[moduleIndex] = now;
+}
+
+/***************************************************************************************************************
+*     M C U _ S o c M o d u l e s C h a n g e d                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SocModulesChanged(uint32_t moduleMask)
+{
+  // a module joining or leaving the slot starts again from its next status set
+  mcuSoc.validMask &= ~moduleMask;
+}
+
+/***************************************************************************************************************
+*     M C U _ S o c T a s k s                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_SocTasks(uint32_t now)
+{
+  uint32_t modules;
+  uint16_t before = pack.socEstimate;
+  int32_t  lowest = SOC_EST_FULL + 1;
+  uint8_t  index;
+
+  if((int32_t)(now - mcuSoc.lastUpdate) < MCU_SOC_INTERVAL) return;
+  mcuSoc.lastUpdate = now;
+
+  for(modules = mcuSoc.validMask; modules != 0; modules &= modules - 1){
+    index = __builtin_ctz(modules);
+    MCU_SocCount(index, now);
+    // the same modules as the pack.soc tree - registered, not in fault
+    if((mcuStats.activeMask & (1UL << index)) && mcuSoc.est[index].soc < lowest)
+      lowest = mcuSoc.est[index].soc;
+  }
+
+  if(lowest <= SOC_EST_FULL)
+    pack.socEstimate = lowest;
+  else
+    pack.socEstimate = FXS_CONVERT(pack.soc, PERCENTAGE, VCU_SOC_PERCENTAGE);
+
+  if(pack.socEstimate != before) mcuStats.dirty |= MCU_STATS_DIRTY_DATA2;
+}
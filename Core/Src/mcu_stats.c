@@ -0,0 +1,309 @@
+/***************************************************************************************************************
+ * @file           : mcu_stats.c                                                   P A C K   C O N T R O L L E R
+ * @brief          : Incremental pack statistics from the module status.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "bms.h"
+#include "stdio.h"
+#include "string.h"
+#include "debug.h"
+#include "mcu_stats.h"
+#include "fixed_signal.h"
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+mcuStats_t mcuStats;
+
+extern batteryPack pack;
+
+static void MCU_StatsRefreshModule(uint8_t moduleIndex);
+static void MCU_StatsDerivePack(void);
+
+
+/***************************************************************************************************************
+*
+*                   Section: Application Local Functions                           P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ S t a t s R e f r e s h M o d u l e                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_StatsRefreshModule(uint8_t moduleIndex)
+{
+  moduleStatsEntry_t* entry = &mcuStats.entry[moduleIndex];
+  uint32_t bit = 1UL << moduleIndex;
+  bool wasActive = (mcuStats.activeMask & bit) != 0;
+  moduleStatus snapshot;
+  int32_t moduleCurrent;
+  int32_t moduleMaxChargeA;
+  int32_t moduleMaxDischargeA;
+
+  mcuStats.onMask     &= ~bit;
+  mcuStats.activeMask &= ~bit;
+  mcuStats.refresh     = true;
+
+  // only generate stats for registered modules that are not in fault or in over current
+  if(!moduleCtl.isRegistered[moduleIndex] || module[moduleIndex].uniqueId == 0 ||
+     moduleCtl.faultCode[moduleIndex].commsError == true || moduleCtl.faultCode[moduleIndex].overCurrent == true ||
+     moduleCtl.faultCode[moduleIndex].hwIncompatible == true){
+    if(wasActive) mcuStats.rebuild = true;
+    return;
+  }
+
+  // one consistent Status1/2/3 set per module - never a new Status1 with an old Status2
+  MCU_ModuleStatusSnapshot(moduleIndex, &snapshot);
+
+  // sum the currents of all modules that are ON and average the voltages
+  if(snapshot.currentState == moduleOn){
+    // calculate module max currents and module current in 0.01 A
+    moduleMaxChargeA    = FXS_QUANTA(module[moduleIndex].maxChargeA,    MODULE_CURRENT);
+    moduleMaxDischargeA = FXS_QUANTA(module[moduleIndex].maxDischargeA, MODULE_CURRENT);
+    moduleCurrent       = FXS_QUANTA(snapshot.mmc,                      MODULE_CURRENT);
+
+    // Check for over current condition. Negative current flows out of battery, positive current flows into battery
+    if(moduleCurrent - FXS_MODULE_CURRENT_TOLERANCE > moduleMaxChargeA){
+      moduleCtl.faultCode[moduleIndex].overCurrent = true;
+      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - module charge current (%.2fA) exceeds specification (max %.2fA)",moduleCurrent / (float)FXS_CURRENT_PER_UNIT, moduleMaxChargeA / (float)FXS_CURRENT_PER_UNIT); serialOut(tempBuffer);}
+    } else if(moduleCurrent + FXS_MODULE_CURRENT_TOLERANCE < moduleMaxDischargeA) {
+      moduleCtl.faultCode[moduleIndex].overCurrent = true;
+      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - module discharge current (%.2fA) exceeds specification (max %.2fA)",moduleCurrent / (float)FXS_CURRENT_PER_UNIT, moduleMaxDischargeA / (float)FXS_CURRENT_PER_UNIT); serialOut(tempBuffer);}
+    }
+    if(moduleCtl.faultCode[moduleIndex].overCurrent == true){
+      // are we in pre-charge (just the one module on)? this was the first module on - go back and select another
+      if (pack.vcuRequestedState == packPrecharge){
+        pack.powerStatus.powerStage = stageSelectModule;
+      }
+      // still counted on this pass as before - it leaves the aggregates on the next one
+      mcuStats.staleMask |= bit;
+    }
+
+    entry->sum[MODULE_STATS_MMV]             = snapshot.mmv;
+    entry->sum[MODULE_STATS_MMC]             = snapshot.mmc;
+    entry->sum[MODULE_STATS_MAX_CHARGE_A]    = module[moduleIndex].maxChargeA;
+    entry->sum[MODULE_STATS_MAX_DISCHARGE_A] = module[moduleIndex].maxDischargeA;
+    mcuStats.onMask |= bit;
+  }
+  entry->on = (mcuStats.onMask & bit) != 0;
+
+  // summed over all active modules, averaged later
+  entry->sum[MODULE_STATS_MAX_CHARGE_END_V] = module[moduleIndex].maxChargeEndV;
+  entry->sum[MODULE_STATS_CELL_AVG_VOLT]    = snapshot.cellAvgVolt;
+  entry->sum[MODULE_STATS_CELL_AVG_TEMP]    = snapshot.cellAvgTemp;
+
+  // highest/lowest
+  entry->key[MODULE_STATS_CELL_LO_VOLT] = snapshot.cellLoVolt;
+  entry->key[MODULE_STATS_CELL_HI_VOLT] = MODULE_STATS_EMPTY - snapshot.cellHiVolt;
+  entry->key[MODULE_STATS_CELL_LO_TEMP] = snapshot.cellLoTemp;
+  entry->key[MODULE_STATS_CELL_HI_TEMP] = MODULE_STATS_EMPTY - snapshot.cellHiTemp;
+  entry->key[MODULE_STATS_SOC]          = snapshot.soc;
+  entry->key[MODULE_STATS_SOH]          = snapshot.soh;
+  mcuStats.activeMask |= bit;
+
+  // a module that stays active moves the totals from its old row to the new one - one that joins needs
+  // the summary compacted again, and the totals with it
+  if(wasActive && !mcuStats.rebuild)
+    ModuleStats_Update(&mcuStats.summary, &mcuStats.totals, mcuStats.row[moduleIndex], entry);
+  else
+    mcuStats.rebuild = true;
+}
+
+/***************************************************************************************************************
+*     M C U _ S t a t s D e r i v e P a c k                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_StatsDerivePack(void)
+{
+  batteryPack before = pack;
+  const moduleStatsResult_t* totals = &mcuStats.totals;
+  uint8_t  modulesOn;
+  uint8_t  slot;
+  uint16_t value;
+  int32_t  totalCurrent;
+  int32_t  maxChargeA;
+  int32_t  maxDischargeA;
+
+  modulesOn = totals->on;
+
+  // Pack active module count - a module that is flagged overcurrent is still active until it gets sent the standby
+  pack.activeModules = mcuStats.summary.rows;
+
+  // Pack faulted module count
+  pack.faultedModules = pack.moduleCount - pack.activeModules;
+
+  // Pack Voltage and Current - currents in 0.01 A
+  totalCurrent  = FXS_SUM_QUANTA(totals->sum[MODULE_STATS_MMC],             modulesOn, MODULE_CURRENT);
+  maxChargeA    = FXS_SUM_QUANTA(totals->sum[MODULE_STATS_MAX_CHARGE_A],    modulesOn, MODULE_CURRENT);
+  maxDischargeA = FXS_SUM_QUANTA(totals->sum[MODULE_STATS_MAX_DISCHARGE_A], modulesOn, MODULE_CURRENT);
+  if (modulesOn > 0){
+    pack.voltage = totals->sum[MODULE_STATS_MMV] / modulesOn;
+    //Check for max/min current out of range - set to min/max and flag error
+    if(totalCurrent > FXS_QUANTA(65535, PACK_CURRENT)){
+      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total current (%.2fA) exceeds specification (max %.2fA)",totalCurrent / (float)FXS_CURRENT_PER_UNIT, (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))); serialOut(tempBuffer);}
+      totalCurrent = FXS_QUANTA(65535, PACK_CURRENT);
+    }
+    else if(totalCurrent < FXS_QUANTA(0, PACK_CURRENT)){
+      if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total current (%.2fA) exceeds specification (max %dA)",totalCurrent / (float)FXS_CURRENT_PER_UNIT, PACK_CURRENT_BASE); serialOut(tempBuffer);}
+      totalCurrent = FXS_QUANTA(0, PACK_CURRENT);
+    }
+    // value is now within limits
+    pack.current = FXS_FROM_QUANTA(totalCurrent, PACK_CURRENT);
+  }else{
+    pack.voltage = 0;
+    pack.current = FXS_FROM_QUANTA(0, PACK_CURRENT); // 0 Amps converted.
+  }
+
+  // Maximum Pack charge/discharge current
+  if(maxChargeA > FXS_QUANTA(65535, PACK_CURRENT)){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxChargeA (%.2fA) exceeds specification (max %.2fA)",maxChargeA / (float)FXS_CURRENT_PER_UNIT, (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))); serialOut(tempBuffer);}
+    maxChargeA = FXS_QUANTA(65535, PACK_CURRENT);
+  }else if(maxChargeA < FXS_QUANTA(0, PACK_CURRENT)){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxChargeA (%.2fA) exceeds specification (max %dA)",maxChargeA / (float)FXS_CURRENT_PER_UNIT, PACK_CURRENT_BASE); serialOut(tempBuffer);}
+    maxChargeA = FXS_QUANTA(0, PACK_CURRENT);
+  }
+  if(maxDischargeA > FXS_QUANTA(65535, PACK_CURRENT)){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxDischargeA (%.2fA) exceeds specification (max %.2fA)",maxDischargeA / (float)FXS_CURRENT_PER_UNIT, (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))); serialOut(tempBuffer);}
+    maxDischargeA = FXS_QUANTA(65535, PACK_CURRENT);
+  }else if(maxDischargeA < FXS_QUANTA(0, PACK_CURRENT)){
+    if((debugLevel & (DBG_MCU + DBG_ERRORS))== (DBG_MCU + DBG_ERRORS)){ sprintf(tempBuffer,"MCU ERROR - Total maxDischargeA (%.2fA) exceeds specification (max %dA)",maxDischargeA / (float)FXS_CURRENT_PER_UNIT, PACK_CURRENT_BASE); serialOut(tempBuffer);}
+    maxDischargeA = FXS_QUANTA(0, PACK_CURRENT);
+  }
+  // values are now within limits
+  pack.maxChargeA    = FXS_FROM_QUANTA(maxChargeA,    PACK_CURRENT);
+  pack.maxDischargeA = FXS_FROM_QUANTA(maxDischargeA, PACK_CURRENT);
+
+  // averages over the active modules
+  if(pack.activeModules > 0){
+    pack.maxChargeEndV = totals->sum[MODULE_STATS_MAX_CHARGE_END_V] / pack.activeModules;
+    pack.cellAvgVolt   = totals->sum[MODULE_STATS_CELL_AVG_VOLT]    / pack.activeModules;
+    pack.cellAvgTemp   = totals->sum[MODULE_STATS_CELL_AVG_TEMP]    / pack.activeModules;
+  }else{
+    pack.maxChargeEndV = 0;
+    pack.cellAvgVolt   = 0;
+    pack.cellAvgTemp   = 0; //-55 degrees!
+  }
+
+  // Pack SOC/SOH = SOC/SOH of weakest module
+  value = totals->min[MODULE_STATS_SOC];
+  pack.soc = value < 255 ? value : 0;
+  value = totals->min[MODULE_STATS_SOH];
+  pack.soh = value < 255 ? value : 0;
+
+  // Pack Hi/Lo Cell Volt and Temp - no active module, or a minimum on the empty key, reports 0 for module 0
+  slot = totals->slot[MODULE_STATS_CELL_HI_VOLT];
+  value = totals->min[MODULE_STATS_CELL_HI_VOLT];
+  pack.cellHiVolt    = MODULE_STATS_EMPTY - value;
+  pack.modCellHiVolt = value != MODULE_STATS_EMPTY ? module[slot].moduleId : 0;
+  slot = totals->slot[MODULE_STATS_CELL_LO_VOLT];
+  value = totals->min[MODULE_STATS_CELL_LO_VOLT];
+  pack.cellLoVolt    = value != MODULE_STATS_EMPTY ? value : 0;
+  pack.modCellLoVolt = value != MODULE_STATS_EMPTY ? module[slot].moduleId : 0;
+
+  slot = totals->slot[MODULE_STATS_CELL_HI_TEMP];
+  value = totals->min[MODULE_STATS_CELL_HI_TEMP];
+  pack.cellHiTemp    = MODULE_STATS_EMPTY - value;
+  pack.modCellHiTemp = value != MODULE_STATS_EMPTY ? module[slot].moduleId : 0;
+  slot = totals->slot[MODULE_STATS_CELL_LO_TEMP];
+  value = totals->min[MODULE_STATS_CELL_LO_TEMP];
+  pack.cellLoTemp    = value != MODULE_STATS_EMPTY ? value : 0; //-55 degrees!
+  pack.modCellLoTemp = value != MODULE_STATS_EMPTY ? module[slot].moduleId : 0;
+
+  // flag the VCU frames whose contents moved
+  if(pack.voltage != before.voltage || pack.current != before.current)
+    mcuStats.dirty |= MCU_STATS_DIRTY_DATA1;
+  if(pack.cellAvgVolt != before.cellAvgVolt || pack.cellHiVolt != before.cellHiVolt ||
+     pack.cellLoVolt != before.cellLoVolt || pack.soc != before.soc)
+    mcuStats.dirty |= MCU_STATS_DIRTY_DATA2;
+  if(pack.cellAvgTemp != before.cellAvgTemp || pack.cellHiTemp != before.cellHiTemp || pack.cellLoTemp != before.cellLoTemp)
+    mcuStats.dirty |= MCU_STATS_DIRTY_DATA3;
+  if(pack.maxChargeA != before.maxChargeA || pack.maxDischargeA != before.maxDischargeA ||
+     pack.maxChargeEndV != before.maxChargeEndV)
+    mcuStats.dirty |= MCU_STATS_DIRTY_DATA5;
+  if(pack.modCellHiVolt != before.modCellHiVolt || pack.modCellLoVolt != before.modCellLoVolt)
+    mcuStats.dirty |= MCU_STATS_DIRTY_DATA8;
+  if(pack.modCellHiTemp != before.modCellHiTemp || pack.modCellLoTemp != before.modCellLoTemp)
+    mcuStats.dirty |= MCU_STATS_DIRTY_DATA9;
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: Statistics Functions                                  P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ S t a t s I n i t                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_StatsInit(void)
+{
+  memset(&mcuStats, 0, sizeof(mcuStats));
+  mcuStats.rebuild = true;
+  mcuStats.refresh = true;
+  mcuStats.dirty   = MCU_STATS_DIRTY_ALL;
+}
+
+/***************************************************************************************************************
+*     M C U _ S t a t s M o d u l e C h a n g e d                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_StatsModuleChanged(uint8_t moduleIndex)
+{
+  // new status, new limits or a fault raised/cleared - recompute on the next MCU_UpdateStats()
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+  mcuStats.staleMask |= (1UL << moduleIndex);
+}
+
+/***************************************************************************************************************
+*     M C U _ S t a t s M o d u l e s C h a n g e d                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_StatsModulesChanged(uint32_t moduleMask)
+{
+  // modules entered or left service - the module count changes with them
+  mcuStats.staleMask |= moduleMask;
+  mcuStats.refresh = true;
+}
+
+/***************************************************************************************************************
+*     M C U _ U p d a t e S t a t s                                               P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_UpdateStats(void)
+{
+  uint32_t stale;
+
+  // modules marked while this runs (over current) are picked up on the next pass
+  stale = mcuStats.staleMask;
+  mcuStats.staleMask = 0;
+  for(; stale != 0; stale &= stale - 1){
+    MCU_StatsRefreshModule(__builtin_ctz(stale));
+  }
+
+  // modules joined or left the aggregates - one compaction and kernel pass however many
+  if(mcuStats.rebuild){
+    mcuStats.rebuild = false;
+    ModuleStats_Compact(&mcuStats.summary, mcuStats.row, mcuStats.entry, mcuStats.activeMask);
+    ModuleStats_Pass(&mcuStats.summary, &mcuStats.totals);
+  }
+
+  if(mcuStats.refresh){
+    mcuStats.refresh = false;
+    MCU_StatsDerivePack();
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ S t a t s T a k e D i r t y                                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+uint8_t MCU_StatsTakeDirty(void)
+{
+  uint8_t dirty = mcuStats.dirty;
+
+  mcuStats.dirty = 0;
+  return dirty;
+}
@@ -0,0 +1,267 @@
+/***************************************************************************************************************
+ * @file           : mcu_telem.c                                                   P A C K   C O N T R O L L E R
+ * @brief          : Per module status history - full rate and 1 s / 10 s / 60 s min/max/avg.
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ **************************************************************************************************************/
+// Include files
+#include "main.h"
+#include "mcu.h"
+#include "bms.h"
+#include "stdio.h"
+#include "string.h"
+#include "debug.h"
+#include "mcu_telem.h"
+
+/***************************************************************************************************************
+*
+*                               Section: Global Data Definitions                   P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+mcuTelemModule_t mcuTelem[MAX_MODULES_PER_PACK];
+mcuTelemQuery_t  mcuTelemQuery;
+
+// indexed by tier - TELEM_TIER_RAW first
+static const uint8_t  mcuTelemDepth[MCU_TELEM_TIERS + 1]  = { MCU_TELEM_RAW_DEPTH, MCU_TELEM_1S_DEPTH, MCU_TELEM_10S_DEPTH, MCU_TELEM_60S_DEPTH };
+static const uint8_t  mcuTelemBase[MCU_TELEM_TIERS + 1]   = { 0, 0, MCU_TELEM_1S_DEPTH, MCU_TELEM_1S_DEPTH + MCU_TELEM_10S_DEPTH };
+static const uint32_t mcuTelemPeriod[MCU_TELEM_TIERS + 1] = { 0, 1000, 10000, 60000 };
+
+static mcuTelemEntry_t* MCU_TelemSlot(uint8_t moduleIndex, uint8_t tier, uint8_t position);
+static void MCU_TelemPush(uint8_t moduleIndex, uint8_t tier, const mcuTelemEntry_t* entry);
+static void MCU_TelemClose(uint8_t moduleIndex, uint8_t tier);
+
+
+/***************************************************************************************************************
+*
+*                   Section: Application Local Functions                           P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ T e l e m S l o t                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static mcuTelemEntry_t* MCU_TelemSlot(uint8_t moduleIndex, uint8_t tier, uint8_t position)
+{
+  if(tier == TELEM_TIER_RAW) return &mcuTelem[moduleIndex].raw[position];
+  return &mcuTelem[moduleIndex].tier[mcuTelemBase[tier] + position];
+}
+
+/***************************************************************************************************************
+*     M C U _ T e l e m P u s h                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_TelemPush(uint8_t moduleIndex, uint8_t tier, const mcuTelemEntry_t* entry)
+{
+  mcuTelemModule_t* history = &mcuTelem[moduleIndex];
+
+  *MCU_TelemSlot(moduleIndex, tier, history->head[tier]) = *entry;
+  if(++history->head[tier] == mcuTelemDepth[tier]) history->head[tier] = 0;
+  if(history->count[tier] < mcuTelemDepth[tier]) history->count[tier]++;
+  history->written[tier]++;
+}
+
+/***************************************************************************************************************
+*     M C U _ T e l e m C l o s e                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static void MCU_TelemClose(uint8_t moduleIndex, uint8_t tier)
+{
+  mcuTelemOpen_t* open = &mcuTelem[moduleIndex].open[tier - 1];
+
+  open->entry.voltAvg = open->voltSum / open->count;
+  open->entry.currAvg = open->currSum / open->count;
+  open->entry.soc     = open->socSum / open->count;
+  open->entry.samples = (open->count > 255) ? 255 : open->count;
+  MCU_TelemPush(moduleIndex, tier, &open->entry);
+  open->count = 0;
+}
+
+
+/***************************************************************************************************************
+*
+*                   Section: Status History Functions                              P A C K   C O N T R O L L E R
+*
+***************************************************************************************************************/
+
+/***************************************************************************************************************
+*     M C U _ T e l e m I n i t                                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_TelemInit(void)
+{
+  memset(mcuTelem, 0, sizeof(mcuTelem));
+  memset(&mcuTelemQuery, 0, sizeof(mcuTelemQuery));
+}
+
+/***************************************************************************************************************
+*     M C U _ T e l e m R e c o r d                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_TelemRecord(uint8_t moduleIndex, const moduleStatus* status, uint32_t now)
+{
+  mcuTelemEntry_t sample;
+  mcuTelemOpen_t* open;
+  uint32_t start;
+  uint8_t  tier;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK) return;
+
+  sample.time       = now;
+  sample.voltMin    = status->mmv;
+  sample.voltMax    = status->mmv;
+  sample.voltAvg    = status->mmv;
+  sample.currMin    = status->mmc;
+  sample.currMax    = status->mmc;
+  sample.currAvg    = status->mmc;
+  sample.cellLoVolt = status->cellLoVolt;
+  sample.cellHiVolt = status->cellHiVolt;
+  sample.cellLoTemp = status->cellLoTemp;
+  sample.cellHiTemp = status->cellHiTemp;
+  sample.soc        = status->soc;
+  sample.samples    = 1;
+  MCU_TelemPush(moduleIndex, TELEM_TIER_RAW, &sample);
+
+  for(tier = TELEM_TIER_1S; tier <= MCU_TELEM_TIERS; tier++){
+    open  = &mcuTelem[moduleIndex].open[tier - 1];
+    start = now - (now % mcuTelemPeriod[tier]);
+
+    // the first set of a later period closes the one being collected
+    if(open->count > 0 && open->entry.time != start) MCU_TelemClose(moduleIndex, tier);
+
+    if(open->count == 0){
+      open->entry      = sample;
+      open->entry.time = start;
+      open->voltSum    = 0;
+      open->currSum    = 0;
+      open->socSum     = 0;
+    } else {
+      if(sample.voltMin    < open->entry.voltMin)    open->entry.voltMin    = sample.voltMin;
+      if(sample.voltMax    > open->entry.voltMax)    open->entry.voltMax    = sample.voltMax;
+      if(sample.currMin    < open->entry.currMin)    open->entry.currMin    = sample.currMin;
+      if(sample.currMax    > open->entry.currMax)    open->entry.currMax    = sample.currMax;
+      if(sample.cellLoVolt < open->entry.cellLoVolt) open->entry.cellLoVolt = sample.cellLoVolt;
+      if(sample.cellHiVolt > open->entry.cellHiVolt) open->entry.cellHiVolt = sample.cellHiVolt;
+      if(sample.cellLoTemp < open->entry.cellLoTemp) open->entry.cellLoTemp = sample.cellLoTemp;
+      if(sample.cellHiTemp > open->entry.cellHiTemp) open->entry.cellHiTemp = sample.cellHiTemp;
+    }
+    // the sums hold 65535 sets of 16 bit values
+    if(open->count < 0xFFFF){
+      open->voltSum += sample.voltAvg;
+      open->currSum += sample.currAvg;
+      open->socSum  += sample.soc;
+      open->count++;
+    }
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ T e l e m M o d u l e s J o i n e d                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_TelemModulesJoined(uint32_t moduleMask)
+{
+  uint32_t modules;
+  uint8_t  index;
+
+  // a new module in the slot starts a new history
+  for(modules = moduleMask; modules != 0; modules &= modules - 1){
+    index = __builtin_ctz(modules);
+    memset(&mcuTelem[index], 0, sizeof(mcuTelem[index]));
+    if(mcuTelemQuery.active && mcuTelemQuery.moduleIndex == index) mcuTelemQuery.active = false;
+  }
+}
+
+/***************************************************************************************************************
+*     M C U _ T e l e m E n t r y                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+bool MCU_TelemEntry(uint8_t moduleIndex, uint8_t tier, uint8_t entry, mcuTelemEntry_t* out)
+{
+  mcuTelemModule_t* history;
+  uint8_t position;
+
+  if(moduleIndex >= MAX_MODULES_PER_PACK || tier > MCU_TELEM_TIERS) return false;
+  history = &mcuTelem[moduleIndex];
+  if(entry >= history->count[tier]) return false;
+
+  // entry 0 is the newest, just behind the write position
+  position = history->head[tier] + mcuTelemDepth[tier] - 1 - entry;
+  if(position >= mcuTelemDepth[tier]) position -= mcuTelemDepth[tier];
+  *out = *MCU_TelemSlot(moduleIndex, tier, position);
+  return true;
+}
+
+/***************************************************************************************************************
+*     M C U _ T e l e m Q u e r y S t a r t                                        P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void MCU_TelemQueryStart(uint8_t moduleId, uint8_t tier, uint8_t firstEntry, uint8_t entryCount)
+{
+  uint8_t moduleIndex = MCU_ModuleIndexFromId(moduleId);
+  uint8_t available;
+
+  mcuTelemQuery.active = false;
+  if(moduleIndex >= MAX_MODULES_PER_PACK || tier > MCU_TELEM_TIERS){
+    if((debugLevel & (DBG_VCU + DBG_ERRORS)) == (DBG_VCU + DBG_ERRORS)){ sprintf(tempBuffer,"VCU RX ERROR - telemetry request for module 0x%02x tier %d", moduleId, tier); serialOut(tempBuffer);}
+    return;
+  }
+  available = mcuTelem[moduleIndex].count[tier];
+  if(firstEntry >= available) return;
+
+  mcuTelemQuery.moduleIndex = moduleIndex;
+  mcuTelemQuery.moduleId    = moduleId;
+  mcuTelemQuery.tier        = tier;
+  mcuTelemQuery.entry       = firstEntry;
+  mcuTelemQuery.end         = (entryCount == 0 || entryCount > available - firstEntry) ? available : firstEntry + entryCount;
+  mcuTelemQuery.page        = TELEM_PAGE_VOLTAGE;
+  mcuTelemQuery.written     = mcuTelem[moduleIndex].written[tier];
+  mcuTelemQuery.active      = true;
+}
+
+/***************************************************************************************************************
+*     M C U _ T e l e m Q u e r y N e x t                                          P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+bool MCU_TelemQueryNext(CANFRM_0x418_MODULE_TELEMETRY* frame, uint32_t now)
+{
+  mcuTelemEntry_t entry;
+  uint16_t shift;
+  uint32_t age;
+
+  if(!mcuTelemQuery.active) return false;
+
+  // entries recorded since the request push the ones still to send further back
+  shift = mcuTelem[mcuTelemQuery.moduleIndex].written[mcuTelemQuery.tier] - mcuTelemQuery.written;
+  if(shift >= mcuTelemDepth[mcuTelemQuery.tier] ||
+     !MCU_TelemEntry(mcuTelemQuery.moduleIndex, mcuTelemQuery.tier, mcuTelemQuery.entry + shift, &entry)){
+    mcuTelemQuery.active = false;     // overwritten
+    return false;
+  }
+
+  frame->module_id = mcuTelemQuery.moduleId;
+  frame->tier      = mcuTelemQuery.tier;
+  frame->page      = mcuTelemQuery.page;
+  frame->entry     = mcuTelemQuery.entry;
+  switch(mcuTelemQuery.page){
+    case TELEM_PAGE_VOLTAGE:
+      frame->value_0 = entry.voltMin;
+      frame->value_1 = entry.voltMax;
+      frame->value_2 = entry.voltAvg;
+      break;
+    case TELEM_PAGE_CURRENT:
+      frame->value_0 = entry.currMin;
+      frame->value_1 = entry.currMax;
+      frame->value_2 = entry.currAvg;
+      break;
+    case TELEM_PAGE_CELL_VOLT:
+      frame->value_0 = entry.cellLoVolt;
+      frame->value_1 = entry.cellHiVolt;
+      frame->value_2 = entry.soc | (entry.samples << 8);
+      break;
+    default:
+      age = (now - entry.time) / 100;
+      frame->value_0 = entry.cellLoTemp;
+      frame->value_1 = entry.cellHiTemp;
+      frame->value_2 = (age > 0xFFFF) ? 0xFFFF : age;
+      break;
+  }
+
+  if(++mcuTelemQuery.page == TELEM_PAGES){
+    mcuTelemQuery.page = TELEM_PAGE_VOLTAGE;
+    if(++mcuTelemQuery.entry >= mcuTelemQuery.end) mcuTelemQuery.active = false;
+  }
+  return true;
+}
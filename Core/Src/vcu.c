@@ -16,6 +16,11 @@
 #include "stdio.h"
 #include "../../protocols/can_frm_vcu.h"
 #include "eeprom_emul.h"
+#include "eeprom_data.h"
+#include "fixed_signal.h"
+#include "mcu_balance.h"
+#include "mcu_sched.h"
+#include "mcu_telem.h"
 
 
 /***************************************************************************************************************
@@ -30,6 +35,9 @@ CAN_TX_FIFO_EVENT vcu_txFlags;
 CAN_TX_MSGOBJ vcu_txObj;
 uint8_t vcu_txd[MAX_DATA_BYTES];
 
+// Frames waiting for the VCU TX FIFO, by traffic class
+canTxQueue_t vcuTxQueue;
+
 // Receive objects
 CAN_RX_FIFO_CONFIG vcu_rxConfig;
 REG_CiFLTOBJ vcu_fObj;
@@ -62,6 +70,7 @@ void VCU_RequestTime(void);
 void VCU_ProcessReadEeprom(void);
 void VCU_ProcessWriteEeprom(void);
 void VCU_ProcessVcuRequestModuleList(void);
+void VCU_ProcessVcuRequestTelemetry(void);
 
 void VCU_TransmitModuleState(void);
 void VCU_TransmitModulePower(void);
@@ -70,6 +79,7 @@ void VCU_TransmitModuleCellTemp(void);
 void VCU_TransmitModuleCellId(void);
 void VCU_TransmitModuleLimits(void);
 void VCU_TransmitModuleList(void);
+void VCU_TransmitTelemetry(void);
 
 
 extern batteryPack pack;
@@ -116,6 +126,8 @@ void VCU_ReceiveMessages(void)
         VCU_ProcessVcuKeepAlive();
     } else if(vcu_rxObj.bF.id.SID == ID_VCU_REQUEST_MODULE_LIST + pack.vcuCanOffset){
         VCU_ProcessVcuRequestModuleList();
+    } else if(vcu_rxObj.bF.id.SID == ID_VCU_REQUEST_TELEMETRY + pack.vcuCanOffset){
+        VCU_ProcessVcuRequestTelemetry();
     } else {
        // Unknown Message
         if((debugLevel & ( DBG_VCU + DBG_ERRORS))==( DBG_VCU + DBG_ERRORS)){ sprintf(tempBuffer,"VCU RX UNKNOWN SID=0x%03x : EID=0x%08x : Byte[0..7]=0x%02x 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x",vcu_rxObj.bF.id.SID,vcu_rxObj.bF.id.EID,vcu_rxd[0],vcu_rxd[1],vcu_rxd[2],vcu_rxd[3],vcu_rxd[4],vcu_rxd[5],vcu_rxd[6],vcu_rxd[7]); serialOut(tempBuffer);}
@@ -130,27 +142,8 @@ void VCU_ReceiveMessages(void)
 /***************************************************************************************************************
 *     V C U _ T r a n s m i t M e s s a g e Q u e u e                              P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
-void VCU_TransmitMessageQueue(CANFDSPI_MODULE_ID index)
+void VCU_TransmitMessageQueue(uint8_t txClass)
 {
-  uint8_t attempts = MAX_TXQUEUE_ATTEMPTS;
-
-  // Check if FIFO is not full
-  do {
-    DRV_CANFDSPI_TransmitChannelEventGet(index, VCU_TX_FIFO, &vcu_txFlags);
-    if (attempts == 0) {
-      Nop();
-      Nop();
-      DRV_CANFDSPI_ErrorCountStateGet(index, &vcu_tec, &vcu_rec, &vcu_errorFlags);
-      if((debugLevel & ( DBG_VCU + DBG_ERRORS))==( DBG_VCU + DBG_ERRORS)){ sprintf(tempBuffer,"VCU TX ERROR - FIFO Full! Check CAN Connection."); serialOut(tempBuffer);}
-
-      //Flush channel
-      DRV_CANFDSPI_TransmitChannelFlush(index, VCU_TX_FIFO);
-      return;
-    }
-    attempts--;
-  }
-  while (!(vcu_txFlags & CAN_TX_FIFO_NOT_FULL_EVENT));
-
   // Load message and transmit
   uint8_t n = DRV_CANFDSPI_DlcToDataBytes(vcu_txObj.bF.ctrl.DLC);
   
@@ -161,7 +154,34 @@ void VCU_TransmitMessageQueue(CANFDSPI_MODULE_ID index)
       serialOut(tempBuffer);
   }
 
-  DRV_CANFDSPI_TransmitChannelLoad(index, VCU_TX_FIFO, &vcu_txObj, vcu_txd, n, true);
+  // The frame waits in RAM until the TX FIFO has room - only a full class ring loses it
+  if (!CanTxQueue_Send(&vcuTxQueue, txClass, &vcu_txObj, vcu_txd, n)) {
+    pack.errorCounts.vcuTxDrop++;
+    DRV_CANFDSPI_ErrorCountStateGet(VCU_CAN, &vcu_tec, &vcu_rec, &vcu_errorFlags);
+    if((debugLevel & ( DBG_VCU + DBG_ERRORS))==( DBG_VCU + DBG_ERRORS)){ sprintf(tempBuffer,"VCU TX ERROR - Queue Full! Check CAN Connection. TEC=%d REC=%d",vcu_tec,vcu_rec); serialOut(tempBuffer);}
+  }
+}
+
+/***************************************************************************************************************
+*     V C U _ T x R e f i l l                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void VCU_TxRefill(void)
+{
+  CanTxQueue_Refill(&vcuTxQueue);
+}
+
+/***************************************************************************************************************
+*     V C U _ S e t C a n O f f s e t                                              P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void VCU_SetCanOffset(uint16_t offset)
+{
+  if(offset == pack.vcuCanOffset) return;
+
+  // The VCU bus filters pass only this pack's IDs - move them with the offset
+  pack.vcuCanOffset = offset;
+  if(CanChannels_Filter(VCU_CAN, &vcuChannelMap) != 0){
+    if(debugLevel & DBG_ERRORS){ sprintf(tempBuffer,"VCU CAN FILTER ERROR OFFSET 0x%03x", offset); serialOut(tempBuffer);}
+  }
 }
 
 
@@ -197,6 +217,9 @@ void VCU_ProcessVcuCommand(void){
   // pack hv bus voltage is encoder the same as vcu so no need to convert it
   pack.vcuHvBusVoltage = command.vcu_hv_bus_voltage;
 
+  // cell balancing for the whole pack
+  MCU_BalancePackControl(command.vcu_cell_balance_ctrl);
+
 
   if(pack.vcuRequestedState != command.vcu_contactor_ctrl){
 
@@ -255,14 +278,15 @@ void VCU_ProcessVcuModuleCommand(void){
     if((debugLevel & (DBG_VCU + DBG_ERRORS)) == (DBG_VCU + DBG_ERRORS)) {sprintf(tempBuffer,"VCU RX ERROR - VCU_ProcessVcuModuleCommand - Invalid ID 0x%02x", pack.dmcModuleId); serialOut(tempBuffer);}
   } else {
 
-    if(module[moduleIndex].currentState != moduleCommand.module_contactor_ctrl){
+    if(moduleCtl.currentState[moduleIndex] != moduleCommand.module_contactor_ctrl){
       // State Change! Set requested state
-      module[moduleIndex].nextState = moduleCommand.module_contactor_ctrl;
+      moduleCtl.nextState[moduleIndex] = moduleCommand.module_contactor_ctrl;
     }
+    // cell balancing for this module only
+    MCU_BalanceModuleControl(moduleIndex, moduleCommand.module_cell_balance_ctrl);
 /*
  * NOT YET IMPLEMENTED
  *
- * moduleCommand.module_cell_balance_ctrl
  * moduleCommand.module_hv_bus_actv_iso
  * moduleCommand.vcu_hv_bus_voltage
  *
@@ -388,7 +412,7 @@ void VCU_ProcessReadEeprom(void){
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_EEPROM_DATA",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_POLL);           // Send it
   } else {
     // EEPROM error
     if(debugLevel  & DBG_ERRORS) {sprintf(tempBuffer,"EEPROM READ ERROR EESTATUS 0x%03x ",eeStatus); serialOut(tempBuffer);}
@@ -454,12 +478,13 @@ void VCU_ProcessWriteEeprom(void){
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_EEPROM_DATA",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_POLL);           // Send it
   } else {
     // EEPROM error
     if(debugLevel  & DBG_ERRORS) {sprintf(tempBuffer,"EEPROM WRITE ERROR EESTATUS 0x%02x",eeStatus ); serialOut(tempBuffer);}
   }
- // Reboot the Pack Controller to reload data from eeprom
+ // Reboot the Pack Controller to reload data from eeprom - a new pack ID moves the VCU IDs and filters
+ // here, after the reply above was queued at the old ones, and the modules re-register under it
  PCU_Initialize();
 }
 
@@ -472,6 +497,22 @@ void VCU_ProcessVcuRequestModuleList(void)
 
 }
 
+/***************************************************************************************************************
+*    V C U _ P r o c e s s V c u R e q u e s t T e l e m e t r y                   P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void VCU_ProcessVcuRequestTelemetry(void)
+{
+  CANFRM_0x40B_VCU_REQUEST_TELEMETRY request;
+
+  memset(&request,0,sizeof(request));
+  memcpy(&request, vcu_rxd, sizeof(request));
+
+  if((debugLevel & DBG_VCU) == DBG_VCU){ sprintf(tempBuffer,"VCU RX 0x%03x VCU Request Telemetry - module 0x%02x tier %d", vcu_rxObj.bF.id.SID, request.module_id, request.tier); serialOut(tempBuffer);}
+
+  // the reply goes out a few frames per pass from VCU_TransmitTelemetry()
+  MCU_TelemQueryStart(request.module_id, request.tier, request.first_entry, request.entry_count);
+}
+
 /***************************************************************************************************************
 *    V C U _ T i c k s S i n c e L a s t M e s s a g e                             P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
@@ -504,13 +545,8 @@ void VCU_TransmitBmsState(void){
 
   CANFRM_0x410_BMS_STATE bmsState;
 
-  float   floatValue  = 0;
-  float   vcuValue    = 0;
-
   //SOH
-  floatValue = PERCENTAGE_BASE + (PERCENTAGE_FACTOR * pack.soh);
-  vcuValue = (floatValue/VCU_SOH_PERCENTAGE_FACTOR) - (VCU_SOH_PERCENTAGE_BASE/VCU_SOH_PERCENTAGE_FACTOR);
-  bmsState.bms_soh = vcuValue;
+  bmsState.bms_soh = FXS_CONVERT(pack.soh, PERCENTAGE, VCU_SOH_PERCENTAGE);
 
   bmsState.bms_state                = pack.state;
   bmsState.bms_status               = pack.status;
@@ -542,7 +578,7 @@ void VCU_TransmitBmsState(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_STATE",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_SAFETY);         // Send it
 }
 
 
@@ -558,22 +594,11 @@ void VCU_TransmitBmsData1(void){
 
   CANFRM_0x421_BMS_DATA_1 bmsData1;
 
-  float   floatValue  = 0;
-  float   vcuValue    = 0;
-
-  // Current
-  // To convert from 16-bit module value to current (Amps), current = base + (16-bit value * factor). Remember offset is -ve
-  floatValue = PACK_CURRENT_BASE + (PACK_CURRENT_FACTOR * pack.current);
-  // To convert a current(Amps) to a 16-bit VCU value, VCU value  = (current/factor) - (base/factor). Remember offset is -ve
-  vcuValue = (floatValue/VCU_CURRENT_FACTOR)-(VCU_CURRENT_BASE/VCU_CURRENT_FACTOR);
-  bmsData1.bms_pack_current = vcuValue;
+  // Current - pack and VCU share the encoding, converted anyway so a change to either stays correct
+  bmsData1.bms_pack_current = FXS_CONVERT(pack.current, PACK_CURRENT, VCU_CURRENT);
 
   //Voltage
-  // To convert from 16-bit module value to voltage (Volts), voltage = base + (16-bit value * factor). Remember offset is -ve
-  floatValue = MODULE_VOLTAGE_BASE + (MODULE_VOLTAGE_FACTOR * pack.voltage);
-  // To convert a voltage (Volts) to a 16-bit VCU value, VCU value  = (voltage/factor) - (base/factor). Remember offset is -ve
-  vcuValue = floatValue/VCU_VOLTAGE_FACTOR; // VCU_VOLTAGE_BASE is zero
-  bmsData1.bms_pack_voltage = vcuValue;
+  bmsData1.bms_pack_voltage = FXS_CONVERT(pack.voltage, MODULE_VOLTAGE, VCU_VOLTAGE);
 
   bmsData1.UNUSED_00_31 = 0;
 
@@ -594,7 +619,7 @@ void VCU_TransmitBmsData1(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_DATA_1",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
 }
 
 /***************************************************************************************************************
@@ -610,28 +635,17 @@ void VCU_TransmitBmsData2(void){
 
   CANFRM_0x422_BMS_DATA_2 bmsData2;
 
-  float   floatValue  = 0;
-  float   vcuValue    = 0;
-
-  //SOC
-  floatValue = PERCENTAGE_BASE + (PERCENTAGE_FACTOR * pack.soc);
-  vcuValue = (floatValue/VCU_SOC_PERCENTAGE_FACTOR) - (VCU_SOC_PERCENTAGE_BASE/VCU_SOC_PERCENTAGE_FACTOR);
-  bmsData2.bms_soc = vcuValue;
+  //SOC - the coulomb counted estimate is already in the VCU encoding
+  bmsData2.bms_soc = pack.socEstimate;
 
   //Avg Cell Volt
-  floatValue = CELL_VOLTAGE_BASE + (CELL_VOLTAGE_FACTOR * pack.cellAvgVolt);
-  vcuValue = floatValue/VCU_CELL_VOLTAGE_FACTOR- (VCU_CELL_VOLTAGE_BASE/VCU_CELL_VOLTAGE_FACTOR);
-  bmsData2.bms_avg_cell_volt = vcuValue;
+  bmsData2.bms_avg_cell_volt = FXS_CONVERT(pack.cellAvgVolt, CELL_VOLTAGE, VCU_CELL_VOLTAGE);
 
   //High Cell Volt
-  floatValue = CELL_VOLTAGE_BASE + (CELL_VOLTAGE_FACTOR * pack.cellHiVolt);
-  vcuValue = (floatValue/VCU_CELL_VOLTAGE_FACTOR) - (VCU_CELL_VOLTAGE_BASE/VCU_CELL_VOLTAGE_FACTOR);
-  bmsData2.bms_high_cell_volt = vcuValue;
+  bmsData2.bms_high_cell_volt = FXS_CONVERT(pack.cellHiVolt, CELL_VOLTAGE, VCU_CELL_VOLTAGE);
 
   //Low Cell Volt
-  floatValue = CELL_VOLTAGE_BASE + (CELL_VOLTAGE_FACTOR * pack.cellLoVolt);
-  vcuValue = (floatValue/VCU_CELL_VOLTAGE_FACTOR) - (VCU_CELL_VOLTAGE_BASE/VCU_CELL_VOLTAGE_FACTOR);
-  bmsData2.bms_low_cell_volt = vcuValue;
+  bmsData2.bms_low_cell_volt = FXS_CONVERT(pack.cellLoVolt, CELL_VOLTAGE, VCU_CELL_VOLTAGE);
 
 
   // clear bit fields
@@ -651,7 +665,7 @@ void VCU_TransmitBmsData2(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_DATA_2",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
 }
 
 /***************************************************************************************************************
@@ -667,23 +681,14 @@ void VCU_TransmitBmsData3(void){
 
   CANFRM_0x423_BMS_DATA_3 bmsData3;
 
-  float   floatValue  = 0;
-  float   vcuValue    = 0;
-
   //Average Cell Temperature
-  floatValue = TEMPERATURE_BASE + (TEMPERATURE_FACTOR * pack.cellAvgTemp);
-  vcuValue = floatValue/VCU_TEMPERATURE_FACTOR - (VCU_TEMPERATURE_BASE/VCU_TEMPERATURE_FACTOR);
-  bmsData3.bms_avg_cell_temp = vcuValue;
+  bmsData3.bms_avg_cell_temp = FXS_CONVERT(pack.cellAvgTemp, TEMPERATURE, VCU_TEMPERATURE);
 
   //High Cell Temperature
-  floatValue = TEMPERATURE_BASE + (TEMPERATURE_FACTOR * pack.cellHiTemp);
-  vcuValue = floatValue/VCU_TEMPERATURE_FACTOR - (VCU_TEMPERATURE_BASE/VCU_TEMPERATURE_FACTOR);
-  bmsData3.bms_high_cell_temp = vcuValue;
+  bmsData3.bms_high_cell_temp = FXS_CONVERT(pack.cellHiTemp, TEMPERATURE, VCU_TEMPERATURE);
 
   //Low Cell Temperature
-  floatValue = TEMPERATURE_BASE + (TEMPERATURE_FACTOR * pack.cellLoTemp);
-  vcuValue = floatValue/VCU_TEMPERATURE_FACTOR - (VCU_TEMPERATURE_BASE/VCU_TEMPERATURE_FACTOR);
-  bmsData3.bms_low_cell_temp = vcuValue;
+  bmsData3.bms_low_cell_temp = FXS_CONVERT(pack.cellLoTemp, TEMPERATURE, VCU_TEMPERATURE);
 
   bmsData3.UNUSED_48_63 = 0;
 
@@ -704,7 +709,7 @@ void VCU_TransmitBmsData3(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_DATA_3",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
 }
 
 /***************************************************************************************************************
@@ -721,23 +726,14 @@ void VCU_TransmitBmsData5(void){
 
   CANFRM_0x425_BMS_DATA_5 bmsData5;
 
-  float   floatValue  = 0;
-  float   vcuValue    = 0;
-
   //bms_charge_limit
-  floatValue = PACK_CURRENT_BASE + (PACK_CURRENT_FACTOR * pack.maxChargeA);
-  vcuValue = (floatValue/VCU_CURRENT_FACTOR) - (VCU_CURRENT_BASE/VCU_CURRENT_FACTOR);
-  bmsData5.bms_charge_limit = vcuValue;
+  bmsData5.bms_charge_limit = FXS_CONVERT(pack.maxChargeA, PACK_CURRENT, VCU_CURRENT);
 
   //bms_discharge_limit
-  floatValue = PACK_CURRENT_BASE + (PACK_CURRENT_FACTOR * pack.maxDischargeA);
-  vcuValue = (floatValue/VCU_CURRENT_FACTOR) - (VCU_CURRENT_BASE/VCU_CURRENT_FACTOR);
-  bmsData5.bms_dischage_limit = vcuValue;
+  bmsData5.bms_dischage_limit = FXS_CONVERT(pack.maxDischargeA, PACK_CURRENT, VCU_CURRENT);
 
   //bms_charge_end_voltage_limit
-  floatValue = MODULE_VOLTAGE_BASE + (MODULE_VOLTAGE_FACTOR * pack.maxChargeEndV);
-  vcuValue = (floatValue/VCU_VOLTAGE_FACTOR) - (VCU_VOLTAGE_BASE/VCU_VOLTAGE_FACTOR);
-  bmsData5.bms_charge_end_voltage_limit = vcuValue;
+  bmsData5.bms_charge_end_voltage_limit = FXS_CONVERT(pack.maxChargeEndV, MODULE_VOLTAGE, VCU_VOLTAGE);
 
   bmsData5.UNUSED_48_63 = 0;
 
@@ -758,7 +754,7 @@ void VCU_TransmitBmsData5(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_DATA_5",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
 }
 
 /***************************************************************************************************************
@@ -800,7 +796,7 @@ void VCU_TransmitBmsData8(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_DATA_8",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
 }
 
 /***************************************************************************************************************
@@ -840,7 +836,7 @@ void VCU_TransmitBmsData9(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_DATA_9",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
 
 }
 
@@ -877,7 +873,7 @@ void VCU_TransmitBmsData10(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_DATA_10",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
 
 }
 
@@ -889,25 +885,28 @@ void VCU_TransmitBmsData10(void){
 void VCU_TransmitModuleState(void)
 {
   CANFRM_0x411_MODULE_STATE moduleState;
+  moduleStatus snapshot;
 
   uint8_t moduleIndex = MCU_ModuleIndexFromId(pack.dmcModuleId);
-  if (moduleIndex == pack.moduleCount){
+  if (moduleIndex >= MAX_MODULES_PER_PACK){
     // Invalid module Id
     if((debugLevel & (DBG_VCU + DBG_ERRORS)) == (DBG_VCU + DBG_ERRORS)) {sprintf(tempBuffer,"VCU TX ERROR - VCU_TransmitModuleState - Invalid ID 0x%02x", pack.dmcModuleId); serialOut(tempBuffer);}
   } else {
 
+    MCU_ModuleStatusSnapshot(moduleIndex, &snapshot);
+
     // No conversions necessary - VCU uses the same module voltage/current/temperature/percentage base and factor as the module.
     moduleState.module_id                   = pack.dmcModuleId;
-    moduleState.module_soc                  = module[moduleIndex].soc;
-    moduleState.module_state                = module[moduleIndex].currentState;
-    moduleState.module_status               = module[moduleIndex].status;
-    moduleState.module_soh                  = module[moduleIndex].soh;
-    moduleState.module_fault_code           = module[moduleIndex].faultCode.commsError | module[moduleIndex].faultCode.hwIncompatible << 1 | module[moduleIndex].faultCode.overCurrent << 2 | module[moduleIndex].faultCode.overTemperature << 3 | module[moduleIndex].faultCode.overVoltage << 4;
-    moduleState.module_cell_balance_active  = 0;
-    moduleState.module_cell_balance_status  = 0;
+    moduleState.module_soc                  = snapshot.soc;
+    moduleState.module_state                = snapshot.currentState;
+    moduleState.module_status               = snapshot.status;
+    moduleState.module_soh                  = snapshot.soh;
+    moduleState.module_fault_code           = moduleCtl.faultCode[moduleIndex].commsError | moduleCtl.faultCode[moduleIndex].hwIncompatible << 1 | moduleCtl.faultCode[moduleIndex].overCurrent << 2 | moduleCtl.faultCode[moduleIndex].overTemperature << 3 | moduleCtl.faultCode[moduleIndex].overVoltage << 4;
+    moduleState.module_cell_balance_active  = (mcuBalance.activeMask >> moduleIndex) & 1;
+    moduleState.module_cell_balance_status  = (mcuBalance.balancedMask >> moduleIndex) & 1;
     moduleState.module_count_total          = pack.moduleCount;
     moduleState.module_count_active         = pack.activeModules;
-    moduleState.module_cell_count           = module[moduleIndex].cellCount;
+    moduleState.module_cell_count           = snapshot.cellCount;
 
     // clear bit fields
     vcu_txObj.word[0] = 0;                              // Configure transmit message
@@ -926,7 +925,7 @@ void VCU_TransmitModuleState(void)
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x MODULE_STATE",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
   }
 }
 
@@ -937,17 +936,20 @@ void VCU_TransmitModuleState(void)
 void VCU_TransmitModulePower(void)
 {
   CANFRM_0x412_MODULE_POWER modulePower;
+  moduleStatus snapshot;
 
   uint8_t moduleIndex = MCU_ModuleIndexFromId(pack.dmcModuleId);
-  if (moduleIndex == pack.moduleCount){
+  if (moduleIndex >= MAX_MODULES_PER_PACK){
     // Invalid module Id
     if((debugLevel & (DBG_VCU + DBG_ERRORS)) == (DBG_VCU + DBG_ERRORS)) {sprintf(tempBuffer,"VCU TX ERROR - VCU_TransmitModulePower - Invalid ID 0x%02x", pack.dmcModuleId); serialOut(tempBuffer);}
   } else {
 
+    MCU_ModuleStatusSnapshot(moduleIndex, &snapshot);
+
     // No conversions necessary - VCU uses the same module voltage/current/temperature/percentage base and factor as the module.
     modulePower.module_id       = pack.dmcModuleId;
-    modulePower.module_current  = module[moduleIndex].mmc;
-    modulePower.module_voltage  = module[moduleIndex].mmv;
+    modulePower.module_current  = snapshot.mmc;
+    modulePower.module_voltage  = snapshot.mmv;
     modulePower.UNUSED_40_63    = 0;
 
     // clear bit fields
@@ -967,7 +969,7 @@ void VCU_TransmitModulePower(void)
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x MODULE_POWER",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
   }
 }
 
@@ -978,18 +980,21 @@ void VCU_TransmitModulePower(void)
 void VCU_TransmitModuleCellVoltage(void)
 {
   CANFRM_0x413_MODULE_CELL_VOLTAGE moduleCellVoltage;
+  moduleStatus snapshot;
 
   uint8_t moduleIndex = MCU_ModuleIndexFromId(pack.dmcModuleId);
-  if (moduleIndex == pack.moduleCount){
+  if (moduleIndex >= MAX_MODULES_PER_PACK){
     // Invalid module Id
     if(debugLevel &  DBG_VCU & DBG_ERRORS) {sprintf(tempBuffer,"VCU TX ERROR - VCU_TransmitModuleCellVoltage - Invalid ID 0x%02x", pack.dmcModuleId); serialOut(tempBuffer);}
   } else {
 
+    MCU_ModuleStatusSnapshot(moduleIndex, &snapshot);
+
     // No conversions necessary - VCU uses the same module voltage/current/temperature/percentage base and factor as the module.
     moduleCellVoltage.module_id             = pack.dmcModuleId;
-    moduleCellVoltage.module_avg_cell_volt  = module[moduleIndex].cellAvgVolt;
-    moduleCellVoltage.module_high_cell_volt = module[moduleIndex].cellHiVolt;
-    moduleCellVoltage.module_low_cell_volt  = module[moduleIndex].cellLoVolt;
+    moduleCellVoltage.module_avg_cell_volt  = snapshot.cellAvgVolt;
+    moduleCellVoltage.module_high_cell_volt = snapshot.cellHiVolt;
+    moduleCellVoltage.module_low_cell_volt  = snapshot.cellLoVolt;
     moduleCellVoltage.UNUSED_56_63          = 0;
 
     // clear bit fields
@@ -1009,7 +1014,7 @@ void VCU_TransmitModuleCellVoltage(void)
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x MODULE_CELL_VOLTAGE",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
   }
 }
 
@@ -1019,18 +1024,21 @@ void VCU_TransmitModuleCellVoltage(void)
 void VCU_TransmitModuleCellTemp(void)
 {
   CANFRM_0x414_MODULE_CELL_TEMP moduleCellTemp;
+  moduleStatus snapshot;
 
   uint8_t moduleIndex = MCU_ModuleIndexFromId(pack.dmcModuleId);
-  if (moduleIndex == pack.moduleCount){
+  if (moduleIndex >= MAX_MODULES_PER_PACK){
     // Invalid module Id
     if(debugLevel &  DBG_VCU & DBG_ERRORS) {sprintf(tempBuffer,"VCU TX ERROR - VCU_TransmitModuleCellTemp - Invalid ID 0x%02x", pack.dmcModuleId); serialOut(tempBuffer);}
   } else {
 
+    MCU_ModuleStatusSnapshot(moduleIndex, &snapshot);
+
     // No conversions necessary - VCU uses the same module voltage/current/temperature/percentage base and factor as the module.
     moduleCellTemp.module_id             = pack.dmcModuleId;
-    moduleCellTemp.module_avg_cell_temp  = module[moduleIndex].cellAvgTemp;
-    moduleCellTemp.module_high_cell_temp = module[moduleIndex].cellHiTemp;
-    moduleCellTemp.module_low_cell_temp  = module[moduleIndex].cellLoTemp;
+    moduleCellTemp.module_avg_cell_temp  = snapshot.cellAvgTemp;
+    moduleCellTemp.module_high_cell_temp = snapshot.cellHiTemp;
+    moduleCellTemp.module_low_cell_temp  = snapshot.cellLoTemp;
     moduleCellTemp.UNUSED_56_63          = 0;
 
     // clear bit fields
@@ -1050,7 +1058,7 @@ void VCU_TransmitModuleCellTemp(void)
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x MODULE_CELL_TEMP",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
   }
 }
 /***************************************************************************************************************
@@ -1094,7 +1102,7 @@ void VCU_TransmitModuleCellId(void)
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x MODULE_CELL_ID",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
   }
   */
 }
@@ -1134,7 +1142,7 @@ void VCU_TransmitModuleLimits(void)
 
     if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x MODULE_LIMITS",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-    VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_VCU);            // Send it
   }
 
 }
@@ -1153,6 +1161,40 @@ void VCU_TransmitModuleList(void)
 }
 
 
+/***************************************************************************************************************
+*     V C U _ T r a n s m i t T e l e m e t r y                                    P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+void VCU_TransmitTelemetry(void)
+{
+  CANFRM_0x418_MODULE_TELEMETRY telemetry;
+  uint8_t frames;
+
+  for(frames = 0; frames < MCU_TELEM_FRAMES_PER_PASS; frames++){
+    memset(&telemetry, 0, sizeof(telemetry));
+    if(!MCU_TelemQueryNext(&telemetry, MCU_Now())) break;
+
+    // clear bit fields
+    vcu_txObj.word[0] = 0;                              // Configure transmit message
+    vcu_txObj.word[1] = 0;
+    vcu_txObj.word[2] = 0;
+
+    memcpy(vcu_txd, &telemetry, sizeof(telemetry));
+
+    vcu_txObj.bF.id.SID = ID_MODULE_TELEMETRY + pack.vcuCanOffset;   // Standard ID + 0x000 for pack 0, +0x100 for pack 1
+    vcu_txObj.bF.id.EID = 0   ;                         // Extended ID
+
+    vcu_txObj.bF.ctrl.BRS = 0;                          // Bit Rate Switch - use DBR when set, NBR when cleared
+    vcu_txObj.bF.ctrl.DLC = CAN_DLC_8;                  // 8 bytes to transmit
+    vcu_txObj.bF.ctrl.FDF = 0;                          // Frame Data Format - CAN FD when set, CAN 2.0 when cleared
+    vcu_txObj.bF.ctrl.IDE = 0;                          // ID Extension selection - send base frame when cleared, extended frame when set
+
+    if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x MODULE_TELEMETRY",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
+
+    VCU_TransmitMessageQueue(CAN_TX_CLASS_BULK);           // Send it
+  }
+}
+
+
 /***************************************************************************************************************
 *     V C U _ R e q u e s t T i m e                                                P A C K   C O N T R O L L E R
 ***************************************************************************************************************/
@@ -1177,7 +1219,7 @@ void VCU_RequestTime(void){
 
   if(debugLevel &  DBG_VCU) {sprintf(tempBuffer,"VCU TX 0x%03x BMS_REQUEST_TIME",vcu_txObj.bF.id.SID); serialOut(tempBuffer);}
 
-  VCU_TransmitMessageQueue(VCU_CAN);                     // Send it
+  VCU_TransmitMessageQueue(CAN_TX_CLASS_POLL);           // Send it
 
 }
 
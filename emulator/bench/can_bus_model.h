@@ -0,0 +1,67 @@
+/******************************************************************************
+ * @file    can_bus_model.h
+ * @brief   CAN frame timing shared by the host benchmarks
+ * @author  Pack Emulator Development Team
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#ifndef CAN_BUS_MODEL_H
+#define CAN_BUS_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const uint32_t BUS_BITRATE = 500000;     // MCP2517FD nominal rate (CAN_500K_2M)
+static const uint32_t BUS_DATA_BITRATE = 2000000;   // MCP2517FD data rate with BRS set (CAN_500K_2M)
+
+// Worst-case extended data frame length in bits including stuff bits and IFS
+static inline uint32_t FrameBits(uint8_t dlc) {
+    // SOF + 11 ID + SRR + IDE + 18 ID + RTR + r1 + r0 + 4 DLC + data + 15 CRC
+    uint32_t stuffed = 1 + 11 + 1 + 1 + 18 + 1 + 2 + 4 + 8u * dlc + 15;
+    uint32_t stuffBits = (stuffed - 1) / 4;
+    // CRC delimiter + ACK slot + ACK delimiter + EOF + intermission
+    return stuffed + stuffBits + 1 + 2 + 7 + 3;
+}
+
+static inline uint32_t FrameTimeUs(uint8_t dlc) {
+    return (FrameBits(dlc) * 1000000u + BUS_BITRATE - 1) / BUS_BITRATE;
+}
+
+// CAN FD payload lengths the DLC can express - shorter payloads are padded up
+static inline uint8_t FdLength(uint8_t bytes) {
+    static const uint8_t lengths[] = { 12, 16, 20, 24, 32, 48, 64 };
+    if (bytes <= 8) return bytes;
+    for (size_t i = 0; i < sizeof(lengths); i++) {
+        if (bytes <= lengths[i]) return lengths[i];
+    }
+    return 64;
+}
+
+// Worst-case CAN FD extended frame with BRS - returns arbitration phase bits and data phase bits
+static inline void FdFrameBits(uint8_t bytes, uint32_t* nominalBits, uint32_t* dataBits) {
+    uint8_t length = FdLength(bytes);
+    // SOF + 11 ID + SRR + IDE + 18 ID + RRS + FDF + res + BRS at the nominal rate
+    uint32_t head = 1 + 11 + 1 + 1 + 18 + 1 + 1 + 1 + 1;
+    // ESI + 4 DLC + data at the data rate, dynamic stuffing
+    uint32_t body = 1 + 4 + 8u * length;
+    // stuff count + CRC17/21 with a fixed stuff bit every 4 bits
+    uint32_t crc = 4 + (length <= 16 ? 17 : 21);
+    *nominalBits = head + (head - 1) / 4
+                 // CRC delimiter + ACK slot + ACK delimiter + EOF + intermission
+                 + 1 + 2 + 7 + 3;
+    *dataBits = body + body / 4 + crc + (crc + 3) / 4;
+}
+
+static inline uint32_t FdFrameTimeUs(uint8_t bytes) {
+    uint32_t nominalBits, dataBits;
+    FdFrameBits(bytes, &nominalBits, &dataBits);
+    return (nominalBits * 1000000u + BUS_BITRATE - 1) / BUS_BITRATE +
+           (dataBits * 1000000u + BUS_DATA_BITRATE - 1) / BUS_DATA_BITRATE;
+}
+
+static inline uint32_t ExtId(uint16_t baseId, uint8_t moduleId) {
+    return ((uint32_t)baseId << 18) | moduleId;
+}
+
+#endif // CAN_BUS_MODEL_H
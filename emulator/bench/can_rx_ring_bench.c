@@ -0,0 +1,312 @@
+/******************************************************************************
+ * @file    can_rx_ring_bench.c
+ * @brief   Stress test of the CAN RX ring (can_rx_ring.h) between two threads
+ * @author  Pack Emulator Development Team
+ *
+ * The ring hands frames from the CAN2 RX interrupt to the main loop with no
+ * lock. Here the two sides run on separate threads, so the acquire/release
+ * ordering is exercised on real parallel hardware rather than by interrupt
+ * preemption on one core:
+ *
+ *   producer   bursts of 1-96 frames (up to a 32 module status burst), each
+ *              stamped with a sequence number and a payload derived from it,
+ *              reserved, filled and committed the way MCU_RxDrain() does
+ *   consumer   peeks, checks the payload, releases - and now and then stalls
+ *              the way a long main loop pass does, so the ring fills and drops,
+ *              or flushes the ring the way a pack ID write re-initializing does
+ *
+ * Fails (exit code 1) if the consumer sees a frame out of order, twice, or
+ * with a payload that does not match its sequence number (a slot reused while
+ * it was being read), or if frames consumed + drops + flushed != frames
+ * produced, or the drops and flushed frames are not exactly the gaps in the
+ * sequence the consumer saw.
+ *
+ * Whether the stress run fills the ring depends on how the threads are
+ * scheduled, so a second two thread test fills it on purpose: the consumer is
+ * held until the producer has committed the ring depth plus a few frames, then
+ * drains. The drops must be exactly the frames past the depth, and the
+ * consumer must see the first CAN_RX_RING_SIZE of each round in order, once.
+ *
+ * Also checks the ring single threaded across the 32 bit counter wrap, and
+ * times a push and pop.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "can_rx_ring.h"
+
+#define BENCH_FRAMES        20000000u
+#define BENCH_BURST_MAX     96          // three frames from each of 32 modules
+#define BENCH_STALL_EVERY   50000       // frames between consumer stalls
+#define BENCH_STALL_SPIN    200000      // consumer stall length, spin iterations
+#define BENCH_FLUSH_EVERY   70001       // frames between consumer flushes
+#define BENCH_TIMED         10000000u
+#define BENCH_FULL_ROUNDS   64          // consumer stalls in the full ring test
+#define BENCH_FULL_EXTRA    37          // frames past the depth vary 1-37 a round
+
+static canRxRing_t ring;
+static volatile bool producerDone;
+static volatile uint32_t fullStage;     // full ring test handshake - even: producer's turn, odd: consumer's
+
+typedef struct {
+    uint64_t consumed;
+    uint64_t flushed;                   // frames released unread by CanRxRing_Flush()
+    uint64_t gaps;                      // frames missing from the sequence
+    uint64_t badOrder;
+    uint64_t badPayload;
+} consumerResult_t;
+
+/* ------------------------------------------------------------------ frames */
+
+static uint32_t Rng(uint32_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void FillFrame(canRxFrame_t* frame, uint32_t seq)
+{
+    frame->obj.word[0] = seq & 0x1FFFFFFF;          // SID/EID bits
+    frame->obj.word[1] = CAN_DLC_64;
+    frame->obj.word[2] = seq;                       // time stamp word carries the sequence
+    for (int i = 0; i < MAX_DATA_BYTES; i++) frame->data[i] = (uint8_t)(seq * 131 + i);
+}
+
+static bool CheckFrame(const canRxFrame_t* frame, uint32_t seq)
+{
+    if (frame->obj.word[0] != (seq & 0x1FFFFFFF) || frame->obj.word[1] != CAN_DLC_64) return false;
+    for (int i = 0; i < MAX_DATA_BYTES; i++) {
+        if (frame->data[i] != (uint8_t)(seq * 131 + i)) return false;
+    }
+    return true;
+}
+
+/* ----------------------------------------------------------------- threads */
+
+static void* Producer(void* arg)
+{
+    uint32_t rng = 0x2545F491;
+    uint32_t seq = 0;
+
+    (void)arg;
+    while (seq < BENCH_FRAMES) {
+        // one interrupt - a burst, then the bus goes quiet for a while
+        uint32_t burst = 1 + Rng(&rng) % BENCH_BURST_MAX;
+        for (uint32_t n = 0; n < burst && seq < BENCH_FRAMES; n++, seq++) {
+            canRxFrame_t* frame = CanRxRing_Reserve(&ring);
+            FillFrame(frame, seq);
+            CanRxRing_Commit(&ring, frame);
+        }
+        for (volatile uint32_t spin = Rng(&rng) % 2000; spin > 0; spin--);
+        // on a single core host the consumer only runs when the producer gives way
+        sched_yield();
+    }
+    __atomic_store_n(&producerDone, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void* Consumer(void* arg)
+{
+    consumerResult_t* r = (consumerResult_t*)arg;
+    uint32_t expected = 0;
+
+    for (;;) {
+        const canRxFrame_t* frame = CanRxRing_Peek(&ring);
+        if (frame == NULL) {
+            // nothing left once the producer is done and the ring is still empty
+            if (__atomic_load_n(&producerDone, __ATOMIC_ACQUIRE) && CanRxRing_Peek(&ring) == NULL) break;
+            sched_yield();
+            continue;
+        }
+        uint32_t seq = frame->obj.word[2];
+        if (seq < expected) r->badOrder++;
+        else r->gaps += seq - expected;
+        if (!CheckFrame(frame, seq)) r->badPayload++;
+        expected = seq + 1;
+        CanRxRing_Release(&ring);
+        r->consumed++;
+
+        // a long main loop pass
+        if (r->consumed % BENCH_STALL_EVERY == 0) {
+            for (volatile uint32_t spin = BENCH_STALL_SPIN; spin > 0; spin--);
+        }
+        // a re-initialization while the producer runs
+        if (r->consumed % BENCH_FLUSH_EVERY == 0) r->flushed += CanRxRing_Flush(&ring);
+    }
+    r->gaps += BENCH_FRAMES - expected;
+    return NULL;
+}
+
+// frames past the ring depth in round 'round' of the full ring test
+static uint32_t FullExtra(uint32_t round)
+{
+    return 1 + (round * 7) % BENCH_FULL_EXTRA;
+}
+
+static void* FullProducer(void* arg)
+{
+    uint32_t seq = 0;
+
+    (void)arg;
+    for (uint32_t round = 0; round < BENCH_FULL_ROUNDS; round++) {
+        // wait for the consumer to drain the last round
+        while (__atomic_load_n(&fullStage, __ATOMIC_ACQUIRE) != 2 * round) sched_yield();
+        for (uint32_t n = 0; n < CAN_RX_RING_SIZE + FullExtra(round); n++, seq++) {
+            canRxFrame_t* frame = CanRxRing_Reserve(&ring);
+            FillFrame(frame, seq);
+            CanRxRing_Commit(&ring, frame);
+        }
+        __atomic_store_n(&fullStage, 2 * round + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void* FullConsumer(void* arg)
+{
+    consumerResult_t* r = (consumerResult_t*)arg;
+    uint32_t seq = 0;
+
+    for (uint32_t round = 0; round < BENCH_FULL_ROUNDS; round++) {
+        // a main loop pass longer than the ring depth - the producer fills the ring meanwhile
+        while (__atomic_load_n(&fullStage, __ATOMIC_ACQUIRE) != 2 * round + 1) sched_yield();
+        for (const canRxFrame_t* frame; (frame = CanRxRing_Peek(&ring)) != NULL;) {
+            uint32_t got = frame->obj.word[2];
+            if (got != seq) r->badOrder++;
+            if (!CheckFrame(frame, got)) r->badPayload++;
+            seq = got + 1;
+            CanRxRing_Release(&ring);
+            r->consumed++;
+        }
+        // the frames that found the ring full never arrive
+        seq += FullExtra(round);
+        __atomic_store_n(&fullStage, 2 * round + 2, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ checks */
+
+static bool StressTest(void)
+{
+    pthread_t producer, consumer;
+    consumerResult_t r = {0};
+    bool pass;
+
+    CanRxRing_Init(&ring);
+    producerDone = false;
+    pthread_create(&consumer, NULL, Consumer, &r);
+    pthread_create(&producer, NULL, Producer, NULL);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    pass = r.badOrder == 0 && r.badPayload == 0 && r.consumed + ring.drops + r.flushed == BENCH_FRAMES &&
+           r.gaps == ring.drops + r.flushed;
+    printf("stress    %u frames: consumed %llu, dropped %u (%.3f%%), flushed %llu, gaps %llu, out of order %llu, bad payload %llu, peak %u/%u - %s\n",
+           BENCH_FRAMES, (unsigned long long)r.consumed, ring.drops, 100.0 * ring.drops / BENCH_FRAMES,
+           (unsigned long long)r.flushed, (unsigned long long)r.gaps, (unsigned long long)r.badOrder, (unsigned long long)r.badPayload,
+           ring.peak, CAN_RX_RING_SIZE, pass ? "ok" : "FAIL");
+    if (ring.drops == 0) printf("          (no drops this run - the full ring test covers that path)\n");
+    return pass;
+}
+
+static bool FullTest(void)
+{
+    pthread_t producer, consumer;
+    consumerResult_t r = {0};
+    uint32_t extra = 0;
+    bool pass;
+
+    for (uint32_t round = 0; round < BENCH_FULL_ROUNDS; round++) extra += FullExtra(round);
+
+    CanRxRing_Init(&ring);
+    fullStage = 0;
+    pthread_create(&consumer, NULL, FullConsumer, &r);
+    pthread_create(&producer, NULL, FullProducer, NULL);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    pass = r.badOrder == 0 && r.badPayload == 0 && r.consumed == (uint64_t)BENCH_FULL_ROUNDS * CAN_RX_RING_SIZE &&
+           ring.drops == extra && ring.peak == CAN_RX_RING_SIZE;
+    printf("full      %u stalls, %u slots + 1-%u frames each: consumed %llu, dropped %u (expected %u), out of order %llu, bad payload %llu, peak %u - %s\n",
+           BENCH_FULL_ROUNDS, CAN_RX_RING_SIZE, BENCH_FULL_EXTRA, (unsigned long long)r.consumed, ring.drops, extra,
+           (unsigned long long)r.badOrder, (unsigned long long)r.badPayload, ring.peak, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+static bool WrapTest(void)
+{
+    bool pass = true;
+    uint32_t seq = 0, expected = 0;
+
+    // counters just short of the wrap - fill past full, then drain, several times round
+    CanRxRing_Init(&ring);
+    ring.head = ring.tail = 0xFFFFFFFFu - CAN_RX_RING_SIZE / 2;
+    for (int round = 0; round < 4; round++) {
+        for (uint32_t n = 0; n < CAN_RX_RING_SIZE + 5; n++, seq++) {
+            canRxFrame_t* frame = CanRxRing_Reserve(&ring);
+            FillFrame(frame, seq);
+            CanRxRing_Commit(&ring, frame);
+        }
+        if (CanRxRing_Count(&ring) != CAN_RX_RING_SIZE) pass = false;
+        for (const canRxFrame_t* frame; (frame = CanRxRing_Peek(&ring)) != NULL;) {
+            if (frame->obj.word[2] != expected || !CheckFrame(frame, expected)) pass = false;
+            expected++;
+            CanRxRing_Release(&ring);
+        }
+        expected = seq;                 // the 5 that found the ring full are gone
+    }
+    if (ring.drops != 4 * 5 || ring.peak != CAN_RX_RING_SIZE) pass = false;
+    printf("wrap      4 rounds of %u frames into %u slots across 2^32: dropped %u, peak %u - %s\n",
+           CAN_RX_RING_SIZE + 5, CAN_RX_RING_SIZE, ring.drops, ring.peak, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+static double PushPopNs(void)
+{
+    struct timespec start, end;
+    uint32_t sink = 0;
+
+    CanRxRing_Init(&ring);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t seq = 0; seq < BENCH_TIMED; seq++) {
+        canRxFrame_t* frame = CanRxRing_Reserve(&ring);
+        frame->obj.word[2] = seq;
+        CanRxRing_Commit(&ring, frame);
+        if ((seq & 31) == 31) {
+            for (const canRxFrame_t* f; (f = CanRxRing_Peek(&ring)) != NULL;) {
+                sink += f->obj.word[2];
+                CanRxRing_Release(&ring);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (sink == 42) printf(" ");
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_TIMED;
+}
+
+int main(void)
+{
+    bool pass = true;
+
+    printf("CAN RX ring - %u frames of %u bytes\n\n", CAN_RX_RING_SIZE, (unsigned)sizeof(canRxFrame_t));
+    pass &= WrapTest();
+    pass &= FullTest();
+    pass &= StressTest();
+    printf("\npush + pop (header only, 32 frame batches): %.1f ns per frame\n", PushPopNs());
+
+    if (!pass) {
+        printf("\nFAIL\n");
+        return 1;
+    }
+    printf("\nPASS\n");
+    return 0;
+}
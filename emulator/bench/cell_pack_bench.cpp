@@ -0,0 +1,222 @@
+/******************************************************************************
+ * @file    cell_pack_bench.cpp
+ * @brief   MODULE_DETAIL vs MODULE_CELL_PACKED - bytes on bus and decode time
+ * @author  Pack Emulator Development Team
+ *
+ * Builds the frames a module would send for a full voltage + temperature
+ * snapshot in both formats, checks that the packed frames decode back to the
+ * exact raw values, and reports frames, bus bits (worst-case stuffing),
+ * bus time at 500 kbit/s and host decode time per cell. The same snapshot as
+ * MODULE_CELL_FD frames (CAN FD, 2 Mbit/s data phase) is costed for comparison.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include "../../protocols/CAN_ID_ALL.h"
+#include "../../protocols/can_frm_mod.h"
+#include "../../protocols/can_cell_pack.h"
+#include "can_bus_model.h"
+
+static const uint8_t BENCH_CELLS = 192;    // MAX_CELLS_PER_MODULE in bms.h
+
+struct BenchFrame {
+    uint32_t eid;
+    uint8_t  length;
+    uint8_t  data[8];
+};
+
+struct Snapshot {
+    std::vector<uint16_t> voltage;      // mV
+    std::vector<uint16_t> temperature;  // 0.01 C + 55.35 C
+};
+
+// Deterministic LCG so every run sees the same cells
+static uint32_t rngState = 12345;
+static int32_t Random(int32_t span) {
+    rngState = rngState * 1103515245u + 12345u;
+    return (int32_t)((rngState >> 16) % (uint32_t)(2 * span + 1)) - span;
+}
+
+static Snapshot MakeSnapshot(uint8_t cells, int32_t voltSpread, int32_t tempSpread) {
+    Snapshot s;
+    for (uint8_t i = 0; i < cells; i++) {
+        s.voltage.push_back((uint16_t)(3700 + Random(voltSpread)));
+        s.temperature.push_back((uint16_t)(8035 + Random(tempSpread)));   // ~25 C
+    }
+    return s;
+}
+
+//---------------------------------------------------------------------------
+// Encoders
+//---------------------------------------------------------------------------
+static std::vector<BenchFrame> EncodeDetail(uint8_t moduleId, const Snapshot& s) {
+    std::vector<BenchFrame> frames;
+    for (size_t i = 0; i < s.voltage.size(); i++) {
+        CANFRM_MODULE_DETAIL detail;
+        memset(&detail, 0, sizeof(detail));
+        detail.cellId = (uint32_t)i;
+        detail.cellCount = (uint32_t)s.voltage.size();
+        detail.cellTemp = s.temperature[i];
+        detail.cellVoltage = s.voltage[i];
+        detail.cellSoc = 160;
+        detail.cellSoh = 190;
+
+        BenchFrame f;
+        f.eid = moduleId;
+        f.length = 8;
+        memcpy(f.data, &detail, 8);
+        frames.push_back(f);
+    }
+    return frames;
+}
+
+static void EncodePackedKind(uint8_t moduleId, uint8_t kind, const std::vector<uint16_t>& values,
+                             std::vector<BenchFrame>& frames) {
+    size_t cell = 0;
+    while (cell < values.size()) {
+        BenchFrame f;
+        size_t left = values.size() - cell;
+        uint8_t available = left > CELL_PACK_MAX_CELLS ? CELL_PACK_MAX_CELLS : (uint8_t)left;
+        uint8_t used = CellPack_Encode(&values[cell], available, f.data, &f.length);
+        f.eid = CellPack_Eid(moduleId, (uint8_t)cell, kind);
+        frames.push_back(f);
+        cell += used;
+    }
+}
+
+static std::vector<BenchFrame> EncodePacked(uint8_t moduleId, const Snapshot& s) {
+    std::vector<BenchFrame> frames;
+    EncodePackedKind(moduleId, CELL_PACK_VOLTAGE, s.voltage, frames);
+    EncodePackedKind(moduleId, CELL_PACK_TEMPERATURE, s.temperature, frames);
+    return frames;
+}
+
+//---------------------------------------------------------------------------
+// Decoders - what the pack does per received frame
+//---------------------------------------------------------------------------
+static void DecodeDetail(const std::vector<BenchFrame>& frames, uint16_t* volt, uint16_t* temp) {
+    for (size_t i = 0; i < frames.size(); i++) {
+        CANFRM_MODULE_DETAIL detail;
+        memcpy(&detail, frames[i].data, sizeof(detail));
+        volt[detail.cellId] = detail.cellVoltage;
+        temp[detail.cellId] = detail.cellTemp;
+    }
+}
+
+static void DecodePacked(const std::vector<BenchFrame>& frames, uint16_t* volt, uint16_t* temp) {
+    uint16_t values[CELL_PACK_MAX_CELLS];
+    for (size_t i = 0; i < frames.size(); i++) {
+        uint8_t cells = CellPack_Decode(frames[i].data, frames[i].length, values);
+        uint8_t first = CellPack_FirstCell(frames[i].eid);
+        uint16_t* dest = CellPack_Kind(frames[i].eid) == CELL_PACK_VOLTAGE ? volt : temp;
+        for (uint8_t c = 0; c < cells; c++) {
+            dest[first + c] = values[c];
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Report
+//---------------------------------------------------------------------------
+struct BusCost {
+    size_t   frames;
+    uint64_t payloadBytes;
+    uint64_t bits;
+};
+
+static BusCost Cost(const std::vector<BenchFrame>& frames) {
+    BusCost c = { frames.size(), 0, 0 };
+    for (size_t i = 0; i < frames.size(); i++) {
+        c.payloadBytes += frames[i].length;
+        c.bits += FrameBits(frames[i].length);
+    }
+    return c;
+}
+
+// MODULE_CELL_FD - voltages then temperatures, CELL_FD_MAX_CELLS raw values per frame
+static BusCost CostCellFd(size_t cells, uint64_t* busUs) {
+    BusCost c = { 0, 0, 0 };
+    *busUs = 0;
+    for (int kind = 0; kind < 2; kind++) {
+        for (size_t cell = 0; cell < cells; cell += CELL_FD_MAX_CELLS) {
+            size_t n = cells - cell < CELL_FD_MAX_CELLS ? cells - cell : CELL_FD_MAX_CELLS;
+            uint8_t bytes = (uint8_t)(sizeof(CANFRM_MODULE_CELL_FD) - sizeof(uint16_t) * (CELL_FD_MAX_CELLS - n));
+            c.frames++;
+            c.payloadBytes += FdLength(bytes);
+            *busUs += FdFrameTimeUs(bytes);
+        }
+    }
+    return c;
+}
+
+template <typename F>
+static double DecodeNsPerCell(F decode, const std::vector<BenchFrame>& frames, size_t cells) {
+    static uint16_t volt[256];
+    static uint16_t temp[256];
+    const int iterations = 20000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        decode(frames, volt, temp);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return ns / iterations / cells;
+}
+
+static bool Verify(const Snapshot& s, const std::vector<BenchFrame>& frames) {
+    uint16_t volt[256] = {0};
+    uint16_t temp[256] = {0};
+    DecodePacked(frames, volt, temp);
+    for (size_t i = 0; i < s.voltage.size(); i++) {
+        if (volt[i] != s.voltage[i] || temp[i] != s.temperature[i]) {
+            printf("  MISMATCH at cell %u\n", (unsigned)i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool RunCase(const char* name, uint8_t cells, int32_t voltSpread, int32_t tempSpread) {
+    Snapshot s = MakeSnapshot(cells, voltSpread, tempSpread);
+    std::vector<BenchFrame> detail = EncodeDetail(1, s);
+    std::vector<BenchFrame> packed = EncodePacked(1, s);
+    BusCost cd = Cost(detail);
+    BusCost cp = Cost(packed);
+    bool ok = Verify(s, packed);
+
+    printf("%s - %u cells, voltage +/-%d mV, temperature +/-%d (0.01 C)%s\n",
+           name, cells, voltSpread, tempSpread, ok ? "" : "  ** DECODE MISMATCH **");
+    printf("  %-8s %7s %9s %9s %9s %10s\n", "format", "frames", "payload", "bus bits", "bus (ms)", "decode ns/cell");
+    printf("  %-8s %7u %9llu %9llu %9.2f %10.1f\n", "detail", (unsigned)cd.frames,
+           (unsigned long long)cd.payloadBytes, (unsigned long long)cd.bits,
+           cd.bits * 1000.0 / BUS_BITRATE, DecodeNsPerCell(DecodeDetail, detail, cells));
+    printf("  %-8s %7u %9llu %9llu %9.2f %10.1f\n", "packed", (unsigned)cp.frames,
+           (unsigned long long)cp.payloadBytes, (unsigned long long)cp.bits,
+           cp.bits * 1000.0 / BUS_BITRATE, DecodeNsPerCell(DecodePacked, packed, cells));
+    uint64_t fdUs;
+    BusCost cf = CostCellFd(cells, &fdUs);
+    printf("  %-8s %7u %9llu %9s %9.2f %10s\n", "cell fd", (unsigned)cf.frames,
+           (unsigned long long)cf.payloadBytes, "-", fdUs / 1000.0, "-");
+    printf("  packed uses %.1f%%, cell fd %.1f%% of the detail bus time\n\n",
+           100.0 * cp.bits / cd.bits, 100.0 * fdUs * BUS_BITRATE / 1e6 / cd.bits);
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+
+    printf("Cell telemetry frame format benchmark (%u bit/s, worst-case stuffing)\n\n", BUS_BITRATE);
+    ok &= RunCase("Typical",  BENCH_CELLS, 40, 300);
+    ok &= RunCase("Spread",   BENCH_CELLS, 1000, 1500);
+    ok &= RunCase("Worst",    BENCH_CELLS, 3000, 5000);   // most deltas out of range
+    ok &= RunCase("Small",    16, 40, 300);
+
+    return ok ? 0 : 1;
+}
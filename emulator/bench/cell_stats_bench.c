@@ -0,0 +1,138 @@
+/******************************************************************************
+ * @file    cell_stats_bench.c
+ * @brief   Cell statistics kernel (cell_stats.h) vs its scalar definition
+ * @author  Pack Emulator Development Team
+ *
+ * Runs CellStats_Accumulate() - the SIMD kernel the build selects - and
+ * CellStats_Scalar() over the same cell blocks and fails if any accumulator
+ * field or derived statistic differs. Blocks cover every length 0..192, so
+ * every kernel tail is hit, with cells drawn from a realistic pack spread and
+ * from the whole 16-bit range, plus all-0 and all-0xFFFF blocks.
+ *
+ * Then times a full pack pass (32 modules of 94 cells) both ways.
+ *
+ * C rather than C++ like the other benches: bms.h reuses type names as member
+ * names, which C++ rejects.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bms.h"
+#include "cell_stats.h"
+
+#define BENCH_MODULES   32
+#define BENCH_CELLS     94
+#define BENCH_ROUNDS    20000
+
+static uint32_t seed = 1;
+static batteryCell cells[MAX_CELLS_PER_MODULE];
+static batteryCell prior[40];
+static batteryCell packCells[BENCH_MODULES][BENCH_CELLS];
+
+static uint32_t Next(uint32_t span)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) % span;
+}
+
+static bool SameAcc(const cellStatsAcc_t* a, const cellStatsAcc_t* b)
+{
+    if (a->cells != b->cells || a->minVolt != b->minVolt || a->maxVolt != b->maxVolt ||
+        a->minTemp != b->minTemp || a->maxTemp != b->maxTemp || a->sumVolt != b->sumVolt ||
+        a->sumTemp != b->sumTemp || a->sumSqVolt != b->sumSqVolt || a->sumSqTemp != b->sumSqTemp)
+        return false;
+    return memcmp(a->hist, b->hist, sizeof(a->hist)) == 0;
+}
+
+static bool SameStat(const cellStatsAcc_t* a, const cellStatsAcc_t* b)
+{
+    cellStat_t sa, sb;
+    CellStats_Finish(a->cells, a->minVolt, a->maxVolt, a->sumVolt, a->sumSqVolt, &sa);
+    CellStats_Finish(b->cells, b->minVolt, b->maxVolt, b->sumVolt, b->sumSqVolt, &sb);
+    if (memcmp(&sa, &sb, sizeof(sa)) != 0) return false;
+    CellStats_Finish(a->cells, a->minTemp, a->maxTemp, a->sumTemp, a->sumSqTemp, &sa);
+    CellStats_Finish(b->cells, b->minTemp, b->maxTemp, b->sumTemp, b->sumSqTemp, &sb);
+    return memcmp(&sa, &sb, sizeof(sa)) == 0;
+}
+
+static void Fill(batteryCell* cell, uint16_t count, int kind)
+{
+    for (uint16_t i = 0; i < count; i++) {
+        switch (kind) {
+        case 0:  cell[i].voltage = 3200 + Next(1000); cell[i].temp = 7000 + Next(3000); break;  // pack spread
+        case 1:  cell[i].voltage = Next(65536);       cell[i].temp = Next(65536);       break;  // any raw value
+        case 2:  cell[i].voltage = 0;                 cell[i].temp = 0;                 break;
+        default: cell[i].voltage = 0xFFFF;            cell[i].temp = 0xFFFF;            break;
+        }
+        cell[i].soc = Next(256);
+        cell[i].soh = Next(256);
+    }
+}
+
+static double PackPassNs(bool useKernel, uint64_t* sink)
+{
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        cellStatsAcc_t acc;
+        CellStats_Init(&acc);
+        for (int m = 0; m < BENCH_MODULES; m++) {
+            if (useKernel) CellStats_Accumulate(packCells[m], BENCH_CELLS, &acc);
+            else           CellStats_Scalar(packCells[m], BENCH_CELLS, &acc);
+        }
+        *sink += acc.sumSqVolt + acc.minTemp;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_ROUNDS;
+}
+
+int main(void)
+{
+    uint32_t blocks = 0, wrong = 0;
+
+    // every length, every kind, and added onto a non-empty accumulator as the pack pass does
+    for (int kind = 0; kind < 4; kind++) {
+        for (uint16_t length = 0; length <= MAX_CELLS_PER_MODULE; length++) {
+            for (int round = 0; round < 20; round++) {
+                uint16_t priorCount = Next(40);
+                cellStatsAcc_t kernel, scalar;
+                Fill(cells, length, kind);
+                Fill(prior, priorCount, 0);
+                CellStats_Init(&kernel);
+                CellStats_Init(&scalar);
+                CellStats_Scalar(prior, priorCount, &kernel);
+                CellStats_Scalar(prior, priorCount, &scalar);
+
+                CellStats_Accumulate(cells, length, &kernel);
+                CellStats_Scalar(cells, length, &scalar);
+                if (!SameAcc(&kernel, &scalar) || !SameStat(&kernel, &scalar)) {
+                    if (wrong < 5) printf("  mismatch: kind %d, %u cells\n", kind, length);
+                    wrong++;
+                }
+                blocks++;
+            }
+        }
+    }
+    printf("Kernel %s vs scalar: %u blocks, %u mismatches\n", CELL_STATS_KERNEL, blocks, wrong);
+
+    // timing - a full pack of 32 modules with 94 cells each
+    for (int m = 0; m < BENCH_MODULES; m++) Fill(packCells[m], BENCH_CELLS, 0);
+    uint64_t sink = 0;
+    double scalarNs = PackPassNs(false, &sink);
+    double kernelNs = PackPassNs(true, &sink);
+    printf("\nOne pack pass (%d modules x %d cells), host:\n", BENCH_MODULES, BENCH_CELLS);
+    printf("  scalar  %8.0f ns   %5.2f ns/cell\n", scalarNs, scalarNs / (BENCH_MODULES * BENCH_CELLS));
+    printf("  %-6s  %8.0f ns   %5.2f ns/cell   (%.1fx)\n", CELL_STATS_KERNEL, kernelNs,
+           kernelNs / (BENCH_MODULES * BENCH_CELLS), scalarNs / kernelNs);
+    printf("  (checksum %llu)\n", (unsigned long long)sink);
+
+    if (wrong) printf("\nFAIL - the kernel differs from the scalar definition\n");
+    return wrong ? 1 : 0;
+}
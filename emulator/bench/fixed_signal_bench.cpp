@@ -0,0 +1,293 @@
+/******************************************************************************
+ * @file    fixed_signal_bench.cpp
+ * @brief   Integer signal conversions (fixed_signal.h) vs the float/double path
+ * @author  Pack Emulator Development Team
+ *
+ * For every conversion the pack controller makes each BMS cycle - module
+ * current sums to the pack encoding and pack values to the VCU encodings -
+ * checks the FXS_ integer conversion against the exact value of the encoding
+ * over the whole input range, counts where the float path it replaces differs,
+ * and times one pack update done each way.
+ *
+ * The exact value is worked out in long double from the _FACTOR/_BASE
+ * constants and snapped to the nearest integer when it is within 1e-6 of one,
+ * so it does not depend on the quanta in fixed_signal.h.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "fixed_signal.h"
+
+//---------------------------------------------------------------------------
+// Float constants - copied from Core/Inc/mcu.h and Core/Inc/vcu.h
+//---------------------------------------------------------------------------
+#define PACK_CURRENT_BASE           -1600
+#define PACK_CURRENT_FACTOR         0.05
+#define MODULE_VOLTAGE_BASE         0
+#define MODULE_VOLTAGE_FACTOR       0.015
+#define CELL_VOLTAGE_BASE           0
+#define CELL_VOLTAGE_FACTOR         0.001
+#define MODULE_CURRENT_BASE         -655.36
+#define MODULE_CURRENT_FACTOR       0.02
+#define TEMPERATURE_BASE            -55.35
+#define TEMPERATURE_FACTOR          0.01
+#define PERCENTAGE_BASE             0
+#define PERCENTAGE_FACTOR           0.5
+#define MODULE_CURRENT_TOLERANCE    0.3
+
+#define VCU_CURRENT_BASE            -1600
+#define VCU_CURRENT_FACTOR          0.05
+#define VCU_VOLTAGE_BASE            0
+#define VCU_VOLTAGE_FACTOR          0.05
+#define VCU_TEMPERATURE_BASE        -273
+#define VCU_TEMPERATURE_FACTOR      0.03125
+#define VCU_CELL_VOLTAGE_BASE       0
+#define VCU_CELL_VOLTAGE_FACTOR     0.001
+#define VCU_SOC_PERCENTAGE_BASE     0
+#define VCU_SOC_PERCENTAGE_FACTOR   0.0015625
+#define VCU_SOH_PERCENTAGE_BASE     0
+#define VCU_SOH_PERCENTAGE_FACTOR   0.4
+
+//---------------------------------------------------------------------------
+// Exact value of an encoding - nearest integer if within 1e-6 of one, else truncated
+//---------------------------------------------------------------------------
+static int32_t Exact(long double v)
+{
+    long double r = roundl(v);
+    if (fabsl(v - r) < 1e-6L) return (int32_t)r;
+    return (int32_t)truncl(v);
+}
+
+static int32_t ExactConvert(uint32_t raw, long double srcFactor, long double srcBase,
+                            long double dstFactor, long double dstBase)
+{
+    return Exact((srcBase + srcFactor * raw - dstBase) / dstFactor);
+}
+
+//---------------------------------------------------------------------------
+// VCU conversions - float path exactly as vcu.c wrote it, and the FXS_ path
+//---------------------------------------------------------------------------
+struct VcuConversion {
+    const char* name;
+    uint32_t    maxRaw;
+    long double srcFactor, srcBase, dstFactor, dstBase;
+    uint16_t  (*floatPath)(uint32_t raw);
+    uint16_t  (*fixedPath)(uint32_t raw);
+};
+
+#define FLOAT_PATH(SRCF, SRCB, DSTF, DSTB) \
+    [](uint32_t raw) -> uint16_t { \
+        float floatValue = SRCB + (SRCF * raw); \
+        float vcuValue = (floatValue/DSTF) - (DSTB/DSTF); \
+        return (uint16_t)(uint32_t)vcuValue; }
+
+#define FIXED_PATH(SRC, DST) \
+    [](uint32_t raw) -> uint16_t { return (uint16_t)FXS_CONVERT(raw, SRC, DST); }
+
+static const VcuConversion vcuConversions[] = {
+    { "SOH          0x410", 255,
+      PERCENTAGE_FACTOR, PERCENTAGE_BASE, VCU_SOH_PERCENTAGE_FACTOR, VCU_SOH_PERCENTAGE_BASE,
+      FLOAT_PATH(PERCENTAGE_FACTOR, PERCENTAGE_BASE, VCU_SOH_PERCENTAGE_FACTOR, VCU_SOH_PERCENTAGE_BASE),
+      FIXED_PATH(PERCENTAGE, VCU_SOH_PERCENTAGE) },
+    { "pack current 0x421", 65535,
+      PACK_CURRENT_FACTOR, PACK_CURRENT_BASE, VCU_CURRENT_FACTOR, VCU_CURRENT_BASE,
+      FLOAT_PATH(PACK_CURRENT_FACTOR, PACK_CURRENT_BASE, VCU_CURRENT_FACTOR, VCU_CURRENT_BASE),
+      FIXED_PATH(PACK_CURRENT, VCU_CURRENT) },
+    { "pack voltage 0x421", 65535,
+      MODULE_VOLTAGE_FACTOR, MODULE_VOLTAGE_BASE, VCU_VOLTAGE_FACTOR, VCU_VOLTAGE_BASE,
+      FLOAT_PATH(MODULE_VOLTAGE_FACTOR, MODULE_VOLTAGE_BASE, VCU_VOLTAGE_FACTOR, VCU_VOLTAGE_BASE),
+      FIXED_PATH(MODULE_VOLTAGE, VCU_VOLTAGE) },
+    { "SOC          0x422", 204,
+      PERCENTAGE_FACTOR, PERCENTAGE_BASE, VCU_SOC_PERCENTAGE_FACTOR, VCU_SOC_PERCENTAGE_BASE,
+      FLOAT_PATH(PERCENTAGE_FACTOR, PERCENTAGE_BASE, VCU_SOC_PERCENTAGE_FACTOR, VCU_SOC_PERCENTAGE_BASE),
+      FIXED_PATH(PERCENTAGE, VCU_SOC_PERCENTAGE) },
+    { "cell voltage 0x422", 65535,
+      CELL_VOLTAGE_FACTOR, CELL_VOLTAGE_BASE, VCU_CELL_VOLTAGE_FACTOR, VCU_CELL_VOLTAGE_BASE,
+      FLOAT_PATH(CELL_VOLTAGE_FACTOR, CELL_VOLTAGE_BASE, VCU_CELL_VOLTAGE_FACTOR, VCU_CELL_VOLTAGE_BASE),
+      FIXED_PATH(CELL_VOLTAGE, VCU_CELL_VOLTAGE) },
+    { "cell temp    0x423", 65535,
+      TEMPERATURE_FACTOR, TEMPERATURE_BASE, VCU_TEMPERATURE_FACTOR, VCU_TEMPERATURE_BASE,
+      FLOAT_PATH(TEMPERATURE_FACTOR, TEMPERATURE_BASE, VCU_TEMPERATURE_FACTOR, VCU_TEMPERATURE_BASE),
+      FIXED_PATH(TEMPERATURE, VCU_TEMPERATURE) },
+    { "current lim  0x425", 65535,
+      PACK_CURRENT_FACTOR, PACK_CURRENT_BASE, VCU_CURRENT_FACTOR, VCU_CURRENT_BASE,
+      FLOAT_PATH(PACK_CURRENT_FACTOR, PACK_CURRENT_BASE, VCU_CURRENT_FACTOR, VCU_CURRENT_BASE),
+      FIXED_PATH(PACK_CURRENT, VCU_CURRENT) },
+};
+
+//---------------------------------------------------------------------------
+// Pack current from the module current sum - float path as mcu_stats.c wrote it
+//---------------------------------------------------------------------------
+static uint16_t PackCurrentFloat(uint32_t sum, uint8_t modulesOn)
+{
+    float totalCurrent = (modulesOn * MODULE_CURRENT_BASE) + (sum * MODULE_CURRENT_FACTOR);
+    if (totalCurrent > (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR)))
+        totalCurrent = (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR));
+    else if (totalCurrent < PACK_CURRENT_BASE)
+        totalCurrent = PACK_CURRENT_BASE;
+    float packCurrent = (totalCurrent/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
+    return (uint16_t)packCurrent;
+}
+
+static uint16_t PackCurrentFixed(uint32_t sum, uint8_t modulesOn)
+{
+    int32_t totalCurrent = FXS_SUM_QUANTA(sum, modulesOn, MODULE_CURRENT);
+    if (totalCurrent > FXS_QUANTA(65535, PACK_CURRENT))  totalCurrent = FXS_QUANTA(65535, PACK_CURRENT);
+    else if (totalCurrent < FXS_QUANTA(0, PACK_CURRENT)) totalCurrent = FXS_QUANTA(0, PACK_CURRENT);
+    return (uint16_t)FXS_FROM_QUANTA(totalCurrent, PACK_CURRENT);
+}
+
+static int32_t PackCurrentExact(uint32_t sum, uint8_t modulesOn)
+{
+    long double amps = modulesOn * (long double)MODULE_CURRENT_BASE + sum * (long double)MODULE_CURRENT_FACTOR;
+    int32_t raw = Exact((amps - PACK_CURRENT_BASE) / (long double)PACK_CURRENT_FACTOR);
+    if (amps > PACK_CURRENT_BASE + 65535 * (long double)PACK_CURRENT_FACTOR) raw = 65535;
+    if (amps < PACK_CURRENT_BASE) raw = 0;
+    return raw;
+}
+
+//---------------------------------------------------------------------------
+// One pack update - MCU_StatsDerivePack() currents, the over current check of
+// every module on and the VCU data frame conversions
+//---------------------------------------------------------------------------
+struct PackInput {
+    uint16_t mmc[32];
+    uint16_t maxChargeA[32];
+    uint16_t maxDischargeA[32];
+    uint16_t voltage, soc, soh, cellAvgVolt, cellHiVolt, cellLoVolt;
+    uint16_t cellAvgTemp, cellHiTemp, cellLoTemp, maxChargeEndV;
+};
+
+static uint32_t PackUpdateFloat(const PackInput& in)
+{
+    uint32_t acc = 0;
+    uint32_t sumMmc = 0, sumChg = 0, sumDis = 0;
+    for (int i = 0; i < 32; i++) {
+        float moduleMaxChargeA    = MODULE_CURRENT_BASE + (in.maxChargeA[i]    * MODULE_CURRENT_FACTOR);
+        float moduleMaxDischargeA = MODULE_CURRENT_BASE + (in.maxDischargeA[i] * MODULE_CURRENT_FACTOR);
+        float moduleCurrent       = MODULE_CURRENT_BASE + (in.mmc[i]           * MODULE_CURRENT_FACTOR);
+        if (moduleCurrent - MODULE_CURRENT_TOLERANCE > moduleMaxChargeA) acc++;
+        else if (moduleCurrent + MODULE_CURRENT_TOLERANCE < moduleMaxDischargeA) acc++;
+        sumMmc += in.mmc[i]; sumChg += in.maxChargeA[i]; sumDis += in.maxDischargeA[i];
+    }
+    uint16_t current = PackCurrentFloat(sumMmc, 32);
+    acc += current + PackCurrentFloat(sumChg, 32) + PackCurrentFloat(sumDis, 32);
+    acc += vcuConversions[0].floatPath(in.soh);
+    acc += vcuConversions[1].floatPath(current);
+    acc += vcuConversions[2].floatPath(in.voltage);
+    acc += vcuConversions[3].floatPath(in.soc);
+    acc += vcuConversions[4].floatPath(in.cellAvgVolt) + vcuConversions[4].floatPath(in.cellHiVolt) +
+           vcuConversions[4].floatPath(in.cellLoVolt);
+    acc += vcuConversions[5].floatPath(in.cellAvgTemp) + vcuConversions[5].floatPath(in.cellHiTemp) +
+           vcuConversions[5].floatPath(in.cellLoTemp);
+    acc += vcuConversions[6].floatPath(in.maxChargeEndV) + vcuConversions[2].floatPath(in.maxChargeEndV);
+    return acc;
+}
+
+static uint32_t PackUpdateFixed(const PackInput& in)
+{
+    uint32_t acc = 0;
+    uint32_t sumMmc = 0, sumChg = 0, sumDis = 0;
+    for (int i = 0; i < 32; i++) {
+        int32_t moduleMaxChargeA    = FXS_QUANTA(in.maxChargeA[i],    MODULE_CURRENT);
+        int32_t moduleMaxDischargeA = FXS_QUANTA(in.maxDischargeA[i], MODULE_CURRENT);
+        int32_t moduleCurrent       = FXS_QUANTA(in.mmc[i],           MODULE_CURRENT);
+        if (moduleCurrent - FXS_MODULE_CURRENT_TOLERANCE > moduleMaxChargeA) acc++;
+        else if (moduleCurrent + FXS_MODULE_CURRENT_TOLERANCE < moduleMaxDischargeA) acc++;
+        sumMmc += in.mmc[i]; sumChg += in.maxChargeA[i]; sumDis += in.maxDischargeA[i];
+    }
+    uint16_t current = PackCurrentFixed(sumMmc, 32);
+    acc += current + PackCurrentFixed(sumChg, 32) + PackCurrentFixed(sumDis, 32);
+    acc += vcuConversions[0].fixedPath(in.soh);
+    acc += vcuConversions[1].fixedPath(current);
+    acc += vcuConversions[2].fixedPath(in.voltage);
+    acc += vcuConversions[3].fixedPath(in.soc);
+    acc += vcuConversions[4].fixedPath(in.cellAvgVolt) + vcuConversions[4].fixedPath(in.cellHiVolt) +
+           vcuConversions[4].fixedPath(in.cellLoVolt);
+    acc += vcuConversions[5].fixedPath(in.cellAvgTemp) + vcuConversions[5].fixedPath(in.cellHiTemp) +
+           vcuConversions[5].fixedPath(in.cellLoTemp);
+    acc += vcuConversions[6].fixedPath(in.maxChargeEndV) + vcuConversions[2].fixedPath(in.maxChargeEndV);
+    return acc;
+}
+
+template <typename F>
+static double TimeNs(F update, const std::vector<PackInput>& inputs, int rounds, uint32_t& sink)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const PackInput& in : inputs) sink += update(in);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)rounds * inputs.size());
+}
+
+int main()
+{
+    bool failed = false;
+
+    printf("Conversion           inputs   fixed != exact   float != exact   float != fixed\n");
+    for (const VcuConversion& c : vcuConversions) {
+        uint32_t fixedWrong = 0, floatWrong = 0, differ = 0;
+        for (uint32_t raw = 0; raw <= c.maxRaw; raw++) {
+            int32_t  exact = ExactConvert(raw, c.srcFactor, c.srcBase, c.dstFactor, c.dstBase);
+            uint16_t fx = c.fixedPath(raw);
+            uint16_t fl = c.floatPath(raw);
+            if (fx != (uint16_t)exact) fixedWrong++;
+            if (fl != (uint16_t)exact) floatWrong++;
+            if (fl != fx) differ++;
+        }
+        printf("%s  %8u   %14u   %14u   %14u\n", c.name, c.maxRaw + 1, fixedWrong, floatWrong, differ);
+        if (fixedWrong) failed = true;
+    }
+
+    // every module current sum of 1..32 modules on
+    {
+        uint64_t inputs = 0, fixedWrong = 0, floatWrong = 0, differ = 0;
+        for (uint8_t on = 1; on <= 32; on++) {
+            for (uint32_t sum = 0; sum <= 65535u * on; sum++) {
+                int32_t  exact = PackCurrentExact(sum, on);
+                uint16_t fx = PackCurrentFixed(sum, on);
+                uint16_t fl = PackCurrentFloat(sum, on);
+                if (fx != (uint16_t)exact) fixedWrong++;
+                if (fl != (uint16_t)exact) floatWrong++;
+                if (fl != fx) differ++;
+                inputs++;
+            }
+        }
+        printf("%s  %8llu   %14llu   %14llu   %14llu\n", "module sum -> pack", (unsigned long long)inputs,
+               (unsigned long long)fixedWrong, (unsigned long long)floatWrong, (unsigned long long)differ);
+        if (fixedWrong) failed = true;
+    }
+
+    // timing - 32 modules on, random values in the ranges each signal sees
+    std::vector<PackInput> inputs(4096);
+    uint32_t seed = 1;
+    auto next = [&seed](uint32_t span) { seed = seed * 1664525u + 1013904223u; return (seed >> 8) % span; };
+    for (PackInput& in : inputs) {
+        for (int i = 0; i < 32; i++) {
+            in.mmc[i]           = 32768 + next(2000) - 1000;
+            in.maxChargeA[i]    = 32768 + 500;
+            in.maxDischargeA[i] = 32768 - 2100;
+        }
+        in.voltage = next(65536); in.soc = next(201); in.soh = next(201);
+        in.cellAvgVolt = 3000 + next(1200); in.cellHiVolt = 3000 + next(1200); in.cellLoVolt = 3000 + next(1200);
+        in.cellAvgTemp = 5535 + next(6000); in.cellHiTemp = 5535 + next(6000); in.cellLoTemp = 5535 + next(6000);
+        in.maxChargeEndV = next(65536);
+    }
+    uint32_t sink = 0;
+    double floatNs = TimeNs(PackUpdateFloat, inputs, 200, sink);
+    double fixedNs = TimeNs(PackUpdateFixed, inputs, 200, sink);
+    printf("\nOne pack update (32 modules on, 12 VCU conversions), host:\n");
+    printf("  float/double  %8.1f ns\n", floatNs);
+    printf("  fixed         %8.1f ns   (%.1fx)\n", fixedNs, floatNs / fixedNs);
+    printf("  (checksum %u)\n", sink);
+
+    if (failed) printf("\nFAIL - a fixed point conversion differs from the exact encoding\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,664 @@
+/******************************************************************************
+ * @file    module_stats_bench.c
+ * @brief   Pack aggregation (module_stats.h) vs its scalar definition, the
+ *          tournament trees it replaced and the original float statistics
+ * @author  Pack Emulator Development Team
+ *
+ * Drives one random sequence of module changes - modules joining and leaving
+ * the aggregates, switching on and off, new keys including 0 and 0xFFFF -
+ * through four copies of the pack aggregates:
+ *
+ *   trees    the earlier mcu_stats.c: a tournament tree per key replayed from
+ *            the changed leaf, running sums with the old contribution taken
+ *            out and the new one put in
+ *   summary  mcu_stats.c: ModuleStats_Update() for a module that stays active,
+ *            compaction and one ModuleStats_Pass() on membership change
+ *   pass     the summary with every row rewritten in place and a full
+ *            ModuleStats_Pass() each pass
+ *   scalar   ModuleStats_Scalar() over the entries
+ *
+ * and fails (exit code 1) if any minimum, winning slot, sum or on count
+ * differs after any step.
+ *
+ * Then derives the pack values from the summary the way mcu_stats.c does and
+ * compares them with the float MCU_UpdateStats() of the original mcu.c over
+ * random packs. Every value must match, except that the float currents may
+ * differ where the integer ones are the exact value of the encoding.
+ *
+ * Last, times one pack pass with 1, 4 and 32 modules changed each way.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <math.h>
+
+#include "bms.h"
+#include "module_stats.h"
+#include "fixed_signal.h"
+
+#define TREE_SLOTS      32
+#define BENCH_STEPS     200000
+#define BENCH_PACKS     200000
+#define BENCH_ROUNDS    200000
+
+// Float constants - copied from Core/Inc/eeprom_data.h
+#define PACK_CURRENT_BASE         -1600
+#define PACK_CURRENT_FACTOR       0.05
+#define MODULE_CURRENT_BASE       -655.36
+#define MODULE_CURRENT_FACTOR     0.02
+
+static uint32_t seed = 1;
+
+static uint32_t Next(uint32_t span)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) % span;
+}
+
+/* ------------------------------------------------- tournament tree reference */
+
+typedef struct {
+    uint16_t key[MODULE_STATS_KEYS][TREE_SLOTS];
+    uint8_t  node[MODULE_STATS_KEYS][TREE_SLOTS];
+    uint32_t sum[MODULE_STATS_SUMS];
+    uint32_t activeMask;
+    uint32_t onMask;
+    moduleStatsEntry_t in[MAX_MODULES_PER_PACK];    // contribution in the sums
+} trees_t;
+
+static uint8_t TreeWinner(const trees_t* t, uint8_t tree, uint8_t node)
+{
+    return node >= TREE_SLOTS ? node - TREE_SLOTS : t->node[tree][node];
+}
+
+static void TreeReplay(trees_t* t, uint8_t tree, uint8_t slot)
+{
+    for (uint8_t node = (TREE_SLOTS + slot) >> 1; node > 0; node >>= 1) {
+        uint8_t left  = TreeWinner(t, tree, node << 1);
+        uint8_t right = TreeWinner(t, tree, (node << 1) + 1);
+        t->node[tree][node] = t->key[tree][right] < t->key[tree][left] ? right : left;
+    }
+}
+
+static void TreeInit(trees_t* t)
+{
+    memset(t, 0, sizeof(*t));
+    for (uint8_t tree = 0; tree < MODULE_STATS_KEYS; tree++) {
+        for (uint8_t slot = 0; slot < TREE_SLOTS; slot++) t->key[tree][slot] = MODULE_STATS_EMPTY;
+        for (uint8_t slot = 0; slot < TREE_SLOTS; slot += 2) TreeReplay(t, tree, slot);
+    }
+}
+
+static void TreeSet(trees_t* t, uint8_t slot, bool active, const moduleStatsEntry_t* e)
+{
+    uint32_t bit = 1UL << slot;
+    uint8_t  i;
+
+    if (t->onMask & bit)
+        for (i = 0; i < MODULE_STATS_ON_SUMS; i++) t->sum[i] -= t->in[slot].sum[i];
+    if (t->activeMask & bit)
+        for (i = MODULE_STATS_ON_SUMS; i < MODULE_STATS_SUMS; i++) t->sum[i] -= t->in[slot].sum[i];
+    t->onMask &= ~bit;
+    t->activeMask &= ~bit;
+
+    for (i = 0; i < MODULE_STATS_KEYS; i++) {
+        t->key[i][slot] = active ? e->key[i] : MODULE_STATS_EMPTY;
+        TreeReplay(t, i, slot);
+    }
+    if (!active) return;
+
+    t->in[slot] = *e;
+    if (e->on) {
+        for (i = 0; i < MODULE_STATS_ON_SUMS; i++) t->sum[i] += e->sum[i];
+        t->onMask |= bit;
+    }
+    for (i = MODULE_STATS_ON_SUMS; i < MODULE_STATS_SUMS; i++) t->sum[i] += e->sum[i];
+    t->activeMask |= bit;
+}
+
+static void TreeResult(const trees_t* t, moduleStatsResult_t* r)
+{
+    memset(r, 0, sizeof(*r));
+    for (uint8_t i = 0; i < MODULE_STATS_KEYS; i++) {
+        r->slot[i] = t->node[i][1];
+        r->min[i]  = t->key[i][r->slot[i]];
+    }
+    memcpy(r->sum, t->sum, sizeof(r->sum));
+    r->on = __builtin_popcount(t->onMask);
+}
+
+/* -------------------------------------------------------- summary (firmware) */
+
+typedef struct {
+    moduleStatsEntry_t   entry[MAX_MODULES_PER_PACK];
+    moduleStatsSummary_t summary;
+    moduleStatsResult_t  totals;
+    uint8_t              row[MAX_MODULES_PER_PACK];
+    uint32_t             activeMask;
+    bool                 rebuild;
+} packStats_t;
+
+static void PackInit(packStats_t* p)
+{
+    memset(p, 0, sizeof(*p));
+    p->rebuild = true;
+}
+
+// as MCU_StatsRefreshModule() and MCU_UpdateStats()
+static void PackSet(packStats_t* p, uint8_t slot, bool active, const moduleStatsEntry_t* e)
+{
+    uint32_t bit = 1UL << slot;
+    bool wasActive = (p->activeMask & bit) != 0;
+
+    p->activeMask &= ~bit;
+    if (!active) {
+        if (wasActive) p->rebuild = true;
+        return;
+    }
+    p->entry[slot] = *e;
+    p->activeMask |= bit;
+    if (wasActive && !p->rebuild) ModuleStats_Update(&p->summary, &p->totals, p->row[slot], e);
+    else                          p->rebuild = true;
+}
+
+static const moduleStatsResult_t* PackResult(packStats_t* p)
+{
+    if (p->rebuild) {
+        p->rebuild = false;
+        ModuleStats_Compact(&p->summary, p->row, p->entry, p->activeMask);
+        ModuleStats_Pass(&p->summary, &p->totals);
+    }
+    return &p->totals;
+}
+
+// full pass every time - rows rewritten in place
+static void PassSet(packStats_t* p, uint8_t slot, bool active, const moduleStatsEntry_t* e)
+{
+    uint32_t bit = 1UL << slot;
+    bool wasActive = (p->activeMask & bit) != 0;
+
+    p->activeMask &= ~bit;
+    if (!active) {
+        if (wasActive) p->rebuild = true;
+        return;
+    }
+    p->entry[slot] = *e;
+    p->activeMask |= bit;
+    if (wasActive && !p->rebuild) ModuleStats_SetRow(&p->summary, p->row[slot], slot, e);
+    else                          p->rebuild = true;
+}
+
+static void PassResult(packStats_t* p, moduleStatsResult_t* r)
+{
+    if (p->rebuild) {
+        p->rebuild = false;
+        ModuleStats_Compact(&p->summary, p->row, p->entry, p->activeMask);
+    }
+    ModuleStats_Pass(&p->summary, r);
+}
+
+/* ---------------------------------------------------------------- checking */
+
+static uint16_t RandomKey(void)
+{
+    switch (Next(8)) {
+    case 0:  return 0;
+    case 1:  return MODULE_STATS_EMPTY;
+    case 2:  return 3600 + Next(4);                 // plenty of ties
+    default: return Next(65536);
+    }
+}
+
+static void RandomEntry(moduleStatsEntry_t* e)
+{
+    for (uint8_t i = 0; i < MODULE_STATS_KEYS; i++) e->key[i] = RandomKey();
+    for (uint8_t i = 0; i < MODULE_STATS_SUMS; i++) e->sum[i] = Next(8) == 0 ? 0xFFFF : Next(65536);
+    e->on = Next(3) != 0;
+}
+
+static bool Same(const moduleStatsResult_t* a, const moduleStatsResult_t* b)
+{
+    return memcmp(a->min, b->min, sizeof(a->min)) == 0 && memcmp(a->slot, b->slot, sizeof(a->slot)) == 0 &&
+           memcmp(a->sum, b->sum, sizeof(a->sum)) == 0 && a->on == b->on;
+}
+
+static void Print(const char* name, const moduleStatsResult_t* r)
+{
+    printf("  %-7s", name);
+    for (uint8_t i = 0; i < MODULE_STATS_KEYS; i++) printf(" %5u@%-2u", r->min[i], r->slot[i]);
+    for (uint8_t i = 0; i < MODULE_STATS_SUMS; i++) printf(" %7u", r->sum[i]);
+    printf(" on %u\n", r->on);
+}
+
+static bool Check(void)
+{
+    static trees_t trees;
+    static packStats_t packStats;
+    static packStats_t passStats;
+    moduleStatsResult_t fromTrees, fromSummary, fromPass, fromScalar;
+    moduleStatsEntry_t e;
+
+    TreeInit(&trees);
+    PackInit(&packStats);
+    PackInit(&passStats);
+
+    for (uint32_t step = 0; step < BENCH_STEPS; step++) {
+        // one to a few modules change per pass, sometimes the whole pack leaves
+        uint32_t changes = Next(4) == 0 ? 1 + Next(MAX_MODULES_PER_PACK) : 1;
+        bool     drain   = Next(5000) == 0;
+        for (uint32_t c = 0; c < changes || (drain && c < MAX_MODULES_PER_PACK); c++) {
+            uint8_t slot   = drain ? c : Next(MAX_MODULES_PER_PACK);
+            bool    active = !drain && Next(6) != 0;
+            RandomEntry(&e);
+            TreeSet(&trees, slot, active, &e);
+            PackSet(&packStats, slot, active, &e);
+            PassSet(&passStats, slot, active, &e);
+        }
+        TreeResult(&trees, &fromTrees);
+        fromSummary = *PackResult(&packStats);
+        PassResult(&passStats, &fromPass);
+        ModuleStats_Scalar(packStats.entry, packStats.activeMask, &fromScalar);
+        if (!Same(&fromTrees, &fromSummary) || !Same(&fromTrees, &fromPass) || !Same(&fromTrees, &fromScalar)) {
+            printf("MISMATCH at step %u, active 0x%08x\n", step, packStats.activeMask);
+            Print("trees", &fromTrees);
+            Print("summary", &fromSummary);
+            Print("pass", &fromPass);
+            Print("scalar", &fromScalar);
+            return false;
+        }
+    }
+    printf("%d steps - trees, summary, pass and scalar agree on every minimum, slot, sum and on count\n\n", BENCH_STEPS);
+    return true;
+}
+
+/* ------------------------------------------- original float MCU_UpdateStats */
+
+typedef struct {                    // the module fields MCU_UpdateStats() read
+    bool     active;                // registered, not faulted
+    bool     on;                    // currentState == moduleOn
+    uint16_t mmv, mmc, maxChargeA, maxDischargeA, maxChargeEndV;
+    uint16_t cellAvgVolt, cellAvgTemp, cellLoVolt, cellHiVolt, cellLoTemp, cellHiTemp;
+    uint8_t  soc, soh;
+} benchModule_t;
+
+typedef struct {                    // the pack values it wrote, as batteryPack holds them
+    uint16_t voltage;
+    uint32_t current, maxChargeA, maxDischargeA;
+    uint16_t maxChargeEndV, cellAvgVolt, cellHiVolt, cellLoVolt, cellAvgTemp, cellHiTemp, cellLoTemp;
+    uint8_t  soc, soh, activeModules;
+    uint8_t  modCellHiVolt, modCellLoVolt, modCellHiTemp, modCellLoTemp;
+} benchPack_t;
+
+// the loop and conversions of the original mcu.c, module ID = slot + 1 - the over current checks only
+// flag modules for the next pass, so they are left out
+static void BaselineFloat(const benchModule_t* m, benchPack_t* pack)
+{
+    uint8_t  modulesOn = 0, activeModules = 0;
+    uint32_t voltage = 0, totalMaxChargeEndV = 0, totalAvgCellVolt = 0, totalAvgCellTemp = 0;
+    float    moduleCurrent, moduleMaxChargeA, moduleMaxDischargeA;
+    float    totalCurrent = 0, maxChargeA = 0, maxDischargeA = 0, packCurrent;
+    uint16_t lowestSoc = 255, lowestSoh = 255;
+    uint16_t highestCellVolt = 0, lowestCellVolt = 65535, highestCellTemp = 0, lowestCellTemp = 65535;
+    uint8_t  modLowestCellVolt = 0, modHighestCellVolt = 0, modLowestCellTemp = 0, modHighestCellTemp = 0;
+
+    memset(pack, 0, sizeof(*pack));
+    for (uint8_t index = 0; index < MAX_MODULES_PER_PACK; index++) {
+        if (!m[index].active) continue;
+        if (m[index].on) {
+            moduleMaxChargeA    = MODULE_CURRENT_BASE + (m[index].maxChargeA    * MODULE_CURRENT_FACTOR);
+            moduleMaxDischargeA = MODULE_CURRENT_BASE + (m[index].maxDischargeA * MODULE_CURRENT_FACTOR);
+            voltage = voltage + m[index].mmv;
+            modulesOn++;
+            moduleCurrent       = MODULE_CURRENT_BASE + (m[index].mmc           * MODULE_CURRENT_FACTOR);
+            totalCurrent  = totalCurrent  + moduleCurrent;
+            maxDischargeA = maxDischargeA + moduleMaxDischargeA;
+            maxChargeA    = maxChargeA    + moduleMaxChargeA;
+        }
+        totalMaxChargeEndV = totalMaxChargeEndV + m[index].maxChargeEndV;
+        totalAvgCellVolt   = totalAvgCellVolt   + m[index].cellAvgVolt;
+        totalAvgCellTemp   = totalAvgCellTemp   + m[index].cellAvgTemp;
+        if (m[index].soc < lowestSoc) lowestSoc = m[index].soc;
+        if (m[index].soh < lowestSoh) lowestSoh = m[index].soh;
+        if (m[index].cellLoVolt < lowestCellVolt)  { lowestCellVolt  = m[index].cellLoVolt; modLowestCellVolt  = index + 1; }
+        if (m[index].cellHiVolt > highestCellVolt) { highestCellVolt = m[index].cellHiVolt; modHighestCellVolt = index + 1; }
+        if (m[index].cellHiTemp > highestCellTemp) { highestCellTemp = m[index].cellHiTemp; modHighestCellTemp = index + 1; }
+        if (m[index].cellLoTemp < lowestCellTemp)  { lowestCellTemp  = m[index].cellLoTemp; modLowestCellTemp  = index + 1; }
+        activeModules++;
+    }
+    pack->activeModules = activeModules;
+
+    if (modulesOn > 0) {
+        pack->voltage = voltage / modulesOn;
+        if (totalCurrent > (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))) totalCurrent = (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR));
+        else if (totalCurrent < PACK_CURRENT_BASE)                            totalCurrent = PACK_CURRENT_BASE;
+        packCurrent = (totalCurrent/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
+        pack->current = (uint16_t) packCurrent;
+    } else {
+        pack->voltage = 0;
+        packCurrent = (0 / PACK_CURRENT_FACTOR) - (PACK_CURRENT_BASE / PACK_CURRENT_FACTOR);
+        pack->current = (uint16_t) packCurrent;
+    }
+
+    if (maxChargeA > (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))) maxChargeA = (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR));
+    else if (maxChargeA < PACK_CURRENT_BASE)                            maxChargeA = PACK_CURRENT_BASE;
+    if (maxDischargeA > (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR))) maxDischargeA = (PACK_CURRENT_BASE + (65535 * PACK_CURRENT_FACTOR));
+    else if (maxDischargeA < PACK_CURRENT_BASE)                               maxDischargeA = PACK_CURRENT_BASE;
+    pack->maxChargeA    = (maxChargeA/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
+    pack->maxDischargeA = (maxDischargeA/PACK_CURRENT_FACTOR)-(PACK_CURRENT_BASE/PACK_CURRENT_FACTOR);
+
+    pack->maxChargeEndV = activeModules > 0 ? totalMaxChargeEndV / activeModules : 0;
+    pack->soc = (activeModules > 0 && lowestSoc < 255) ? lowestSoc : 0;
+    pack->soh = (activeModules > 0 && lowestSoh < 255) ? lowestSoh : 0;
+    pack->cellAvgVolt = activeModules > 0 ? totalAvgCellVolt / activeModules : 0;
+    pack->cellHiVolt = highestCellVolt;
+    pack->modCellHiVolt = modHighestCellVolt;
+    pack->cellLoVolt    = lowestCellVolt < 65535 ? lowestCellVolt : 0;
+    pack->modCellLoVolt = lowestCellVolt < 65535 ? modLowestCellVolt : 0;
+    pack->cellAvgTemp = activeModules > 0 ? totalAvgCellTemp / activeModules : 0;
+    pack->cellHiTemp = highestCellTemp;
+    pack->modCellHiTemp = modHighestCellTemp;
+    pack->cellLoTemp    = lowestCellTemp < 65535 ? lowestCellTemp : 0;
+    pack->modCellLoTemp = lowestCellTemp < 65535 ? modLowestCellTemp : 0;
+}
+
+// the module's entry as MCU_StatsRefreshModule() builds it
+static void EntryOf(const benchModule_t* m, moduleStatsEntry_t* e)
+{
+    memset(e, 0, sizeof(*e));
+    if (m->on) {
+        e->sum[MODULE_STATS_MMV]             = m->mmv;
+        e->sum[MODULE_STATS_MMC]             = m->mmc;
+        e->sum[MODULE_STATS_MAX_CHARGE_A]    = m->maxChargeA;
+        e->sum[MODULE_STATS_MAX_DISCHARGE_A] = m->maxDischargeA;
+    }
+    e->on = m->on;
+    e->sum[MODULE_STATS_MAX_CHARGE_END_V] = m->maxChargeEndV;
+    e->sum[MODULE_STATS_CELL_AVG_VOLT]    = m->cellAvgVolt;
+    e->sum[MODULE_STATS_CELL_AVG_TEMP]    = m->cellAvgTemp;
+    e->key[MODULE_STATS_CELL_LO_VOLT] = m->cellLoVolt;
+    e->key[MODULE_STATS_CELL_HI_VOLT] = MODULE_STATS_EMPTY - m->cellHiVolt;
+    e->key[MODULE_STATS_CELL_LO_TEMP] = m->cellLoTemp;
+    e->key[MODULE_STATS_CELL_HI_TEMP] = MODULE_STATS_EMPTY - m->cellHiTemp;
+    e->key[MODULE_STATS_SOC]          = m->soc;
+    e->key[MODULE_STATS_SOH]          = m->soh;
+}
+
+static int32_t ClampQuanta(int32_t quanta)
+{
+    if (quanta > FXS_QUANTA(65535, PACK_CURRENT)) return FXS_QUANTA(65535, PACK_CURRENT);
+    if (quanta < FXS_QUANTA(0, PACK_CURRENT))     return FXS_QUANTA(0, PACK_CURRENT);
+    return quanta;
+}
+
+// the pack values as MCU_StatsDerivePack() derives them from the totals, without the error prints
+static void Derive(const moduleStatsResult_t* t, uint8_t activeModules, benchPack_t* pack)
+{
+    uint8_t modulesOn = t->on;
+    uint16_t value;
+
+    memset(pack, 0, sizeof(*pack));
+    pack->activeModules = activeModules;
+    pack->voltage       = modulesOn > 0 ? t->sum[MODULE_STATS_MMV] / modulesOn : 0;
+    pack->current       = FXS_FROM_QUANTA(modulesOn > 0 ? ClampQuanta(FXS_SUM_QUANTA(t->sum[MODULE_STATS_MMC], modulesOn, MODULE_CURRENT)) : 0, PACK_CURRENT);
+    pack->maxChargeA    = FXS_FROM_QUANTA(ClampQuanta(FXS_SUM_QUANTA(t->sum[MODULE_STATS_MAX_CHARGE_A],    modulesOn, MODULE_CURRENT)), PACK_CURRENT);
+    pack->maxDischargeA = FXS_FROM_QUANTA(ClampQuanta(FXS_SUM_QUANTA(t->sum[MODULE_STATS_MAX_DISCHARGE_A], modulesOn, MODULE_CURRENT)), PACK_CURRENT);
+    if (activeModules > 0) {
+        pack->maxChargeEndV = t->sum[MODULE_STATS_MAX_CHARGE_END_V] / activeModules;
+        pack->cellAvgVolt   = t->sum[MODULE_STATS_CELL_AVG_VOLT]    / activeModules;
+        pack->cellAvgTemp   = t->sum[MODULE_STATS_CELL_AVG_TEMP]    / activeModules;
+    }
+
+    value = t->min[MODULE_STATS_SOC];
+    pack->soc = value < 255 ? value : 0;
+    value = t->min[MODULE_STATS_SOH];
+    pack->soh = value < 255 ? value : 0;
+
+    value = t->min[MODULE_STATS_CELL_HI_VOLT];
+    pack->cellHiVolt    = MODULE_STATS_EMPTY - value;
+    pack->modCellHiVolt = value != MODULE_STATS_EMPTY ? t->slot[MODULE_STATS_CELL_HI_VOLT] + 1 : 0;
+    value = t->min[MODULE_STATS_CELL_LO_VOLT];
+    pack->cellLoVolt    = value != MODULE_STATS_EMPTY ? value : 0;
+    pack->modCellLoVolt = value != MODULE_STATS_EMPTY ? t->slot[MODULE_STATS_CELL_LO_VOLT] + 1 : 0;
+    value = t->min[MODULE_STATS_CELL_HI_TEMP];
+    pack->cellHiTemp    = MODULE_STATS_EMPTY - value;
+    pack->modCellHiTemp = value != MODULE_STATS_EMPTY ? t->slot[MODULE_STATS_CELL_HI_TEMP] + 1 : 0;
+    value = t->min[MODULE_STATS_CELL_LO_TEMP];
+    pack->cellLoTemp    = value != MODULE_STATS_EMPTY ? value : 0;
+    pack->modCellLoTemp = value != MODULE_STATS_EMPTY ? t->slot[MODULE_STATS_CELL_LO_TEMP] + 1 : 0;
+}
+
+// Exact value of an encoding - nearest integer if within 1e-6 of one, else truncated
+static int32_t Exact(long double v)
+{
+    long double r = roundl(v);
+    if (fabsl(v - r) < 1e-6L) return (int32_t)r;
+    return (int32_t)truncl(v);
+}
+
+// pack current of modulesOn module currents summing to raw sum, clamped as the pack encoding demands
+static uint32_t PackCurrentExact(uint32_t sum, uint8_t modulesOn)
+{
+    long double amps = modulesOn * (long double)MODULE_CURRENT_BASE + sum * (long double)MODULE_CURRENT_FACTOR;
+    long double top  = PACK_CURRENT_BASE + 65535 * (long double)PACK_CURRENT_FACTOR;
+
+    if (amps > top)               amps = top;
+    if (amps < PACK_CURRENT_BASE) amps = PACK_CURRENT_BASE;
+    return Exact((amps - PACK_CURRENT_BASE) / (long double)PACK_CURRENT_FACTOR);
+}
+
+static uint16_t RandomCurrent(void)
+{
+    switch (Next(8)) {
+    case 0:  return Next(0x10000);                      // anywhere - drives the pack sums into the clamps
+    case 1:  return Next(2) ? 0 : 0xFFFF;
+    default: return 32768 + Next(4001) - 2000;          // +-40 A
+    }
+}
+
+static void RandomModule(benchModule_t* m)
+{
+    m->active        = Next(8) != 0;
+    m->on            = Next(4) != 0;
+    m->mmv           = Next(0x10000);
+    m->mmc           = RandomCurrent();
+    m->maxChargeA    = RandomCurrent();
+    m->maxDischargeA = RandomCurrent();
+    m->maxChargeEndV = Next(0x10000);
+    m->cellAvgVolt   = Next(0x10000);
+    m->cellAvgTemp   = Next(0x10000);
+    m->cellLoVolt    = RandomKey();
+    m->cellHiVolt    = RandomKey();
+    m->cellLoTemp    = RandomKey();
+    m->cellHiTemp    = RandomKey();
+    m->soc           = Next(8) ? Next(101) : 255;
+    m->soh           = Next(8) ? Next(101) : 255;
+}
+
+#define SAME_FIELD(f)   (a->f == b->f)
+
+static bool SameOtherThanCurrents(const benchPack_t* a, const benchPack_t* b)
+{
+    return SAME_FIELD(voltage) && SAME_FIELD(maxChargeEndV) && SAME_FIELD(activeModules) &&
+           SAME_FIELD(cellAvgVolt) && SAME_FIELD(cellHiVolt) && SAME_FIELD(cellLoVolt) &&
+           SAME_FIELD(cellAvgTemp) && SAME_FIELD(cellHiTemp) && SAME_FIELD(cellLoTemp) &&
+           SAME_FIELD(soc) && SAME_FIELD(soh) &&
+           SAME_FIELD(modCellHiVolt) && SAME_FIELD(modCellLoVolt) && SAME_FIELD(modCellHiTemp) && SAME_FIELD(modCellLoTemp);
+}
+
+static void PrintPack(const char* name, const benchPack_t* p)
+{
+    printf("  %-8s V %u I %u chg %u dis %u endV %u active %u soc %u soh %u\n", name, p->voltage, p->current,
+           p->maxChargeA, p->maxDischargeA, p->maxChargeEndV, p->activeModules, p->soc, p->soh);
+    printf("  %-8s cellV %u/%u/%u (%u/%u) cellT %u/%u/%u (%u/%u)\n", "", p->cellAvgVolt, p->cellHiVolt,
+           p->cellLoVolt, p->modCellHiVolt, p->modCellLoVolt, p->cellAvgTemp, p->cellHiTemp, p->cellLoTemp,
+           p->modCellHiTemp, p->modCellLoTemp);
+}
+
+// one pack whose modules change a few at a time through the summary, read after every step
+static bool Baseline(void)
+{
+    static benchModule_t modules[MAX_MODULES_PER_PACK];
+    static packStats_t packStats;
+    benchPack_t fromFloat, fromSummary;
+    const moduleStatsResult_t* totals;
+    moduleStatsEntry_t e;
+    uint32_t currentOff = 0, chargeOff = 0, dischargeOff = 0;
+    uint32_t sumOn[3];
+
+    PackInit(&packStats);
+    for (uint8_t m = 0; m < MAX_MODULES_PER_PACK; m++) {
+        RandomModule(&modules[m]);
+        EntryOf(&modules[m], &e);
+        PackSet(&packStats, m, modules[m].active, &e);
+    }
+
+    for (uint32_t step = 0; step < BENCH_PACKS; step++) {
+        uint8_t changes = 1 + Next(3);
+        for (uint8_t c = 0; c < changes; c++) {
+            uint8_t slot = Next(MAX_MODULES_PER_PACK);
+            RandomModule(&modules[slot]);
+            EntryOf(&modules[slot], &e);
+            PackSet(&packStats, slot, modules[slot].active, &e);
+        }
+        BaselineFloat(modules, &fromFloat);
+        totals = PackResult(&packStats);
+        Derive(totals, packStats.summary.rows, &fromSummary);
+
+        uint8_t on = 0;
+        sumOn[0] = sumOn[1] = sumOn[2] = 0;
+        for (uint8_t m = 0; m < MAX_MODULES_PER_PACK; m++) {
+            if (!modules[m].active || !modules[m].on) continue;
+            on++;
+            sumOn[0] += modules[m].mmc;
+            sumOn[1] += modules[m].maxChargeA;
+            sumOn[2] += modules[m].maxDischargeA;
+        }
+        if (!SameOtherThanCurrents(&fromFloat, &fromSummary) ||
+            fromSummary.current       != PackCurrentExact(on > 0 ? sumOn[0] : 0, on) ||
+            fromSummary.maxChargeA    != PackCurrentExact(sumOn[1], on) ||
+            fromSummary.maxDischargeA != PackCurrentExact(sumOn[2], on)) {
+            printf("MISMATCH at pack %u\n", step);
+            PrintPack("float", &fromFloat);
+            PrintPack("summary", &fromSummary);
+            return false;
+        }
+        currentOff   += fromFloat.current       != fromSummary.current;
+        chargeOff    += fromFloat.maxChargeA    != fromSummary.maxChargeA;
+        dischargeOff += fromFloat.maxDischargeA != fromSummary.maxDischargeA;
+    }
+    printf("%d packs - summary matches the float MCU_UpdateStats() on every value but the currents,\n", BENCH_PACKS);
+    printf("which are exact; the float ones were off in %u current, %u maxChargeA, %u maxDischargeA\n\n",
+           currentOff, chargeOff, dischargeOff);
+    return true;
+}
+
+
+/* ------------------------------------------------------------------ timing */
+
+static double Ns(struct timespec* start, struct timespec* end)
+{
+    return ((end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec)) / BENCH_ROUNDS;
+}
+
+static void Time(uint8_t changed)
+{
+    static trees_t trees;
+    static packStats_t packStats;
+    static packStats_t passStats;
+    static moduleStatsEntry_t entries[MAX_MODULES_PER_PACK];
+    moduleStatsResult_t r;
+    struct timespec start, end;
+    uint32_t sink = 0;
+    double treeNs, summaryNs, passNs, scalarNs;
+
+    TreeInit(&trees);
+    PackInit(&packStats);
+    PackInit(&passStats);
+    for (uint8_t m = 0; m < MAX_MODULES_PER_PACK; m++) {
+        RandomEntry(&entries[m]);
+        TreeSet(&trees, m, true, &entries[m]);
+        PackSet(&packStats, m, true, &entries[m]);
+        PassSet(&passStats, m, true, &entries[m]);
+    }
+    PackResult(&packStats);
+    PassResult(&passStats, &r);
+
+    // a pass: the changed modules' values move, then the pack values are read
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint8_t c = 0; c < changed; c++) {
+            uint8_t slot = (round + c * 7) & (MAX_MODULES_PER_PACK - 1);
+            entries[slot].key[0] ^= 1;
+            TreeSet(&trees, slot, true, &entries[slot]);
+        }
+        TreeResult(&trees, &r);
+        sink += r.min[0] + r.sum[1];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    treeNs = Ns(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint8_t c = 0; c < changed; c++) {
+            uint8_t slot = (round + c * 7) & (MAX_MODULES_PER_PACK - 1);
+            entries[slot].key[0] ^= 1;
+            PackSet(&packStats, slot, true, &entries[slot]);
+        }
+        r = *PackResult(&packStats);
+        sink += r.min[0] + r.sum[1];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    summaryNs = Ns(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint8_t c = 0; c < changed; c++) {
+            uint8_t slot = (round + c * 7) & (MAX_MODULES_PER_PACK - 1);
+            entries[slot].key[0] ^= 1;
+            PassSet(&passStats, slot, true, &entries[slot]);
+        }
+        PassResult(&passStats, &r);
+        sink += r.min[0] + r.sum[1];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    passNs = Ns(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint8_t c = 0; c < changed; c++) {
+            uint8_t slot = (round + c * 7) & (MAX_MODULES_PER_PACK - 1);
+            entries[slot].key[0] ^= 1;
+            packStats.entry[slot] = entries[slot];
+        }
+        ModuleStats_Scalar(packStats.entry, packStats.activeMask, &r);
+        sink += r.min[0] + r.sum[1];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    scalarNs = Ns(&start, &end);
+
+    printf("%-9u %12.0f %12.0f %12.0f %12.0f\n", changed, treeNs, summaryNs, passNs, scalarNs);
+    if (sink == 42) printf(" ");
+}
+
+int main(void)
+{
+    if (!Check() || !Baseline()) {
+        printf("\nFAIL\n");
+        return 1;
+    }
+
+    printf("pack pass, %d modules active (ns)\n", MAX_MODULES_PER_PACK);
+    printf("%-9s %12s %12s %12s %12s\n", "changed", "trees", "summary", "pass", "scalar");
+    Time(1);
+    Time(4);
+    Time(MAX_MODULES_PER_PACK);
+
+    printf("\nPASS\n");
+    return 0;
+}
@@ -0,0 +1,270 @@
+/******************************************************************************
+ * @file    soc_estimator_bench.c
+ * @brief   Coulomb counting SOC estimator (soc_estimator.h) against current profiles
+ * @author  Pack Emulator Development Team
+ *
+ * Feeds a module current profile through a reference module - exact SOC in
+ * double precision at 1 ms, status reports with its SOC in 0.5 % steps and
+ * its current in 0.02 A steps - and runs the estimator on the reports the way
+ * mcu_soc.c does: counted forward every 100 ms, corrected on every report.
+ *
+ * Built-in profiles cover driving, charging and current pulses, with the
+ * module capacity on and off the firmware's nominal. A recorded profile is
+ * read from a CSV file of "time_ms,current_A" lines (positive charges):
+ *
+ *   ./soc_estimator_bench.exe profile.csv [capacityAh] [startSoc%]
+ *
+ * Fails (exit code 1) if a built-in profile's estimate strays further from the
+ * reference than SOC_BENCH_MAX_ERROR. Then times a 32 module counting pass.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "soc_estimator.h"
+
+#define BENCH_NOMINAL_AH        100     // MCU_SOC_MODULE_AH
+#define BENCH_UPDATE_MS         100     // MCU_SOC_INTERVAL
+#define BENCH_REPORT_MS         500     // module status period
+#define BENCH_MODULES           32
+#define BENCH_ROUNDS            200000
+#define SOC_BENCH_MAX_ERROR     0.25    // % - no worse than the 0.5 % reports themselves
+#define BENCH_MAX_SAMPLES       200000
+
+typedef double (*profileFn)(uint32_t ms);
+
+typedef struct {
+    const char* name;
+    profileFn   current;
+    uint32_t    durationMs;
+    double      capacityAh;             // the reference module's real capacity
+    double      startSoc;               // %
+} benchCase_t;
+
+typedef struct {
+    double   maxError;                  // %
+    double   rmsError;
+    double   maxReportError;
+    double   maxStep;                   // largest estimate change between updates, %
+    uint32_t changes;                   // updates that changed the estimate
+    uint32_t reportChanges;             // reports that changed the reported SOC
+    double   endSoc;
+} benchResult_t;
+
+static uint32_t  csvCount;
+static uint32_t  csvTime[BENCH_MAX_SAMPLES];
+static double    csvCurrent[BENCH_MAX_SAMPLES];
+
+/* ---------------------------------------------------------------- profiles */
+
+static double DriveProfile(uint32_t ms)
+{
+    // 120 s urban cycle - pull away, cruise, regen, stop, hard pull, creep
+    uint32_t t = (ms / 1000) % 120;
+    if (t < 10)  return -120.0;
+    if (t < 60)  return -35.0;
+    if (t < 70)  return 40.0;
+    if (t < 90)  return 0.0;
+    if (t < 100) return -150.0;
+    return -20.0;
+}
+
+static double ChargeProfile(uint32_t ms)
+{
+    // 50 A constant current for 70 min, then a taper down to 5 A over 50 min
+    double minutes = ms / 60000.0;
+    if (minutes < 70.0) return 50.0;
+    return 50.0 - 45.0 * fmin((minutes - 70.0) / 50.0, 1.0);
+}
+
+static double PulseProfile(uint32_t ms)
+{
+    // 100 s pulse test - 10 s discharge, 40 s rest, 10 s charge, 40 s rest
+    uint32_t t = (ms / 1000) % 100;
+    if (t < 10)  return -100.0;
+    if (t < 50)  return 0.0;
+    if (t < 60)  return 75.0;
+    return 0.0;
+}
+
+static double CsvProfile(uint32_t ms)
+{
+    // held from one recorded sample to the next
+    uint32_t lo = 0, hi = csvCount;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (csvTime[mid] <= ms) lo = mid; else hi = mid;
+    }
+    return csvCurrent[lo];
+}
+
+static bool LoadCsv(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    char line[128];
+    double t, a;
+
+    if (!f) { printf("cannot open %s\n", path); return false; }
+    csvCount = 0;
+    while (fgets(line, sizeof(line), f) && csvCount < BENCH_MAX_SAMPLES) {
+        if (line[0] == '#' || sscanf(line, "%lf,%lf", &t, &a) != 2) continue;
+        if (csvCount > 0 && (uint32_t)t < csvTime[csvCount - 1]) continue;
+        csvTime[csvCount]    = (uint32_t)t;
+        csvCurrent[csvCount] = a;
+        csvCount++;
+    }
+    fclose(f);
+    if (csvCount == 0) { printf("%s: no time_ms,current_A samples\n", path); return false; }
+    // recordings need not start at 0
+    for (uint32_t i = csvCount; i-- > 0;) csvTime[i] -= csvTime[0];
+    return true;
+}
+
+/* --------------------------------------------------------------------- run */
+
+static uint8_t ReportedSoc(double soc)
+{
+    long steps = lround(soc / 0.5);
+    return (uint8_t)(steps < 0 ? 0 : (steps > 200 ? 200 : steps));
+}
+
+static int32_t ReportedCurrent(double amps)
+{
+    // module encoding is 0.02 A - the estimator takes 0.01 A quanta
+    return 2 * (int32_t)lround(amps / 0.02);
+}
+
+static benchResult_t RunCase(const benchCase_t* c)
+{
+    benchResult_t r = {0};
+    socEst_t est;
+    double   soc = c->startSoc;
+    double   sumSq = 0.0;
+    double   last;
+    uint32_t samples = 0;
+    uint32_t lastCount = 0;
+    uint8_t  reported = ReportedSoc(soc);
+    const int32_t chargePerQuantum = BENCH_NOMINAL_AH * SOC_EST_QUANTUM_PER_AH;
+
+    SocEst_Reset(&est, reported, ReportedCurrent(c->current(0)));
+    last = est.soc / 640.0;
+
+    for (uint32_t ms = 1; ms <= c->durationMs; ms++) {
+        // reference module - the current of the millisecond just past
+        soc += c->current(ms - 1) / (c->capacityAh * 36.0) / 1000.0;
+        soc  = fmin(fmax(soc, 0.0), 100.0);
+
+        if (ms % BENCH_REPORT_MS == 0) {
+            uint8_t now = ReportedSoc(soc);
+            SocEst_Integrate(&est, ms - lastCount, chargePerQuantum);
+            lastCount = ms;
+            SocEst_Report(&est, now, ReportedCurrent(c->current(ms)));
+            if (now != reported) r.reportChanges++;
+            reported = now;
+            if (fabs(reported * 0.5 - soc) > r.maxReportError) r.maxReportError = fabs(reported * 0.5 - soc);
+        }
+        if (ms % BENCH_UPDATE_MS == 0) {
+            double value, error;
+            SocEst_Integrate(&est, ms - lastCount, chargePerQuantum);
+            lastCount = ms;
+            value = est.soc / 640.0;
+            error = fabs(value - soc);
+            if (error > r.maxError) r.maxError = error;
+            sumSq += error * error;
+            samples++;
+            if (value != last) r.changes++;
+            if (fabs(value - last) > r.maxStep) r.maxStep = fabs(value - last);
+            last = value;
+        }
+    }
+    r.rmsError = samples ? sqrt(sumSq / samples) : 0.0;
+    r.endSoc   = soc;
+    return r;
+}
+
+static void PrintHeader(void)
+{
+    printf("%-18s %6s %6s %7s | %8s %8s %8s | %8s %8s %6s %6s\n", "profile", "Ah", "start", "end",
+           "maxErr", "rmsErr", "rptErr", "maxStep", "rptStep", "chg/s", "rpt/s");
+}
+
+static void PrintResult(const benchCase_t* c, const benchResult_t* r)
+{
+    double seconds = c->durationMs / 1000.0;
+    printf("%-18s %6.1f %5.1f%% %6.2f%% | %7.3f%% %7.3f%% %7.3f%% | %7.4f%% %7.3f%% %6.2f %6.3f\n",
+           c->name, c->capacityAh, c->startSoc, r->endSoc, r->maxError, r->rmsError, r->maxReportError,
+           r->maxStep, 0.5, r->changes / seconds, r->reportChanges / seconds);
+}
+
+static double CountPassNs(void)
+{
+    static socEst_t pack[BENCH_MODULES];
+    struct timespec start, end;
+    int32_t sink = 0;
+
+    for (int m = 0; m < BENCH_MODULES; m++) SocEst_Reset(&pack[m], 100 + m, -2000 - 37 * m);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int m = 0; m < BENCH_MODULES; m++) {
+            SocEst_Integrate(&pack[m], BENCH_UPDATE_MS, BENCH_NOMINAL_AH * SOC_EST_QUANTUM_PER_AH);
+            if (pack[m].soc == 0) SocEst_Reset(&pack[m], 200, pack[m].current);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (int m = 0; m < BENCH_MODULES; m++) sink += pack[m].soc;
+    if (sink == 42) printf(" ");
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_ROUNDS;
+}
+
+int main(int argc, char** argv)
+{
+    static const benchCase_t cases[] = {
+        { "drive",            DriveProfile,  3600000, 100.0, 90.0 },
+        { "drive 90Ah",       DriveProfile,  3600000,  90.0, 90.0 },
+        { "drive 110Ah",      DriveProfile,  3600000, 110.0, 90.0 },
+        { "charge",           ChargeProfile, 7200000, 100.0, 20.0 },
+        { "charge 80Ah",      ChargeProfile, 7200000,  80.0, 20.0 },
+        { "pulse",            PulseProfile,  1800000, 100.0, 60.0 },
+        { "pulse 120Ah",      PulseProfile,  1800000, 120.0, 60.0 },
+    };
+    bool pass = true;
+
+    printf("SOC estimator - %d Ah nominal, updated every %d ms, module status every %d ms\n\n",
+           BENCH_NOMINAL_AH, BENCH_UPDATE_MS, BENCH_REPORT_MS);
+    PrintHeader();
+
+    if (argc > 1) {
+        benchCase_t c = { argv[1], CsvProfile, 0, BENCH_NOMINAL_AH, 50.0 };
+        benchResult_t r;
+        if (!LoadCsv(argv[1])) return 1;
+        if (argc > 2) c.capacityAh = atof(argv[2]);
+        if (argc > 3) c.startSoc   = atof(argv[3]);
+        c.durationMs = csvTime[csvCount - 1];
+        r = RunCase(&c);
+        PrintResult(&c, &r);
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        benchResult_t r = RunCase(&cases[i]);
+        PrintResult(&cases[i], &r);
+        if (r.maxError > SOC_BENCH_MAX_ERROR) pass = false;
+    }
+
+    printf("\nmaxErr/rmsErr: estimate vs reference, rptErr: the reported 0.5 %% SOC (pack.soc) vs reference\n");
+    printf("maxStep: largest estimate change in one %d ms update, rptStep: the reported SOC step\n", BENCH_UPDATE_MS);
+    printf("\n%d module counting pass: %.0f ns\n", BENCH_MODULES, CountPassNs());
+
+    if (!pass) {
+        printf("\nFAIL - estimate error above %.2f %%\n", SOC_BENCH_MAX_ERROR);
+        return 1;
+    }
+    printf("\nPASS\n");
+    return 0;
+}
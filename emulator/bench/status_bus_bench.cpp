@@ -0,0 +1,263 @@
+/******************************************************************************
+ * @file    status_bus_bench.cpp
+ * @brief   Simulated module bus benchmark - unicast vs broadcast status polling
+ * @author  Pack Emulator Development Team
+ *
+ * Deterministic discrete-event model of the module CAN bus (500 kbit/s nominal,
+ * 29-bit extended frames, worst-case bit stuffing, lowest-ID arbitration).
+ *
+ * Compares one full status refresh of N modules using:
+ *   - unicast pipelined polling (PCU_Tasks/MCU_PollNextCandidate, window 1..6)
+ *   - broadcast request with slotted replies (MCU_RequestAllModuleStatus)
+ * each on classic CAN (STATUS_1/2/3) and on CAN FD with BRS (one STATUS_FD frame).
+ *
+ * Reports pack TX frames per refresh, snapshot latency, bus time and bus load at
+ * a 250 ms refresh, and peak RX FIFO occupancy / overflows for the pack's RX FIFO
+ * drained once per main loop pass.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "../../protocols/CAN_ID_ALL.h"
+#include "../../protocols/can_frm_mod.h"
+#include "can_bus_model.h"
+
+//---------------------------------------------------------------------------
+// Bus / node parameters
+//---------------------------------------------------------------------------
+static const uint32_t RX_FIFO_DEPTH     = 16;       // rxConfig.FifoSize = 15 -> 16 messages
+static const uint32_t REFRESH_TARGET_US = 250000;   // MCU_POLL_REFRESH_TARGET
+static const uint32_t MODULE_TURNAROUND = 400;      // ModuleCPU request -> first reply ready (us)
+static const uint32_t MODULE_FRAME_GAP  = 50;       // ModuleCPU load time between its own frames (us)
+static const uint8_t  STATUS_FD_BYTES   = 24;       // STATUS_FD with the reserved tail left off
+
+//---------------------------------------------------------------------------
+// Discrete-event bus
+//---------------------------------------------------------------------------
+struct Frame {
+    uint64_t ready;     // earliest time the frame may start arbitration (us)
+    uint32_t id;        // extended ID - lower wins arbitration
+    uint8_t  dlc;       // payload bytes
+    uint8_t  source;    // 0 = pack, else module ID
+    bool     fd;        // CAN FD frame with BRS
+};
+
+struct Result {
+    uint32_t packTxFrames;
+    uint32_t busFrames;
+    uint64_t busBusyUs;
+    uint64_t snapshotUs;
+    uint32_t fifoPeak;
+    uint32_t fifoOverflows;
+};
+
+class Bus {
+public:
+    explicit Bus(uint32_t drainUs) : now(0), drainPeriod(drainUs), nextDrain(drainUs),
+        fifoCount(0) { memset(&result, 0, sizeof(result)); }
+
+    void Queue(const Frame& f) { pending.push_back(f); }
+
+    // Runs until no frame is pending, calling onDelivered for every frame that completes
+    template <typename F> void Run(F onDelivered) {
+        while (!pending.empty()) {
+            // Earliest time any frame is ready
+            uint64_t earliest = pending[0].ready;
+            for (size_t i = 1; i < pending.size(); i++) {
+                earliest = std::min(earliest, pending[i].ready);
+            }
+            if (earliest > now) now = earliest;
+
+            // Arbitration among all frames ready at the start of this frame
+            size_t win = pending.size();
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (pending[i].ready <= now && (win == pending.size() || pending[i].id < pending[win].id)) {
+                    win = i;
+                }
+            }
+            Frame f = pending[win];
+            pending.erase(pending.begin() + win);
+
+            uint32_t duration = f.fd ? FdFrameTimeUs(f.dlc) : FrameTimeUs(f.dlc);
+            now += duration;
+            result.busFrames++;
+            result.busBusyUs += duration;
+            if (f.source == 0) {
+                result.packTxFrames++;
+            } else {
+                ReceiveIntoFifo();
+            }
+            onDelivered(f, now);
+        }
+    }
+
+    uint64_t Now() const { return now; }
+    Result result;
+
+private:
+    void DrainUpTo(uint64_t t) {
+        while (nextDrain <= t) {
+            fifoCount = 0;          // MCU_ReceiveMessages empties the FIFO each pass
+            nextDrain += drainPeriod;
+        }
+    }
+
+    void ReceiveIntoFifo() {
+        DrainUpTo(now);
+        if (fifoCount >= RX_FIFO_DEPTH) {
+            result.fifoOverflows++;
+            return;
+        }
+        fifoCount++;
+        result.fifoPeak = std::max(result.fifoPeak, fifoCount);
+    }
+
+    std::vector<Frame> pending;
+    uint64_t now;
+    uint64_t drainPeriod;
+    uint64_t nextDrain;
+    uint32_t fifoCount;
+};
+
+// Module replies to a status request - STATUS_1/2/3 back to back, or one STATUS_FD
+static void QueueStatusReplies(Bus& bus, uint8_t moduleId, uint64_t start, bool fd) {
+    static const uint16_t ids[3] = { ID_MODULE_STATUS_1, ID_MODULE_STATUS_2, ID_MODULE_STATUS_3 };
+    if (fd) {
+        Frame f = { start, ExtId(ID_MODULE_STATUS_FD, moduleId), STATUS_FD_BYTES, moduleId, true };
+        bus.Queue(f);
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        Frame f = { start + (uint64_t)i * MODULE_FRAME_GAP, ExtId(ids[i], moduleId), 8, moduleId, false };
+        bus.Queue(f);
+    }
+}
+
+static uint8_t StatusFrames(bool fd) { return fd ? 1 : 3; }
+
+//---------------------------------------------------------------------------
+// Strategies
+//---------------------------------------------------------------------------
+static Result RunUnicast(uint8_t modules, uint8_t window, uint32_t drainUs, bool fd) {
+    Bus bus(drainUs);
+    uint8_t nextModule = 1;
+    uint8_t received[CAN_MODULE_ID_MAX + 1] = {0};
+    uint8_t inFlight = 0;
+    uint64_t lastComplete = 0;
+
+    // Pack loop issues one request per module, keeping up to 'window' in flight
+    auto issue = [&](uint64_t t) {
+        while (inFlight < window && nextModule <= modules) {
+            Frame req = { t, ExtId(ID_MODULE_STATUS_REQUEST, nextModule), 1, 0, fd };
+            bus.Queue(req);
+            nextModule++;
+            inFlight++;
+        }
+    };
+    issue(0);
+
+    bus.Run([&](const Frame& f, uint64_t t) {
+        if (f.source == 0) {
+            QueueStatusReplies(bus, (uint8_t)(f.id & 0xFF), t + MODULE_TURNAROUND, fd);
+            return;
+        }
+        if (++received[f.source] == StatusFrames(fd)) {
+            inFlight--;
+            lastComplete = t;
+            // Completion is seen at the next main loop pass
+            issue(((t + drainUs - 1) / drainUs) * drainUs);
+        }
+    });
+
+    bus.result.snapshotUs = lastComplete;
+    return bus.result;
+}
+
+static Result RunBroadcast(uint8_t modules, uint8_t slotWidth, uint32_t drainUs, bool fd) {
+    Bus bus(drainUs);
+    uint8_t received[CAN_MODULE_ID_MAX + 1] = {0};
+    uint64_t lastComplete = 0;
+
+    CANFRM_MODULE_STATUS_BROADCAST request;
+    request.slotWidth = slotWidth;
+    request.sequence = 1;
+
+    Frame req = { 0, ExtId(ID_MODULE_STATUS_REQUEST, CAN_MODULE_ID_BROADCAST), 2, 0, fd };
+    bus.Queue(req);
+
+    bus.Run([&](const Frame& f, uint64_t t) {
+        if (f.source == 0) {
+            for (uint8_t id = 1; id <= modules; id++) {
+                uint64_t slot = (uint64_t)(id - 1) * request.slotWidth * MODULE_STATUS_SLOT_UNIT_US;
+                QueueStatusReplies(bus, id, t + MODULE_TURNAROUND + slot, fd);
+            }
+            return;
+        }
+        if (++received[f.source] == StatusFrames(fd)) {
+            lastComplete = t;
+        }
+    });
+
+    bus.result.snapshotUs = lastComplete;
+    return bus.result;
+}
+
+//---------------------------------------------------------------------------
+// Report
+//---------------------------------------------------------------------------
+static void PrintRow(const char* name, uint8_t modules, const Result& r) {
+    double load = 100.0 * (double)r.busBusyUs / REFRESH_TARGET_US;
+    printf("  %-16s %3u  %6u  %6u  %9.2f  %9.2f  %6.2f%%  %4u  %5u\n",
+           name, modules, r.packTxFrames, r.busFrames,
+           r.snapshotUs / 1000.0, r.busBusyUs / 1000.0, load,
+           r.fifoPeak, r.fifoOverflows);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t drainUs = 1000;    // PCU_Tasks main loop pass
+    if (argc > 1) {
+        drainUs = (uint32_t)atoi(argv[1]);
+        if (drainUs == 0) drainUs = 1000;
+    }
+
+    printf("Module bus status refresh benchmark\n");
+    printf("  bitrate %u bit/s, RX FIFO %u deep drained every %u us, refresh target %u ms\n",
+           BUS_BITRATE, RX_FIFO_DEPTH, drainUs, REFRESH_TARGET_US / 1000);
+    printf("  worst-case frame time: request %u us, broadcast %u us, status %u us\n",
+           FrameTimeUs(1), FrameTimeUs(2), FrameTimeUs(8));
+    printf("  CAN FD %u/%u bit/s:    request %u us, broadcast %u us, STATUS_FD %u us (%u bytes), 64 bytes %u us\n\n",
+           BUS_BITRATE, BUS_DATA_BITRATE, FdFrameTimeUs(1), FdFrameTimeUs(2),
+           FdFrameTimeUs(STATUS_FD_BYTES), STATUS_FD_BYTES, FdFrameTimeUs(64));
+
+    printf("  %-16s %3s  %6s  %6s  %9s  %9s  %7s  %4s  %5s\n",
+           "strategy", "N", "packTx", "frames", "snap(ms)", "busy(ms)", "load", "peak", "ovfl");
+
+    const uint8_t counts[] = { 8, 16, CAN_MODULE_ID_MAX };
+    for (size_t c = 0; c < sizeof(counts); c++) {
+        uint8_t n = counts[c];
+        char name[32];
+        for (uint8_t w = 1; w <= 6; w++) {
+            snprintf(name, sizeof(name), "unicast w=%u", w);
+            PrintRow(name, n, RunUnicast(n, w, drainUs, false));
+        }
+        snprintf(name, sizeof(name), "broadcast s=%u", MODULE_STATUS_SLOT_DEFAULT);
+        PrintRow(name, n, RunBroadcast(n, MODULE_STATUS_SLOT_DEFAULT, drainUs, false));
+        PrintRow("broadcast s=0", n, RunBroadcast(n, 0, drainUs, false));
+        for (uint8_t w = 1; w <= 6; w += 5) {
+            snprintf(name, sizeof(name), "FD unicast w=%u", w);
+            PrintRow(name, n, RunUnicast(n, w, drainUs, true));
+        }
+        snprintf(name, sizeof(name), "FD broadcast s=%u", MODULE_STATUS_SLOT_FD);
+        PrintRow(name, n, RunBroadcast(n, MODULE_STATUS_SLOT_FD, drainUs, true));
+        printf("\n");
+    }
+    return 0;
+}
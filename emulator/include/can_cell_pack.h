@@ -0,0 +1,138 @@
+ /**************************************************************************************************************
+ * @file           : can_cell_pack.h                                               P A C K   C O N T R O L L E R
+ * @brief          : Packed multi-cell MODULE_CELL_PACKED (0x50A) frame encode/decode helpers
+ ***************************************************************************************************************
+ * Copyright (C) 2023-2024 Modular Battery Technologies, Inc.
+ * US Patents 11,380,942; 11,469,470; 11,575,270; others. All rights reserved
+ *
+ * Shared by ModuleCPU, Pack Controller and Pack Emulator - keep the copies in protocols/, Core/Inc/ and
+ * emulator/include/ identical.
+ *
+ * Extended ID:  (ID_MODULE_CELL_PACKED << 18) | (kind << 16) | (firstCell << 8) | moduleId
+ *
+ * Payload (little endian):
+ *   bytes 0-1   value of firstCell (raw MODULE_DETAIL units - mV or 0.01 C + 55.35 C)
+ *   bytes 2-7   up to four 12 bit two's complement deltas, cell firstCell+n minus the base value,
+ *               packed LSB first
+ *
+ * The number of deltas follows from the DLC: 2 = 0, 4 = 1, 5 = 2, 7 = 3, 8 = 4, so one frame carries
+ * up to CELL_PACK_MAX_CELLS cells. The encoder ends a frame early when the next cell is outside the
+ * +/-2047 delta range, and that cell starts the next frame as a new base.
+ **************************************************************************************************************/
+#ifndef INC_CAN_CELL_PACK_H_
+#define INC_CAN_CELL_PACK_H_
+
+#include <stdint.h>
+
+#define CELL_PACK_VOLTAGE       0       // kind - cell voltages
+#define CELL_PACK_TEMPERATURE   1       // kind - cell temperatures
+
+#define CELL_PACK_MAX_DELTAS    4
+#define CELL_PACK_MAX_CELLS     (CELL_PACK_MAX_DELTAS + 1)
+#define CELL_PACK_DELTA_MIN     (-2048)
+#define CELL_PACK_DELTA_MAX     2047
+
+
+/***************************************************************************************************************
+*     C e l l P a c k _ E i d                                                      P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint32_t CellPack_Eid(uint8_t moduleId, uint8_t firstCell, uint8_t kind)
+{
+  // 18 bit extended part of the ID - what the MCP2517FD reports in EID
+  return ((uint32_t)(kind & 0x01) << 16) | ((uint32_t)firstCell << 8) | moduleId;
+}
+
+static inline uint8_t CellPack_ModuleId(uint32_t eid)  { return (uint8_t)(eid & 0xFF); }
+static inline uint8_t CellPack_FirstCell(uint32_t eid) { return (uint8_t)((eid >> 8) & 0xFF); }
+static inline uint8_t CellPack_Kind(uint32_t eid)      { return (uint8_t)((eid >> 16) & 0x01); }
+
+/***************************************************************************************************************
+*     C e l l P a c k _ L e n g t h                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint8_t CellPack_Length(uint8_t deltas)
+{
+  // base + 12 bits per delta, rounded up to whole bytes
+  return (uint8_t)(2 + ((deltas * 12) + 7) / 8);
+}
+
+/***************************************************************************************************************
+*     C e l l P a c k _ C e l l s                                                  P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint8_t CellPack_Cells(uint8_t length)
+{
+  // cells carried by a frame of this length, 0 if the length is not a valid packing
+  switch(length){
+    case 2:  return 1;
+    case 4:  return 2;
+    case 5:  return 3;
+    case 7:  return 4;
+    case 8:  return 5;
+    default: return 0;
+  }
+}
+
+/***************************************************************************************************************
+*     C e l l P a c k _ E n c o d e                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint8_t CellPack_Encode(const uint16_t* values, uint8_t available, uint8_t* data, uint8_t* length)
+{
+  uint64_t bits = 0;
+  uint8_t  deltas = 0;
+  int32_t  delta;
+  uint8_t  index;
+
+  if(available == 0){
+    *length = 0;
+    return 0;
+  }
+
+  // take cells while their delta from the base fits in 12 bits
+  while(deltas < CELL_PACK_MAX_DELTAS && (uint8_t)(deltas + 1) < available){
+    delta = (int32_t)values[deltas + 1] - (int32_t)values[0];
+    if(delta < CELL_PACK_DELTA_MIN || delta > CELL_PACK_DELTA_MAX) break;
+    bits |= (uint64_t)((uint32_t)delta & 0x0FFF) << (12 * deltas);
+    deltas++;
+  }
+
+  *length = CellPack_Length(deltas);
+  data[0] = (uint8_t)(values[0] & 0xFF);
+  data[1] = (uint8_t)(values[0] >> 8);
+  for(index = 2; index < *length; index++){
+    data[index] = (uint8_t)(bits & 0xFF);
+    bits >>= 8;
+  }
+  return (uint8_t)(deltas + 1);
+}
+
+/***************************************************************************************************************
+*     C e l l P a c k _ D e c o d e                                                P A C K   C O N T R O L L E R
+***************************************************************************************************************/
+static inline uint8_t CellPack_Decode(const uint8_t* data, uint8_t length, uint16_t* values)
+{
+  // data must have 8 readable bytes, values room for CELL_PACK_MAX_CELLS - returns the cells decoded
+  uint64_t bits = 0;
+  uint16_t base;
+  uint32_t field;
+  uint8_t  cells;
+  uint8_t  index;
+
+  cells = CellPack_Cells(length);
+  if(cells == 0) return 0;
+
+  // always read the full 8 byte payload - bits past the last delta are never used
+  base = (uint16_t)(data[0] | (data[1] << 8));
+  for(index = 7; index > 1; index--){
+    bits = (bits << 8) | data[index];
+  }
+
+  values[0] = base;
+  for(index = 1; index < cells; index++){
+    field = (uint32_t)(bits & 0x0FFF);
+    bits >>= 12;
+    // sign extend the 12 bit delta
+    values[index] = (uint16_t)(base + (int16_t)((int32_t)(field ^ 0x800) - 0x800));
+  }
+  return cells;
+}
+
+#endif /* INC_CAN_CELL_PACK_H_ */
@@ -90,6 +90,7 @@ struct ModuleInfo {
     // Message waiting flags to prevent flooding
     bool waitingForStatusResponse;   // Waiting for STATUS_1/2/3 after STATUS_REQUEST
     bool waitingForCellResponse;     // Waiting for MODULE_DETAIL after DETAIL_REQUEST
+    uint8_t statusFramesReceived;    // STATUS_1/2/3 received bits (0x07 = complete)
     DWORD cellRequestTime;           // When we sent the cell detail request
     
     // Web4 data
@@ -137,6 +138,17 @@ public:
     bool IsModuleResponding(uint8_t moduleId);
     void SetStatusPending(uint8_t moduleId, bool pending);
     
+    // Broadcast status request (0x512 to module ID 0x00, slotted replies)
+    void SetBroadcastStatus(bool enable) { broadcastStatusEnabled = enable; }
+    bool IsBroadcastStatusEnabled() const { return broadcastStatusEnabled; }
+    void BeginBroadcastStatus(DWORD currentTime, uint8_t slotWidth);
+    bool RecordStatusFrame(uint8_t moduleId, uint8_t frameBit);
+    bool IsBroadcastStatusActive() const { return broadcastActive; }
+    DWORD GetBroadcastSlotOffsetUs(uint8_t moduleId) const;
+    DWORD GetLastSnapshotMs() const { return lastSnapshotMs; }
+    uint32_t GetBroadcastCycles() const { return broadcastCycles; }
+    uint32_t GetBroadcastIncomplete() const { return broadcastIncomplete; }
+    
     // Pack calculations
     float GetPackVoltage();
     float GetPackCurrent();
@@ -171,6 +183,17 @@ private:
     uint32_t moduleTimeoutMs;
     uint8_t maxModules;
     
+    // Broadcast status state
+    bool broadcastStatusEnabled;
+    bool broadcastActive;
+    uint8_t broadcastSlotWidth;     // MODULE_STATUS_SLOT_UNIT_US units
+    DWORD broadcastStartTime;
+    uint8_t broadcastExpected;      // Modules that should answer this cycle
+    uint8_t broadcastCompleted;     // Modules that have sent all of STATUS_1/2/3
+    DWORD lastSnapshotMs;           // Request to last reply of the last complete cycle
+    uint32_t broadcastCycles;
+    uint32_t broadcastIncomplete;   // Cycles replaced before every module answered
+    
     // Statistics
     uint32_t totalMessages;
     uint32_t totalErrors;
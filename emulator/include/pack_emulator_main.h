@@ -20,6 +20,7 @@
 #include "module_manager.h"
 #include "can_interface.h"
 #include "../../protocols/CAN_ID_ALL.h"
+#include "../../protocols/can_cell_pack.h"
 #include <fstream>
 #include <vector>
 #include <ctime>
@@ -195,6 +196,7 @@ private:	// User declarations
     DWORD lastHeartbeatTime;  // Track when last heartbeat was sent
     uint8_t selectedModuleId;
     uint8_t nextModuleToPoll;
+    uint8_t broadcastSequence;  // Sequence number of the last broadcast status request
     DWORD lastPollTime;
     PackEmulator::ModuleState selectedState;  // Track the selected state for Set All
     
@@ -277,6 +279,7 @@ private:	// User declarations
     void SendStateChangeMessage();
     void SendCellDetailRequest();
     void SendStatusRequest();
+    void SendBroadcastStatusRequest();
     void SendRegistrationAck();
     void SendTimeSync();
     void SendDiscoveryRequest();
@@ -294,6 +297,7 @@ private:	// User declarations
     void ProcessCellTemperatures(uint8_t moduleId, const uint8_t* data);
     void ProcessModuleFault(uint8_t moduleId, const uint8_t* data);
     void ProcessModuleDetail(uint8_t moduleId, const uint8_t* data);
+    void ProcessCellPacked(uint32_t extendedId, const uint8_t* data, uint8_t length);
     void ProcessModuleCellCommStatus(uint8_t moduleId, const uint8_t* data);
     
     // Helper functions
@@ -0,0 +1,9 @@
+/******************************************************************************
+ * @file    Canfdspi_register.h
+ * @brief   Pack simulator - case forward for canfdspi_api.h
+ *
+ * canfdspi_api.h includes "Canfdspi_register.h", which only finds
+ * Core/Inc/canfdspi_register.h on a case-insensitive file system.
+ ******************************************************************************/
+
+#include "canfdspi_register.h"
@@ -0,0 +1,408 @@
+/******************************************************************************
+ * @file    pack_sim.cpp
+ * @brief   Deterministic pack simulator - firmware main loop on a virtual clock
+ * @author  Pack Emulator Development Team
+ *
+ * Runs the pack controller's own mcu.c/mcu_sched.c/vcu.c/debug.c against a
+ * virtual module bus and a set of simulated modules. PCU_Tasks() is called
+ * once per main loop pass; each pass costs the configured loop time plus the
+ * SPI time of every message it loaded or read, and the bus runs up to the
+ * start of the next pass. Nothing depends on the wall clock, so a given set
+ * of options and seed always produces the same report.
+ *
+ * Reports:
+ *   - status poll latency  - status request loaded to the new status published
+ *   - status freshness     - age of each module's published status, sampled every 10 ms
+ *   - cell data freshness  - age of each module's last complete cell set (-d)
+ *   - bus load             - busy share of each 100 ms window of the module bus
+ *   - cell balancing       - cell voltage spread before and after, with -b
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+
+#include "../../protocols/CAN_ID_ALL.h"
+#include "sim_model.h"
+
+static const uint64_t SAMPLE_US         = 10000;     // freshness sample period
+static const uint32_t LOAD_WINDOW_US    = 100000;    // bus load window
+static const uint64_t DETAIL_TIMEOUT_US = 2000000;   // give up on a cell detail chain after this
+static const uint64_t NEVER             = ~0ull;
+
+//---------------------------------------------------------------------------
+// Module profiles
+//---------------------------------------------------------------------------
+static const ModuleProfile PROFILE_NOMINAL = { "nominal", 94,  400,  200,     0, false, 0.0 };
+static const ModuleProfile PROFILE_LOSSY   = { "lossy",   94,  400,  200, 10000, false, 0.0 };
+static const ModuleProfile PROFILE_SLOW    = { "slow",    94, 4000, 4000,     0, false, 0.0 };
+static const ModuleProfile PROFILE_SMALL   = { "small",   16,  400,  200,     0, false, 0.0 };
+static const ModuleProfile PROFILE_FD      = { "fd",      94,  400,  200,     0, true,  0.0 };
+
+struct SimOptions {
+    uint8_t     modules;
+    const char* profile;
+    double      seconds;
+    uint64_t    seed;
+    uint32_t    loopUs;
+    uint32_t    detailMs;       // 0 = no cell detail requests
+    int         cells;          // -1 = profile
+    int         latencyUs;      // -1 = profile
+    double      lossPct;        // < 0 = profile
+    double      currentA;
+    bool        balance;
+    bool        verbose;
+};
+
+static bool ProfileFor(const char* name, uint8_t index, ModuleProfile& p) {
+    if (strcmp(name, "mixed") == 0) {
+        static const ModuleProfile* mix[] = { &PROFILE_NOMINAL, &PROFILE_SLOW, &PROFILE_LOSSY, &PROFILE_SMALL };
+        p = *mix[index % 4];
+        return true;
+    }
+    static const ModuleProfile* all[] = { &PROFILE_NOMINAL, &PROFILE_LOSSY, &PROFILE_SLOW, &PROFILE_SMALL, &PROFILE_FD };
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (strcmp(name, all[i]->name) == 0) {
+            p = *all[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------
+// Histogram
+//---------------------------------------------------------------------------
+Histogram::Histogram(const char* title, const char* unit, const std::vector<double>& edges)
+    : title(title), unit(unit), edges(edges), counts(edges.size() + 1, 0) {}
+
+void Histogram::Add(double value) {
+    size_t bucket = std::upper_bound(edges.begin(), edges.end(), value - 1e-9) - edges.begin();
+    counts[bucket]++;
+    values.push_back(value);
+}
+
+double Histogram::Percentile(double p) const {
+    if (values.empty()) return 0;
+    std::vector<double> sorted(values);
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    rank = rank ? rank - 1 : 0;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+void Histogram::Print() const {
+    printf("%s (%s) - %llu samples", title, unit, (unsigned long long)values.size());
+    if (values.empty()) {
+        printf("\n\n");
+        return;
+    }
+    printf(", p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+           Percentile(50), Percentile(90), Percentile(99), *std::max_element(values.begin(), values.end()));
+
+    uint64_t peak = *std::max_element(counts.begin(), counts.end());
+    for (size_t i = 0; i < counts.size(); i++) {
+        char label[32];
+        if (i < edges.size()) snprintf(label, sizeof(label), "<= %g", edges[i]);
+        else                  snprintf(label, sizeof(label), "> %g", edges.back());
+        int bar = peak ? (int)((counts[i] * 50 + peak - 1) / peak) : 0;
+        printf("  %10s  %6.2f%%  %.*s\n", label, 100.0 * counts[i] / values.size(), bar,
+               "##################################################");
+    }
+    printf("\n");
+}
+
+//---------------------------------------------------------------------------
+// Command line
+//---------------------------------------------------------------------------
+static void Usage() {
+    printf("usage: pack_sim.exe [options]\n");
+    printf("  -n modules    simulated modules, 1-%u (default 16)\n", CAN_MODULE_ID_MAX);
+    printf("  -p profile    nominal | lossy | slow | small | fd | mixed (default nominal)\n");
+    printf("                fd needs the firmware built with make FW_DEFS=-DMCU_USE_CANFD - without it\n");
+    printf("                the pack never switches the bus to CAN FD and fd runs like nominal\n");
+    printf("  -t seconds    virtual time to run (default 60)\n");
+    printf("  -s seed       random seed (default 1)\n");
+    printf("  -l us         main loop pass time before SPI traffic (default 200)\n");
+    printf("  -d ms         request one module's cell detail every ms, round robin, 0 = off (default 100)\n");
+    printf("  -c cells      override cells per module\n");
+    printf("  -j us         override module reply latency\n");
+    printf("  -x percent    override frame loss\n");
+    printf("  -i amps       module current in STATUS_1 (default 0 - modules poll as idle)\n");
+    printf("  -b            cell balancing on, as vcu_cell_balance_ctrl from the VCU\n");
+    printf("  -v            print the firmware's serial output\n");
+}
+
+static bool ParseOptions(int argc, char* argv[], SimOptions& o) {
+    o.modules = 16;
+    o.profile = "nominal";
+    o.seconds = 60;
+    o.seed = 1;
+    o.loopUs = 200;
+    o.detailMs = 100;
+    o.cells = -1;
+    o.latencyUs = -1;
+    o.lossPct = -1;
+    o.currentA = 0;
+    o.balance = false;
+    o.verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-v") == 0) { o.verbose = true; continue; }
+        if (strcmp(arg, "-b") == 0) { o.balance = true; continue; }
+        if (arg[0] != '-' || arg[1] == 0 || arg[2] != 0 || i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        switch (arg[1]) {
+        case 'n': o.modules = (uint8_t)atoi(value); break;
+        case 'p': o.profile = value; break;
+        case 't': o.seconds = atof(value); break;
+        case 's': o.seed = strtoull(value, nullptr, 0); break;
+        case 'l': o.loopUs = (uint32_t)atoi(value); break;
+        case 'd': o.detailMs = (uint32_t)atoi(value); break;
+        case 'c': o.cells = atoi(value); break;
+        case 'j': o.latencyUs = atoi(value); break;
+        case 'x': o.lossPct = atof(value); break;
+        case 'i': o.currentA = atof(value); break;
+        default: return false;
+        }
+    }
+    ModuleProfile check;
+    return o.modules >= 1 && o.modules <= CAN_MODULE_ID_MAX && o.seconds > 0 && o.loopUs > 0 &&
+           o.cells <= 255 && ProfileFor(o.profile, 0, check);
+}
+
+//---------------------------------------------------------------------------
+// Simulation
+//---------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    SimOptions opt;
+    if (!ParseOptions(argc, argv, opt)) {
+        Usage();
+        return 2;
+    }
+
+    SimRng rng(opt.seed);
+    VirtualBus bus(LOAD_WINDOW_US);
+    std::vector<std::unique_ptr<SimModule> > modules;
+    bool fdModules = false;
+
+    for (uint8_t i = 0; i < opt.modules; i++) {
+        ModuleProfile p;
+        ProfileFor(opt.profile, i, p);
+        if (opt.cells >= 0)     p.cells = (uint8_t)opt.cells;
+        if (opt.latencyUs >= 0) p.latencyUs = (uint32_t)opt.latencyUs;
+        if (opt.lossPct >= 0)   p.lossPpm = (uint32_t)(opt.lossPct * 10000);
+        p.currentA = opt.currentA;
+        fdModules |= p.canFd;
+        modules.push_back(std::unique_ptr<SimModule>(new SimModule(bus, 0x10000000u + rng.Uniform(0x0FFFFFFF), p, rng)));
+    }
+
+    Histogram pollLatency("Status poll latency", "ms", { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 });
+    Histogram statusAge("Status freshness", "ms", { 10, 25, 50, 100, 250, 500, 1000, 2000, 4000 });
+    Histogram cellAge("Cell data freshness", "ms", { 250, 500, 1000, 2000, 4000, 8000, 16000 });
+    Histogram detailTime("Cell detail fetch", "ms", { 10, 25, 50, 100, 250, 500, 1000, 2000 });
+    Histogram busLoad("Module bus load per 100 ms", "%", { 5, 10, 15, 20, 25, 30, 40, 50, 60, 80 });
+
+    // indexed by module ID
+    std::vector<uint64_t> requestTime(CAN_MODULE_ID_MAX + 1, NEVER);
+    std::vector<uint64_t> statusSampled(CAN_MODULE_ID_MAX + 1, NEVER);
+    // indexed by pack module index
+    std::vector<uint16_t> lastSeq(CAN_MODULE_ID_MAX, 0);
+    std::vector<uint64_t> statusTime(CAN_MODULE_ID_MAX, NEVER);
+    std::vector<uint64_t> cellTime(CAN_MODULE_ID_MAX, NEVER);
+
+    bus.onPackFrame = [&](const BusFrame& f, uint64_t t) {
+        for (size_t i = 0; i < modules.size(); i++) modules[i]->OnPackFrame(f.frame, t);
+    };
+    uint32_t balanceFrames = 0;
+    bus.onPackTx = [&](const BusFrame& f, uint64_t t) {
+        if (f.frame.sid == ID_MODULE_CELL_BALANCE) balanceFrames++;
+        if (f.frame.sid != ID_MODULE_STATUS_REQUEST) return;
+        uint8_t target = (uint8_t)(f.frame.eid & 0xFF);
+        for (uint8_t id = 1; id <= CAN_MODULE_ID_MAX; id++) {
+            if ((target == id || target == CAN_MODULE_ID_BROADCAST) && requestTime[id] == NEVER) requestTime[id] = t;
+        }
+    };
+    bus.onPackRx = [&](const BusFrame& f, uint64_t t) {
+        (void)t;
+        if (f.frame.sid >= ID_MODULE_STATUS_1 && f.frame.sid <= ID_MODULE_STATUS_3) statusSampled[f.frame.eid & 0xFF] = f.sampled;
+        if (f.frame.sid == ID_MODULE_STATUS_FD) statusSampled[f.frame.eid & 0xFF] = f.sampled;
+    };
+
+    SimFw_SetLog(opt.verbose, opt.verbose ? 0x09 : 0);      // DBG_ERRORS + DBG_MCU
+    SimFw_Initialize();
+    SimFw_SetBalance(opt.balance);
+
+    uint64_t end = (uint64_t)(opt.seconds * 1000000);
+    uint64_t now = 0;
+    uint64_t nextSample = SAMPLE_US;
+    uint64_t nextDetail = (uint64_t)opt.detailMs * 1000;
+    uint64_t detailStart = 0;
+    uint8_t  detailIndex = CAN_MODULE_ID_MAX;    // pack index being fetched, CAN_MODULE_ID_MAX = none
+    uint8_t  detailNext = 1;
+    uint32_t detailStalls = 0;
+    uint64_t passes = 0;
+    int      firstSpread = -1;           // cell spread once every module has a cell set
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    while (now < end) {
+        // frames landing while the loop runs - the RX interrupt drains them, its SPI time holds the loop up
+        // and frames leaving a full TX FIFO - the TX interrupt loads the next ones queued
+        uint64_t landed;
+        while (bus.RunUntilInt(now, landed)) {
+            bus.SetPassTime(landed);
+            SimFw_SetTime(landed);
+            SimFw_RxLine();
+            SimFw_TxLine();
+            now = std::max(now, landed + bus.SpiUs());
+        }
+        bus.SetPassTime(now);
+        SimFw_SetTime(now);
+        SimFw_Tasks();
+        passes++;
+
+        // cell detail requester - one module at a time, round robin over registered modules
+        if (opt.detailMs) {
+            if (detailIndex < CAN_MODULE_ID_MAX) {
+                if (!SimFw_CellDetailWaiting(detailIndex)) {
+                    cellTime[detailIndex] = detailStart;
+                    detailTime.Add((now - detailStart) / 1000.0);
+                    detailIndex = CAN_MODULE_ID_MAX;
+                } else if (now - detailStart > DETAIL_TIMEOUT_US) {
+                    SimFw_CellDetailCancel(detailIndex);
+                    detailStalls++;
+                    detailIndex = CAN_MODULE_ID_MAX;
+                }
+            }
+            if (detailIndex == CAN_MODULE_ID_MAX && now >= nextDetail) {
+                for (uint8_t tries = 0; tries < CAN_MODULE_ID_MAX; tries++) {
+                    uint8_t id = detailNext;
+                    detailNext = detailNext % CAN_MODULE_ID_MAX + 1;
+                    uint8_t index = SimFw_ModuleIndex(id);
+                    if (SimFw_Registered(index) && !SimFw_CellDetailWaiting(index)) {
+                        SimFw_RequestCellDetail(id);
+                        detailIndex = index;
+                        detailStart = now;
+                        break;
+                    }
+                }
+                nextDetail = now + (uint64_t)opt.detailMs * 1000;
+            }
+        }
+
+        // a changed status sequence is a newly published status set
+        uint64_t passEnd = now + bus.SpiUs();
+        for (uint8_t index = 0; index < CAN_MODULE_ID_MAX; index++) {
+            if (!SimFw_Registered(index)) continue;
+            uint16_t seq = SimFw_StatusSeq(index);
+            if (seq == lastSeq[index]) continue;
+            lastSeq[index] = seq;
+            uint8_t id = index + 1;     // module ID = index + 1
+            statusTime[index] = statusSampled[id];
+            if (requestTime[id] != NEVER) {
+                pollLatency.Add((passEnd - requestTime[id]) / 1000.0);
+                requestTime[id] = NEVER;
+            }
+        }
+
+        now = passEnd + opt.loopUs;
+
+        while (nextSample <= now && nextSample < end) {
+            for (uint8_t index = 0; index < CAN_MODULE_ID_MAX; index++) {
+                if (!SimFw_Registered(index)) continue;
+                if (statusTime[index] != NEVER) statusAge.Add((nextSample - statusTime[index]) / 1000.0);
+                if (opt.detailMs && cellTime[index] != NEVER) cellAge.Add((nextSample - cellTime[index]) / 1000.0);
+            }
+            nextSample += SAMPLE_US;
+        }
+        if (firstSpread < 0) {
+            simCellStats_t first;
+            SimFw_CellStats(&first);
+            if (first.modules == opt.modules) firstSpread = first.voltSpread;
+        }
+    }
+    bus.RunUntil(end);
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    size_t windows = std::min(bus.windowBusyUs.size(), (size_t)(end / LOAD_WINDOW_US));
+    bus.windowBusyUs.resize(windows, 0);
+    for (size_t w = 0; w < windows; w++) busLoad.Add(100.0 * bus.windowBusyUs[w] / LOAD_WINDOW_US);
+
+    uint32_t lost = 0;
+    uint8_t registered = 0;
+    for (size_t i = 0; i < modules.size(); i++) {
+        lost += modules[i]->framesLost;
+        if (modules[i]->Id() != 0) registered++;
+    }
+
+    printf("Pack simulator - %u modules, profile %s, seed %llu, %.1f s virtual\n",
+           opt.modules, opt.profile, (unsigned long long)opt.seed, opt.seconds);
+    printf("  main loop %u us + %u us SPI per message, %llu passes, %.2f s wall (%.0fx real time)\n",
+           opt.loopUs, SIM_SPI_FRAME_US, (unsigned long long)passes, wallSeconds,
+           wallSeconds > 0 ? opt.seconds / wallSeconds : 0.0);
+    printf("  modules registered %u/%u (pack active %u), module bus %s, poll window %u\n",
+           registered, opt.modules, SimFw_ModuleCount(), SimFw_ModuleBusFd() ? "CAN FD" : "classic",
+           SimFw_PollWindow());
+    if (fdModules && !SimFw_CanFdBuilt())
+        printf("  (the modules offer CAN FD but the firmware was built without MCU_USE_CANFD - make clean && make FW_DEFS=-DMCU_USE_CANFD)\n");
+    printf("  frames pack %llu, modules %llu, lost by modules %u, VCU (not modelled) %llu\n",
+           (unsigned long long)bus.stats.packFrames, (unsigned long long)bus.stats.moduleFrames, lost,
+           (unsigned long long)bus.stats.vcuFrames);
+    char rxPeaks[SIM_CAN_FIFOS * 8] = "";
+    for (uint8_t fifo = 0; fifo < SIM_CAN_FIFOS; fifo++) {
+        if (!bus.PackFifoRx(fifo)) continue;
+        size_t used = strlen(rxPeaks);
+        snprintf(rxPeaks + used, sizeof(rxPeaks) - used, "%s%u/%u", used ? " " : "", bus.PackRxPeak(fifo),
+                 bus.PackFifoDepth(fifo));
+    }
+    printf("  bus busy %.2f%%, RX FIFO peak %s, RX overflows %llu (firmware counted %u), filtered %llu, detail stalls %u\n",
+           100.0 * bus.stats.busyUs / end, rxPeaks, (unsigned long long)bus.stats.rxOverflows, SimFw_RxOverflows(),
+           (unsigned long long)bus.stats.rxFiltered, detailStalls);
+    uint32_t ringPeak, ringDrops;
+    SimFw_RxRing(&ringPeak, &ringDrops);
+    printf("  RX ring peak %u/%u, dropped %u\n", ringPeak, SIM_RX_RING_SIZE, ringDrops);
+    static const char* const txClassNames[SIM_TX_CLASSES] = { "safety", "vcu", "poll", "bulk" };
+    for (uint8_t txClass = 0; txClass < SIM_TX_CLASSES; txClass++) {
+        simTxClass_t tx;
+        SimFw_TxClass(txClass, &tx);
+        if (tx.sent == 0 && tx.drops == 0) continue;
+        printf("  TX %-6s %u sent, dropped %u, queued mean %.2f max %u ms\n", txClassNames[txClass], tx.sent,
+               tx.drops, (double)tx.latencySum / tx.sent, tx.latencyMax);
+    }
+    printf("  SPI busy %.2f%%, %.1f%% of it by DMA\n", 100.0 * bus.stats.spiUs / end,
+           bus.stats.spiUs ? 100.0 * bus.stats.spiDmaUs / bus.stats.spiUs : 0.0);
+    simCellStats_t cellStats;
+    SimFw_CellStats(&cellStats);
+    printf("  cell stats %u modules %u cells, voltage %u-%u mV mean %u sd %u, temperature %.2f-%.2f C mean %.2f sd %.2f\n",
+           cellStats.modules, cellStats.cells, cellStats.voltMin, cellStats.voltMax, cellStats.voltMean,
+           cellStats.voltStddev, cellStats.tempMin * 0.01 - 55.35, cellStats.tempMax * 0.01 - 55.35,
+           cellStats.tempMean * 0.01 - 55.35, cellStats.tempStddev * 0.01);
+    if (opt.balance) {
+        printf("  cell balancing spread ");
+        if (firstSpread >= 0) printf("%d mV -> ", firstSpread);
+        printf("%u mV, %u cells bleeding, %u balance frames, pack %s\n",
+               cellStats.voltSpread, cellStats.bleeding, balanceFrames,
+               cellStats.balanced ? "balanced" : cellStats.balanceActive ? "balancing" : "not balanced");
+    }
+    printf("\n");
+
+    pollLatency.Print();
+    statusAge.Print();
+    if (opt.detailMs) {
+        detailTime.Print();
+        cellAge.Print();
+    }
+    busLoad.Print();
+
+    return registered == opt.modules ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+/******************************************************************************
+ * @file    sim_bus.cpp
+ * @brief   Pack simulator - virtual module CAN bus
+ * @author  Pack Emulator Development Team
+ *
+ * Discrete-event model of the module bus as in emulator/bench: every node
+ * (the pack's MCP2517FD and each simulated module) offers one frame, the
+ * lowest extended ID among frames ready when the bus goes idle wins, and the
+ * frame occupies the bus for its worst-case stuffed length. A module offers
+ * the head of its queue. The pack offers from its highest priority transmit
+ * channel with a frame ready - the head of a FIFO, the lowest ID in the TXQ.
+ * Frames from modules land in the receive FIFO the shim's acceptance filters
+ * pick (SimCan_Route()), or are dropped when none takes them.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "sim_model.h"
+#include "can_bus_model.h"
+
+static VirtualBus* simBus = nullptr;
+
+VirtualBus::VirtualBus(uint32_t loadWindowUs)
+    : loadWindow(loadWindowUs), nodes(1), fifos(SIM_CAN_FIFOS), busy(false), currentFifo(0), currentPos(0),
+      currentEnd(0), busFree(0), passTime(0), spiUs(0), stopOnInt(false), interrupt(false),
+      interruptAt(0) {
+    memset(&stats, 0, sizeof(stats));
+    memset(&current, 0, sizeof(current));
+    simBus = this;
+}
+
+uint16_t VirtualBus::AddNode() {
+    nodes.push_back(std::deque<BusFrame>());
+    return (uint16_t)(nodes.size() - 1);
+}
+
+void VirtualBus::Queue(uint16_t node, const BusFrame& f) {
+    BusFrame queued = f;
+    queued.node = node;
+    nodes[node].push_back(queued);
+}
+
+static uint32_t ArbitrationId(const simFrame_t& f) {
+    return ((uint32_t)f.sid << 18) | (f.eid & 0x3FFFF);
+}
+
+static uint32_t Duration(const simFrame_t& f) {
+    return f.fd ? FdFrameTimeUs(f.length) : FrameTimeUs(f.length);
+}
+
+void VirtualBus::AddBusy(uint64_t start, uint32_t duration) {
+    // split across load windows so a frame on a boundary counts in both
+    uint64_t end = start + duration;
+    while (start < end) {
+        size_t window = (size_t)(start / loadWindow);
+        uint64_t windowEnd = (uint64_t)(window + 1) * loadWindow;
+        uint64_t part = std::min(end, windowEnd) - start;
+        if (windowBusyUs.size() <= window) windowBusyUs.resize(window + 1, 0);
+        windowBusyUs[window] += (uint32_t)part;
+        start += part;
+    }
+    stats.busyUs += duration;
+}
+
+void VirtualBus::Complete(uint64_t t) {
+    BusFrame f = current;
+    busy = false;
+    busFree = t;
+
+    if (f.node == 0) {
+        PackFifo& tx = fifos[currentFifo];
+        bool txFull = tx.frames.size() >= tx.depth;
+        tx.frames.erase(tx.frames.begin() + currentPos);
+        stats.packFrames++;
+        if (txFull) {
+            interrupt = true;
+            interruptAt = t;
+        }
+        if (onPackFrame) onPackFrame(f, t);
+        return;
+    }
+    nodes[f.node].pop_front();
+    stats.moduleFrames++;
+
+    // acceptance filters - a frame none of them takes never reaches the pack's RAM
+    uint8_t fifo = SimCan_Route(SIM_CAN_MODULE_BUS, &f.frame);
+    if (fifo == 0 || fifo >= SIM_CAN_FIFOS || !PackFifoRx(fifo)) {
+        stats.rxFiltered++;
+        return;
+    }
+    PackFifo& rx = fifos[fifo];
+    if (rx.frames.size() >= rx.depth) {
+        rx.overflow = true;
+        stats.rxOverflows++;
+        return;
+    }
+    rx.frames.push_back(f);
+    rx.peak = std::max(rx.peak, (uint32_t)rx.frames.size());
+    interrupt = true;
+    interruptAt = t;
+}
+
+bool VirtualBus::PackNext(uint64_t start, uint8_t& fifo, size_t& pos) const {
+    // the highest priority transmit channel with a frame ready - in the TXQ its lowest ID
+    bool found = false;
+    for (uint8_t n = 0; n < SIM_CAN_FIFOS; n++) {
+        const PackFifo& tx = fifos[n];
+        if (!tx.txPriority || tx.frames.empty() || (found && tx.txPriority <= fifos[fifo].txPriority)) continue;
+        size_t best = tx.frames.size();
+        size_t span = n == 0 ? tx.frames.size() : 1;
+        for (size_t i = 0; i < span; i++) {
+            if (tx.frames[i].ready > start) continue;
+            if (best == tx.frames.size() ||
+                ArbitrationId(tx.frames[i].frame) < ArbitrationId(tx.frames[best].frame)) {
+                best = i;
+            }
+        }
+        if (best == tx.frames.size()) continue;
+        fifo = n;
+        pos = best;
+        found = true;
+    }
+    return found;
+}
+
+void VirtualBus::RunUntil(uint64_t t) {
+    for (;;) {
+        if (busy) {
+            if (currentEnd > t) return;
+            Complete(currentEnd);
+            if (stopOnInt && interrupt) return;
+            continue;
+        }
+
+        // earliest time any queued frame may start - frames are loaded in time order, so a head is the earliest
+        bool any = false;
+        uint64_t earliest = 0;
+        for (size_t n = 0; n < nodes.size(); n++) {
+            if (nodes[n].empty()) continue;
+            if (!any || nodes[n].front().ready < earliest) earliest = nodes[n].front().ready;
+            any = true;
+        }
+        for (size_t n = 0; n < fifos.size(); n++) {
+            if (!fifos[n].txPriority || fifos[n].frames.empty()) continue;
+            if (!any || fifos[n].frames.front().ready < earliest) earliest = fifos[n].frames.front().ready;
+            any = true;
+        }
+        if (!any) return;
+        uint64_t start = std::max(busFree, earliest);
+        if (start > t) return;
+
+        // arbitration among the frames ready at the start of this frame - the pack offers one
+        uint8_t fifo = 0;
+        size_t pos = 0;
+        bool pack = PackNext(start, fifo, pos);
+        size_t win = nodes.size();
+        for (size_t n = 1; n < nodes.size(); n++) {
+            if (nodes[n].empty() || nodes[n].front().ready > start) continue;
+            if (win == nodes.size() ||
+                ArbitrationId(nodes[n].front().frame) < ArbitrationId(nodes[win].front().frame)) {
+                win = n;
+            }
+        }
+        if (pack && (win == nodes.size() ||
+                     ArbitrationId(fifos[fifo].frames[pos].frame) < ArbitrationId(nodes[win].front().frame))) {
+            current = fifos[fifo].frames[pos];
+            currentFifo = fifo;
+            currentPos = pos;
+        } else {
+            current = nodes[win].front();
+        }
+        uint32_t duration = Duration(current.frame);
+        currentEnd = start + duration;
+        busy = true;
+        AddBusy(start, duration);
+    }
+}
+
+bool VirtualBus::RunUntilInt(uint64_t t, uint64_t& at) {
+    // between main loop passes the CAN2 interrupts run - RX as each frame lands, TX as a full channel frees a slot
+    interrupt = false;
+    stopOnInt = true;
+    RunUntil(t);
+    stopOnInt = false;
+    at = interruptAt;
+    return interrupt;
+}
+
+void VirtualBus::AddSpi(uint32_t us, bool dma) {
+    // the bus keeps running while the firmware talks to the MCP2517FD, so a
+    // full TX channel drains while the refill loads it
+    spiUs += us;
+    stats.spiUs += us;
+    if (dma) stats.spiDmaUs += us;
+    RunUntil(passTime + spiUs);
+}
+
+void VirtualBus::PackFifoConfigure(uint8_t fifo, uint8_t depth, uint8_t txPriority) {
+    // configuration mode - the channel starts empty
+    PackFifo& channel = fifos[fifo];
+    channel.frames.clear();
+    channel.depth = depth;
+    channel.txPriority = txPriority;
+    channel.overflow = false;
+    channel.peak = 0;
+}
+
+bool VirtualBus::PackTxLoad(uint8_t fifo, const simFrame_t& f) {
+    if (!fifos[fifo].txPriority || PackTxFree(fifo) == 0) return false;
+    BusFrame queued;
+    queued.frame = f;
+    // the frame reaches the channel once the SPI transfer that loads it is done
+    queued.ready = passTime + spiUs;
+    queued.sampled = queued.ready;
+    queued.node = 0;
+    fifos[fifo].frames.push_back(queued);
+    if (onPackTx) onPackTx(queued, queued.ready);
+    return true;
+}
+
+uint8_t VirtualBus::PackTxFree(uint8_t fifo) const {
+    const PackFifo& tx = fifos[fifo];
+    return (uint8_t)(tx.depth - std::min<size_t>(tx.frames.size(), tx.depth));
+}
+
+bool VirtualBus::PackRxGet(uint8_t fifo, BusFrame& f) {
+    std::deque<BusFrame>& rx = fifos[fifo].frames;
+    if (!PackFifoRx(fifo) || rx.empty()) return false;
+    f = rx.front();
+    rx.pop_front();
+    if (onPackRx) onPackRx(f, passTime + spiUs);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Hooks for the CANFDSPI shim
+//---------------------------------------------------------------------------
+extern "C" {
+
+void SimBus_PackFifoConfigure(uint8_t channel, uint8_t fifo, uint8_t depth, uint8_t txPriority) {
+    if (channel == SIM_CAN_MODULE_BUS && fifo < SIM_CAN_FIFOS) simBus->PackFifoConfigure(fifo, depth, txPriority);
+}
+
+bool SimBus_PackTxLoad(uint8_t channel, uint8_t fifo, const simFrame_t* frame) {
+    if (channel != SIM_CAN_MODULE_BUS) {
+        simBus->CountVcuFrame();
+        return true;
+    }
+    return fifo < SIM_CAN_FIFOS && simBus->PackTxLoad(fifo, *frame);
+}
+
+uint8_t SimBus_PackTxFree(uint8_t channel, uint8_t fifo) {
+    return channel == SIM_CAN_MODULE_BUS && fifo < SIM_CAN_FIFOS ? simBus->PackTxFree(fifo) : 0;
+}
+
+bool SimBus_PackRxGet(uint8_t channel, uint8_t fifo, simFrame_t* frame) {
+    BusFrame f;
+    if (channel != SIM_CAN_MODULE_BUS || fifo >= SIM_CAN_FIFOS || !simBus->PackRxGet(fifo, f)) return false;
+    *frame = f.frame;
+    return true;
+}
+
+uint8_t SimBus_PackRxCount(uint8_t channel, uint8_t fifo) {
+    return channel == SIM_CAN_MODULE_BUS && fifo < SIM_CAN_FIFOS ? simBus->PackRxCount(fifo) : 0;
+}
+
+bool SimBus_PackRxOverflow(uint8_t channel, uint8_t fifo) {
+    return channel == SIM_CAN_MODULE_BUS && fifo < SIM_CAN_FIFOS && simBus->PackRxOverflow(fifo);
+}
+
+void SimBus_PackRxOverflowClear(uint8_t channel, uint8_t fifo) {
+    if (channel == SIM_CAN_MODULE_BUS && fifo < SIM_CAN_FIFOS) simBus->PackRxOverflowClear(fifo);
+}
+
+void SimBus_SpiTime(uint32_t us) {
+    simBus->AddSpi(us);
+}
+
+void SimBus_SpiDmaTime(uint32_t us) {
+    simBus->AddSpi(us, true);
+}
+
+}
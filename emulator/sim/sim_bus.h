@@ -0,0 +1,109 @@
+/******************************************************************************
+ * @file    sim_bus.h
+ * @brief   Pack simulator - virtual CAN bus and firmware hooks
+ * @author  Pack Emulator Development Team
+ *
+ * The firmware half of the simulator (sim_canfdspi.c, sim_main.c) is C and
+ * built against the real firmware headers. The bus and module models are C++.
+ * This header is the only interface between the two halves.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#ifndef SIM_BUS_H
+#define SIM_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_CAN_CHANNELS    3       // CAN1 (VCU), CAN2 (modules), CAN3 - as main.h
+#define SIM_CAN_MODULE_BUS  1       // CAN2
+#define SIM_CAN_FIFOS       32      // controller channels - the TXQ and FIFO 1-31
+#define SIM_RX_RING_SIZE    128     // CAN_RX_RING_SIZE
+#define SIM_TX_CLASSES      4       // CAN_TX_CLASSES
+#define SIM_SPI_FRAME_US    40      // SPI time to load or read one message object
+#define SIM_SPI_REG_US      4       // SPI time to read one FIFO status register
+
+typedef struct {
+  uint16_t sid;
+  uint32_t eid;
+  uint8_t  length;        // payload bytes
+  bool     fd;            // CAN FD frame
+  bool     brs;           // bit rate switch - data phase at BUS_DATA_BITRATE
+  uint8_t  data[64];
+} simFrame_t;
+
+//---------------------------------------------------------------------------
+// Virtual MCP2517FD - implemented by the bus, called from the CANFDSPI shim
+//---------------------------------------------------------------------------
+// fifo is the controller channel - 0 the TXQ. Only the module bus is modelled: frames loaded for the
+// other channels are counted, and their FIFOs stay empty.
+void     SimBus_PackFifoConfigure(uint8_t channel, uint8_t fifo, uint8_t depth, uint8_t txPriority);  // txPriority 0 receives
+bool     SimBus_PackTxLoad(uint8_t channel, uint8_t fifo, const simFrame_t* frame);
+uint8_t  SimBus_PackTxFree(uint8_t channel, uint8_t fifo);
+bool     SimBus_PackRxGet(uint8_t channel, uint8_t fifo, simFrame_t* frame);
+uint8_t  SimBus_PackRxCount(uint8_t channel, uint8_t fifo);
+bool     SimBus_PackRxOverflow(uint8_t channel, uint8_t fifo);
+void     SimBus_PackRxOverflowClear(uint8_t channel, uint8_t fifo);
+void     SimBus_SpiTime(uint32_t us);
+void     SimBus_SpiDmaTime(uint32_t us);         // SPI time of a DMA transfer - the bus is held, the CPU is not
+
+//---------------------------------------------------------------------------
+// Virtual MCP2517FD configuration - implemented by the CANFDSPI shim, called by the bus and sim_main.c
+//---------------------------------------------------------------------------
+uint8_t  SimCan_Route(uint8_t channel, const simFrame_t* frame);     // receive FIFO the filters pick, 0 if none
+bool     SimCan_RxLine(uint8_t channel);        // INT1 - a receive FIFO meets its enabled event
+bool     SimCan_TxLine(uint8_t channel);        // INT0 - a transmit channel with the not full event enabled has room
+
+//---------------------------------------------------------------------------
+// Firmware side - implemented in sim_main.c, called from the harness
+//---------------------------------------------------------------------------
+typedef struct {                // pack cell statistics - voltages in mV, temperatures raw
+    uint16_t cells;
+    uint8_t  modules;
+    uint16_t voltMin, voltMax, voltMean, voltStddev;
+    uint16_t tempMin, tempMax, tempMean, tempStddev;
+    uint16_t voltSpread;
+    uint16_t bleeding;          // cells the balancing planner has bleeding
+    bool     balanceActive;     // pack.cellBalanceActive
+    bool     balanced;          // pack.cellBalanceStatus
+} simCellStats_t;
+
+typedef struct {                // one module bus transmit class - latencies in TIM1 ticks (ms)
+    uint32_t sent;
+    uint32_t drops;
+    uint32_t latencyMax;
+    uint32_t latencySum;
+} simTxClass_t;
+
+void     SimFw_SetTime(uint64_t us);
+void     SimFw_Initialize(void);
+void     SimFw_Tasks(void);
+void     SimFw_RxLine(void);                // CAN2 RX interrupt line - also sampled by the CANFDSPI shim
+void     SimFw_TxLine(void);                // CAN2 TX channel not full line - likewise
+void     SimFw_SetLog(bool on, uint8_t level);
+uint8_t  SimFw_ModuleIndex(uint8_t moduleId);
+bool     SimFw_Registered(uint8_t moduleIndex);
+uint16_t SimFw_StatusSeq(uint8_t moduleIndex);
+void     SimFw_RequestCellDetail(uint8_t moduleId);
+bool     SimFw_CellDetailWaiting(uint8_t moduleIndex);
+void     SimFw_CellDetailCancel(uint8_t moduleIndex);
+uint8_t  SimFw_ModuleCount(void);
+uint32_t SimFw_RxOverflows(void);
+void     SimFw_RxRing(uint32_t* peak, uint32_t* drops);
+void     SimFw_TxClass(uint8_t txClass, simTxClass_t* stats);
+bool     SimFw_ModuleBusFd(void);
+bool     SimFw_CanFdBuilt(void);            // firmware built with MCU_USE_CANFD
+uint8_t  SimFw_PollWindow(void);
+void     SimFw_CellStats(simCellStats_t* stats);
+void     SimFw_SetBalance(bool on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_BUS_H
@@ -0,0 +1,547 @@
+/******************************************************************************
+ * @file    sim_canfdspi.c
+ * @brief   Pack simulator - CANFDSPI driver shim over the virtual CAN bus
+ * @author  Pack Emulator Development Team
+ *
+ * Replaces Core/Src/canfdspi_api.c for the host build. Only the calls the
+ * firmware makes are implemented. Channel, filter and event configuration is
+ * kept: the depth and priority of each channel go to the bus, the filters
+ * route each received frame to its FIFO (SimCan_Route()), and the enabled
+ * events drive the interrupt lines (SimCan_RxLine(), SimCan_TxLine()). The
+ * other configuration calls succeed and do nothing. Message calls move frames
+ * between the firmware's message objects and the virtual MCP2517FD channels
+ * in sim_bus.cpp. Register and RAM accesses go to a scratch buffer so
+ * CAN_TestRegisterAccess/CAN_TestRamAccess pass.
+ *
+ * Every message loaded or read is charged SIM_SPI_FRAME_US of SPI time, every
+ * FIFO status read SIM_SPI_REG_US. Each of those calls samples the CAN2 RX
+ * and TX interrupt lines at its end - a frame that arrived during the transfer
+ * starts a drain there, or extends the one running, and a frame that left a
+ * full TX FIFO starts a refill.
+ *
+ * DRV_CANFDSPI_ReceiveBatchGet() and DRV_CANFDSPI_TransmitLoad() - DMA chains
+ * on hardware - run at once and charge their time as DMA time: one status read
+ * per batch or load, then a message object per frame. A call made from a
+ * completion is queued and run when that completion returns, one after
+ * another, as the transfer interrupts are.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <string.h>
+#include "main.h"
+#include "canfdspi_api.h"
+#include "sim_bus.h"
+
+typedef struct {
+  uint8_t           depth;        // messages - 0 until configured
+  uint8_t           txPriority;   // 1-32 transmits, 0 receives
+  CAN_TX_FIFO_EVENT txEvents;     // enabled interrupts
+  CAN_RX_FIFO_EVENT rxEvents;
+} simChannel_t;
+
+typedef struct {
+  CAN_FILTEROBJ_ID  id;
+  CAN_MASKOBJ_ID    mask;
+  uint8_t           fifo;
+  bool              enabled;
+} simFilter_t;
+
+static uint8_t simRegisters[SIM_CAN_CHANNELS][4096];
+static simChannel_t simChannels[SIM_CAN_CHANNELS][SIM_CAN_FIFOS];
+static simFilter_t simFilters[SIM_CAN_CHANNELS][CAN_FILTER_TOTAL];
+static CANFDSPI_XFER* simDmaHead;      // DMA chains waiting for the one running
+static CANFDSPI_XFER* simDmaTail;
+static bool simDmaRunning;
+
+//---------------------------------------------------------------------------
+// Helpers
+//---------------------------------------------------------------------------
+static CAN_DLC SimLengthToDlc(uint8_t length)
+{
+  static const uint8_t fdLengths[] = { 12, 16, 20, 24, 32, 48, 64 };
+  uint8_t index;
+
+  if(length <= 8) return (CAN_DLC)length;
+  for(index = 0; index < sizeof(fdLengths); index++){
+    if(length <= fdLengths[index]) return (CAN_DLC)(CAN_DLC_12 + index);
+  }
+  return CAN_DLC_64;
+}
+
+static void SimChannelConfigure(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, uint8_t depth, uint8_t txPriority)
+{
+  simChannel_t* ch = &simChannels[index][channel];
+
+  ch->depth = depth;
+  ch->txPriority = txPriority;
+  ch->txEvents = CAN_TX_FIFO_NO_EVENT;
+  ch->rxEvents = CAN_RX_FIFO_NO_EVENT;
+  SimBus_PackFifoConfigure(index, channel, depth, txPriority);
+}
+
+static CAN_TX_FIFO_EVENT SimTxFlags(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+  uint8_t depth = simChannels[index][channel].depth;
+  uint8_t free;
+  CAN_TX_FIFO_EVENT flags = CAN_TX_FIFO_NO_EVENT;
+
+  // only the module bus is modelled - the VCU bus channels never fill
+  free = index == SIM_CAN_MODULE_BUS ? SimBus_PackTxFree(index, channel) : depth;
+  if(free > 0)                   flags |= CAN_TX_FIFO_NOT_FULL_EVENT;
+  if(depth && free >= depth / 2) flags |= CAN_TX_FIFO_HALF_FULL_EVENT;
+  if(depth && free == depth)     flags |= CAN_TX_FIFO_EMPTY_EVENT;
+  return flags;
+}
+
+static CAN_RX_FIFO_EVENT SimRxFlags(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+  uint8_t depth = simChannels[index][channel].depth;
+  uint8_t count = SimBus_PackRxCount(index, channel);
+  CAN_RX_FIFO_EVENT flags = CAN_RX_FIFO_NO_EVENT;
+
+  if(count > 0)                           flags |= CAN_RX_FIFO_NOT_EMPTY_EVENT;
+  if(depth && count >= depth / 2)         flags |= CAN_RX_FIFO_HALF_FULL_EVENT;
+  if(depth && count == depth)             flags |= CAN_RX_FIFO_FULL_EVENT;
+  if(SimBus_PackRxOverflow(index, channel)) flags |= CAN_RX_FIFO_OVERFLOW_EVENT;
+  return flags;
+}
+
+static void SimLines(void)
+{
+  SimFw_RxLine();
+  SimFw_TxLine();
+}
+
+static void SimDmaSubmit(CANFDSPI_XFER* xfer)
+{
+  CANFDSPI_XFER* next;
+
+  // xfer->done runs the whole chain - queued behind the one running
+  xfer->next = NULL;
+  if(simDmaTail != NULL) simDmaTail->next = xfer;
+  else                   simDmaHead = xfer;
+  simDmaTail = xfer;
+  if(simDmaRunning) return;
+
+  simDmaRunning = true;
+  while((next = simDmaHead) != NULL){
+    simDmaHead = next->next;
+    if(simDmaHead == NULL) simDmaTail = NULL;
+    next->done(next);
+  }
+  simDmaRunning = false;
+}
+
+//---------------------------------------------------------------------------
+// Configuration - channels, filters and events are kept, the rest ignored
+//---------------------------------------------------------------------------
+int8_t DRV_CANFDSPI_Reset(CANFDSPI_MODULE_ID index)
+{
+  uint8_t channel;
+
+  if(index >= SIM_CAN_CHANNELS) return -1;
+  for(channel = 0; channel < SIM_CAN_FIFOS; channel++)
+    SimChannelConfigure(index, (CAN_FIFO_CHANNEL)channel, 0, 0);
+  memset(simFilters[index], 0, sizeof(simFilters[index]));
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_EccEnable(CANFDSPI_MODULE_ID index)            { (void)index; return 0; }
+int8_t DRV_CANFDSPI_RamInit(CANFDSPI_MODULE_ID index, uint8_t d)   { (void)index; (void)d; return 0; }
+int8_t DRV_CANFDSPI_ConfigureObjectReset(CAN_CONFIG* config)       { memset(config, 0, sizeof(*config)); return 0; }
+int8_t DRV_CANFDSPI_Configure(CANFDSPI_MODULE_ID index, CAN_CONFIG* config) { (void)index; (void)config; return 0; }
+
+int8_t DRV_CANFDSPI_TransmitQueueConfigureObjectReset(CAN_TX_QUEUE_CONFIG* config)
+{
+  memset(config, 0, sizeof(*config));
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_TransmitQueueConfigure(CANFDSPI_MODULE_ID index, CAN_TX_QUEUE_CONFIG* config)
+{
+  SimChannelConfigure(index, CAN_TXQUEUE_CH0, config->FifoSize + 1, config->TxPriority + 1);
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_TransmitChannelConfigureObjectReset(CAN_TX_FIFO_CONFIG* config)
+{
+  memset(config, 0, sizeof(*config));
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_TransmitChannelConfigure(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_TX_FIFO_CONFIG* config)
+{
+  SimChannelConfigure(index, channel, config->FifoSize + 1, config->TxPriority + 1);
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ReceiveChannelConfigureObjectReset(CAN_RX_FIFO_CONFIG* config)
+{
+  memset(config, 0, sizeof(*config));
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ReceiveChannelConfigure(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_RX_FIFO_CONFIG* config)
+{
+  SimChannelConfigure(index, channel, config->FifoSize + 1, 0);
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_FilterObjectConfigure(CANFDSPI_MODULE_ID index, CAN_FILTER filter, CAN_FILTEROBJ_ID* id)
+{
+  simFilters[index][filter].id = *id;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_FilterMaskConfigure(CANFDSPI_MODULE_ID index, CAN_FILTER filter, CAN_MASKOBJ_ID* mask)
+{
+  simFilters[index][filter].mask = *mask;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_FilterToFifoLink(CANFDSPI_MODULE_ID index, CAN_FILTER filter, CAN_FIFO_CHANNEL channel, bool enable)
+{
+  simFilters[index][filter].fifo = channel;
+  simFilters[index][filter].enabled = enable;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_FilterDisable(CANFDSPI_MODULE_ID index, CAN_FILTER filter)
+{
+  simFilters[index][filter].enabled = false;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_BitTimeConfigure(CANFDSPI_MODULE_ID index, CAN_BITTIME_SETUP bitTime, CAN_SSP_MODE sspMode, CAN_SYSCLK_SPEED clk)
+{
+  (void)index; (void)bitTime; (void)sspMode; (void)clk;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_GpioModeConfigure(CANFDSPI_MODULE_ID index, GPIO_PIN_MODE gpio0, GPIO_PIN_MODE gpio1)
+{
+  (void)index; (void)gpio0; (void)gpio1;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_TransmitChannelEventEnable(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_TX_FIFO_EVENT flags)
+{
+  simChannels[index][channel].txEvents |= flags;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ReceiveChannelEventEnable(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_RX_FIFO_EVENT flags)
+{
+  simChannels[index][channel].rxEvents |= flags;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ModuleEventEnable(CANFDSPI_MODULE_ID index, CAN_MODULE_EVENT flags)
+{
+  (void)index; (void)flags;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_OperationModeSelect(CANFDSPI_MODULE_ID index, CAN_OPERATION_MODE opMode)
+{
+  (void)index; (void)opMode;
+  return 0;
+}
+
+//---------------------------------------------------------------------------
+// Register and RAM access - scratch memory, reads return what was written
+//---------------------------------------------------------------------------
+int8_t DRV_CANFDSPI_WriteByteArray(CANFDSPI_MODULE_ID index, uint16_t address, uint8_t *txd, uint16_t nBytes)
+{
+  if(index >= SIM_CAN_CHANNELS || address + nBytes > sizeof(simRegisters[0])) return -1;
+  memcpy(&simRegisters[index][address], txd, nBytes);
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ReadByteArray(CANFDSPI_MODULE_ID index, uint16_t address, uint8_t *rxd, uint16_t nBytes)
+{
+  if(index >= SIM_CAN_CHANNELS || address + nBytes > sizeof(simRegisters[0])) return -1;
+  memcpy(rxd, &simRegisters[index][address], nBytes);
+  return 0;
+}
+
+//---------------------------------------------------------------------------
+// Messages
+//---------------------------------------------------------------------------
+uint32_t DRV_CANFDSPI_DlcToDataBytes(CAN_DLC dlc)
+{
+  static const uint8_t fdLengths[] = { 12, 16, 20, 24, 32, 48, 64 };
+
+  if(dlc < CAN_DLC_12) return dlc;
+  if(dlc <= CAN_DLC_64) return fdLengths[dlc - CAN_DLC_12];
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_TransmitChannelEventGet(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_TX_FIFO_EVENT* flags)
+{
+  SimBus_SpiTime(SIM_SPI_REG_US);
+  *flags = SimTxFlags(index, channel);
+  SimLines();
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_TransmitChannelLoad(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_TX_MSGOBJ* txObj,
+                                        uint8_t *txd, uint32_t txdNumBytes, bool flush)
+{
+  simFrame_t frame;
+  bool loaded;
+
+  (void)flush;
+  if(txdNumBytes > sizeof(frame.data)) return -3;
+  if(!(SimTxFlags(index, channel) & CAN_TX_FIFO_NOT_FULL_EVENT)) return -4;
+
+  memset(&frame, 0, sizeof(frame));
+  frame.sid    = txObj->bF.id.SID;
+  frame.eid    = txObj->bF.id.EID;
+  frame.fd     = txObj->bF.ctrl.FDF;
+  frame.brs    = txObj->bF.ctrl.BRS;
+  frame.length = (uint8_t)txdNumBytes;
+  memcpy(frame.data, txd, txdNumBytes);
+
+  SimBus_SpiTime(SIM_SPI_FRAME_US);
+  loaded = SimBus_PackTxLoad(index, channel, &frame);
+  SimLines();
+  return loaded ? 0 : -4;
+}
+
+int8_t DRV_CANFDSPI_TransmitChannelFlush(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+  (void)index; (void)channel;
+  // frames go out as soon as they are loaded - nothing held back to flush
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ErrorCountStateGet(CANFDSPI_MODULE_ID index, uint8_t* tec, uint8_t* rec, CAN_ERROR_STATE* flags)
+{
+  (void)index;
+  *tec = 0;
+  *rec = 0;
+  *flags = CAN_ERROR_FREE_STATE;
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ReceiveChannelEventGet(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_RX_FIFO_EVENT* flags)
+{
+  SimBus_SpiTime(SIM_SPI_REG_US);
+  *flags = SimRxFlags(index, channel);
+  SimLines();
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ReceiveChannelEventOverflowClear(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+  SimBus_PackRxOverflowClear(index, channel);
+  return 0;
+}
+
+int8_t DRV_CANFDSPI_ReceiveMessageGet(CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel, CAN_RX_MSGOBJ* rxObj,
+                                      uint8_t *rxd, uint8_t nBytes)
+{
+  simFrame_t frame;
+
+  if(!SimBus_PackRxGet(index, channel, &frame)) return -1;
+
+  rxObj->word[0] = 0;
+  rxObj->word[1] = 0;
+  rxObj->word[2] = 0;
+  rxObj->bF.id.SID   = frame.sid;
+  rxObj->bF.id.EID   = frame.eid;
+  rxObj->bF.ctrl.DLC = SimLengthToDlc(frame.length);
+  rxObj->bF.ctrl.IDE = 1;
+  rxObj->bF.ctrl.FDF = frame.fd;
+  rxObj->bF.ctrl.BRS = frame.brs;
+
+  // the driver always reads nBytes - bytes past the DLC are whatever the FIFO RAM held, zero here
+  memset(rxd, 0, nBytes);
+  memcpy(rxd, frame.data, frame.length < nBytes ? frame.length : nBytes);
+
+  SimBus_SpiTime(SIM_SPI_FRAME_US);
+  SimLines();
+  return 0;
+}
+
+//---------------------------------------------------------------------------
+// Batched receive - message objects laid out in batch->rx as the RAM burst
+// leaves them, without a wrap
+//---------------------------------------------------------------------------
+#define SIM_RX_OBJ_SIZE   (8 + MAX_DATA_BYTES)
+
+int8_t DRV_CANFDSPI_ReceiveBatchConfigure(CANFDSPI_RX_BATCH* batch, CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+  memset(batch, 0, sizeof(*batch));
+  batch->index    = index;
+  batch->channel  = channel;
+  batch->ramStart = cRAMADDR_START;
+  batch->objSize  = SIM_RX_OBJ_SIZE;
+  batch->depth    = simChannels[index][channel].depth;
+  return 0;
+}
+
+static void SimRxBatchRun(CANFDSPI_XFER* xfer)
+{
+  CANFDSPI_RX_BATCH* batch = (CANFDSPI_RX_BATCH*)xfer->context;
+  CAN_RX_MSGOBJ rxObj;
+  simFrame_t frame;
+  uint8_t* ba;
+  uint8_t count;
+
+  // FIFO status, once per batch
+  SimBus_SpiDmaTime(SIM_SPI_REG_US);
+  count = SimBus_PackRxCount(batch->index, batch->channel);
+  batch->flags = SimRxFlags(batch->index, batch->channel);
+  if(batch->flags & CAN_RX_FIFO_OVERFLOW_EVENT)
+    SimBus_PackRxOverflowClear(batch->index, batch->channel);
+
+  // the messages waiting then - ones landing during the burst wait for the next batch
+  if(count > CANFDSPI_RX_BATCH_MAX) count = CANFDSPI_RX_BATCH_MAX;
+  batch->first = count;
+  for(batch->count = 0; batch->count < count && SimBus_PackRxGet(batch->index, batch->channel, &frame); batch->count++){
+    memset(&rxObj, 0, sizeof(rxObj));
+    rxObj.bF.id.SID   = frame.sid;
+    rxObj.bF.id.EID   = frame.eid;
+    rxObj.bF.ctrl.DLC = SimLengthToDlc(frame.length);
+    rxObj.bF.ctrl.IDE = 1;
+    rxObj.bF.ctrl.FDF = frame.fd;
+    rxObj.bF.ctrl.BRS = frame.brs;
+
+    // bytes past the DLC are whatever the FIFO RAM held, zero here
+    ba = &batch->rx[2 + batch->count * SIM_RX_OBJ_SIZE];
+    memcpy(ba, rxObj.word, 8);
+    memset(ba + 8, 0, MAX_DATA_BYTES);
+    memcpy(ba + 8, frame.data, frame.length < MAX_DATA_BYTES ? frame.length : MAX_DATA_BYTES);
+    SimBus_SpiDmaTime(SIM_SPI_FRAME_US);
+  }
+
+  SimLines();
+  if(batch->done != NULL) batch->done(batch);
+}
+
+int8_t DRV_CANFDSPI_ReceiveBatchGet(CANFDSPI_RX_BATCH* batch)
+{
+  if(batch->depth == 0) return -1;
+  batch->status = 0;
+  batch->flags  = CAN_RX_FIFO_NO_EVENT;
+  batch->count  = 0;
+  batch->xfer[0].context = batch;
+  batch->xfer[0].done = SimRxBatchRun;
+  SimDmaSubmit(&batch->xfer[0]);
+  return 0;
+}
+
+void DRV_CANFDSPI_ReceiveBatchMessage(CANFDSPI_RX_BATCH* batch, uint8_t i, CAN_RX_MSGOBJ* rxObj, uint8_t *rxd, uint8_t nBytes)
+{
+  const uint8_t* ba = &batch->rx[2 + i * SIM_RX_OBJ_SIZE];
+
+  memcpy(rxObj->word, ba, 8);
+  rxObj->word[2] = 0;
+  memcpy(rxd, ba + 8, nBytes < MAX_DATA_BYTES ? nBytes : MAX_DATA_BYTES);
+}
+
+//---------------------------------------------------------------------------
+// Asynchronous transmit load - the frame is held in load->tx until it runs
+//---------------------------------------------------------------------------
+void DRV_CANFDSPI_TransmitLoadConfigure(CANFDSPI_TX_LOAD* load, CANFDSPI_MODULE_ID index, CAN_FIFO_CHANNEL channel)
+{
+  memset(load, 0, sizeof(*load));
+  load->index   = index;
+  load->channel = channel;
+}
+
+static void SimTxLoadRun(CANFDSPI_XFER* xfer)
+{
+  CANFDSPI_TX_LOAD* load = (CANFDSPI_TX_LOAD*)xfer->context;
+  CAN_TX_MSGOBJ txObj;
+  simFrame_t frame;
+
+  // FIFO status, then the message object if there is room for it
+  SimBus_SpiDmaTime(SIM_SPI_REG_US);
+  load->flags = SimTxFlags(load->index, load->channel);
+
+  load->loaded = (load->flags & CAN_TX_FIFO_NOT_FULL_EVENT) != 0;
+  if(load->loaded){
+    memset(&txObj, 0, sizeof(txObj));
+    memcpy(txObj.word, &load->tx[2], 8);
+    memset(&frame, 0, sizeof(frame));
+    frame.sid    = txObj.bF.id.SID;
+    frame.eid    = txObj.bF.id.EID;
+    frame.fd     = txObj.bF.ctrl.FDF;
+    frame.brs    = txObj.bF.ctrl.BRS;
+    frame.length = (uint8_t)(load->xfer[1].size - 10);
+    memcpy(frame.data, &load->tx[10], frame.length);
+
+    SimBus_SpiDmaTime(SIM_SPI_FRAME_US);
+    SimBus_PackTxLoad(load->index, load->channel, &frame);
+  }
+
+  SimLines();
+  if(load->done != NULL) load->done(load);
+}
+
+int8_t DRV_CANFDSPI_TransmitLoad(CANFDSPI_TX_LOAD* load, CAN_TX_MSGOBJ* txObj, uint8_t *txd, uint32_t txdNumBytes)
+{
+  if(txdNumBytes > MAX_DATA_BYTES) return -3;
+
+  // the message object as the driver lays it out - command, header, data - without the padding
+  memcpy(&load->tx[2], txObj->word, 8);
+  memcpy(&load->tx[10], txd, txdNumBytes);
+  load->xfer[1].size = (uint16_t)(10 + txdNumBytes);
+
+  load->status = 0;
+  load->flags  = CAN_TX_FIFO_NO_EVENT;
+  load->loaded = false;
+  load->xfer[0].context = load;
+  load->xfer[0].done = SimTxLoadRun;
+  SimDmaSubmit(&load->xfer[0]);
+  return 0;
+}
+
+//---------------------------------------------------------------------------
+// Virtual MCP2517FD - acceptance filters and interrupt lines for the bus
+//---------------------------------------------------------------------------
+uint8_t SimCan_Route(uint8_t channel, const simFrame_t* frame)
+{
+  const simFilter_t* filter;
+  uint8_t n;
+
+  // the lowest numbered filter that matches - frames on the module bus are extended, so a filter that
+  // takes only standard frames never does
+  for(n = 0; n < CAN_FILTER_TOTAL; n++){
+    filter = &simFilters[channel][n];
+    if(!filter->enabled) continue;
+    if(((frame->sid ^ filter->id.SID) & filter->mask.MSID) != 0) continue;
+    if(((frame->eid ^ filter->id.EID) & filter->mask.MEID) != 0) continue;
+    if(filter->mask.MIDE && !filter->id.EXIDE) continue;
+    return filter->fifo;
+  }
+  return 0;
+}
+
+bool SimCan_RxLine(uint8_t channel)
+{
+  const simChannel_t* ch;
+  uint8_t n;
+
+  for(n = 1; n < SIM_CAN_FIFOS; n++){
+    ch = &simChannels[channel][n];
+    if(ch->depth && !ch->txPriority && (SimRxFlags(channel, (CAN_FIFO_CHANNEL)n) & ch->rxEvents)) return true;
+  }
+  return false;
+}
+
+bool SimCan_TxLine(uint8_t channel)
+{
+  const simChannel_t* ch;
+  uint8_t n;
+
+  for(n = 0; n < SIM_CAN_FIFOS; n++){
+    ch = &simChannels[channel][n];
+    if(ch->txPriority && (SimTxFlags(channel, (CAN_FIFO_CHANNEL)n) & ch->txEvents)) return true;
+  }
+  return false;
+}
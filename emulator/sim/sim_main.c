@@ -0,0 +1,290 @@
+/******************************************************************************
+ * @file    sim_main.c
+ * @brief   Pack simulator - stands in for Core/Src/main.c on the host
+ * @author  Pack Emulator Development Team
+ *
+ * Provides the globals and helpers mcu.c, vcu.c, debug.c and web4_handler.c
+ * take from main.c, drives TIM1 from the virtual clock and gives the harness
+ * read access to the pack state it reports on.
+ *
+ * TIM1 runs at 1 ms per count with Period 99 as on the STM32, so
+ * etTimerOverflows advances every 100 ms and sendMaxState/sendState are raised
+ * on the same overflows HAL_TIM_PeriodElapsedCallback() raises them.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "bms.h"
+#include "mcu.h"
+#include "mcu_sched.h"
+#include "mcu_cellstats.h"
+#include "mcu_balance.h"
+#include "can_rx_ring.h"
+#include "can_tx_queue.h"
+#include "debug.h"
+#include "eeprom_emul.h"
+#include "eeprom_data.h"
+#include "sim_bus.h"
+
+#define SIM_RTC_EPOCH   1735689600      // 2025-01-01 00:00:00 UTC
+
+//---------------------------------------------------------------------------
+// main.c globals
+//---------------------------------------------------------------------------
+extern batteryPack pack;
+extern canRxRing_t mcuRxRing;
+extern canTxQueue_t mcuTxQueue;
+
+static TIM_TypeDef simTim1;
+
+TIM_HandleTypeDef  htim1;
+UART_HandleTypeDef huart1;
+
+uint8_t  can3RxInterrupt = 0;
+uint8_t  can3TxInterrupt = 0;
+uint8_t  can2RxInterrupt = 0;
+uint8_t  can2TxInterrupt = 0;
+uint8_t  can1RxInterrupt = 0;
+uint8_t  can1TxInterrupt = 0;
+uint32_t etTimerOverflows = 0;
+
+uint8_t  hwPlatform = PLATFORM_NUCLEO;
+uint8_t  EE_PACK_ID = 0;
+uint8_t  decSec = 0;
+uint8_t  sendMaxState = 0;
+uint8_t  sendState = 0;
+uint8_t  debugLevel = 0;
+uint32_t debugMessages = 0;
+char     tempBuffer[MAX_BUFFER];
+uint32_t eeVarDataTab[NB_OF_VARIABLES+1] = {0};
+
+static bool     simLog = false;
+static uint64_t simNowUs = 0;
+
+//---------------------------------------------------------------------------
+// main.c helpers
+//---------------------------------------------------------------------------
+void serialOut(char* message)
+{
+  if(simLog) printf("%10.3f %s\n", simNowUs / 1000.0, message);
+}
+
+void switchLedOn(uint8_t led)  { (void)led; }
+void switchLedOff(uint8_t led) { (void)led; }
+
+void writeRTC(time_t now) { (void)now; }
+
+time_t readRTC(void)
+{
+  return (time_t)(SIM_RTC_EPOCH + simNowUs / 1000000);
+}
+
+EE_Status LoadAllEEPROM(void)
+{
+  // eeVarDataTab is the EEPROM - blank (pack ID 0) at start, StoreEEPROM writes persist
+  return EE_OK;
+}
+
+EE_Status LoadFromEEPROM(uint16_t virtAddress, uint32_t *eeData)
+{
+  return EE_ReadVariable32bits(virtAddress, eeData);
+}
+
+EE_Status StoreEEPROM(uint16_t virtAddress, uint32_t data)
+{
+  if(virtAddress > NB_OF_VARIABLES) return EE_INVALID_VIRTUALADDRESS;
+  eeVarDataTab[virtAddress] = data;
+  return EE_OK;
+}
+
+EE_Status EE_ReadVariable32bits(uint16_t VirtAddress, uint32_t* pData)
+{
+  if(VirtAddress > NB_OF_VARIABLES) return EE_INVALID_VIRTUALADDRESS;
+  *pData = eeVarDataTab[VirtAddress];
+  return EE_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  return (uint32_t)(simNowUs / 1000);
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  (void)huart; (void)Timeout;
+  if(simLog) fwrite(pData, 1, Size, stdout);
+  return HAL_OK;
+}
+
+//---------------------------------------------------------------------------
+// Virtual clock
+//---------------------------------------------------------------------------
+void SimFw_SetTime(uint64_t us)
+{
+  uint32_t overflows = (uint32_t)(us / 1000 / (htim1.Init.Period + 1));
+
+  simNowUs = us;
+  // HAL_TIM_PeriodElapsedCallback() once for every overflow passed
+  while(etTimerOverflows < overflows){
+    etTimerOverflows++;
+    decSec++;
+    if(decSec == 10) decSec = 0;
+    if((decSec % 2) == 0) sendMaxState = 1;
+    if((decSec % 5) == 0) sendState = 1;
+  }
+  simTim1.CNT = (uint32_t)(us / 1000 % (htim1.Init.Period + 1));
+}
+
+//---------------------------------------------------------------------------
+// Firmware entry points
+//---------------------------------------------------------------------------
+void SimFw_Initialize(void)
+{
+  htim1.Instance = &simTim1;
+  htim1.Init.Period = 99;
+  SimFw_SetTime(0);
+  PCU_Initialize();
+}
+
+void SimFw_Tasks(void)
+{
+  // frames that arrived between passes were drained by the RX interrupt as they landed
+  SimFw_RxLine();
+  SimFw_TxLine();
+  PCU_Tasks();
+}
+
+void SimFw_RxLine(void)
+{
+  // CAN2_INT1 is asserted while a receive FIFO meets its enabled event - HAL_GPIO_EXTI_Callback() runs on each edge
+  uint8_t line = SimCan_RxLine(CAN2);
+
+  if(line == can2RxInterrupt) return;
+  can2RxInterrupt = line;
+  if(line) MCU_RxDrain();
+}
+
+void SimFw_TxLine(void)
+{
+  // CAN2_INT0 is asserted while a transmit channel has room - HAL_GPIO_EXTI_Callback() runs on each edge
+  uint8_t line = SimCan_TxLine(CAN2);
+
+  if(line == can2TxInterrupt) return;
+  can2TxInterrupt = line;
+  if(line) MCU_TxRefill();
+}
+
+void SimFw_SetLog(bool on, uint8_t level)
+{
+  simLog = on;
+  debugLevel = level;
+  debugMessages = on ? DEBUG_MESSAGES : 0;
+}
+
+//---------------------------------------------------------------------------
+// Pack state for the harness
+//---------------------------------------------------------------------------
+uint8_t SimFw_ModuleIndex(uint8_t moduleId)
+{
+  return MCU_ModuleIndexFromId(moduleId);
+}
+
+bool SimFw_Registered(uint8_t moduleIndex)
+{
+  return moduleIndex < MAX_MODULES_PER_PACK && moduleCtl.isRegistered[moduleIndex];
+}
+
+uint16_t SimFw_StatusSeq(uint8_t moduleIndex)
+{
+  return module[moduleIndex].statusSeq;
+}
+
+void SimFw_RequestCellDetail(uint8_t moduleId)
+{
+  MCU_RequestCellDetail(moduleId);
+}
+
+bool SimFw_CellDetailWaiting(uint8_t moduleIndex)
+{
+  return moduleCtl.waiting[moduleIndex];
+}
+
+void SimFw_CellDetailCancel(uint8_t moduleIndex)
+{
+  // the requester gives up on a chain that lost a frame
+  moduleCtl.waiting[moduleIndex] = false;
+  if(mcuDetailStream.active && mcuDetailStream.moduleIndex == moduleIndex) mcuDetailStream.active = false;
+}
+
+uint8_t SimFw_ModuleCount(void)
+{
+  return pack.activeModules;
+}
+
+uint32_t SimFw_RxOverflows(void)
+{
+  return pack.errorCounts.mcuRxOverflow;
+}
+
+void SimFw_RxRing(uint32_t* peak, uint32_t* drops)
+{
+  *peak  = mcuRxRing.peak;
+  *drops = mcuRxRing.drops;
+}
+
+void SimFw_TxClass(uint8_t txClass, simTxClass_t* stats)
+{
+  const canTxClass_t* ring = &mcuTxQueue.txClass[txClass];
+
+  stats->sent       = ring->sent;
+  stats->drops      = ring->drops;
+  stats->latencyMax = ring->latencyMax;
+  stats->latencySum = ring->latencySum;
+}
+
+bool SimFw_ModuleBusFd(void)
+{
+  return pack.moduleBusFd;
+}
+
+bool SimFw_CanFdBuilt(void)
+{
+#ifdef MCU_USE_CANFD
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint8_t SimFw_PollWindow(void)
+{
+  return mcuPoll.window;
+}
+
+void SimFw_CellStats(simCellStats_t* stats)
+{
+  stats->cells      = mcuCellStats.cells;
+  stats->modules    = mcuCellStats.modules;
+  stats->voltMin    = mcuCellStats.volt.min;
+  stats->voltMax    = mcuCellStats.volt.max;
+  stats->voltMean   = mcuCellStats.volt.mean;
+  stats->voltStddev = mcuCellStats.volt.stddev;
+  stats->tempMin    = mcuCellStats.temp.min;
+  stats->tempMax    = mcuCellStats.temp.max;
+  stats->tempMean   = mcuCellStats.temp.mean;
+  stats->tempStddev = mcuCellStats.temp.stddev;
+  stats->voltSpread = mcuCellStats.volt.spread;
+  stats->bleeding   = mcuBalance.bleeding;
+  stats->balanceActive = pack.cellBalanceActive;
+  stats->balanced   = pack.cellBalanceStatus;
+}
+
+void SimFw_SetBalance(bool on)
+{
+  // as vcu_cell_balance_ctrl in the VCU command
+  MCU_BalancePackControl(on ? MCU_BALANCE_CTRL_ON : MCU_BALANCE_CTRL_OFF);
+}
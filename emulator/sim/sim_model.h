@@ -0,0 +1,196 @@
+/******************************************************************************
+ * @file    sim_model.h
+ * @brief   Pack simulator - virtual bus, simulated modules and statistics
+ * @author  Pack Emulator Development Team
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#ifndef SIM_MODEL_H
+#define SIM_MODEL_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <functional>
+
+#include "sim_bus.h"
+
+//---------------------------------------------------------------------------
+// Deterministic random numbers - the same seed always gives the same run
+//---------------------------------------------------------------------------
+class SimRng {
+public:
+    explicit SimRng(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+    uint32_t Next() {
+        // xorshift64*
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+    uint32_t Uniform(uint32_t span) { return span ? Next() % span : 0; }
+    bool     ChancePpm(uint32_t ppm) { return ppm && Uniform(1000000) < ppm; }
+private:
+    uint64_t state;
+};
+
+//---------------------------------------------------------------------------
+// Virtual CAN bus - the module bus (CAN2) with frame timing from can_bus_model.h
+//---------------------------------------------------------------------------
+struct BusFrame {
+    simFrame_t frame;
+    uint64_t   ready;       // earliest time the frame may start arbitration (us)
+    uint64_t   sampled;     // time the sender took the data in it (us)
+    uint16_t   node;        // 0 = pack, else simulated module node
+};
+
+struct BusStats {
+    uint64_t packFrames;
+    uint64_t moduleFrames;
+    uint64_t busyUs;
+    uint64_t rxOverflows;   // frames a pack RX FIFO had to drop
+    uint64_t rxFiltered;    // frames no acceptance filter took
+    uint64_t vcuFrames;     // CAN1 frames - counted, not modelled
+    uint64_t spiUs;         // firmware SPI time
+    uint64_t spiDmaUs;      // of which run by DMA - the CPU is free meanwhile
+};
+
+class VirtualBus {
+public:
+    typedef std::function<void(const BusFrame&, uint64_t)> Listener;
+
+    VirtualBus(uint32_t loadWindowUs);
+
+    uint16_t AddNode();
+    void     Queue(uint16_t node, const BusFrame& f);
+    void     RunUntil(uint64_t t);
+    bool     RunUntilInt(uint64_t t, uint64_t& at);      // stops once a module frame lands in an RX FIFO, or a pack frame leaves a full TX channel
+
+    // pack controller side - used by the SimBus_* hooks
+    void     SetPassTime(uint64_t t) { passTime = t; spiUs = 0; }
+    uint32_t SpiUs() const { return spiUs; }
+    void     AddSpi(uint32_t us, bool dma = false);
+    void     PackFifoConfigure(uint8_t fifo, uint8_t depth, uint8_t txPriority);
+    bool     PackTxLoad(uint8_t fifo, const simFrame_t& f);
+    uint8_t  PackTxFree(uint8_t fifo) const;
+    bool     PackRxGet(uint8_t fifo, BusFrame& f);
+    uint8_t  PackRxCount(uint8_t fifo) const { return (uint8_t)fifos[fifo].frames.size(); }
+    bool     PackRxOverflow(uint8_t fifo) const { return fifos[fifo].overflow; }
+    void     PackRxOverflowClear(uint8_t fifo) { fifos[fifo].overflow = false; }
+    uint8_t  PackFifoDepth(uint8_t fifo) const { return fifos[fifo].depth; }
+    bool     PackFifoRx(uint8_t fifo) const { return fifos[fifo].depth && !fifos[fifo].txPriority; }
+    uint32_t PackRxPeak(uint8_t fifo) const { return fifos[fifo].peak; }
+    void     CountVcuFrame() { stats.vcuFrames++; }
+
+    Listener onPackFrame;       // a pack frame finished - modules listen
+    Listener onPackTx;          // the firmware loaded a frame into the TX FIFO
+    Listener onPackRx;          // the firmware read a frame out of the RX FIFO
+
+    BusStats stats;
+    std::vector<uint32_t> windowBusyUs;    // bus busy time per load window
+    uint32_t loadWindow;
+
+private:
+    struct PackFifo {                   // one MCP2517FD channel of the pack's module bus controller
+        std::deque<BusFrame> frames;
+        uint8_t  depth;                 // 0 - not configured
+        uint8_t  txPriority;            // 1-32 transmits, 0 receives
+        bool     overflow;
+        uint32_t peak;
+    };
+
+    void Complete(uint64_t t);
+    void AddBusy(uint64_t start, uint32_t duration);
+    bool PackNext(uint64_t start, uint8_t& fifo, size_t& pos) const;
+
+    std::vector<std::deque<BusFrame> > nodes;     // node 0 unused - the pack sends from fifos
+    std::vector<PackFifo> fifos;
+    bool     busy;
+    BusFrame current;
+    uint8_t  currentFifo;               // pack frames - the channel and place it is sent from
+    size_t   currentPos;
+    uint64_t currentEnd;
+    uint64_t busFree;
+    uint64_t passTime;
+    uint32_t spiUs;
+    bool     stopOnInt;
+    bool     interrupt;
+    uint64_t interruptAt;
+};
+
+//---------------------------------------------------------------------------
+// Simulated module - answers the pack like ModuleCPU does
+//---------------------------------------------------------------------------
+struct ModuleProfile {
+    const char* name;
+    uint8_t  cells;
+    uint32_t latencyUs;     // request received to first reply ready
+    uint32_t jitterUs;      // plus up to this much, uniformly
+    uint32_t lossPpm;       // chance each frame the module sends is lost
+    bool     canFd;         // reports MODULE_HW_CAP_CANFD
+    double   currentA;      // module current reported in STATUS_1
+};
+
+class SimModule {
+public:
+    SimModule(VirtualBus& bus, uint32_t uniqueId, const ModuleProfile& profile, SimRng& rng);
+
+    void OnPackFrame(const simFrame_t& f, uint64_t t);
+
+    uint8_t  Id() const { return id; }
+    uint16_t Node() const { return node; }
+    const ModuleProfile& Profile() const { return profile; }
+    uint32_t framesLost;
+
+private:
+    void     Send(uint64_t ready, uint16_t sid, const void* data, uint8_t length, bool fd, uint64_t sampled);
+    uint64_t Turnaround(uint64_t t);
+    void     Sample(uint64_t t);
+    void     SendStatus(uint64_t ready, bool fd, uint64_t sampled);
+    void     SendHardware(uint64_t ready, uint64_t sampled);
+    void     SendCellFd(uint64_t ready, uint64_t sampled);
+    void     SendDetail(uint64_t ready, uint8_t cellId, uint64_t sampled);
+    void     SendWindow(uint64_t ready, uint8_t base, uint16_t received);
+    void     Bleed(uint64_t t);
+    void     SetBleed(const simFrame_t& f, uint64_t t);
+
+    VirtualBus&   bus;
+    SimRng&       rng;
+    ModuleProfile profile;
+    uint16_t      node;
+    uint32_t      uniqueId;
+    uint8_t       id;           // 0 until registered
+    uint8_t       state;
+    std::vector<uint16_t> voltage;      // mV
+    std::vector<uint16_t> temperature;  // 0.01 C + 55.35 C
+    std::vector<int16_t>  voltOffset;
+    std::vector<int16_t>  tempOffset;
+    std::vector<uint64_t> bleedUntil;   // cell bleeds until this time (us)
+    std::vector<uint64_t> bleedUs;      // total time the cell has bled
+    uint64_t      lastBleed;
+    bool          streaming;    // cell detail stream in progress
+    uint8_t       streamTransfer;
+    uint8_t       streamWindow;
+    uint64_t      streamSampled;    // time the stream's cell snapshot was taken
+};
+
+//---------------------------------------------------------------------------
+// Histogram with fixed bucket edges
+//---------------------------------------------------------------------------
+class Histogram {
+public:
+    Histogram(const char* title, const char* unit, const std::vector<double>& edges);
+    void   Add(double value);
+    double Percentile(double p) const;
+    void   Print() const;
+    size_t Count() const { return values.size(); }
+private:
+    const char*         title;
+    const char*         unit;
+    std::vector<double> edges;
+    std::vector<uint64_t> counts;
+    std::vector<double> values;
+};
+
+#endif // SIM_MODEL_H
@@ -0,0 +1,330 @@
+/******************************************************************************
+ * @file    sim_module.cpp
+ * @brief   Pack simulator - simulated ModuleCPU
+ * @author  Pack Emulator Development Team
+ *
+ * Answers the pack controller's module bus requests the way ModuleCPU does:
+ *   0x51D announce request      -> 0x500 announcement (unregistered only, random backoff)
+ *   0x510 registration          -> takes the module ID if the unique ID matches, sends 0x501
+ *   0x512 status request        -> 0x502/0x503/0x504, or one 0x50B on a CAN FD request,
+ *                                  STATUS_3 has MODULE_HW_CAP_CANFD if the profile has it
+ *                                  broadcast (ID 0x00) replies in the module's ID slot
+ *   0x511 hardware request      -> 0x501
+ *   0x515 detail request        -> 0x505 for the requested cell, or every cell as 0x50C on CAN FD
+ *   0x519 detail stream request -> a window of 0x505 frames back to back
+ *   0x51A detail window ACK     -> the next window, the cells the bitmap lacks, or stop
+ *   0x514 state change          -> reports the new state in STATUS_1
+ *   0x51B cell balance          -> bleeds the masked cells for up to 'duration' seconds
+ *   0x518 / 0x51E deregister    -> back to unregistered, bleeding stops
+ *
+ * Each reply is ready profile.latencyUs + up to profile.jitterUs after the
+ * request finished on the bus, with 50 us between a module's own frames, and
+ * any frame is lost with probability profile.lossPpm.
+ *
+ * A bleeding cell loses BLEED_UV_PER_S - far faster than a real bleed resistor,
+ * so a run of a few minutes shows the balancing planner converge.
+ *
+ * Copyright (C) 2025 Modular Battery Technologies, Inc.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../../protocols/CAN_ID_ALL.h"
+#include "../../protocols/can_frm_mod.h"
+#include "sim_model.h"
+
+static const uint32_t MODULE_FRAME_GAP    = 50;     // ModuleCPU load time between its own frames (us)
+static const uint32_t ANNOUNCE_BACKOFF_US = 5000;   // random announcement delay so modules don't collide
+static const uint8_t  STATUS_FD_BYTES     = 24;     // STATUS_FD with the reserved tail left off
+static const uint16_t CELL_MV_NOMINAL     = 3700;
+static const uint16_t CELL_TEMP_NOMINAL   = 8035;   // 25 C in 0.01 C + 55.35 C units
+static const uint16_t CURRENT_ZERO        = 32768;  // 0 A in MODULE_CURRENT_FACTOR units
+static const uint16_t HW_MAX_CHARGE       = 33268;  // +10 A
+static const uint16_t HW_MAX_DISCHARGE    = 30668;  // -42 A
+static const uint32_t BLEED_UV_PER_S      = 200;
+static const uint8_t  STREAM_WINDOW_MAX   = 16;     // cells a DETAIL_WINDOW_ACK bitmap covers
+
+SimModule::SimModule(VirtualBus& bus, uint32_t uniqueId, const ModuleProfile& profile, SimRng& rng)
+    : framesLost(0), bus(bus), rng(rng), profile(profile), uniqueId(uniqueId), id(0), state(0), lastBleed(0),
+      streaming(false), streamTransfer(0), streamWindow(0), streamSampled(0) {
+    node = bus.AddNode();
+    voltage.resize(profile.cells);
+    temperature.resize(profile.cells);
+    bleedUntil.resize(profile.cells, 0);
+    bleedUs.resize(profile.cells, 0);
+    // fixed per-cell spread around nominal so summaries differ between modules
+    for (uint8_t i = 0; i < profile.cells; i++) {
+        voltOffset.push_back((int16_t)rng.Uniform(81) - 40);
+        tempOffset.push_back((int16_t)rng.Uniform(601) - 300);
+    }
+    Sample(0);
+}
+
+uint64_t SimModule::Turnaround(uint64_t t) {
+    return t + profile.latencyUs + rng.Uniform(profile.jitterUs + 1);
+}
+
+void SimModule::Bleed(uint64_t t) {
+    for (uint8_t i = 0; i < profile.cells; i++) {
+        if (bleedUntil[i] > lastBleed) bleedUs[i] += (bleedUntil[i] < t ? bleedUntil[i] : t) - lastBleed;
+    }
+    lastBleed = t;
+}
+
+void SimModule::SetBleed(const simFrame_t& f, uint64_t t) {
+    CANFRM_MODULE_CELL_BALANCE balance;
+    memcpy(&balance, f.data, sizeof(balance));
+    uint64_t mask = balance.cellMaskLo | (uint64_t)balance.cellMaskHi << 16;
+    Bleed(t);
+    for (uint8_t n = 0; n < CELL_BALANCE_FRAME_CELLS && balance.firstCell + n < profile.cells; n++) {
+        bleedUntil[balance.firstCell + n] = (mask >> n) & 1 ? t + balance.duration * 1000000ull : t;
+    }
+}
+
+void SimModule::Sample(uint64_t t) {
+    Bleed(t);
+    for (uint8_t i = 0; i < profile.cells; i++) {
+        int drop = (int)(bleedUs[i] * BLEED_UV_PER_S / 1000000000);
+        voltage[i] = (uint16_t)(CELL_MV_NOMINAL + voltOffset[i] - drop + (int)rng.Uniform(5) - 2);
+        temperature[i] = (uint16_t)(CELL_TEMP_NOMINAL + tempOffset[i] + (int)rng.Uniform(21) - 10);
+    }
+}
+
+void SimModule::Send(uint64_t ready, uint16_t sid, const void* data, uint8_t length, bool fd, uint64_t sampled) {
+    if (rng.ChancePpm(profile.lossPpm)) {
+        framesLost++;
+        return;
+    }
+    BusFrame f;
+    memset(&f, 0, sizeof(f));
+    f.frame.sid = sid;
+    f.frame.eid = id ? id : CAN_MODULE_ID_UNREGISTERED;
+    f.frame.length = length;
+    f.frame.fd = fd;
+    f.frame.brs = fd;
+    memcpy(f.frame.data, data, length);
+    f.ready = ready;
+    f.sampled = sampled;
+    bus.Queue(node, f);
+}
+
+void SimModule::SendStatus(uint64_t ready, bool fd, uint64_t sampled) {
+    CANFRM_MODULE_STATUS_FD status;
+    uint32_t total = 0;
+    uint16_t loV = 0xFFFF, hiV = 0, loT = 0xFFFF, hiT = 0;
+    uint32_t tempTotal = 0;
+
+    memset(&status, 0, sizeof(status));
+    for (uint8_t i = 0; i < profile.cells; i++) {
+        total += voltage[i];
+        tempTotal += temperature[i];
+        if (voltage[i] < loV) loV = voltage[i];
+        if (voltage[i] > hiV) hiV = voltage[i];
+        if (temperature[i] < loT) loT = temperature[i];
+        if (temperature[i] > hiT) hiT = temperature[i];
+    }
+    uint8_t cells = profile.cells ? profile.cells : 1;
+
+    status.status1.moduleState  = state;
+    status.status1.moduleStatus = 0;
+    status.status1.moduleSoc    = 160;      // 80 %
+    status.status1.moduleSoh    = 190;      // 95 %
+    status.status1.cellCount    = profile.cells;
+    status.status1.moduleMmc    = (uint16_t)(CURRENT_ZERO + (int32_t)(profile.currentA / 0.02));
+    status.status1.moduleMmv    = total / 15;
+    status.status2.cellLoVolt   = loV;
+    status.status2.cellHiVolt   = hiV;
+    status.status2.cellAvgVolt  = total / cells;
+    status.status2.cellTotalV   = total / 15;
+    status.status3.cellLoTemp   = loT;
+    status.status3.cellHiTemp   = hiT;
+    status.status3.cellAvgTemp  = tempTotal / cells;
+    status.status3.hwCaps       = profile.canFd ? MODULE_HW_CAP_CANFD : 0;
+
+    if (fd) {
+        Send(ready, ID_MODULE_STATUS_FD, &status, STATUS_FD_BYTES, true, sampled);
+        return;
+    }
+    Send(ready, ID_MODULE_STATUS_1, &status.status1, 8, false, sampled);
+    Send(ready + MODULE_FRAME_GAP, ID_MODULE_STATUS_2, &status.status2, 8, false, sampled);
+    Send(ready + 2 * MODULE_FRAME_GAP, ID_MODULE_STATUS_3, &status.status3, 8, false, sampled);
+}
+
+void SimModule::SendHardware(uint64_t ready, uint64_t sampled) {
+    CANFRM_MODULE_HARDWARE hardware;
+    memset(&hardware, 0, sizeof(hardware));
+    hardware.maxChargeA = HW_MAX_CHARGE;
+    hardware.maxDischargeA = HW_MAX_DISCHARGE;
+    hardware.maxChargeEndV = (uint32_t)profile.cells * 4200 / 15;
+    hardware.hwVersion = 1;
+    Send(ready, ID_MODULE_HARDWARE, &hardware, 8, false, sampled);
+}
+
+void SimModule::SendCellFd(uint64_t ready, uint64_t sampled) {
+    for (uint8_t kind = CELL_FD_VOLTAGE; kind <= CELL_FD_TEMPERATURE; kind++) {
+        const std::vector<uint16_t>& values = kind == CELL_FD_VOLTAGE ? voltage : temperature;
+        for (uint8_t first = 0; first < profile.cells; first += CELL_FD_MAX_CELLS) {
+            CANFRM_MODULE_CELL_FD cellFd;
+            uint8_t count = (uint8_t)(profile.cells - first < CELL_FD_MAX_CELLS ? profile.cells - first : CELL_FD_MAX_CELLS);
+            memset(&cellFd, 0, sizeof(cellFd));
+            cellFd.firstCell = first;
+            cellFd.cellCount = count;
+            cellFd.kind = kind;
+            cellFd.totalCells = profile.cells;
+            memcpy(cellFd.value, &values[first], count * sizeof(uint16_t));
+            Send(ready, ID_MODULE_CELL_FD, &cellFd, (uint8_t)(4 + 2 * count), true, sampled);
+            ready += MODULE_FRAME_GAP;
+        }
+    }
+}
+
+void SimModule::SendDetail(uint64_t ready, uint8_t cellId, uint64_t sampled) {
+    CANFRM_MODULE_DETAIL detail;
+    memset(&detail, 0, sizeof(detail));
+    detail.cellId = cellId;
+    detail.cellCount = profile.cells;
+    detail.cellTemp = temperature[cellId];
+    detail.cellVoltage = voltage[cellId];
+    detail.cellSoc = 160;
+    detail.cellSoh = 190;
+    Send(ready, ID_MODULE_DETAIL, &detail, 8, false, sampled);
+}
+
+void SimModule::SendWindow(uint64_t ready, uint8_t base, uint16_t received) {
+    for (uint8_t n = 0; n < streamWindow && base + n < profile.cells; n++) {
+        if ((received >> n) & 1) continue;
+        SendDetail(ready, (uint8_t)(base + n), streamSampled);
+        ready += MODULE_FRAME_GAP;
+    }
+}
+
+void SimModule::OnPackFrame(const simFrame_t& f, uint64_t t) {
+    uint8_t target = (uint8_t)(f.eid & 0xFF);
+    bool forMe = id != 0 && target == id;
+
+    switch (f.sid) {
+    case ID_MODULE_ANNOUNCE_REQUEST:
+        if (id == 0) {
+            CANFRM_MODULE_ANNOUNCEMENT announcement;
+            memset(&announcement, 0, sizeof(announcement));
+            announcement.moduleFw = 1;
+            announcement.moduleMfgId = 2;
+            announcement.modulePartId = 3;
+            announcement.moduleUniqueId = uniqueId;
+            Send(Turnaround(t) + rng.Uniform(ANNOUNCE_BACKOFF_US), ID_MODULE_ANNOUNCEMENT, &announcement, 8, false, t);
+        }
+        break;
+
+    case ID_MODULE_REGISTRATION: {
+        CANFRM_MODULE_REGISTRATION registration;
+        memcpy(&registration, f.data, sizeof(registration));
+        if (registration.moduleUniqueId == uniqueId) {
+            // ModuleCPU reports its hardware as soon as it is registered
+            id = (uint8_t)registration.moduleId;
+            SendHardware(Turnaround(t), t);
+        }
+        break;
+    }
+
+    case ID_MODULE_STATUS_REQUEST:
+        if (forMe) {
+            Sample(t);
+            SendStatus(Turnaround(t), f.fd && profile.canFd, t);
+        } else if (id != 0 && target == CAN_MODULE_ID_BROADCAST && f.length >= 2) {
+            CANFRM_MODULE_STATUS_BROADCAST request;
+            memcpy(&request, f.data, sizeof(request));
+            uint64_t slot = (uint64_t)(id - 1) * request.slotWidth * MODULE_STATUS_SLOT_UNIT_US;
+            Sample(t);
+            SendStatus(Turnaround(t) + slot, f.fd && profile.canFd, t);
+        }
+        break;
+
+    case ID_MODULE_HARDWARE_REQUEST:
+        if (forMe) SendHardware(Turnaround(t), t);
+        break;
+
+    case ID_MODULE_DETAIL_REQUEST:
+        if (forMe) {
+            CANFRM_MODULE_DETAIL_REQUEST request;
+            memset(&request, 0, sizeof(request));
+            memcpy(&request, f.data, f.length < sizeof(request) ? f.length : sizeof(request));
+            if (f.fd && profile.canFd) {
+                Sample(t);
+                SendCellFd(Turnaround(t), t);
+            } else if (request.cellId < profile.cells) {
+                if (request.cellId == 0) Sample(t);
+                SendDetail(Turnaround(t), (uint8_t)request.cellId, t);
+            }
+        }
+        break;
+
+    case ID_MODULE_DETAIL_STREAM_REQUEST:
+        if (forMe && f.length >= 3) {
+            CANFRM_MODULE_DETAIL_STREAM_REQUEST request;
+            memset(&request, 0, sizeof(request));
+            memcpy(&request, f.data, f.length < sizeof(request) ? f.length : sizeof(request));
+            if (request.windowSize == 0 || request.windowSize > STREAM_WINDOW_MAX || request.firstCell >= profile.cells) break;
+            // one snapshot for the whole transfer, as ModuleCPU takes it
+            Sample(t);
+            streaming = true;
+            streamTransfer = (uint8_t)request.transferId;
+            streamWindow = (uint8_t)request.windowSize;
+            streamSampled = t;
+            SendWindow(Turnaround(t), (uint8_t)request.firstCell, 0);
+        }
+        break;
+
+    case ID_MODULE_DETAIL_WINDOW_ACK:
+        if (forMe && streaming && f.length >= 4) {
+            CANFRM_MODULE_DETAIL_WINDOW_ACK ack;
+            memset(&ack, 0, sizeof(ack));
+            memcpy(&ack, f.data, f.length < sizeof(ack) ? f.length : sizeof(ack));
+            if (ack.transferId != streamTransfer) break;
+            if (ack.status == DETAIL_ACK_RETRY) {
+                SendWindow(Turnaround(t), (uint8_t)ack.windowBase, (uint16_t)ack.bitmap);
+            } else if (ack.status == DETAIL_ACK_OK && ack.windowBase + streamWindow < profile.cells) {
+                SendWindow(Turnaround(t), (uint8_t)(ack.windowBase + streamWindow), 0);
+            } else {
+                // the last window acknowledged, or an abort, ends the transfer
+                streaming = false;
+            }
+        }
+        break;
+
+    case ID_MODULE_STATE_CHANGE:
+        if (forMe) {
+            CANFRM_MODULE_STATE_CHANGE change;
+            memcpy(&change, f.data, sizeof(change));
+            state = (uint8_t)change.state;
+        }
+        break;
+
+    case ID_MODULE_CELL_BALANCE:
+        if (forMe) SetBleed(f, t);
+        break;
+
+    case ID_MODULE_DEREGISTER:
+        if (forMe) {
+            Bleed(t);
+            bleedUntil.assign(profile.cells, 0);
+            id = 0;
+            streaming = false;
+        }
+        break;
+
+    case ID_MODULE_ALL_DEREGISTER:
+        Bleed(t);
+        bleedUntil.assign(profile.cells, 0);
+        id = 0;
+        streaming = false;
+        break;
+
+    case ID_MODULE_ALL_ISOLATE:
+        state = 0;      // moduleOff
+        break;
+
+    default:
+        break;
+    }
+}
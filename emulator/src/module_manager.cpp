@@ -22,6 +22,15 @@ ModuleManager::ModuleManager()
     , minDiscoveryId(1)
     , moduleTimeoutMs(5000)
     , maxModules(32)
+    , broadcastStatusEnabled(false)
+    , broadcastActive(false)
+    , broadcastSlotWidth(MODULE_STATUS_SLOT_DEFAULT)
+    , broadcastStartTime(0)
+    , broadcastExpected(0)
+    , broadcastCompleted(0)
+    , lastSnapshotMs(0)
+    , broadcastCycles(0)
+    , broadcastIncomplete(0)
     , totalMessages(0)
     , totalErrors(0) {
     startTime = GetTickCount();
@@ -376,6 +385,75 @@ void ModuleManager::SetStatusPending(uint8_t moduleId, bool pending) {
     }
 }
 
+void ModuleManager::BeginBroadcastStatus(DWORD currentTime, uint8_t slotWidth) {
+    // A new broadcast replaces any cycle still in progress
+    if (broadcastActive && broadcastCompleted < broadcastExpected) {
+        broadcastIncomplete++;
+    }
+    
+    broadcastActive = true;
+    broadcastSlotWidth = slotWidth;
+    broadcastStartTime = currentTime;
+    broadcastExpected = 0;
+    broadcastCompleted = 0;
+    broadcastCycles++;
+    
+    // Every registered module answers a broadcast - expect STATUS_1/2/3 from each
+    for (std::map<uint8_t, ModuleInfo>::iterator it = modules.begin(); it != modules.end(); ++it) {
+        ModuleInfo& module = it->second;
+        if (!module.isRegistered) continue;
+        
+        module.statusFramesReceived = 0;
+        module.statusPending = true;
+        if (!module.waitingForStatusResponse) {
+            // Keep the original request time for modules already overdue so CheckTimeouts still fires
+            module.waitingForStatusResponse = true;
+            module.statusRequestTime = currentTime;
+        }
+        broadcastExpected++;
+    }
+}
+
+bool ModuleManager::RecordStatusFrame(uint8_t moduleId, uint8_t frameBit) {
+    std::map<uint8_t, ModuleInfo>::iterator it = modules.find(moduleId);
+    if (it == modules.end() || frameBit > 2) {
+        return false;
+    }
+    
+    ModuleInfo& module = it->second;
+    if (module.statusFramesReceived == 0x07) {
+        // Already complete this cycle (late duplicate)
+        return false;
+    }
+    
+    module.statusFramesReceived |= (uint8_t)(1 << frameBit);
+    if (module.statusFramesReceived != 0x07) {
+        return false;
+    }
+    
+    // All three status frames received
+    module.statusPending = false;
+    module.waitingForStatusResponse = false;
+    
+    if (broadcastActive) {
+        broadcastCompleted++;
+        if (broadcastCompleted >= broadcastExpected) {
+            // Whole pack answered - record how long the snapshot took
+            lastSnapshotMs = GetTickCount() - broadcastStartTime;
+            broadcastActive = false;
+        }
+    }
+    return true;
+}
+
+DWORD ModuleManager::GetBroadcastSlotOffsetUs(uint8_t moduleId) const {
+    // Module N starts replying (N-1) slots after the request
+    if (moduleId < CAN_MODULE_ID_MIN || moduleId > CAN_MODULE_ID_MAX) {
+        return 0;
+    }
+    return (DWORD)(moduleId - 1) * broadcastSlotWidth * MODULE_STATUS_SLOT_UNIT_US;
+}
+
 float ModuleManager::GetPackVoltage() {
     float total = 0.0f;
     for (std::map<uint8_t, ModuleInfo>::const_iterator iter = modules.begin(); iter != modules.end(); ++iter) {
@@ -24,6 +24,7 @@ __fastcall TMainForm::TMainForm(TComponent* Owner)
     , isConnected(false)
     , selectedModuleId(0)
     , nextModuleToPoll(0)
+    , broadcastSequence(0)
     , lastPollTime(0)
     , selectedState(PackEmulator::ModuleState::OFF)
     , pollingCellDetails(false)
@@ -1038,6 +1039,9 @@ void TMainForm::OnCANMessage(const PackEmulator::CANMessage& msg) {
         case ID_MODULE_DETAIL:
             description = " [Module Detail]";
             break;
+        case ID_MODULE_CELL_PACKED:
+            description = " [Cell Packed]";
+            break;
         case ID_MODULE_CELL_COMM_STATUS1:
             description = " [Cell Comm Status]";
             break;
@@ -1198,6 +1202,7 @@ void TMainForm::OnCANMessage(const PackEmulator::CANMessage& msg) {
         
         // Clear the pending flag since we got a response
         moduleManager->SetStatusPending(moduleId, false);
+        moduleManager->RecordStatusFrame(moduleId, 0);
         ProcessModuleStatus1(moduleId, msg.data);
     }
     else if (canId == ID_MODULE_STATUS_2) {
@@ -1208,6 +1213,7 @@ void TMainForm::OnCANMessage(const PackEmulator::CANMessage& msg) {
         if (++status2Count % 10 == 0) {
             LogMessage("<- 0x" + IntToHex((int)canId, 3) + " STATUS_2 from module " + IntToStr(moduleId));
         }
+        moduleManager->RecordStatusFrame(moduleId, 1);
         ProcessModuleStatus2(moduleId, msg.data);
     }
     else if (canId == ID_MODULE_STATUS_3) {
@@ -1218,6 +1224,7 @@ void TMainForm::OnCANMessage(const PackEmulator::CANMessage& msg) {
         if (++status3Count % 10 == 0) {
             LogMessage("<- 0x" + IntToHex((int)canId, 3) + " STATUS_3 from module " + IntToStr(moduleId));
         }
+        moduleManager->RecordStatusFrame(moduleId, 2);
         ProcessModuleStatus3(moduleId, msg.data);
     }
     else if (canId == ID_MODULE_HARDWARE) {
@@ -1244,6 +1251,10 @@ void TMainForm::OnCANMessage(const PackEmulator::CANMessage& msg) {
                   " for cell " + IntToStr(cellId));
         ProcessModuleDetail(moduleIdFromExtended, msg.data);
     }
+    // Check for packed multi-cell messages
+    else if (canId == ID_MODULE_CELL_PACKED) {
+        ProcessCellPacked(msg.id, msg.data, msg.length);
+    }
     // Check for cell comm status messages
     else if (canId == ID_MODULE_CELL_COMM_STATUS1) {
         ProcessModuleCellCommStatus(moduleIdFromExtended, msg.data);
@@ -1396,6 +1407,46 @@ void TMainForm::ProcessModuleFault(uint8_t moduleId, const uint8_t* data) {
     // For now, we'll just log the fault. Could enhance ModuleInfo to track faultCode
 }
 
+void TMainForm::ProcessCellPacked(uint32_t extendedId, const uint8_t* data, uint8_t length) {
+    // Parse MODULE_CELL_PACKED (0x50A) - see protocols/can_cell_pack.h
+    // Extended ID bits 0-7: module ID, bits 8-15: first cell, bit 16: voltage (0) or temperature (1)
+    // Payload: 16-bit base value for the first cell, then up to four 12-bit deltas
+    uint32_t eid = extendedId & 0x3FFFF;
+    uint8_t moduleId = CellPack_ModuleId(eid);
+    uint8_t firstCell = CellPack_FirstCell(eid);
+    bool isTemperature = (CellPack_Kind(eid) == CELL_PACK_TEMPERATURE);
+
+    PackEmulator::ModuleInfo* module = moduleManager->GetModule(moduleId);
+    if (module == NULL) return;
+
+    uint16_t values[CELL_PACK_MAX_CELLS];
+    uint8_t cells = CellPack_Decode(data, length, values);
+    if (cells == 0) {
+        LogMessage("Module " + IntToStr(moduleId) + " packed cell frame with bad length " + IntToStr(length));
+        return;
+    }
+
+    // Grow the cell arrays if this frame reaches past what we have seen so far
+    size_t needed = (size_t)firstCell + cells;
+    if (module->cellVoltages.size() < needed) {
+        module->cellVoltages.resize(needed, 0.0f);
+        module->cellTemperatures.resize(needed, 0.0f);
+        module->cellLastUpdateTimes.resize(needed, 0);
+    }
+
+    DWORD now = GetTickCount();
+    for (uint8_t i = 0; i < cells; i++) {
+        size_t cellId = (size_t)firstCell + i;
+        if (isTemperature) {
+            module->cellTemperatures[cellId] = (values[i] * 0.01f) - 55.35f;
+        } else {
+            module->cellVoltages[cellId] = values[i] * 0.001f;
+        }
+        module->cellLastUpdateTimes[cellId] = now;
+    }
+    module->lastMessageTime = now;
+}
+
 void TMainForm::ProcessModuleDetail(uint8_t moduleId, const uint8_t* data) {
     // Parse MODULE_DETAIL (0x505) - Protocol updated Sept 24, 2025:
     // Byte 0: Cell ID (requested cell number)
@@ -1587,7 +1638,7 @@ void TMainForm::ProcessModuleStatus3(uint8_t moduleId, const uint8_t* data) {
     // Bytes 0-1: cellLoTemp (16 bits, TEMPERATURE_FACTOR = 0.01°C per bit, -55.35°C offset)
     // Bytes 2-3: cellHiTemp (16 bits, TEMPERATURE_FACTOR = 0.01°C per bit, -55.35°C offset)
     // Bytes 4-5: cellAvgTemp (16 bits, TEMPERATURE_FACTOR = 0.01°C per bit, -55.35°C offset)
-    // Bytes 6-7: UNUSED
+    // Byte 6 bits 0-3: hwCaps (MODULE_HW_CAP_CANFD), rest UNUSED
     // Note: Temperature encoding: actual_celsius = (raw * 0.01) - 55.35
     
     // Reuse the module pointer we already have
@@ -1818,6 +1869,30 @@ void TMainForm::SendModuleStatusRequest(uint8_t moduleId) {
     }
 }
 
+void TMainForm::SendBroadcastStatusRequest() {
+    if (!isConnected) return;
+    
+    // Send status request to all registered modules (0x512 to module ID 0x00)
+    // Each module replies with STATUS_1/2/3 starting (moduleId - 1) * slotWidth * 100us after this frame
+    CANFRM_MODULE_STATUS_BROADCAST request;
+    uint8_t data[2];
+    request.slotWidth = MODULE_STATUS_SLOT_DEFAULT;
+    request.sequence = ++broadcastSequence;
+    memcpy(data, &request, sizeof(data));
+    
+    uint32_t extendedId = ((uint32_t)ID_MODULE_STATUS_REQUEST << 18) | CAN_MODULE_ID_BROADCAST;
+    
+    if (canInterface->SendMessage(extendedId, data, sizeof(data), true)) {
+        moduleManager->BeginBroadcastStatus(GetTickCount(), request.slotWidth);
+        
+        // Log occasionally to avoid spam
+        if (broadcastSequence % 20 == 0) {
+            LogMessage("→ 0x512 [Broadcast Status Request] seq " + IntToStr(broadcastSequence) +
+                       " last snapshot " + IntToStr((int)moduleManager->GetLastSnapshotMs()) + "ms");
+        }
+    }
+}
+
 //---------------------------------------------------------------------------
 void __fastcall TMainForm::DiscoveryTimerTimer(TObject *Sender) {
     (void)Sender;
@@ -1841,6 +1916,18 @@ void __fastcall TMainForm::PollTimerTimer(TObject *Sender) {
     std::vector<uint8_t> moduleIds = moduleManager->GetRegisteredModuleIds();
     if (moduleIds.empty()) return;
     
+    // Broadcast mode - one request per refresh, modules answer in their own slots
+    if (moduleManager->IsBroadcastStatusEnabled()) {
+        DWORD currentTime = GetTickCount();
+        if (moduleManager->IsBroadcastStatusActive() && currentTime - lastPollTime < 250) {
+            return;  // Previous cycle still collecting replies
+        }
+        lastPollTime = currentTime;
+        messageFlags.statusRequest = true;
+        messageFlags.statusModuleId = CAN_MODULE_ID_BROADCAST;
+        return;
+    }
+    
     // Simple round-robin polling - poll one module per timer tick
     if (nextModuleToPoll >= moduleIds.size()) {
         nextModuleToPoll = 0;
@@ -2053,6 +2140,11 @@ void TMainForm::SendCellDetailRequest() {
 void TMainForm::SendStatusRequest() {
     uint8_t moduleId = messageFlags.statusModuleId;
     
+    if (moduleId == CAN_MODULE_ID_BROADCAST) {
+        SendBroadcastStatusRequest();
+        return;
+    }
+    
     // Check if module is still waiting for a previous status response
     PackEmulator::ModuleInfo* module = moduleManager->GetModule(moduleId);
     bool isRetry = false;
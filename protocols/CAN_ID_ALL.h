@@ -115,10 +115,55 @@
  *   - 0x51D ANNOUNCE_REQUEST - Request all unregistered modules announce
  *
  * To All Registered (0x00):
+ *   - 0x512 STATUS_REQUEST - Slotted status poll, see BROADCAST STATUS REQUEST below
  *   - 0x517 MAX_STATE - Set maximum allowed operational state
  *   - 0x51E ALL_DEREGISTER - Deregister all modules
  *   - 0x51F ALL_ISOLATE - Isolate all modules (open relays)
  *
+ * BROADCAST STATUS REQUEST:
+ *
+ *   Pack sends (0x512 << 18) | 0x00 with CANFRM_MODULE_STATUS_BROADCAST (2 bytes).
+ *   Each registered module waits (moduleId - 1) * slotWidth * MODULE_STATUS_SLOT_UNIT_US
+ *   after reception, then sends STATUS_1, STATUS_2 and STATUS_3 back to back.
+ *   One pack frame replaces one 0x512 per module, and the responses arrive in ID order
+ *   without contending for the bus. The default slot (1.2 ms) fits three extended
+ *   8-byte frames at 500 kbit/s with worst case bit stuffing.
+ *
+ * STREAMING CELL DETAIL:
+ *
+ *   Pack sends (0x519 << 18) | moduleId with CANFRM_MODULE_DETAIL_STREAM_REQUEST.
+ *   The module sends windowSize MODULE_DETAIL (0x505) frames back to back, starting
+ *   at firstCell, then waits for (0x51A << 18) | moduleId CANFRM_MODULE_DETAIL_WINDOW_ACK:
+ *     DETAIL_ACK_OK     whole window received - send the next window
+ *     DETAIL_ACK_RETRY  resend the cells whose bitmap bit is clear
+ *     DETAIL_ACK_ABORT  stop the transfer
+ *   The ACK of the last window ends the transfer. Replaces one 0x515/0x505 round
+ *   trip per cell with one ACK per window.
+ *
+ * CELL BALANCING:
+ *
+ *   Pack sends (0x51B << 18) | moduleId with CANFRM_MODULE_CELL_BALANCE, one frame per
+ *   CELL_BALANCE_FRAME_CELLS cells starting at firstCell. Bit n of cellMask set = bleed
+ *   cell firstCell + n, clear = stop bleeding it. The module bleeds for at most
+ *   'duration' seconds after the frame and then stops by itself, so a pack controller
+ *   that goes quiet never leaves a resistor on. The pack repeats the masks well inside
+ *   the duration while balancing, and sends all-clear masks when it stops.
+ *
+ * CAN FD MODULE BUS:
+ *
+ *   A module sets MODULE_HW_CAP_CANFD in CANFRM_MODULE_STATUS_3.hwCaps when it handles
+ *   CAN FD (500 kbit/s arbitration, 2 Mbit/s data). The bits were unused and zero before,
+ *   so a module that predates them reads as classic only. Once every registered module has
+ *   reported it, the pack sends STATUS_REQUEST and DETAIL_REQUEST as FD frames with BRS
+ *   set. A module answers an FD request with FD frames:
+ *     0x50B STATUS_FD  CANFRM_MODULE_STATUS_FD in place of STATUS_1/2/3 (at least 24 bytes)
+ *     0x50C CELL_FD    CANFRM_MODULE_CELL_FD in place of MODULE_DETAIL - every cell from
+ *                      the requested cellId, all voltages then all temperatures, up to
+ *                      CELL_FD_MAX_CELLS per frame
+ *   A module answers a classic request with classic frames. When a module without FD
+ *   support registers, the pack returns to classic requests, so older modules never see
+ *   an FD frame from the pack.
+ *
  * FILTERING BENEFITS:
  *
  * - Modules don't hear each other's responses (reduced bus load)
@@ -139,6 +184,28 @@
 #define CAN_MODULE_ID_MAX           0x1F  // Last assignable module ID (31 modules)
 #define CAN_MODULE_ID_UNREGISTERED  0xFF  // Unregistered module announcement
 
+// Broadcast status request response slots
+#define MODULE_STATUS_SLOT_UNIT_US  100   // Slot width unit - microseconds
+#define MODULE_STATUS_SLOT_DEFAULT  12    // Default slot width - 1.2 ms per module
+#define MODULE_STATUS_SLOT_FD       3     // Slot width on a CAN FD bus - one STATUS_FD frame per module
+
+// Streaming cell detail window ACK status
+#define DETAIL_ACK_OK               0x00
+#define DETAIL_ACK_RETRY            0x01
+#define DETAIL_ACK_ABORT            0xFF
+#define DETAIL_WINDOW_MAX           16    // Cells per window - one bit each in the ACK bitmap
+
+// Cell balancing
+#define CELL_BALANCE_FRAME_CELLS    48    // Cells per CELL_BALANCE frame - one bit each in cellMask
+
+// CANFRM_MODULE_STATUS_3 hwCaps bits
+#define MODULE_HW_CAP_CANFD         0x01  // Module sends and receives CAN FD frames (2 Mbit/s data phase)
+
+// CAN FD cell frame
+#define CELL_FD_VOLTAGE             0     // kind - cell voltages
+#define CELL_FD_TEMPERATURE         1     // kind - cell temperatures
+#define CELL_FD_MAX_CELLS           30    // 64 byte payload - 4 byte header + 30 x 16 bit values
+
 // ========================================
 // BMS DIAGNOSTIC MESSAGES (0x220-0x228)
 // VCU <-> Pack Controller Diagnostic Interface
@@ -206,6 +273,7 @@
 #define ID_VCU_MODULE_COMMAND       0x404
 #define ID_VCU_KEEP_ALIVE           0x405
 #define ID_VCU_REQUEST_MODULE_LIST  0x406
+#define ID_VCU_REQUEST_TELEMETRY    0x40B    // Module status history, answered with MODULE_TELEMETRY
 
 // Web4 Key Distribution (VCU to Pack Controller)
 #define ID_VCU_WEB4_PACK_KEY_HALF   0x407    // Pack controller's device key half
@@ -222,6 +290,29 @@
 #define ID_MODULE_CELL_ID           0x415
 #define ID_MODULE_LIMITS            0x416
 #define ID_MODULE_LIST              0x417
+#define ID_MODULE_TELEMETRY         0x418    // One page of one history entry, see MODULE TELEMETRY below
+
+// MODULE TELEMETRY
+//
+// The pack keeps a history of every module's published status: the latest sets at full rate (RAW) and
+// min/max/avg over 1 s, 10 s and 60 s periods. VCU_REQUEST_TELEMETRY names a module, a tier and a run of
+// entries counted back from the newest. Each entry comes back as TELEM_PAGES MODULE_TELEMETRY frames:
+//   TELEM_PAGE_VOLTAGE    module voltage min, max, avg            (0.015 V, as MODULE_POWER)
+//   TELEM_PAGE_CURRENT    module current min, max, avg            (0.02 A - 655.36 A, as MODULE_POWER)
+//   TELEM_PAGE_CELL_VOLT  lowest cell, highest cell               (0.001 V), SOC avg | samples << 8
+//   TELEM_PAGE_CELL_TEMP  lowest cell, highest cell               (0.01 C - 55.35 C), age in 0.1 s
+// A RAW entry is one status set, so min, max and avg are equal and samples is 1. Age is from the sample,
+// or the period start, to the reply (65535 = older). The reply stops at the oldest entry kept; a module
+// or tier with no entries is not answered.
+#define TELEM_TIER_RAW              0
+#define TELEM_TIER_1S               1
+#define TELEM_TIER_10S              2
+#define TELEM_TIER_60S              3
+#define TELEM_PAGE_VOLTAGE          0
+#define TELEM_PAGE_CURRENT          1
+#define TELEM_PAGE_CELL_VOLT        2
+#define TELEM_PAGE_CELL_TEMP        3
+#define TELEM_PAGES                 4
 
 #define ID_BMS_DATA_1               0x421
 #define ID_BMS_DATA_2               0x422
@@ -261,6 +352,9 @@
 #define ID_MODULE_CELL_COMM_STATUS1 0x507
 #define ID_MODULE_CELL_COMM_STATUS2 0x508
 #define ID_MODULE_STATUS_4          0x509
+#define ID_MODULE_CELL_PACKED       0x50A  // Up to 5 cells per frame, see can_cell_pack.h - EID bits 8-16 = first cell, kind
+#define ID_MODULE_STATUS_FD         0x50B  // CAN FD only - STATUS_1/2/3 in one frame, see CAN FD MODULE BUS
+#define ID_MODULE_CELL_FD           0x50C  // CAN FD only - up to 30 raw cell values per frame
 
 // Pack Controller to Module Controller
 // Extended Frame: (Base ID << 18) | Module ID
@@ -269,12 +363,15 @@
 // Module-specific uses Module ID = 0x01-0x1F
 #define ID_MODULE_REGISTRATION      0x510  // Module ID = 0xFF (unregistered modules only)
 #define ID_MODULE_HARDWARE_REQUEST  0x511  // Module ID = 0x01-0x1F (specific module)
-#define ID_MODULE_STATUS_REQUEST    0x512  // Module ID = 0x01-0x1F (specific module)
+#define ID_MODULE_STATUS_REQUEST    0x512  // Module ID = 0x01-0x1F (specific module) or 0x00 (broadcast, slotted replies)
 #define ID_MODULE_STATE_CHANGE      0x514  // Module ID = 0x01-0x1F (specific module)
 #define ID_MODULE_DETAIL_REQUEST    0x515  // Module ID = 0x01-0x1F (specific module)
 #define ID_MODULE_SET_TIME          0x516  // Module ID = 0x01-0x1F (specific module)
 #define ID_MODULE_MAX_STATE         0x517  // Module ID = 0x00 (broadcast - all registered modules)
 #define ID_MODULE_DEREGISTER        0x518  // Module ID = 0x01-0x1F (specific module)
+#define ID_MODULE_DETAIL_STREAM_REQUEST 0x519  // Module ID = 0x01-0x1F (specific module)
+#define ID_MODULE_DETAIL_WINDOW_ACK 0x51A  // Module ID = 0x01-0x1F (specific module)
+#define ID_MODULE_CELL_BALANCE      0x51B  // Module ID = 0x01-0x1F (specific module)
 #define ID_MODULE_ANNOUNCE_REQUEST  0x51D  // Module ID = 0xFF (unregistered modules only)
 #define ID_MODULE_ALL_DEREGISTER    0x51E  // Module ID = 0x00 (broadcast - all registered modules)
 #define ID_MODULE_ALL_ISOLATE       0x51F  // Module ID = 0x00 (broadcast - all registered modules)